@@ -861,6 +861,58 @@ bool HugeTLBFS_SHM::unmap(void* ptr) {
   return true;
 }
 
+void* HugeTLBFS_SHM::map_shared(const std::string& name, size_t length,
+                                bool create, void* addr) {
+  assert(name.compare(0, filename_prefix_.size(), filename_prefix_) != 0);
+
+  length = roundup(length);
+
+  char path[PATH_MAX];
+  snprintf(path, PATH_MAX, "%s/%s", hugetlbfs_path_.c_str(), name.c_str());
+
+  int fd = open(path, create ? (O_CREAT | O_RDWR) : O_RDWR, 0755);
+  if (fd == -1) {
+    perror("");
+    fprintf(stderr, "error: could not open %s\n", path);
+    return nullptr;
+  }
+
+  if (create && ftruncate(fd, static_cast<off_t>(length)) != 0) {
+    perror("");
+    fprintf(stderr, "error: could not resize %s\n", path);
+    close(fd);
+    return nullptr;
+  }
+
+  // Without MAP_FIXED, addr is only a hint that is not taken if the address
+  // range is in use.
+  void* p = mmap(addr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (p == MAP_FAILED) {
+    fprintf(stderr, "error: could not map %s\n", path);
+    return nullptr;
+  }
+  if (addr != nullptr && p != addr) {
+    munmap(p, length);
+    fprintf(stderr, "error: could not map %s at %p\n", path, addr);
+    return nullptr;
+  }
+
+  if (verbose_) printf("mapped shared file %s at %p\n", path, p);
+  return p;
+}
+
+bool HugeTLBFS_SHM::unmap_shared(void* ptr, size_t length) {
+  return munmap(ptr, roundup(length)) == 0;
+}
+
+bool HugeTLBFS_SHM::remove_shared(const std::string& name) {
+  char path[PATH_MAX];
+  snprintf(path, PATH_MAX, "%s/%s", hugetlbfs_path_.c_str(), name.c_str());
+  return unlink(path) == 0;
+}
+
 void* HugeTLBFS_SHM::malloc_contiguous(size_t size, size_t lcore) {
   size = HugeTLBFS_SHM::roundup(size);
   // size_t entry_id = mehcached_shm_alloc(size, (size_t)-1);
@@ -56,6 +56,17 @@ class HugeTLBFS_SHM {
   bool map(size_t entry_id, void* ptr, size_t offset, size_t length);
   bool unmap(void* ptr);
 
+  // Maps a file named name in hugetlbfs_path so that other processes can map
+  // the same memory by name.  The file is created with length bytes if create
+  // is true.  If addr is given, the file is mapped only at that address (e.g.,
+  // the address used by an earlier process) without replacing any existing
+  // mapping.  The name must not start with filename_prefix, and other processes
+  // using the same directory must disable clean_other_files_on_init.
+  void* map_shared(const std::string& name, size_t length, bool create,
+                   void* addr = nullptr);
+  bool unmap_shared(void* ptr, size_t length);
+  bool remove_shared(const std::string& name);
+
   size_t get_memuse() const { return used_memory_; }
   void dump_page_info();
 
@@ -0,0 +1,783 @@
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "mica/transaction/db.h"
+#include "mica/util/lcore.h"
+
+// Checks BTreeIndex against a std::set of the keys that it should have:
+// count_range(), rank(), and select() with subtree counts
+// (BasicDBConfig::kBTreeSubtreeCounts) after mixed inserts and removes that
+// split and merge nodes, along with check() on the tree.  Also checks
+// BTreeIndex::Scanner in both directions with every range type, offsets, and
+// limits, and scans resumed from cursors in later transactions.
+// CompositeKey keys with signed and unsigned fields must order like tuples of
+// the fields, both as keys and in an index.  BTreeStringKey keys must order
+// like std::string in unique and non-unique indexes.
+
+struct DBConfig : public ::mica::transaction::BasicDBConfig {
+  static constexpr bool kBTreeSubtreeCounts = true;
+  typedef ::mica::transaction::NullLogger<DBConfig> Logger;
+};
+
+typedef DBConfig::Alloc Alloc;
+typedef ::mica::transaction::PagePool<DBConfig> PagePool;
+typedef ::mica::transaction::DB<DBConfig> DB;
+typedef ::mica::transaction::Transaction<DBConfig> Transaction;
+typedef ::mica::transaction::BTreeRangeType BTreeRangeType;
+typedef DB::BTreeIndexUniqueU64 BTreeIndex;
+typedef BTreeIndex::Scanner Scanner;
+typedef BTreeIndex::ScanSlice ScanSlice;
+typedef BTreeIndex::ScanCursor ScanCursor;
+// Two words, which use the SIMD node search.
+typedef ::mica::transaction::CompositeKey<int16_t, uint8_t, int32_t, int64_t>
+    SignedKey;
+typedef std::tuple<int16_t, uint8_t, int32_t, int64_t> SignedTuple;
+typedef DB::BTreeIndexT<SignedKey> BTreeIndexSigned;
+typedef DB::StringKey StringKey;
+typedef DB::BTreeIndexUniqueString BTreeIndexString;
+typedef DB::BTreeIndexNonuniqueString BTreeIndexNonuniqueString;
+
+static ::mica::util::Stopwatch sw;
+
+// For the main table.  Not really used.
+static const uint64_t kDataSize = 8;
+// The number of index operations in a transaction.
+static const uint64_t kBatchSize = 16;
+// The number of random queries after each round of updates.
+static const uint64_t kQueryCount = 1000;
+// The number of random scans.
+static const uint64_t kScanCount = 300;
+// The number of keys in the CompositeKey index.
+static const uint64_t kCompositeKeyCount = 2000;
+// The number of keys in the string indexes.
+static const uint64_t kStringKeyCount = 2000;
+
+static uint64_t failure_count = 0;
+
+static void check(bool cond, const char* what) {
+  if (cond) return;
+  printf("  FAILED: %s\n", what);
+  failure_count++;
+}
+
+static uint64_t make_value(uint64_t key) { return key * 3 + 1; }
+
+// Applies op to the keys in transactions of kBatchSize keys, retrying aborted
+// transactions.  op returns the result of the index operation.
+template <typename Op>
+static uint64_t run_batches(DB* db, const std::vector<uint64_t>& keys,
+                            const Op& op) {
+  Transaction tx(db->context(0));
+  uint64_t succeeded = 0;
+  for (uint64_t i = 0; i < keys.size(); i += kBatchSize) {
+    auto end = std::min(i + kBatchSize, uint64_t(keys.size()));
+    while (true) {
+      bool ok = tx.begin();
+      uint64_t batch_succeeded = 0;
+      for (uint64_t j = i; ok && j < end; j++) {
+        auto ret = op(&tx, keys[j]);
+        if (ret == BTreeIndex::kHaveToAbort)
+          ok = false;
+        else
+          batch_succeeded += ret;
+      }
+      if (!ok) {
+        tx.abort();
+        continue;
+      }
+      if (tx.commit()) {
+        succeeded += batch_succeeded;
+        break;
+      }
+    }
+  }
+  return succeeded;
+}
+
+// Compares count_range(), rank(), and select() with the sorted keys at random
+// points in [0, key_range).
+static void check_ranks(DB* db, BTreeIndex* idx,
+                        const std::set<uint64_t>& key_set, uint64_t key_range,
+                        std::mt19937_64& rng) {
+  std::vector<uint64_t> keys(key_set.begin(), key_set.end());
+  auto lower = [&keys](uint64_t key) {
+    return static_cast<uint64_t>(
+        std::lower_bound(keys.begin(), keys.end(), key) - keys.begin());
+  };
+  auto upper = [&keys](uint64_t key) {
+    return static_cast<uint64_t>(
+        std::upper_bound(keys.begin(), keys.end(), key) - keys.begin());
+  };
+  auto diff = [](uint64_t a, uint64_t b) { return a > b ? a - b : 0; };
+
+  Transaction tx(db->context(0));
+  tx.begin();
+  check(idx->check(&tx), "check tree");
+
+  uint64_t rank_mismatches = 0;
+  uint64_t count_mismatches = 0;
+  uint64_t select_mismatches = 0;
+  for (uint64_t q = 0; q < kQueryCount; q++) {
+    auto a = rng() % key_range;
+    auto b = rng() % key_range;
+    bool skip_validation = (q & 1) != 0;
+
+    if (idx->rank(&tx, a, skip_validation) != lower(a)) rank_mismatches++;
+
+    if (idx->count_range<BTreeRangeType::kInclusive,
+                         BTreeRangeType::kInclusive>(
+            &tx, a, b, skip_validation) != diff(upper(b), lower(a)) ||
+        idx->count_range<BTreeRangeType::kExclusive,
+                         BTreeRangeType::kExclusive>(
+            &tx, a, b, skip_validation) != diff(lower(b), upper(a)) ||
+        idx->count_range<BTreeRangeType::kOpen, BTreeRangeType::kExclusive>(
+            &tx, a, b, skip_validation) != lower(b) ||
+        idx->count_range<BTreeRangeType::kInclusive, BTreeRangeType::kOpen>(
+            &tx, a, b, skip_validation) != keys.size() - lower(a) ||
+        idx->count_range<BTreeRangeType::kOpen, BTreeRangeType::kOpen>(
+            &tx, a, b, skip_validation) != keys.size())
+      count_mismatches++;
+
+    // Some k are past the last key.
+    auto k = rng() % (keys.size() + 3);
+    uint64_t found_key = 0;
+    uint64_t found_value = 0;
+    auto ret = idx->select(&tx, k, skip_validation,
+                           [&](const uint64_t& key, uint64_t value) {
+                             found_key = key;
+                             found_value = value;
+                             return true;
+                           });
+    if (k < keys.size() ? ret != 1 || found_key != keys[k] ||
+                              found_value != make_value(keys[k])
+                        : ret != 0)
+      select_mismatches++;
+  }
+  check(tx.commit(), "commit queries");
+
+  check(rank_mismatches == 0, "rank");
+  check(count_mismatches == 0, "count_range");
+  check(select_mismatches == 0, "select");
+}
+
+static void test_rank(DB* db, uint64_t num_keys) {
+  printf("rank:\n");
+
+  bool ret = db->create_btree_index_unique_u64("rank_idx",
+                                               db->get_table("main"));
+  assert(ret);
+  (void)ret;
+  auto idx = db->get_btree_index_unique_u64("rank_idx");
+  {
+    Transaction tx(db->context(0));
+    idx->init(&tx);
+  }
+
+  std::mt19937_64 rng(1);
+  std::set<uint64_t> key_set;
+  auto key_range = num_keys * 4;
+  check_ranks(db, idx, key_set, key_range, rng);
+
+  // Mostly inserts first, and then mostly removes, so that nodes are split
+  // and later merged.
+  for (int round = 0; round < 6; round++) {
+    std::vector<uint64_t> insert_keys;
+    std::vector<uint64_t> remove_keys;
+    for (uint64_t i = 0; i < num_keys; i++) {
+      auto key = rng() % key_range;
+      if ((round < 3) == (rng() % 4 != 0))
+        insert_keys.push_back(key);
+      else
+        remove_keys.push_back(key);
+    }
+
+    std::set<uint64_t> expected = key_set;
+    uint64_t inserted_count = 0;
+    for (auto key : insert_keys)
+      if (expected.insert(key).second) inserted_count++;
+    uint64_t removed_count = 0;
+    for (auto key : remove_keys)
+      if (expected.erase(key) != 0) removed_count++;
+
+    auto inserted =
+        run_batches(db, insert_keys, [idx](Transaction* tx, uint64_t key) {
+          return idx->insert(tx, key, make_value(key));
+        });
+    auto removed =
+        run_batches(db, remove_keys, [idx](Transaction* tx, uint64_t key) {
+          return idx->remove(tx, key, make_value(key));
+        });
+    check(inserted == inserted_count, "insert new keys only");
+    check(removed == removed_count, "remove present keys only");
+    key_set.swap(expected);
+
+    check_ranks(db, idx, key_set, key_range, rng);
+  }
+
+  std::vector<uint64_t> remaining(key_set.begin(), key_set.end());
+  auto removed =
+      run_batches(db, remaining, [idx](Transaction* tx, uint64_t key) {
+        return idx->remove(tx, key, make_value(key));
+      });
+  check(removed == remaining.size(), "remove all keys");
+  key_set.clear();
+  check_ranks(db, idx, key_set, key_range, rng);
+}
+
+// The keys of key_set in [min_key, max_key] with the bound types, in scan
+// order.
+static std::vector<uint64_t> expected_scan(const std::set<uint64_t>& key_set,
+                                           BTreeRangeType left_type,
+                                           uint64_t min_key,
+                                           BTreeRangeType right_type,
+                                           uint64_t max_key, bool reversed) {
+  std::vector<uint64_t> keys;
+  for (auto key : key_set) {
+    if ((left_type == BTreeRangeType::kInclusive && key < min_key) ||
+        (left_type == BTreeRangeType::kExclusive && key <= min_key))
+      continue;
+    if ((right_type == BTreeRangeType::kInclusive && key > max_key) ||
+        (right_type == BTreeRangeType::kExclusive && key >= max_key))
+      continue;
+    keys.push_back(key);
+  }
+  if (reversed) std::reverse(keys.begin(), keys.end());
+  return keys;
+}
+
+// Appends the keys of the scanner's slices to keys after checking the values.
+// Returns false if the transaction has to abort.
+static bool drain_scanner(Scanner* scanner, std::vector<uint64_t>* keys,
+                          uint64_t* value_mismatches) {
+  ScanSlice slice;
+  while (true) {
+    auto n = scanner->next(&slice);
+    if (n == BTreeIndex::kHaveToAbort) return false;
+    if (n == 0) return true;
+    for (uint64_t i = 0; i < n; i++) {
+      keys->push_back(slice.key(i));
+      if (slice.value(i) != make_value(slice.key(i))) (*value_mismatches)++;
+    }
+  }
+}
+
+static void test_scan(DB* db, uint64_t num_keys) {
+  printf("scan:\n");
+
+  bool ret = db->create_btree_index_unique_u64("scan_idx",
+                                               db->get_table("main"));
+  assert(ret);
+  (void)ret;
+  auto idx = db->get_btree_index_unique_u64("scan_idx");
+  {
+    Transaction tx(db->context(0));
+    idx->init(&tx);
+  }
+
+  std::mt19937_64 rng(2);
+  auto key_range = num_keys * 4;
+  std::set<uint64_t> key_set;
+  for (uint64_t i = 0; i < num_keys; i++) key_set.insert(rng() % key_range);
+  std::vector<uint64_t> keys(key_set.begin(), key_set.end());
+  std::shuffle(keys.begin(), keys.end(), rng);
+  auto inserted =
+      run_batches(db, keys, [idx](Transaction* tx, uint64_t key) {
+        return idx->insert(tx, key, make_value(key));
+      });
+  check(inserted == keys.size(), "insert keys");
+
+  const BTreeRangeType kRangeTypes[] = {BTreeRangeType::kOpen,
+                                        BTreeRangeType::kInclusive,
+                                        BTreeRangeType::kExclusive};
+
+  uint64_t scan_mismatches = 0;
+  uint64_t resume_mismatches = 0;
+  uint64_t value_mismatches = 0;
+  uint64_t aborts = 0;
+  Transaction tx(db->context(0));
+  for (uint64_t q = 0; q < kScanCount; q++) {
+    auto left_type = kRangeTypes[rng() % 3];
+    auto right_type = kRangeTypes[rng() % 3];
+    // Some ranges are empty or reversed.
+    auto min_key = rng() % key_range;
+    auto max_key = rng() % 8 == 0 ? rng() % key_range
+                                  : min_key + rng() % (key_range / 8);
+    bool reversed = (q & 1) != 0;
+    bool skip_validation = (q & 2) != 0;
+    auto offset = rng() % 4 == 0 ? rng() % 200 : 0;
+    auto limit = rng() % 2 == 0 ? rng() % 200 : Scanner::kNoLimit;
+
+    auto expected = expected_scan(key_set, left_type, min_key, right_type,
+                                  max_key, reversed);
+    auto first = std::min(offset, uint64_t(expected.size()));
+    auto last = std::min(limit == Scanner::kNoLimit ? expected.size()
+                                                    : first + limit,
+                         uint64_t(expected.size()));
+
+    std::vector<uint64_t> found;
+    tx.begin();
+    Scanner scanner(idx, &tx, left_type, min_key, right_type, max_key,
+                    reversed, skip_validation);
+    scanner.set_offset(offset);
+    scanner.set_limit(limit);
+    if (!drain_scanner(&scanner, &found, &value_mismatches)) {
+      tx.abort();
+      aborts++;
+      continue;
+    }
+    if (!tx.commit()) {
+      aborts++;
+      continue;
+    }
+    if (found !=
+        std::vector<uint64_t>(
+            expected.begin() + static_cast<std::ptrdiff_t>(first),
+            expected.begin() + static_cast<std::ptrdiff_t>(last)))
+      scan_mismatches++;
+    // The cursor reaches the end only if the limit did not stop the scan.
+    if (scanner.cursor().end != (last == expected.size())) scan_mismatches++;
+
+    // Scan the whole range again a few entries per transaction.
+    auto chunk = 1 + rng() % 100;
+    ScanCursor cursor;
+    cursor.has_last_key = false;
+    cursor.end = false;
+    found.clear();
+    // A resumed scan that repeats entries must not run forever.
+    while (!cursor.end && found.size() <= expected.size()) {
+      tx.begin();
+      Scanner chunk_scanner(idx, &tx, left_type, min_key, right_type, max_key,
+                            reversed, skip_validation);
+      chunk_scanner.resume(cursor);
+      chunk_scanner.set_limit(chunk);
+      auto prev_size = found.size();
+      if (!drain_scanner(&chunk_scanner, &found, &value_mismatches)) {
+        tx.abort();
+        found.resize(prev_size);
+        aborts++;
+        continue;
+      }
+      if (!tx.commit()) {
+        found.resize(prev_size);
+        aborts++;
+        continue;
+      }
+      cursor = chunk_scanner.cursor();
+    }
+    if (found != expected) resume_mismatches++;
+  }
+
+  printf("  %" PRIu64 " aborts\n", aborts);
+  check(scan_mismatches == 0, "scan with offset and limit");
+  check(resume_mismatches == 0, "resume scan");
+  check(value_mismatches == 0, "scan values");
+}
+
+// Mostly small values around zero so that keys often tie on earlier fields,
+// and the extremes of the type.
+template <class T>
+static T random_field(std::mt19937_64& rng) {
+  switch (rng() % 8) {
+    case 0:
+      return std::numeric_limits<T>::min();
+    case 1:
+      return std::numeric_limits<T>::max();
+    default:
+      return static_cast<T>(static_cast<int64_t>(rng() % 8) - 4);
+  }
+}
+
+template <class... Fields>
+static std::tuple<Fields...> random_tuple(std::mt19937_64& rng) {
+  // Braced initialization evaluates the fields in order.
+  return std::tuple<Fields...>{random_field<Fields>(rng)...};
+}
+
+template <class... Fields, size_t... Is>
+static ::mica::transaction::CompositeKey<Fields...> to_key(
+    const std::tuple<Fields...>& t, std::index_sequence<Is...>) {
+  return ::mica::transaction::CompositeKey<Fields...>(std::get<Is>(t)...);
+}
+
+template <class... Fields, size_t... Is>
+static std::tuple<Fields...> to_tuple(
+    const ::mica::transaction::CompositeKey<Fields...>& key,
+    std::index_sequence<Is...>) {
+  return std::tuple<Fields...>(key.template get<Is>()...);
+}
+
+// Compares the fields, order, and equality of random keys with tuples.
+template <class... Fields>
+static void check_composite_keys(std::mt19937_64& rng, const char* what) {
+  typedef ::mica::transaction::CompositeKey<Fields...> Key;
+  auto seq = std::index_sequence_for<Fields...>();
+
+  uint64_t mismatches = 0;
+  for (uint64_t q = 0; q < kQueryCount; q++) {
+    auto a = random_tuple<Fields...>(rng);
+    auto b = random_tuple<Fields...>(rng);
+    auto key_a = to_key(a, seq);
+    auto key_b = to_key(b, seq);
+    if (to_tuple(key_a, seq) != a || (key_a < key_b) != (a < b) ||
+        (key_b < key_a) != (b < a) || (key_a == key_b) != (a == b) ||
+        (a == b && std::hash<Key>()(key_a) != std::hash<Key>()(key_b)))
+      mismatches++;
+
+    // set() changes only its field.
+    auto c = a;
+    std::get<0>(c) = std::get<0>(b);
+    key_a.template set<0>(std::get<0>(b));
+    if (to_tuple(key_a, seq) != c) mismatches++;
+  }
+  check(mismatches == 0, what);
+}
+
+static void test_composite(DB* db) {
+  printf("composite key:\n");
+
+  std::mt19937_64 rng(3);
+  check_composite_keys<int16_t, uint8_t, int32_t, int64_t>(rng,
+                                                            "two-word keys");
+  // Three words, which do not use the SIMD node search.
+  check_composite_keys<int8_t, int64_t, uint16_t, int32_t>(
+      rng, "three-word keys");
+  check_composite_keys<int64_t>(rng, "one-field keys");
+
+  bool ret = db->create_btree_index<SignedKey>("composite_idx",
+                                               db->get_table("main"));
+  assert(ret);
+  (void)ret;
+  auto idx = db->get_btree_index<SignedKey>("composite_idx");
+  {
+    Transaction tx(db->context(0));
+    idx->init(&tx);
+  }
+
+  // Keys and their insertion order as values.
+  std::vector<SignedTuple> tuples;
+  std::map<SignedTuple, uint64_t> expected;
+  for (uint64_t i = 0; i < kCompositeKeyCount; i++) {
+    auto t = random_tuple<int16_t, uint8_t, int32_t, int64_t>(rng);
+    if (expected.emplace(t, tuples.size()).second) tuples.push_back(t);
+  }
+  std::vector<uint64_t> positions(tuples.size());
+  for (uint64_t i = 0; i < tuples.size(); i++) positions[i] = i;
+
+  auto seq = std::index_sequence_for<int16_t, uint8_t, int32_t, int64_t>();
+  auto inserted = run_batches(
+      db, positions, [idx, &tuples, seq](Transaction* tx, uint64_t i) {
+        return idx->insert(tx, to_key(tuples[i], seq), i);
+      });
+  check(inserted == tuples.size(), "insert composite keys");
+
+  typedef std::vector<std::pair<SignedTuple, uint64_t>> Entries;
+  auto collect = [seq](Entries* entries) {
+    return [entries, seq](const SignedKey& key, uint64_t value) {
+      entries->emplace_back(to_tuple(key, seq), value);
+      return true;
+    };
+  };
+
+  Transaction tx(db->context(0));
+  tx.begin();
+  check(idx->check(&tx), "check composite key tree");
+  Entries forward;
+  Entries backward;
+  idx->lookup<BTreeRangeType::kOpen, BTreeRangeType::kOpen, false>(
+      &tx, SignedKey(), SignedKey(), false, collect(&forward));
+  idx->lookup<BTreeRangeType::kOpen, BTreeRangeType::kOpen, true>(
+      &tx, SignedKey(), SignedKey(), false, collect(&backward));
+  check(tx.commit(), "commit composite key scans");
+
+  Entries sorted(expected.begin(), expected.end());
+  check(forward == sorted, "scan composite keys");
+  std::reverse(sorted.begin(), sorted.end());
+  check(backward == sorted, "reverse scan composite keys");
+
+  // Ranges across negative and positive fields.
+  uint64_t range_mismatches = 0;
+  uint64_t lookup_mismatches = 0;
+  for (uint64_t q = 0; q < kQueryCount; q++) {
+    auto lo = random_tuple<int16_t, uint8_t, int32_t, int64_t>(rng);
+    auto hi = random_tuple<int16_t, uint8_t, int32_t, int64_t>(rng);
+    auto& t = tuples[rng() % tuples.size()];
+
+    tx.begin();
+    Entries found;
+    idx->lookup<BTreeRangeType::kInclusive, BTreeRangeType::kExclusive, false>(
+        &tx, to_key(lo, seq), to_key(hi, seq), false, collect(&found));
+    uint64_t found_value = 0;
+    auto lookup_ret = idx->lookup(&tx, to_key(t, seq), false,
+                                  [&found_value](const SignedKey& key,
+                                                 uint64_t value) {
+                                    (void)key;
+                                    found_value = value;
+                                    return true;
+                                  });
+    check(tx.commit(), "commit composite key lookups");
+
+    Entries range;
+    if (lo < hi)
+      range.assign(expected.lower_bound(lo), expected.lower_bound(hi));
+    if (found != range) range_mismatches++;
+    if (lookup_ret != 1 || found_value != expected[t]) lookup_mismatches++;
+  }
+  check(range_mismatches == 0, "composite key ranges");
+  check(lookup_mismatches == 0, "composite key lookups");
+}
+
+static StringKey make_string_key(const std::string& s) {
+  StringKey key{};
+  bool ret = key.append(s);
+  assert(ret);
+  (void)ret;
+  return key;
+}
+
+// Strings of up to the maximum length from a few bytes including zero and
+// 0xff.  Many share a prefix longer than the 8 bytes kept as an integer.
+static std::string random_string(std::mt19937_64& rng) {
+  static const char kBytes[] = {'\0', 'a', 'b', '\xff'};
+  std::string s;
+  if (rng() % 2 == 0) s = "common prefix";
+  auto len = rng() % (StringKey::kMaxLength - s.size() + 1);
+  for (uint64_t i = 0; i < len; i++) s.push_back(kBytes[rng() % 4]);
+  return s;
+}
+
+// Compares StringKey with std::string, whose comparison works like memcmp().
+static void check_string_keys(std::mt19937_64& rng) {
+  uint64_t mismatches = 0;
+  for (uint64_t q = 0; q < kQueryCount; q++) {
+    auto a = random_string(rng);
+    auto b = rng() % 4 == 0 ? a.substr(0, rng() % (a.size() + 1))
+                            : random_string(rng);
+    auto key_a = make_string_key(a);
+    auto key_b = make_string_key(b);
+    if (key_a.str() != a || (key_a < key_b) != (a < b) ||
+        (key_b < key_a) != (b < a) || (key_a == key_b) != (a == b))
+      mismatches++;
+
+    // A separator must be after the left key and not after the right key.
+    if (a < b) {
+      auto sep = ::mica::transaction::btree_separator(key_a, key_b);
+      if (!(key_a < sep) || key_b < sep) mismatches++;
+    }
+
+    auto n = rng() % (a.size() + 1);
+    auto truncated = key_a;
+    truncated.truncate(n);
+    if (truncated != make_string_key(a.substr(0, n))) mismatches++;
+
+    // Big-endian integers order like the integers.
+    auto x = rng() >> (rng() % 64);
+    auto y = rng() >> (rng() % 64);
+    StringKey key_x{};
+    StringKey key_y{};
+    key_x.append_u64(x);
+    key_y.append_u64(y);
+    if ((key_x < key_y) != (x < y)) mismatches++;
+  }
+  check(mismatches == 0, "string keys");
+
+  auto full = make_string_key(std::string(StringKey::kMaxLength, 'a'));
+  auto copy = full;
+  check(!full.append("b") && full == copy, "reject too long keys");
+}
+
+static void test_string(DB* db) {
+  printf("string key:\n");
+
+  std::mt19937_64 rng(4);
+  check_string_keys(rng);
+
+  bool ret = db->create_btree_index_unique_string("string_idx",
+                                                  db->get_table("main"));
+  assert(ret);
+  ret = db->create_btree_index_nonunique_string("nonunique_string_idx",
+                                                db->get_table("main"));
+  assert(ret);
+  (void)ret;
+  auto idx = db->get_btree_index_unique_string("string_idx");
+  auto nonunique_idx =
+      db->get_btree_index_nonunique_string("nonunique_string_idx");
+  {
+    Transaction tx(db->context(0));
+    idx->init(&tx);
+    nonunique_idx->init(&tx);
+  }
+
+  // Strings and their insertion order as values.  The non-unique index has
+  // each string with up to three row IDs.
+  std::vector<std::string> strings;
+  std::map<std::string, uint64_t> expected;
+  std::set<std::pair<std::string, uint64_t>> expected_rows;
+  for (uint64_t i = 0; i < kStringKeyCount; i++) {
+    auto s = random_string(rng);
+    if (expected.emplace(s, strings.size()).second) strings.push_back(s);
+  }
+  std::vector<uint64_t> positions(strings.size());
+  for (uint64_t i = 0; i < strings.size(); i++) positions[i] = i;
+  for (auto i : positions)
+    for (uint64_t row_id = 0; row_id <= i % 3; row_id++)
+      expected_rows.emplace(strings[i], row_id);
+
+  auto inserted = run_batches(
+      db, positions, [idx, nonunique_idx, &strings](Transaction* tx,
+                                                    uint64_t i) {
+        auto key = make_string_key(strings[i]);
+        for (uint64_t row_id = 0; row_id <= i % 3; row_id++)
+          if (nonunique_idx->insert(tx, std::make_pair(key, row_id), 0) !=
+              1)
+            return BTreeIndex::kHaveToAbort;
+        return idx->insert(tx, key, i);
+      });
+  check(inserted == strings.size(), "insert string keys");
+
+  Transaction tx(db->context(0));
+  tx.begin();
+  check(idx->check(&tx), "check string key tree");
+  check(nonunique_idx->check(&tx), "check non-unique string key tree");
+  std::vector<std::pair<std::string, uint64_t>> found;
+  idx->lookup<BTreeRangeType::kOpen, BTreeRangeType::kOpen, false>(
+      &tx, StringKey{}, StringKey{}, false,
+      [&found](const StringKey& key, uint64_t value) {
+        found.emplace_back(key.str(), value);
+        return true;
+      });
+  std::vector<std::pair<std::string, uint64_t>> found_rows;
+  nonunique_idx->lookup<BTreeRangeType::kOpen, BTreeRangeType::kOpen, true>(
+      &tx, std::make_pair(StringKey{}, uint64_t(0)),
+      std::make_pair(StringKey{}, uint64_t(0)), false,
+      [&found_rows](const std::pair<StringKey, uint64_t>& key,
+                    uint64_t value) {
+        (void)value;
+        found_rows.emplace_back(key.first.str(), key.second);
+        return true;
+      });
+  check(tx.commit(), "commit string key scans");
+  check(found == std::vector<std::pair<std::string, uint64_t>>(
+                     expected.begin(), expected.end()),
+        "scan string keys");
+  check(found_rows == std::vector<std::pair<std::string, uint64_t>>(
+                          expected_rows.rbegin(), expected_rows.rend()),
+        "reverse scan non-unique string keys");
+
+  uint64_t range_mismatches = 0;
+  uint64_t row_mismatches = 0;
+  for (uint64_t q = 0; q < kQueryCount; q++) {
+    auto lo = random_string(rng);
+    auto hi = random_string(rng);
+    auto& s = strings[rng() % strings.size()];
+
+    tx.begin();
+    uint64_t count = 0;
+    auto ret_range =
+        idx->lookup<BTreeRangeType::kExclusive, BTreeRangeType::kInclusive,
+                    false>(&tx, make_string_key(lo), make_string_key(hi),
+                           false, [](const StringKey& key, uint64_t value) {
+                             (void)key;
+                             (void)value;
+                             return true;
+                           });
+    auto key = make_string_key(s);
+    std::set<uint64_t> row_ids;
+    nonunique_idx->lookup<BTreeRangeType::kInclusive,
+                          BTreeRangeType::kInclusive, false>(
+        &tx, std::make_pair(key, uint64_t(0)),
+        std::make_pair(key, ~uint64_t(0)), false,
+        [&row_ids, &key](const std::pair<StringKey, uint64_t>& k,
+                         uint64_t value) {
+          (void)value;
+          if (k.first == key) row_ids.insert(k.second);
+          return true;
+        });
+    check(tx.commit(), "commit string key lookups");
+
+    if (lo < hi)
+      for (auto it = expected.upper_bound(lo);
+           it != expected.end() && it->first <= hi; ++it)
+        count++;
+    if (ret_range != count) range_mismatches++;
+    if (row_ids.size() != expected[s] % 3 + 1 ||
+        *row_ids.rbegin() != expected[s] % 3)
+      row_mismatches++;
+  }
+  check(range_mismatches == 0, "string key ranges");
+  check(row_mismatches == 0, "non-unique string key lookups");
+
+  // Remove every other key.
+  std::vector<uint64_t> removed_positions;
+  for (uint64_t i = 0; i < strings.size(); i += 2)
+    removed_positions.push_back(i);
+  auto removed = run_batches(
+      db, removed_positions, [idx, &strings](Transaction* tx, uint64_t i) {
+        return idx->remove(tx, make_string_key(strings[i]), i);
+      });
+  check(removed == removed_positions.size(), "remove string keys");
+  uint64_t remove_mismatches = 0;
+  for (uint64_t i = 0; i < strings.size(); i++) {
+    tx.begin();
+    auto ret_lookup = idx->lookup(
+        &tx, make_string_key(strings[i]), false,
+        [](const StringKey& key, uint64_t value) {
+          (void)key;
+          (void)value;
+          return true;
+        });
+    check(tx.commit(), "commit string key lookups");
+    if (ret_lookup != (i % 2 == 0 ? 0 : 1)) remove_mismatches++;
+  }
+  check(remove_mismatches == 0, "find kept string keys only");
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc != 2) {
+    printf("%s NUM-KEYS\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  auto config = ::mica::util::Config::load_file("test_tx.json");
+
+  uint64_t num_keys = static_cast<uint64_t>(atol(argv[1]));
+
+  Alloc alloc(config.get("alloc"));
+  PagePool* page_pools[2];
+  page_pools[0] = new PagePool(&alloc, uint64_t(1073741824), 0);
+  page_pools[1] = nullptr;
+
+  ::mica::util::lcore.pin_thread(0);
+
+  sw.init_start();
+  sw.init_end();
+
+  DBConfig::Logger logger;
+  DB db(page_pools, &logger, &sw, 1);
+
+  const uint64_t kDataSizes[] = {kDataSize};
+  bool ret = db.create_table("main", 1, kDataSizes);
+  assert(ret);
+  (void)ret;
+
+  db.activate(0);
+  test_rank(&db, num_keys);
+  test_scan(&db, num_keys);
+  test_composite(&db);
+  test_string(&db);
+  db.deactivate(0);
+
+  if (failure_count != 0) {
+    printf("%" PRIu64 " checks failed\n", failure_count);
+    return EXIT_FAILURE;
+  }
+  printf("all checks passed\n");
+  return EXIT_SUCCESS;
+}
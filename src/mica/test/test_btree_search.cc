@@ -0,0 +1,443 @@
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "mica/transaction/db.h"
+#include "mica/util/lcore.h"
+
+// Compares the scalar node search and the SIMD node search
+// (BasicDBConfig::kBTreeSIMDSearch) of BTreeIndex, first on node-sized key
+// arrays and then with lookups on whole indexes.  Also compares building an
+// index with inserts and with BTreeIndex::bulk_load(), and looking up
+// CompositeKey keys made by splitting the integer keys into two fields.
+// Indexes loaded in runs (bulk_load_leaves() and bulk_load_finish()) and with
+// a tiny fill factor must pass check() and find the same keys, and duplicate
+// keys must make bulk loading fail.
+
+template <bool SIMDSearch>
+struct DBConfig : public ::mica::transaction::BasicDBConfig {
+  static constexpr bool kBTreeSIMDSearch = SIMDSearch;
+  typedef ::mica::transaction::NullLogger<DBConfig> Logger;
+};
+
+typedef ::mica::transaction::BasicDBConfig::Alloc Alloc;
+typedef ::mica::transaction::BTreeRangeType BTreeRangeType;
+
+static ::mica::util::Stopwatch sw;
+
+// For the main table.  Not really used.
+static const uint64_t kDataSize = 8;
+// The number of index operations in a transaction.
+static const uint64_t kBatchSize = 16;
+
+// The number of node-sized key arrays; small enough to fit in cache.
+static const uint64_t kNodeCount = 512;
+static const int kNodeStride = 64;
+
+// The number of runs for parallel bulk loading; one of them is empty.
+static const uint64_t kBulkLoadRuns = 4;
+
+static uint64_t failure_count = 0;
+
+static void check(bool cond, const char* what) {
+  if (cond) return;
+  printf("  FAILED: %s\n", what);
+  failure_count++;
+}
+
+// The scalar search of BTreeIndex::search_leftmost<true>().
+static int search_scalar(const uint64_t* keys, int count, uint64_t key) {
+  int left = 0;
+  int right = count;
+  while (left + 8 <= right) {
+    int mid = (left + right) >> 1;
+    if (key < keys[mid])
+      right = mid + 1;
+    else
+      left = mid + 1;
+  }
+  for (; left < right; left++)
+    if (key < keys[left]) break;
+  return left;
+}
+
+static int search_simd(const uint64_t* keys, int count, uint64_t key) {
+  return count -
+         ::mica::transaction::BTreeSIMDSearch<uint64_t>::count<true>(
+             keys, count, key);
+}
+
+template <typename SearchFunc>
+static double bench_node_search(const std::vector<uint64_t>& nodes, int count,
+                                const std::vector<uint64_t>& lookup_keys,
+                                const SearchFunc& search, uint64_t* sum) {
+  uint64_t start = sw.now();
+  for (uint64_t i = 0; i < lookup_keys.size(); i++) {
+    auto keys = &nodes[(i % kNodeCount) * kNodeStride];
+    *sum += static_cast<uint64_t>(search(keys, count, lookup_keys[i]));
+  }
+  uint64_t end = sw.now();
+  return sw.diff(end, start) * 1000000000. /
+         static_cast<double>(lookup_keys.size());
+}
+
+static void run_node_search(const std::vector<uint64_t>& lookup_keys,
+                            uint64_t key_range) {
+  std::mt19937_64 rng(2);
+
+  printf("node search (ns/search):\n");
+  for (int count : {15, 31, 59}) {
+    std::vector<uint64_t> nodes(kNodeCount * kNodeStride);
+    for (uint64_t i = 0; i < kNodeCount; i++) {
+      auto keys = &nodes[i * kNodeStride];
+      for (int j = 0; j < count; j++) keys[j] = rng() % key_range;
+      std::sort(keys, keys + count);
+    }
+
+    uint64_t sum_scalar = 0;
+    uint64_t sum_simd = 0;
+    double t_scalar = bench_node_search(nodes, count, lookup_keys,
+                                        search_scalar, &sum_scalar);
+    double t_simd =
+        bench_node_search(nodes, count, lookup_keys, search_simd, &sum_simd);
+    printf("  %2d keys: scalar %6.2lf  SIMD %6.2lf%s\n", count, t_scalar,
+           t_simd, sum_scalar == sum_simd ? "" : " (MISMATCH)");
+    check(sum_scalar == sum_simd, "node search");
+  }
+  printf("\n");
+}
+
+template <class StaticConfig>
+void run(Alloc* alloc, const std::vector<uint64_t>& keys,
+         const std::vector<uint64_t>& lookup_keys) {
+  typedef ::mica::transaction::PagePool<StaticConfig> PagePool;
+  typedef ::mica::transaction::DB<StaticConfig> DB;
+  typedef ::mica::transaction::Transaction<StaticConfig> Transaction;
+  typedef typename DB::BTreeIndexUniqueU64 BTreeIndexUnique;
+  typedef typename DB::BTreeIndexNonuniqueU64 BTreeIndexNonunique;
+  typedef ::mica::transaction::CompositeKey<uint32_t, uint16_t> CompositeKey;
+  typedef typename DB::template BTreeIndexT<CompositeKey> BTreeIndexComposite;
+
+  printf("SIMD search: %s\n",
+         BTreeIndexUnique::kUseSIMDSearch ? "enabled" : "disabled");
+
+  PagePool* page_pools[2];
+  page_pools[0] = new PagePool(alloc, uint64_t(1073741824), 0);
+  page_pools[1] = nullptr;
+
+  typename StaticConfig::Logger logger;
+  DB db(page_pools, &logger, &sw, 1);
+
+  const uint64_t kDataSizes[] = {kDataSize};
+  bool ret = db.create_table("main", 1, kDataSizes);
+  assert(ret);
+  ret = db.create_btree_index_unique_u64("unique_idx", db.get_table("main"));
+  assert(ret);
+  ret = db.create_btree_index_nonunique_u64("nonunique_idx",
+                                            db.get_table("main"));
+  assert(ret);
+  ret = db.create_btree_index_unique_u64("bulk_idx", db.get_table("main"));
+  assert(ret);
+  ret = db.template create_btree_index<CompositeKey>("composite_idx",
+                                                     db.get_table("main"));
+  assert(ret);
+  ret = db.create_btree_index_unique_u64("runs_idx", db.get_table("main"));
+  assert(ret);
+  ret = db.create_btree_index_unique_u64("sparse_idx", db.get_table("main"));
+  assert(ret);
+  ret = db.create_btree_index_unique_u64("dup_idx", db.get_table("main"));
+  assert(ret);
+  (void)ret;
+
+  auto unique_idx = db.get_btree_index_unique_u64("unique_idx");
+  auto nonunique_idx = db.get_btree_index_nonunique_u64("nonunique_idx");
+  auto bulk_idx = db.get_btree_index_unique_u64("bulk_idx");
+  auto composite_idx =
+      db.template get_btree_index<CompositeKey>("composite_idx");
+  assert(composite_idx != nullptr);
+  auto runs_idx = db.get_btree_index_unique_u64("runs_idx");
+  auto sparse_idx = db.get_btree_index_unique_u64("sparse_idx");
+  auto dup_idx = db.get_btree_index_unique_u64("dup_idx");
+
+  auto to_composite_key = [](uint64_t key) {
+    return CompositeKey(static_cast<uint32_t>(key >> 12),
+                        static_cast<uint16_t>(key & 0xfff));
+  };
+
+  // The number of lookup keys found in the unique index.
+  uint64_t unique_found = 0;
+
+  db.activate(0);
+  {
+    Transaction tx(db.context(0));
+    unique_idx->init(&tx);
+    nonunique_idx->init(&tx);
+    composite_idx->init(&tx);
+
+    uint64_t start = sw.now();
+    for (uint64_t i = 0; i < keys.size(); i += kBatchSize) {
+      while (true) {
+        bool ok = tx.begin();
+        uint64_t end = std::min(i + kBatchSize, uint64_t(keys.size()));
+        for (uint64_t j = i; ok && j < end; j++) {
+          // Use a few row IDs for each key in the non-unique index.
+          ok = unique_idx->insert(&tx, keys[j], j) !=
+                   BTreeIndexUnique::kHaveToAbort &&
+               nonunique_idx->insert(&tx, std::make_pair(keys[j] >> 2, j),
+                                     0) != BTreeIndexNonunique::kHaveToAbort &&
+               composite_idx->insert(&tx, to_composite_key(keys[j]), j) !=
+                   BTreeIndexComposite::kHaveToAbort;
+        }
+        if (!ok) {
+          tx.abort();
+          continue;
+        }
+        if (tx.commit()) break;
+      }
+    }
+    uint64_t end = sw.now();
+    printf("  insert:            %7.3lf M ops/sec\n",
+           static_cast<double>(keys.size()) / sw.diff(end, start) / 1000000.);
+  }
+
+  // Use the same values as the inserts into the unique index.
+  std::vector<uint64_t> sorted_keys(keys.size());
+  std::vector<uint64_t> sorted_values(keys.size());
+  {
+    Transaction tx(db.context(0));
+    bulk_idx->init(&tx);
+
+    std::vector<std::pair<uint64_t, uint64_t>> items(keys.size());
+    for (uint64_t j = 0; j < keys.size(); j++) items[j] = {keys[j], j};
+
+    uint64_t start = sw.now();
+    std::sort(items.begin(), items.end());
+    for (uint64_t j = 0; j < items.size(); j++) {
+      sorted_keys[j] = items[j].first;
+      sorted_values[j] = items[j].second;
+    }
+    bool ok = bulk_idx->bulk_load(&tx, sorted_keys.data(), sorted_values.data(),
+                                  sorted_keys.size());
+    uint64_t end = sw.now();
+    printf("  bulk load:         %7.3lf M ops/sec%s\n",
+           static_cast<double>(keys.size()) / sw.diff(end, start) / 1000000.,
+           ok ? "" : " (FAILED)");
+    check(ok, "bulk load");
+  }
+
+  {
+    Transaction tx(db.context(0));
+    runs_idx->init(&tx);
+    sparse_idx->init(&tx);
+    dup_idx->init(&tx);
+
+    // Each run would be built by a different thread.
+    std::vector<typename BTreeIndexUnique::BulkLoadRun> runs(kBulkLoadRuns +
+                                                             1);
+    bool ok = true;
+    for (uint64_t r = 0; ok && r < kBulkLoadRuns; r++) {
+      auto begin = sorted_keys.size() * r / kBulkLoadRuns;
+      auto end = sorted_keys.size() * (r + 1) / kBulkLoadRuns;
+      // Leave the run in the middle empty.
+      auto run_r = r < kBulkLoadRuns / 2 ? r : r + 1;
+      ok = runs_idx->bulk_load_leaves(&tx, sorted_keys.data() + begin,
+                                      sorted_values.data() + begin,
+                                      end - begin, 1., &runs[run_r]);
+    }
+    check(ok && runs_idx->bulk_load_finish(&tx, runs, 1.),
+          "bulk load in runs");
+
+    check(sparse_idx->bulk_load(&tx, sorted_keys.data(), sorted_values.data(),
+                                sorted_keys.size(), 0.01),
+          "bulk load with a tiny fill factor");
+
+    if (sorted_keys.size() >= 2) {
+      auto dup_keys = sorted_keys;
+      dup_keys[dup_keys.size() / 2] = dup_keys[dup_keys.size() / 2 - 1];
+      check(!dup_idx->bulk_load(&tx, dup_keys.data(), sorted_values.data(),
+                                dup_keys.size()),
+            "reject duplicate keys in bulk load");
+    }
+
+    tx.begin();
+    check(bulk_idx->check(&tx), "check bulk-loaded tree");
+    check(runs_idx->check(&tx), "check tree loaded in runs");
+    check(sparse_idx->check(&tx), "check sparse tree");
+    check(tx.commit(), "commit checks");
+  }
+
+  {
+    Transaction tx(db.context(0));
+    uint64_t found = 0;
+
+    uint64_t start = sw.now();
+    for (uint64_t i = 0; i < lookup_keys.size(); i += kBatchSize) {
+      tx.begin(true);
+      uint64_t end = std::min(i + kBatchSize, uint64_t(lookup_keys.size()));
+      for (uint64_t j = i; j < end; j++)
+        found += unique_idx->lookup(&tx, lookup_keys[j], true,
+                                    [](auto& k, auto v) {
+                                      (void)k;
+                                      (void)v;
+                                      return false;
+                                    });
+      tx.commit();
+    }
+    uint64_t end = sw.now();
+    printf("  lookup (unique):   %7.3lf M ops/sec (found %" PRIu64 ")\n",
+           static_cast<double>(lookup_keys.size()) / sw.diff(end, start) /
+               1000000.,
+           found);
+    unique_found = found;
+  }
+
+  {
+    Transaction tx(db.context(0));
+    uint64_t found = 0;
+    uint64_t mismatched = 0;
+
+    uint64_t start = sw.now();
+    for (uint64_t i = 0; i < lookup_keys.size(); i += kBatchSize) {
+      tx.begin(true);
+      uint64_t end = std::min(i + kBatchSize, uint64_t(lookup_keys.size()));
+      for (uint64_t j = i; j < end; j++)
+        found += bulk_idx->lookup(&tx, lookup_keys[j], true,
+                                  [&keys, &mismatched](auto& k, auto v) {
+                                    if (keys[v] != k) mismatched++;
+                                    return false;
+                                  });
+      tx.commit();
+    }
+    uint64_t end = sw.now();
+    printf("  lookup (bulk):     %7.3lf M ops/sec (found %" PRIu64 ")%s\n",
+           static_cast<double>(lookup_keys.size()) / sw.diff(end, start) /
+               1000000.,
+           found, mismatched == 0 ? "" : " (MISMATCH)");
+    check(found == unique_found && mismatched == 0, "lookup (bulk)");
+  }
+
+  for (auto idx : {runs_idx, sparse_idx}) {
+    Transaction tx(db.context(0));
+    uint64_t found = 0;
+    uint64_t mismatched = 0;
+    for (uint64_t i = 0; i < lookup_keys.size(); i += kBatchSize) {
+      tx.begin(true);
+      uint64_t end = std::min(i + kBatchSize, uint64_t(lookup_keys.size()));
+      for (uint64_t j = i; j < end; j++)
+        found += idx->lookup(&tx, lookup_keys[j], true,
+                             [&keys, &mismatched](auto& k, auto v) {
+                               if (keys[v] != k) mismatched++;
+                               return false;
+                             });
+      tx.commit();
+    }
+    check(found == unique_found && mismatched == 0,
+          idx == runs_idx ? "lookup (runs)" : "lookup (sparse)");
+  }
+
+  {
+    Transaction tx(db.context(0));
+    uint64_t found = 0;
+
+    uint64_t start = sw.now();
+    for (uint64_t i = 0; i < lookup_keys.size(); i += kBatchSize) {
+      tx.begin(true);
+      uint64_t end = std::min(i + kBatchSize, uint64_t(lookup_keys.size()));
+      for (uint64_t j = i; j < end; j++) {
+        auto key = lookup_keys[j] >> 2;
+        found += nonunique_idx->template lookup<BTreeRangeType::kInclusive,
+                                                BTreeRangeType::kInclusive,
+                                                false>(
+            &tx, std::make_pair(key, uint64_t(0)),
+            std::make_pair(key, ~uint64_t(0)), true, [](auto& k, auto v) {
+              (void)k;
+              (void)v;
+              return true;
+            });
+      }
+      tx.commit();
+    }
+    uint64_t end = sw.now();
+    printf("  lookup (nonunique): %6.3lf M ops/sec (found %" PRIu64 ")\n",
+           static_cast<double>(lookup_keys.size()) / sw.diff(end, start) /
+               1000000.,
+           found);
+  }
+  {
+    Transaction tx(db.context(0));
+    uint64_t found = 0;
+    uint64_t mismatched = 0;
+
+    uint64_t start = sw.now();
+    for (uint64_t i = 0; i < lookup_keys.size(); i += kBatchSize) {
+      tx.begin(true);
+      uint64_t end = std::min(i + kBatchSize, uint64_t(lookup_keys.size()));
+      for (uint64_t j = i; j < end; j++)
+        found += composite_idx->lookup(
+            &tx, to_composite_key(lookup_keys[j]), true,
+            [&keys, &mismatched](auto& k, auto v) {
+              if (((uint64_t(k.template get<0>()) << 12) |
+                   k.template get<1>()) != keys[v])
+                mismatched++;
+              return false;
+            });
+      tx.commit();
+    }
+    uint64_t end = sw.now();
+    printf("  lookup (composite): %6.3lf M ops/sec (found %" PRIu64 ")%s\n",
+           static_cast<double>(lookup_keys.size()) / sw.diff(end, start) /
+               1000000.,
+           found, mismatched == 0 ? "" : " (MISMATCH)");
+    check(found == unique_found && mismatched == 0, "lookup (composite)");
+  }
+  db.deactivate(0);
+  printf("\n");
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc != 3) {
+    printf("%s NUM-KEYS LOOKUP-COUNT\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  auto config = ::mica::util::Config::load_file("test_tx.json");
+
+  uint64_t num_keys = static_cast<uint64_t>(atol(argv[1]));
+  uint64_t lookup_count = static_cast<uint64_t>(atol(argv[2]));
+
+  Alloc alloc(config.get("alloc"));
+
+  ::mica::util::lcore.pin_thread(0);
+
+  sw.init_start();
+  sw.init_end();
+
+  printf("num_keys = %" PRIu64 "\n", num_keys);
+  printf("lookup_count = %" PRIu64 "\n", lookup_count);
+#ifndef NDEBUG
+  printf("!NDEBUG\n");
+#endif
+  printf("\n");
+
+  // Sparse keys in a random order; half of the lookups miss.
+  std::mt19937_64 rng(1);
+  std::vector<uint64_t> keys(num_keys);
+  for (uint64_t i = 0; i < num_keys; i++) keys[i] = i * 2;
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  std::vector<uint64_t> lookup_keys(lookup_count);
+  for (uint64_t i = 0; i < lookup_count; i++)
+    lookup_keys[i] = rng() % (num_keys * 2);
+
+  run_node_search(lookup_keys, num_keys * 2);
+
+  run<DBConfig<false>>(&alloc, keys, lookup_keys);
+  run<DBConfig<true>>(&alloc, keys, lookup_keys);
+
+  if (failure_count != 0) {
+    printf("%" PRIu64 " checks failed\n", failure_count);
+    return EXIT_FAILURE;
+  }
+  printf("all checks passed\n");
+  return EXIT_SUCCESS;
+}
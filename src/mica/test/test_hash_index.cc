@@ -0,0 +1,471 @@
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "mica/transaction/bulk_loader.h"
+#include "mica/transaction/db.h"
+#include "mica/util/lcore.h"
+
+// Checks HashIndex with a filter (BasicDBConfig::kHashIndexFilterBitsPerKey)
+// in front of the buckets: lookups and removes of present and absent keys
+// while the index grows past its expected size, and lookups after the filter
+// is rebuilt from the buckets or disabled.
+//
+// Without the filter, an index created for one row must split its buckets
+// again and again, and lookups and removes must still find every key in the
+// split buckets.
+//
+// Also checks the values of a non-unique HashIndex: a single value in the
+// bucket slot and posting lists that span several blocks, built by inserts
+// and by bulk loading, while values are removed from the head, middle, and
+// tail blocks.
+
+struct DBConfig : public ::mica::transaction::BasicDBConfig {
+  static constexpr uint64_t kHashIndexFilterBitsPerKey = 8;
+  typedef ::mica::transaction::NullLogger<DBConfig> Logger;
+};
+
+typedef DBConfig::Alloc Alloc;
+typedef ::mica::transaction::PagePool<DBConfig> PagePool;
+typedef ::mica::transaction::DB<DBConfig> DB;
+typedef ::mica::transaction::Transaction<DBConfig> Transaction;
+typedef DB::HashIndexUniqueU64 HashIndex;
+typedef DB::HashIndexNonuniqueU64 NonuniqueHashIndex;
+typedef ::mica::transaction::BulkLoader<DBConfig> BulkLoader;
+
+static ::mica::util::Stopwatch sw;
+
+// For the main table.  Not really used.
+static const uint64_t kDataSize = 8;
+// The number of index operations in a transaction.
+static const uint64_t kBatchSize = 16;
+
+static uint64_t failure_count = 0;
+
+static void check(bool cond, const char* what) {
+  if (cond) return;
+  printf("  FAILED: %s\n", what);
+  failure_count++;
+}
+
+static uint64_t make_value(uint64_t key) { return key * 3 + 1; }
+
+// Applies op to the keys in transactions of kBatchSize keys, retrying aborted
+// transactions.  op returns the result of the index operation.
+template <typename Op>
+static uint64_t run_batches(DB* db, const std::vector<uint64_t>& keys,
+                            const Op& op) {
+  Transaction tx(db->context(0));
+  uint64_t succeeded = 0;
+  for (uint64_t i = 0; i < keys.size(); i += kBatchSize) {
+    auto end = std::min(i + kBatchSize, uint64_t(keys.size()));
+    while (true) {
+      bool ok = tx.begin();
+      uint64_t batch_succeeded = 0;
+      for (uint64_t j = i; ok && j < end; j++) {
+        auto ret = op(&tx, keys[j]);
+        if (ret == HashIndex::kHaveToAbort)
+          ok = false;
+        else
+          batch_succeeded += ret;
+      }
+      if (!ok) {
+        tx.abort();
+        continue;
+      }
+      if (tx.commit()) {
+        succeeded += batch_succeeded;
+        break;
+      }
+    }
+  }
+  return succeeded;
+}
+
+// Returns the number of keys found with their own values.
+static uint64_t lookup_keys(DB* db, HashIndex* idx,
+                            const std::vector<uint64_t>& keys) {
+  return run_batches(db, keys, [idx](Transaction* tx, uint64_t key) {
+    uint64_t value = 0;
+    auto ret = idx->lookup(tx, key, false, [&value](auto& k, auto v) {
+      (void)k;
+      value = v;
+      return false;
+    });
+    if (ret == HashIndex::kHaveToAbort) return ret;
+    return ret != 0 && value == make_value(key) ? uint64_t(1) : uint64_t(0);
+  });
+}
+
+static void test_filter(DB* db, uint64_t num_keys) {
+  printf("filter:\n");
+
+  // Start small so that buckets are split and chained.
+  bool ret = db->create_hash_index_unique_u64("filter_idx",
+                                              db->get_table("main"),
+                                              num_keys / 8);
+  assert(ret);
+  (void)ret;
+  auto idx = db->get_hash_index_unique_u64("filter_idx");
+  {
+    Transaction tx(db->context(0));
+    idx->init(&tx);
+  }
+
+  std::mt19937_64 rng(1);
+  std::vector<uint64_t> keys(num_keys);
+  std::vector<uint64_t> absent_keys(num_keys);
+  for (uint64_t i = 0; i < num_keys; i++) {
+    // Even keys are inserted, and odd keys are never inserted.
+    keys[i] = (rng() >> 1) << 1;
+    absent_keys[i] = keys[i] | 1;
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  auto inserted = run_batches(db, keys, [idx](Transaction* tx, uint64_t key) {
+    return idx->insert(tx, key, make_value(key));
+  });
+  check(inserted == keys.size(), "insert all keys");
+  check(lookup_keys(db, idx, keys) == keys.size(), "find present keys");
+  check(lookup_keys(db, idx, absent_keys) == 0, "miss absent keys");
+
+  auto removed =
+      run_batches(db, absent_keys, [idx](Transaction* tx, uint64_t key) {
+        return idx->remove(tx, key, make_value(key));
+      });
+  check(removed == 0, "remove absent keys");
+
+  // Remove half of the keys; their filter bits stay set.
+  auto mid = keys.begin() + static_cast<std::ptrdiff_t>(keys.size() / 2);
+  std::vector<uint64_t> removed_keys(keys.begin(), mid);
+  std::vector<uint64_t> kept_keys(mid, keys.end());
+  removed = run_batches(db, removed_keys, [idx](Transaction* tx, uint64_t key) {
+    return idx->remove(tx, key, make_value(key));
+  });
+  check(removed == removed_keys.size(), "remove present keys");
+  check(lookup_keys(db, idx, removed_keys) == 0, "miss removed keys");
+
+  // A rebuilt filter must have the bits of every key in the buckets,
+  // including those in split and overflow buckets.
+  idx->rebuild_filter();
+  check(lookup_keys(db, idx, kept_keys) == kept_keys.size(),
+        "find kept keys after rebuild");
+  check(lookup_keys(db, idx, removed_keys) == 0,
+        "miss removed keys after rebuild");
+  check(lookup_keys(db, idx, absent_keys) == 0,
+        "miss absent keys after rebuild");
+
+  // Keys inserted after the rebuild go through the filter as before.
+  inserted = run_batches(db, removed_keys, [idx](Transaction* tx,
+                                                 uint64_t key) {
+    return idx->insert(tx, key, make_value(key));
+  });
+  check(inserted == removed_keys.size(), "insert keys again");
+  check(lookup_keys(db, idx, keys) == keys.size(),
+        "find keys inserted after rebuild");
+
+  idx->disable_filter();
+  check(lookup_keys(db, idx, keys) == keys.size(),
+        "find keys without filter");
+  check(lookup_keys(db, idx, absent_keys) == 0,
+        "miss absent keys without filter");
+}
+
+static void test_split(DB* db, uint64_t num_keys) {
+  printf("split:\n");
+
+  bool ret =
+      db->create_hash_index_unique_u64("split_idx", db->get_table("main"), 1);
+  assert(ret);
+  (void)ret;
+  auto idx = db->get_hash_index_unique_u64("split_idx");
+  {
+    Transaction tx(db->context(0));
+    idx->init(&tx);
+  }
+  // Lookups of absent keys must reach the buckets.
+  idx->disable_filter();
+
+  std::mt19937_64 rng(2);
+  std::vector<uint64_t> keys(num_keys);
+  for (uint64_t i = 0; i < num_keys; i++) keys[i] = (rng() >> 1) << 1;
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  std::shuffle(keys.begin(), keys.end(), rng);
+  std::vector<uint64_t> absent_keys(keys.size());
+  for (uint64_t i = 0; i < keys.size(); i++) absent_keys[i] = keys[i] | 1;
+
+  // Check the keys inserted so far after each quarter of the inserts.
+  uint64_t inserted = 0;
+  for (uint64_t round = 1; round <= 4; round++) {
+    auto begin = keys.begin() + static_cast<std::ptrdiff_t>(inserted);
+    inserted = keys.size() * round / 4;
+    auto end = keys.begin() + static_cast<std::ptrdiff_t>(inserted);
+    std::vector<uint64_t> round_keys(begin, end);
+    check(run_batches(db, round_keys,
+                      [idx](Transaction* tx, uint64_t key) {
+                        return idx->insert(tx, key, make_value(key));
+                      }) == round_keys.size(),
+          "insert keys into splitting buckets");
+    std::vector<uint64_t> present_keys(keys.begin(), end);
+    check(lookup_keys(db, idx, present_keys) == present_keys.size(),
+          "find keys after splits");
+  }
+  check(lookup_keys(db, idx, absent_keys) == 0, "miss absent keys");
+  check(idx->index_table()->row_count() >=
+            keys.size() / HashIndex::Bucket::kBucketSize,
+        "grow the index table");
+
+  // Duplicates must be found in split buckets.
+  auto duplicated = run_batches(db, keys, [idx](Transaction* tx,
+                                                uint64_t key) {
+    return idx->insert(tx, key, make_value(key));
+  });
+  check(duplicated == 0, "reject duplicate keys");
+
+  auto mid = keys.begin() + static_cast<std::ptrdiff_t>(keys.size() / 2);
+  std::vector<uint64_t> removed_keys(keys.begin(), mid);
+  std::vector<uint64_t> kept_keys(mid, keys.end());
+  auto remove = [idx](Transaction* tx, uint64_t key) {
+    return idx->remove(tx, key, make_value(key));
+  };
+  check(run_batches(db, absent_keys, remove) == 0, "remove absent keys");
+  check(run_batches(db, removed_keys, remove) == removed_keys.size(),
+        "remove keys from split buckets");
+  check(run_batches(db, removed_keys, remove) == 0,
+        "remove removed keys again");
+  check(lookup_keys(db, idx, removed_keys) == 0, "miss removed keys");
+  check(lookup_keys(db, idx, kept_keys) == kept_keys.size(),
+        "find kept keys");
+
+  check(run_batches(db, removed_keys,
+                    [idx](Transaction* tx, uint64_t key) {
+                      return idx->insert(tx, key, make_value(key));
+                    }) == removed_keys.size(),
+        "insert removed keys again");
+  check(lookup_keys(db, idx, keys) == keys.size(), "find reinserted keys");
+
+  check(run_batches(db, keys, remove) == keys.size(), "remove all keys");
+  check(lookup_keys(db, idx, keys) == 0, "miss keys in an emptied index");
+}
+
+// Returns the values of key in ascending order.
+static std::vector<uint64_t> lookup_values(DB* db, NonuniqueHashIndex* idx,
+                                           uint64_t key) {
+  Transaction tx(db->context(0));
+  std::vector<uint64_t> values;
+  uint64_t ret;
+  while (true) {
+    values.clear();
+    tx.begin();
+    ret = idx->lookup(&tx, key, false, [&values](auto& k, auto v) {
+      (void)k;
+      values.push_back(v);
+      return true;
+    });
+    if (ret == NonuniqueHashIndex::kHaveToAbort) {
+      tx.abort();
+      continue;
+    }
+    if (tx.commit()) break;
+  }
+  check(ret == values.size(), "count found values");
+  std::sort(values.begin(), values.end());
+  return values;
+}
+
+static void check_values(DB* db, NonuniqueHashIndex* idx, uint64_t key,
+                         std::vector<uint64_t> expected, const char* what) {
+  std::sort(expected.begin(), expected.end());
+  check(lookup_values(db, idx, key) == expected, what);
+}
+
+static uint64_t insert_values(DB* db, NonuniqueHashIndex* idx, uint64_t key,
+                              const std::vector<uint64_t>& values) {
+  return run_batches(db, values, [idx, key](Transaction* tx, uint64_t value) {
+    return idx->insert(tx, key, value);
+  });
+}
+
+static uint64_t remove_values(DB* db, NonuniqueHashIndex* idx, uint64_t key,
+                              const std::vector<uint64_t>& values) {
+  return run_batches(db, values, [idx, key](Transaction* tx, uint64_t value) {
+    return idx->remove(tx, key, value);
+  });
+}
+
+// Removes values from expected and the index.
+static void remove_range(DB* db, NonuniqueHashIndex* idx, uint64_t key,
+                         std::vector<uint64_t>* expected, uint64_t begin,
+                         uint64_t end, const char* what) {
+  std::vector<uint64_t> values;
+  for (auto v = begin; v < end; v++) {
+    auto it = std::find(expected->begin(), expected->end(), v);
+    if (it == expected->end()) continue;
+    expected->erase(it);
+    values.push_back(v);
+  }
+  check(remove_values(db, idx, key, values) == values.size(), what);
+  check_values(db, idx, key, *expected, what);
+}
+
+static void test_posting(DB* db) {
+  printf("posting:\n");
+
+  bool ret = db->create_hash_index_nonunique_u64(
+      "posting_idx", db->get_table("main"), 1024);
+  assert(ret);
+  (void)ret;
+  auto idx = db->get_hash_index_nonunique_u64("posting_idx");
+  {
+    Transaction tx(db->context(0));
+    idx->init(&tx);
+  }
+
+  // A single value stays in the bucket slot.
+  check(insert_values(db, idx, 1, {7}) == 1, "insert a single value");
+  check_values(db, idx, 1, {7}, "find a single value");
+  check(remove_values(db, idx, 1, {8}) == 0, "remove an absent value");
+  check(remove_values(db, idx, 1, {7}) == 1, "remove a single value");
+  check_values(db, idx, 1, {}, "miss a removed single value");
+
+  // Consecutive values take one byte each, so the list has three full blocks
+  // and a partial tail block.
+  const uint64_t kBlockValues = NonuniqueHashIndex::kMaxPostingBlockValues;
+  const uint64_t n = kBlockValues * 3 + 16;
+  std::vector<uint64_t> expected;
+  for (uint64_t v = 1; v <= n; v++) expected.push_back(v);
+  check(insert_values(db, idx, 2, expected) == n, "fill posting blocks");
+  check_values(db, idx, 2, expected, "find values in all blocks");
+  check_values(db, idx, 3, {}, "miss an absent key");
+
+  remove_range(db, idx, 2, &expected, 5, 6, "remove from the head block");
+  remove_range(db, idx, 2, &expected, kBlockValues + 50,
+               kBlockValues + 51, "remove from a middle block");
+  remove_range(db, idx, 2, &expected, n - 1, n, "remove from the tail block");
+  check(remove_values(db, idx, 2, {n + 100}) == 0,
+        "remove an absent value from a list");
+
+  remove_range(db, idx, 2, &expected, kBlockValues * 2 + 1,
+               kBlockValues * 3 + 1, "empty a middle block");
+  remove_range(db, idx, 2, &expected, 1, kBlockValues + 1,
+               "empty the head block");
+
+  // The tail must still be reachable from the new head.
+  std::vector<uint64_t> more;
+  for (uint64_t v = n + 1; v <= n + 8; v++) more.push_back(v);
+  check(insert_values(db, idx, 2, more) == more.size(),
+        "append after emptying the head block");
+  expected.insert(expected.end(), more.begin(), more.end());
+  check_values(db, idx, 2, expected, "find appended values");
+
+  remove_range(db, idx, 2, &expected, kBlockValues * 3 + 1, n + 9,
+               "empty the tail block");
+  check(insert_values(db, idx, 2, {n + 9}) == 1,
+        "append after emptying the tail block");
+  expected.push_back(n + 9);
+  check_values(db, idx, 2, expected, "find a value in a new tail block");
+
+  remove_range(db, idx, 2, &expected, 0, n + 10, "empty the list");
+  check(insert_values(db, idx, 2, {42}) == 1, "insert into an emptied key");
+  check_values(db, idx, 2, {42}, "find a value of an emptied key");
+}
+
+static void test_bulk_posting(DB* db) {
+  printf("bulk posting:\n");
+
+  bool ret = db->create_hash_index_nonunique_u64(
+      "bulk_posting_idx", db->get_table("main"), 1024);
+  assert(ret);
+  (void)ret;
+  auto idx = db->get_hash_index_nonunique_u64("bulk_posting_idx");
+  {
+    Transaction tx(db->context(0));
+    idx->init(&tx);
+  }
+
+  // Key 10 has a single value, key 11 two values, and key 12 several blocks.
+  const uint64_t kBlockValues = NonuniqueHashIndex::kMaxPostingBlockValues;
+  const uint64_t n = kBlockValues * 2 + 16;
+  std::vector<uint64_t> values_11{3, 1};
+  std::vector<uint64_t> values_12;
+  std::vector<std::vector<std::pair<uint64_t, uint64_t>>> entries(1);
+  entries[0].emplace_back(10, 5);
+  for (auto v : values_11) entries[0].emplace_back(11, v);
+  for (uint64_t v = 1; v <= n; v++) {
+    values_12.push_back(v);
+    entries[0].emplace_back(12, v);
+  }
+
+  db->deactivate(0);
+  {
+    BulkLoader loader(db, 1);
+    uint64_t inserted = 0;
+    check(idx->bulk_load(&loader, entries, &inserted), "bulk load");
+    check(inserted == entries[0].size(), "bulk load all values");
+  }
+  db->activate(0);
+
+  check_values(db, idx, 10, {5}, "find a bulk-loaded single value");
+  check_values(db, idx, 11, values_11, "find two bulk-loaded values");
+  check_values(db, idx, 12, values_12, "find bulk-loaded blocks");
+
+  check(insert_values(db, idx, 10, {6}) == 1,
+        "insert into a bulk-loaded single value");
+  check_values(db, idx, 10, {5, 6}, "find values added to a single value");
+  check(remove_values(db, idx, 11, {3, 1}) == 2,
+        "remove bulk-loaded values");
+  check_values(db, idx, 11, {}, "miss removed bulk-loaded values");
+
+  remove_range(db, idx, 12, &values_12, 1, kBlockValues + 1,
+               "empty a bulk-loaded head block");
+  check(insert_values(db, idx, 12, {n + 1}) == 1,
+        "append to a bulk-loaded list");
+  values_12.push_back(n + 1);
+  check_values(db, idx, 12, values_12, "find values appended after loading");
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc != 2) {
+    printf("%s NUM-KEYS\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  auto config = ::mica::util::Config::load_file("test_tx.json");
+
+  uint64_t num_keys = static_cast<uint64_t>(atol(argv[1]));
+
+  Alloc alloc(config.get("alloc"));
+  PagePool* page_pools[2];
+  page_pools[0] = new PagePool(&alloc, uint64_t(1073741824), 0);
+  page_pools[1] = nullptr;
+
+  ::mica::util::lcore.pin_thread(0);
+
+  sw.init_start();
+  sw.init_end();
+
+  DBConfig::Logger logger;
+  DB db(page_pools, &logger, &sw, 1);
+
+  const uint64_t kDataSizes[] = {kDataSize};
+  bool ret = db.create_table("main", 1, kDataSizes);
+  assert(ret);
+  (void)ret;
+
+  db.activate(0);
+  test_filter(&db, num_keys);
+  test_split(&db, num_keys);
+  test_posting(&db);
+  test_bulk_posting(&db);
+  db.deactivate(0);
+
+  if (failure_count != 0) {
+    printf("%" PRIu64 " checks failed\n", failure_count);
+    return EXIT_FAILURE;
+  }
+  printf("all checks passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,846 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "mica/transaction/change_capture.h"
+#include "mica/transaction/checkpoint.h"
+#include "mica/transaction/command_replay.h"
+#include "mica/transaction/db.h"
+#include "mica/transaction/logging.h"
+#include "mica/transaction/recovery.h"
+#include "mica/util/lcore.h"
+
+// Checks the redo log written by ParallelLogger for random transactions on a
+// table with secondary indexes: every committed transaction is in the log of
+// its thread in timestamp order, the log is written out and durable_ts()
+// advances only when DB::sync_log() runs (deactivate() included).  Updates
+// that mark only the counter as modified are logged as delta records of its
+// bytes.
+//
+// Recovery must then restore the same rows and index entries into a new DB,
+// including the index state outside tables (the entries of OLCBTreeIndex and
+// the filter of HashIndex), and the new DB must keep running transactions.
+// The same holds for a checkpoint taken between transactions together with
+// the log entries since its checkpoint_ts().
+//
+// CommandReplay of the log written by CommandLogger must reproduce the rows
+// by re-executing the stored procedures in a new DB.
+//
+// The changes polled from ChangeCapture must reproduce the rows in timestamp
+// order, and commits must not fail while a ring is full without a consumer.
+
+struct DBConfig : public ::mica::transaction::BasicDBConfig {
+  static constexpr uint64_t kHashIndexFilterBitsPerKey = 8;
+  typedef ::mica::transaction::ParallelLogger<DBConfig> Logger;
+};
+
+struct CommandDBConfig : public ::mica::transaction::BasicDBConfig {
+  static constexpr uint64_t kHashIndexFilterBitsPerKey = 8;
+  typedef ::mica::transaction::CommandLogger<CommandDBConfig> Logger;
+};
+
+struct CaptureDBConfig : public ::mica::transaction::BasicDBConfig {
+  static constexpr uint64_t kHashIndexFilterBitsPerKey = 8;
+  typedef ::mica::transaction::ChangeCapture<CaptureDBConfig> Logger;
+};
+
+typedef DBConfig::Alloc Alloc;
+typedef DBConfig::Timestamp Timestamp;
+typedef ::mica::transaction::PagePool<DBConfig> PagePool;
+typedef ::mica::transaction::DB<DBConfig> DB;
+typedef ::mica::transaction::Transaction<DBConfig> Transaction;
+typedef ::mica::transaction::Result Result;
+typedef ::mica::transaction::BTreeRangeType BTreeRangeType;
+typedef ::mica::transaction::Recovery<DBConfig> Recovery;
+typedef ::mica::transaction::Checkpointer<DBConfig> Checkpointer;
+
+typedef ::mica::transaction::PagePool<CommandDBConfig> CommandPagePool;
+typedef ::mica::transaction::DB<CommandDBConfig> CommandDB;
+typedef ::mica::transaction::Transaction<CommandDBConfig> CommandTransaction;
+typedef ::mica::transaction::CommandReplay<CommandDBConfig> CommandReplay;
+
+typedef ::mica::transaction::PagePool<CaptureDBConfig> CapturePagePool;
+typedef ::mica::transaction::DB<CaptureDBConfig> CaptureDB;
+typedef ::mica::transaction::Transaction<CaptureDBConfig> CaptureTransaction;
+typedef ::mica::transaction::ChangeRecord<CaptureDBConfig> ChangeRecord;
+typedef ::mica::transaction::ChangeOp ChangeOp;
+typedef ::mica::transaction::LogTxHeader<DBConfig> LogTxHeader;
+typedef ::mica::transaction::LogRecordHeader LogRecordHeader;
+
+static ::mica::util::Stopwatch sw;
+static Alloc* alloc;
+
+// id is in a unique HashIndex and rank in an OLCBTreeIndex.  An update of
+// counter marks only its bytes as modified.
+struct Row {
+  uint64_t id;
+  uint64_t rank;
+  uint64_t counter;
+  uint64_t payload[5];
+};
+
+static bool operator==(const Row& a, const Row& b) {
+  return ::memcmp(&a, &b, sizeof(Row)) == 0;
+}
+
+// Row ID to row.
+typedef std::map<uint64_t, Row> Rows;
+
+// The key ranges.  Random ids and ranks collide often enough to abort some
+// commits.
+static const uint64_t kIDRange = 4096;
+static const uint64_t kRankRange = 4096;
+// The maximum number of rows accessed by a transaction.
+static const uint64_t kMaxAccesses = 4;
+// The number of index lookups in a transaction, which is limited by
+// BasicDBConfig::kMaxAccessSize.
+static const uint64_t kLookupBatchSize = 128;
+// The maximum number of DB::idle() calls to wait for durable_ts().
+static const uint64_t kMaxIdleCount = 1000000;
+
+static const char* kLogPrefix = "test_logging_log_";
+static const char* kRecoveredLogPrefix = "test_logging_recovered_log_";
+static const char* kCheckpointPrefix = "test_logging_checkpoint_";
+static const char* kCommandLogPrefix = "test_logging_cmd_log_";
+static const char* kReplayedCommandLogPrefix = "test_logging_replayed_cmd_log_";
+
+static uint64_t failure_count = 0;
+
+static void check(bool cond, const char* what) {
+  if (cond) return;
+  printf("  FAILED: %s\n", what);
+  failure_count++;
+}
+
+template <class StaticConfig>
+static bool create_tables(::mica::transaction::DB<StaticConfig>* db) {
+  const uint64_t kDataSizes[] = {sizeof(Row)};
+  if (!db->create_table("main", 1, kDataSizes)) return false;
+  auto tbl = db->get_table("main");
+
+  if (!db->create_olc_btree_index_unique_u64("rank_idx", tbl) ||
+      !db->create_hash_index_unique_u64("id_idx", tbl, kIDRange))
+    return false;
+  tbl->add_secondary_index(0, offsetof(Row, rank),
+                           db->get_olc_btree_index_unique_u64("rank_idx"));
+  tbl->add_secondary_index(0, offsetof(Row, id),
+                           db->get_hash_index_unique_u64("id_idx"));
+  return true;
+}
+
+template <class StaticConfig>
+static bool init_indexes(::mica::transaction::DB<StaticConfig>* db) {
+  ::mica::transaction::Transaction<StaticConfig> tx(db->context(0));
+  return db->get_hash_index_unique_u64("id_idx")->init(&tx);
+}
+
+static Row make_row(std::mt19937_64& rng) {
+  Row row;
+  row.id = rng() % kIDRange;
+  row.rank = rng() % kRankRange;
+  row.counter = 0;
+  for (auto& v : row.payload) v = rng();
+  return row;
+}
+
+// Runs a transaction of random inserts, updates, and deletes.  It is aborted
+// by the application once in a while.  Returns the result of commit(), or
+// kAbortedByGetRow for an abort before it.
+template <class StaticConfig>
+static Result run_tx(::mica::transaction::Transaction<StaticConfig>* tx,
+                     ::mica::transaction::Table<StaticConfig>* tbl, Rows* rows,
+                     std::mt19937_64& rng) {
+  typedef ::mica::transaction::Transaction<StaticConfig> Transaction;
+  typedef ::mica::transaction::RowAccessHandle<StaticConfig> RowAccessHandle;
+
+  auto pending = *rows;
+  bool ok = tx->begin();
+  auto access_count = 1 + rng() % kMaxAccesses;
+  for (uint64_t i = 0; ok && i < access_count; i++) {
+    RowAccessHandle rah(tx);
+    auto op = rng() % 8;
+
+    if (op < 3 || pending.empty()) {
+      if (!rah.new_row(tbl, 0, Transaction::kNewRowID, true, sizeof(Row))) {
+        ok = false;
+        break;
+      }
+      auto row = make_row(rng);
+      ::memcpy(rah.data(), &row, sizeof(row));
+      pending[rah.row_id()] = row;
+      continue;
+    }
+
+    auto it = pending.lower_bound(rng() % (pending.rbegin()->first + 1));
+    if (!rah.peek_row(tbl, 0, it->first, true, true, true) ||
+        !rah.read_row() || !rah.write_row(sizeof(Row))) {
+      ok = false;
+      break;
+    }
+    Row row;
+    ::memcpy(&row, rah.cdata(), sizeof(row));
+    check(::memcmp(&row, &it->second, sizeof(row)) == 0, "read row");
+
+    if (op == 3) {
+      if (!rah.delete_row()) {
+        ok = false;
+        break;
+      }
+      pending.erase(it);
+      continue;
+    }
+
+    if (op < 6) {
+      row.counter += 1 + rng() % 100;
+      ::memcpy(rah.data(), &row, sizeof(row));
+      rah.mark_dirty(offsetof(Row, counter), sizeof(row.counter));
+    } else {
+      auto new_row = make_row(rng);
+      if (op == 6)
+        row.rank = new_row.rank;
+      else
+        ::memcpy(row.payload, new_row.payload, sizeof(row.payload));
+      ::memcpy(rah.data(), &row, sizeof(row));
+    }
+    it->second = row;
+  }
+
+  if (!ok || rng() % 16 == 0) {
+    tx->abort();
+    return Result::kAbortedByGetRow;
+  }
+
+  Result result;
+  if (tx->commit(&result)) rows->swap(pending);
+  return result;
+}
+
+// Returns the rows found by looking up every id in the HashIndex, and checks
+// that the table and the OLCBTreeIndex have the same rows.  No thread may be
+// active.
+template <class StaticConfig>
+static Rows read_rows(::mica::transaction::DB<StaticConfig>* db) {
+  typedef ::mica::transaction::Transaction<StaticConfig> Transaction;
+  typedef ::mica::transaction::RowAccessHandle<StaticConfig> RowAccessHandle;
+
+  auto tbl = db->get_table("main");
+  auto id_idx = db->get_hash_index_unique_u64("id_idx");
+  auto rank_idx = db->get_olc_btree_index_unique_u64("rank_idx");
+
+  uint64_t live_count = 0;
+  for (uint64_t row_id = 0; row_id < tbl->row_count(); row_id++) {
+    auto rv = tbl->latest_rv(0, row_id);
+    if (rv != nullptr &&
+        rv->status == ::mica::transaction::RowVersionStatus::kCommitted)
+      live_count++;
+  }
+
+  db->activate(0);
+  Transaction tx(db->context(0));
+
+  Rows rows;
+  bool read_ok = true;
+  for (uint64_t id = 0; id < kIDRange; id++) {
+    if (id % kLookupBatchSize == 0) {
+      if (id != 0) check(tx.commit(), "commit lookups");
+      tx.begin();
+    }
+    uint64_t row_id = 0;
+    auto ret = id_idx->lookup(&tx, id, false,
+                              [&](const uint64_t& key, uint64_t value) {
+                                (void)key;
+                                row_id = value;
+                                return true;
+                              });
+    if (ret == 0) continue;
+
+    RowAccessHandle rah(&tx);
+    Row row;
+    if (!rah.peek_row(tbl, 0, row_id, false, true, false) || !rah.read_row()) {
+      read_ok = false;
+      continue;
+    }
+    ::memcpy(&row, rah.cdata(), sizeof(row));
+    if (row.id != id) read_ok = false;
+    rows[row_id] = row;
+  }
+
+  std::map<uint64_t, uint64_t> ranks;
+  rank_idx
+      ->template lookup<BTreeRangeType::kOpen, BTreeRangeType::kOpen, false>(
+          &tx, 0, 0, false, [&](const uint64_t& key, uint64_t value) {
+            ranks[key] = value;
+            return true;
+          });
+  check(tx.commit(), "commit lookups");
+  db->deactivate(0);
+
+  std::map<uint64_t, uint64_t> expected_ranks;
+  for (auto& e : rows) expected_ranks[e.second.rank] = e.first;
+
+  check(read_ok, "read rows found in the hash index");
+  check(live_count == rows.size(), "find every row in the hash index");
+  check(ranks == expected_ranks, "olc btree index entries");
+  return rows;
+}
+
+// The entries of a log file.
+struct LogContent {
+  bool valid;
+  uint64_t size;
+  std::vector<Timestamp> tx_ts;
+  uint64_t record_count;
+  uint64_t delta_record_count;
+  // The range of the row data covered by delta records.
+  uint64_t delta_begin;
+  uint64_t delta_end;
+};
+
+static LogContent read_log(const std::string& path) {
+  LogContent content;
+  content.valid = false;
+  content.size = 0;
+  content.record_count = 0;
+  content.delta_record_count = 0;
+  content.delta_begin = sizeof(Row);
+  content.delta_end = 0;
+
+  std::vector<char> buf;
+  auto fp = fopen(path.c_str(), "rb");
+  if (fp == nullptr) return content;
+  char chunk[65536];
+  size_t len;
+  while ((len = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+    buf.insert(buf.end(), chunk, chunk + len);
+  fclose(fp);
+  content.size = buf.size();
+
+  uint64_t off = 0;
+  while (off + sizeof(LogTxHeader) <= buf.size()) {
+    auto tx_h = reinterpret_cast<const LogTxHeader*>(buf.data() + off);
+    if (tx_h->size < sizeof(LogTxHeader) || off + tx_h->size > buf.size())
+      return content;
+
+    uint64_t rec_off = off + sizeof(LogTxHeader);
+    for (uint32_t i = 0; i < tx_h->record_count; i++) {
+      if (rec_off + sizeof(LogRecordHeader) > off + tx_h->size) return content;
+      auto rec_h =
+          reinterpret_cast<const LogRecordHeader*>(buf.data() + rec_off);
+      rec_off += sizeof(LogRecordHeader) + ((rec_h->data_size + 7) & ~7U);
+      if (rec_h->is_delta) {
+        content.delta_record_count++;
+        content.delta_begin = std::min(content.delta_begin,
+                                       uint64_t(rec_h->data_off));
+        content.delta_end =
+            std::max(content.delta_end,
+                     uint64_t(rec_h->data_off) + rec_h->data_size);
+      }
+    }
+    if (rec_off != off + tx_h->size) return content;
+
+    content.tx_ts.push_back(tx_h->ts);
+    content.record_count += tx_h->record_count;
+    off += tx_h->size;
+  }
+  content.valid = off == buf.size();
+  return content;
+}
+
+template <class StaticConfig>
+static bool wait_for_durable_ts(::mica::transaction::DB<StaticConfig>* db,
+                                const Timestamp& ts) {
+  for (uint64_t i = 0; i < kMaxIdleCount && db->durable_ts() < ts; i++)
+    db->idle(0);
+  return !(db->durable_ts() < ts);
+}
+
+// Checks that the log of the thread has the committed transactions in order.
+static void check_log(const DBConfig::Logger& logger,
+                      const std::vector<Timestamp>& committed) {
+  auto content = read_log(logger.log_path(0));
+  check(content.valid, "read complete log entries");
+  check(content.size == logger.written_size(0), "write out the log");
+
+  bool ordered = true;
+  for (size_t i = 1; i < content.tx_ts.size(); i++)
+    if (!(content.tx_ts[i - 1] < content.tx_ts[i])) ordered = false;
+  check(ordered, "log transactions in timestamp order");
+
+  // The log also has the transactions of HashIndex::init().
+  size_t j = 0;
+  for (size_t i = 0; i < content.tx_ts.size() && j < committed.size(); i++)
+    if (content.tx_ts[i] == committed[j]) j++;
+  check(j == committed.size(), "log every committed transaction");
+  check(!content.tx_ts.empty() && !committed.empty() &&
+            content.tx_ts.back() == committed.back(),
+        "log no aborted transaction after the last commit");
+
+  check(content.delta_record_count != 0, "log delta records");
+  check(content.delta_begin == offsetof(Row, counter) &&
+            content.delta_end == offsetof(Row, counter) + sizeof(uint64_t),
+        "log only modified bytes");
+}
+
+// Runs num_txs transactions with the log synced only by sync_log() and
+// deactivate(), and takes a checkpoint after half of them.  Returns the
+// remaining rows in rows.
+static void test_parallel_logger(DB* db, DBConfig::Logger* logger,
+                                 Checkpointer* checkpointer, uint64_t num_txs,
+                                 Rows* rows) {
+  printf("parallel logger:\n");
+
+  auto tbl = db->get_table("main");
+  std::mt19937_64 rng(1);
+  std::vector<Timestamp> committed;
+
+  db->set_log_sync_interval(DB::kNoPeriodicLogSync);
+  db->activate(0);
+  check(init_indexes(db), "initialize indexes");
+
+  Transaction tx(db->context(0));
+  auto run = [&](uint64_t count) {
+    for (uint64_t i = 0; i < count; i++)
+      if (run_tx(&tx, tbl, rows, rng) == Result::kCommitted)
+        committed.push_back(tx.ts());
+  };
+
+  run(num_txs / 2);
+  check(!committed.empty(), "commit transactions");
+  for (uint64_t i = 0; i < 1000; i++) db->idle(0);
+  check(db->durable_ts() < committed.back(),
+        "keep durable_ts until the log is synced");
+
+  check(db->sync_log(0), "sync the log");
+  check(wait_for_durable_ts(db, committed.back()),
+        "advance durable_ts after sync_log()");
+  check_log(*logger, committed);
+
+  // The context of the checkpoint thread must not be used meanwhile.
+  db->deactivate(0);
+  check(checkpointer->checkpoint(kCheckpointPrefix, {0}), "write a checkpoint");
+  db->activate(0);
+
+  run(num_txs - num_txs / 2);
+  db->deactivate(0);
+  check_log(*logger, committed);
+
+  // deactivate() has synced the log, so durable_ts() reaches the last commit
+  // once a thread is active again.
+  db->activate(0);
+  check(wait_for_durable_ts(db, committed.back()),
+        "advance durable_ts after deactivate()");
+  db->deactivate(0);
+
+  auto content = read_log(logger->log_path(0));
+  printf("  %zu committed, %zu rows, %" PRIu64 " bytes of log, %" PRIu64
+         " of %" PRIu64 " records are delta\n",
+         committed.size(), rows->size(), logger->written_size(0),
+         content.delta_record_count, content.record_count);
+}
+
+// Recovers the files into a new DB and runs more transactions on it.
+static void test_recovery(const std::vector<std::string>& paths,
+                          const Timestamp* min_ts, const Rows& rows) {
+  PagePool* page_pools[2];
+  page_pools[0] = new PagePool(alloc, uint64_t(1073741824), 0);
+  page_pools[1] = nullptr;
+  DBConfig::Logger logger(kRecoveredLogPrefix);
+  {
+    DB db(page_pools, &logger, &sw, 1);
+    bool ret = create_tables(&db);
+    assert(ret);
+    (void)ret;
+
+    Recovery recovery(&db);
+    check(recovery.replay(paths, 1, nullptr, min_ts), "replay the files");
+
+    // Checkpoint files are in the log format.
+    uint64_t tx_count = 0;
+    bool has_last_ts = false;
+    Timestamp last_ts;
+    for (auto& path : paths) {
+      auto content = read_log(path);
+      check(content.valid, "read complete entries");
+      for (auto& ts : content.tx_ts) {
+        if (min_ts != nullptr && ts < *min_ts) continue;
+        tx_count++;
+        if (!has_last_ts || last_ts < ts) last_ts = ts;
+        has_last_ts = true;
+      }
+    }
+    check(recovery.tx_count() == tx_count, "replay every transaction");
+    check(has_last_ts && recovery.last_ts() == last_ts,
+          "replay up to the last transaction");
+
+    auto recovered_rows = read_rows(&db);
+    check(recovered_rows == rows, "recover rows");
+
+    // New transactions get later timestamps and see the recovered indexes.
+    Rows new_rows = rows;
+    std::mt19937_64 rng(2);
+    uint64_t committed = 0;
+    db.activate(0);
+    {
+      Transaction tx(db.context(0));
+      auto tbl = db.get_table("main");
+      for (uint64_t i = 0; i < 1000; i++)
+        if (run_tx(&tx, tbl, &new_rows, rng) == Result::kCommitted)
+          committed++;
+    }
+    db.deactivate(0);
+    check(committed != 0, "commit transactions after recovery");
+    check(read_rows(&db) == new_rows, "run transactions after recovery");
+
+    printf("  %" PRIu64 " transactions, %" PRIu64 " records, %zu rows\n",
+           recovery.tx_count(), recovery.record_count(), recovered_rows.size());
+  }
+  delete page_pools[0];
+}
+
+// The stored procedures for CommandLogger.
+enum Proc : uint16_t {
+  kInsertProc = 0,  // Args: Row.
+  kUpdateProc,      // Args: UpdateArgs.
+  kDeleteProc,      // Args: id.
+};
+
+struct UpdateArgs {
+  uint64_t id;
+  uint64_t delta;
+};
+
+// The number of times that replay runs a procedure until it commits.
+static const uint64_t kMaxReplayAttempts = 16;
+
+// Runs a procedure once, which does nothing for an id that is not found.
+// Returns whether it has committed.
+static bool run_proc(CommandDB* db, CommandTransaction* tx, uint16_t proc_id,
+                     const char* args, uint32_t args_size) {
+  typedef ::mica::transaction::RowAccessHandle<CommandDBConfig>
+      RowAccessHandle;
+  typedef CommandDB::HashIndexUniqueU64 HashIndex;
+
+  auto tbl = db->get_table("main");
+  auto id_idx = db->get_hash_index_unique_u64("id_idx");
+
+  if (!tx->begin()) return false;
+  tx->set_command(proc_id, args, args_size);
+
+  bool ok = true;
+  if (proc_id == kInsertProc) {
+    assert(args_size == sizeof(Row));
+    RowAccessHandle rah(tx);
+    ok = rah.new_row(tbl, 0, CommandTransaction::kNewRowID, true, sizeof(Row));
+    if (ok) ::memcpy(rah.data(), args, sizeof(Row));
+  } else {
+    UpdateArgs update_args;
+    assert(args_size ==
+           (proc_id == kUpdateProc ? sizeof(UpdateArgs) : sizeof(uint64_t)));
+    ::memcpy(&update_args, args, args_size);
+
+    uint64_t row_id = 0;
+    auto ret = id_idx->lookup(tx, update_args.id, false,
+                              [&](const uint64_t& key, uint64_t value) {
+                                (void)key;
+                                row_id = value;
+                                return true;
+                              });
+    ok = ret != HashIndex::kHaveToAbort;
+
+    if (ok && ret == 1) {
+      RowAccessHandle rah(tx);
+      ok = rah.peek_row(tbl, 0, row_id, true, true, true) && rah.read_row() &&
+           rah.write_row(sizeof(Row));
+      if (ok && proc_id == kUpdateProc) {
+        Row row;
+        ::memcpy(&row, rah.cdata(), sizeof(row));
+        row.counter += update_args.delta;
+        ::memcpy(rah.data(), &row, sizeof(row));
+        rah.mark_dirty(offsetof(Row, counter), sizeof(row.counter));
+      } else if (ok) {
+        ok = rah.delete_row();
+      }
+    }
+  }
+
+  if (!ok) {
+    tx->abort();
+    return false;
+  }
+  return tx->commit();
+}
+
+// Row IDs may differ after replay.
+static std::map<uint64_t, Row> rows_by_id(const Rows& rows) {
+  std::map<uint64_t, Row> m;
+  for (auto& e : rows) m[e.second.id] = e.second;
+  return m;
+}
+
+// Runs num_txs random procedures and replays their command log into a new DB.
+static void test_command_replay(uint64_t num_txs) {
+  printf("command replay:\n");
+
+  Rows rows;
+  uint64_t committed = 0;
+  {
+    CommandPagePool* page_pools[2];
+    page_pools[0] = new CommandPagePool(alloc, uint64_t(1073741824), 0);
+    page_pools[1] = nullptr;
+    // HashIndex::init() is not logged.
+    CommandDBConfig::Logger logger(kCommandLogPrefix, true);
+    {
+      CommandDB db(page_pools, &logger, &sw, 1);
+      bool ret = create_tables(&db);
+      assert(ret);
+      (void)ret;
+
+      db.activate(0);
+      check(init_indexes(&db), "initialize indexes");
+
+      CommandTransaction tx(db.context(0));
+      std::mt19937_64 rng(3);
+      for (uint64_t i = 0; i < num_txs; i++) {
+        auto op = rng() % 4;
+        auto row = make_row(rng);
+        UpdateArgs update_args{row.id, 1 + rng() % 100};
+        bool ok;
+        if (op < 2)
+          ok = run_proc(&db, &tx, kInsertProc,
+                        reinterpret_cast<const char*>(&row), sizeof(row));
+        else if (op == 2)
+          ok = run_proc(&db, &tx, kUpdateProc,
+                        reinterpret_cast<const char*>(&update_args),
+                        sizeof(update_args));
+        else
+          ok = run_proc(&db, &tx, kDeleteProc,
+                        reinterpret_cast<const char*>(&row.id),
+                        sizeof(row.id));
+        if (ok) committed++;
+      }
+      db.deactivate(0);
+
+      rows = read_rows(&db);
+    }
+    delete page_pools[0];
+  }
+  check(committed != 0, "commit procedures");
+
+  CommandPagePool* page_pools[2];
+  page_pools[0] = new CommandPagePool(alloc, uint64_t(1073741824), 0);
+  page_pools[1] = nullptr;
+  CommandDBConfig::Logger logger(kReplayedCommandLogPrefix, true);
+  {
+    CommandDB db(page_pools, &logger, &sw, 1);
+    bool ret = create_tables(&db);
+    assert(ret);
+    (void)ret;
+
+    // Setup work is redone before replay.
+    db.activate(0);
+    check(init_indexes(&db), "initialize indexes");
+    db.deactivate(0);
+
+    CommandReplay replay(&db);
+    check(replay.replay({std::string(kCommandLogPrefix) + "0"}, 0,
+                        [&db](CommandTransaction* tx, uint16_t proc_id,
+                              const char* args, uint32_t args_size) {
+                          for (uint64_t i = 0; i < kMaxReplayAttempts; i++)
+                            if (run_proc(&db, tx, proc_id, args, args_size))
+                              return true;
+                          return false;
+                        }),
+          "replay commands");
+    check(replay.command_count() != 0 && replay.command_count() <= committed,
+          "replay logged commands");
+
+    auto replayed_rows = read_rows(&db);
+    check(rows_by_id(replayed_rows) == rows_by_id(rows), "replay rows");
+
+    printf("  %" PRIu64 " committed, %" PRIu64 " replayed, %zu rows\n",
+           committed, replay.command_count(), replayed_rows.size());
+  }
+  delete page_pools[0];
+}
+
+// The ring size of ChangeCapture, which holds the changes of
+// HashIndex::init().
+static const uint64_t kChangeRingSize = 1048576;
+// The number of transactions whose changes are dropped without a consumer.
+static const uint64_t kDroppedTxCount = 100;
+// The maximum number of transactions to run without a consumer.
+static const uint64_t kMaxTxsWithoutConsumer = 100000;
+
+// Runs num_txs transactions while polling their changes, and then more
+// without polling until the ring is full.
+static void test_change_capture(uint64_t num_txs) {
+  printf("change capture:\n");
+
+  CapturePagePool* page_pools[2];
+  page_pools[0] = new CapturePagePool(alloc, uint64_t(1073741824), 0);
+  page_pools[1] = nullptr;
+  CaptureDBConfig::Logger capture(nullptr, kChangeRingSize);
+  {
+    CaptureDB db(page_pools, &capture, &sw, 1);
+    bool ret = create_tables(&db);
+    assert(ret);
+    (void)ret;
+    auto tbl = db.get_table("main");
+
+    Rows rows;
+    Rows captured_rows;
+    std::vector<Timestamp> changed;
+    std::vector<Timestamp> captured;
+    bool ordered = true;
+    bool applied = true;
+
+    auto apply = [&](const ChangeRecord& rec, const char* data) {
+      if (!captured.empty() && rec.ts < captured.back()) ordered = false;
+      if (rec.last) captured.push_back(rec.ts);
+      if (rec.table_id != tbl->id()) return;
+
+      auto it = captured_rows.find(rec.row_id);
+      if ((rec.op == ChangeOp::kInsert) != (it == captured_rows.end()))
+        applied = false;
+      if (rec.op == ChangeOp::kDelete) {
+        if (it != captured_rows.end()) captured_rows.erase(it);
+      } else if (rec.data_size == sizeof(Row)) {
+        ::memcpy(&captured_rows[rec.row_id], data, sizeof(Row));
+      } else {
+        applied = false;
+      }
+    };
+    // Transactions are emitted once min_wts passes them.
+    auto drain = [&] {
+      for (uint64_t i = 0; i < kMaxIdleCount && capture.pending_size(0) != 0;
+           i++) {
+        db.idle(0);
+        capture.poll(&db, apply);
+      }
+      return capture.pending_size(0) == 0;
+    };
+
+    db.activate(0);
+    check(init_indexes(&db), "initialize indexes");
+    check(drain(), "poll the changes of init()");
+
+    CaptureTransaction tx(db.context(0));
+    std::mt19937_64 rng(4);
+    for (uint64_t i = 0; i < num_txs; i++) {
+      // A transaction that only deletes its new rows has no change.
+      auto prev_rows = rows;
+      if (run_tx(&tx, tbl, &rows, rng) == Result::kCommitted &&
+          !(rows == prev_rows))
+        changed.push_back(tx.ts());
+      db.idle(0);
+      capture.poll(&db, apply);
+    }
+    check(drain(), "poll every change");
+    check(capture.dropped_tx_count(0) == 0, "keep changes while polled");
+    check(ordered, "poll changes in timestamp order");
+    check(applied, "poll inserts, updates, and deletes of the rows");
+    check(captured_rows == rows, "reproduce rows from the changes");
+
+    size_t j = 0;
+    for (size_t i = 0; i < captured.size() && j < changed.size(); i++)
+      if (captured[i] == changed[j]) j++;
+    check(j == changed.size(), "poll every committed transaction");
+
+    // Without a consumer, the ring fills up and the changes are dropped, but
+    // transactions keep committing.
+    uint64_t committed_without_consumer = 0;
+    uint64_t aborted_by_logging = 0;
+    for (uint64_t i = 0; i < kMaxTxsWithoutConsumer &&
+                       capture.dropped_tx_count(0) < kDroppedTxCount;
+         i++) {
+      auto result = run_tx(&tx, tbl, &rows, rng);
+      if (result == Result::kCommitted)
+        committed_without_consumer++;
+      else if (result == Result::kAbortedByLogging)
+        aborted_by_logging++;
+    }
+    check(aborted_by_logging == 0, "commit with a full ring");
+    check(capture.dropped_tx_count(0) == kDroppedTxCount,
+          "drop changes with a full ring");
+    check(capture.dropped_tx_count(0) < committed_without_consumer,
+          "keep changes that fit");
+    check(drain(), "poll every kept change");
+    db.deactivate(0);
+
+    check(read_rows(&db) == rows, "keep rows");
+
+    printf("  %zu changed with polling, %" PRIu64
+           " committed without polling, %" PRIu64 " dropped\n",
+           changed.size(), committed_without_consumer,
+           capture.dropped_tx_count(0));
+  }
+  delete page_pools[0];
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc != 2) {
+    printf("%s NUM-TXS\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  auto config = ::mica::util::Config::load_file("test_tx.json");
+
+  uint64_t num_txs = static_cast<uint64_t>(atol(argv[1]));
+
+  alloc = new Alloc(config.get("alloc"));
+
+  ::mica::util::lcore.pin_thread(0);
+
+  sw.init_start();
+  sw.init_end();
+
+  Rows rows;
+  Checkpointer::Info info;
+  {
+    PagePool* page_pools[2];
+    page_pools[0] = new PagePool(alloc, uint64_t(1073741824), 0);
+    page_pools[1] = nullptr;
+    DBConfig::Logger logger(kLogPrefix);
+    {
+      DB db(page_pools, &logger, &sw, 1);
+      bool ret = create_tables(&db);
+      assert(ret);
+      (void)ret;
+      Checkpointer checkpointer(&db);
+      test_parallel_logger(&db, &logger, &checkpointer, num_txs, &rows);
+      check(read_rows(&db) == rows, "keep rows");
+      check(Checkpointer::read_info(kCheckpointPrefix, &info) &&
+                info.checkpoint_ts == checkpointer.checkpoint_ts(),
+            "read the checkpoint info");
+    }
+    delete page_pools[0];
+  }
+
+  auto log_path = std::string(kLogPrefix) + "0";
+
+  printf("recovery:\n");
+  test_recovery({log_path}, nullptr, rows);
+
+  printf("checkpoint recovery:\n");
+  auto paths = Checkpointer::paths(kCheckpointPrefix, info);
+  check(paths.size() == 1, "find the checkpoint files");
+  auto content = read_log(log_path);
+  check(!content.tx_ts.empty() && content.tx_ts.front() < info.checkpoint_ts,
+        "log transactions before the checkpoint");
+  paths.push_back(log_path);
+  test_recovery(paths, &info.checkpoint_ts, rows);
+
+  test_command_replay(num_txs);
+
+  test_change_capture(num_txs);
+
+  if (failure_count != 0) {
+    printf("%" PRIu64 " checks failed\n", failure_count);
+    return EXIT_FAILURE;
+  }
+  printf("all checks passed\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,306 @@
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <set>
+#include <utility>
+#include "mica/transaction/db.h"
+#include "mica/util/lcore.h"
+
+// Checks the secondary indexes declared with Table::add_secondary_index()
+// against the rows that committed transactions have left: new rows, updates
+// that do and do not change indexed columns, deleted rows, aborted
+// transactions, and commits aborted by a duplicate key in a unique index
+// after other indexes have been updated.  OLCBTreeIndex::rebuild() and
+// DB::rebuild_volatile_indexes() must restore the same entries.
+
+struct DBConfig : public ::mica::transaction::BasicDBConfig {
+  typedef ::mica::transaction::NullLogger<DBConfig> Logger;
+};
+
+typedef DBConfig::Alloc Alloc;
+typedef ::mica::transaction::PagePool<DBConfig> PagePool;
+typedef ::mica::transaction::DB<DBConfig> DB;
+typedef ::mica::transaction::Table<DBConfig> Table;
+typedef ::mica::transaction::Transaction<DBConfig> Transaction;
+typedef ::mica::transaction::RowAccessHandle<DBConfig> RowAccessHandle;
+typedef ::mica::transaction::Result Result;
+typedef ::mica::transaction::BTreeRangeType BTreeRangeType;
+typedef DB::HashIndexUniqueU64 HashIndex;
+typedef DB::BTreeIndexNonuniqueU64 BTreeIndex;
+typedef DB::OLCBTreeIndexUniqueU64 OLCBTreeIndex;
+
+static ::mica::util::Stopwatch sw;
+
+// id is in a unique HashIndex, group in a non-unique BTreeIndex, and rank in
+// an OLCBTreeIndex.  payload is not indexed.
+struct Row {
+  uint64_t id;
+  uint64_t group;
+  uint64_t rank;
+  uint64_t payload;
+};
+
+// The key ranges.  Random ids and ranks collide often enough to abort some
+// commits.
+static const uint64_t kIDRange = 4096;
+static const uint64_t kGroupRange = 16;
+static const uint64_t kRankRange = 4096;
+// The maximum number of rows accessed by a transaction.
+static const uint64_t kMaxAccesses = 4;
+// The number of transactions between index checks.
+static const uint64_t kCheckInterval = 500;
+// The number of hash index lookups in a transaction, which is limited by
+// BasicDBConfig::kMaxAccessSize.
+static const uint64_t kLookupBatchSize = 256;
+
+static uint64_t failure_count = 0;
+
+static void check(bool cond, const char* what) {
+  if (cond) return;
+  printf("  FAILED: %s\n", what);
+  failure_count++;
+}
+
+struct Indexes {
+  HashIndex* id_idx;
+  BTreeIndex* group_idx;
+  OLCBTreeIndex* rank_idx;
+};
+
+// Compares the entries of the indexes with the rows (row ID to row).
+static void check_indexes(DB* db, const Indexes& idxs,
+                          const std::map<uint64_t, Row>& rows) {
+  std::map<uint64_t, uint64_t> ids;
+  std::set<std::pair<uint64_t, uint64_t>> groups;
+  std::map<uint64_t, uint64_t> ranks;
+  for (auto& e : rows) {
+    ids[e.second.id] = e.first;
+    groups.emplace(e.second.group, e.first);
+    ranks[e.second.rank] = e.first;
+  }
+
+  Transaction tx(db->context(0));
+
+  uint64_t id_mismatches = 0;
+  for (uint64_t id = 0; id < kIDRange; id++) {
+    if (id % kLookupBatchSize == 0) {
+      if (id != 0) check(tx.commit(), "commit lookups");
+      tx.begin();
+    }
+    uint64_t found_value = HashIndex::kNullRowID;
+    auto ret = idxs.id_idx->lookup(&tx, id, false,
+                                   [&](const uint64_t& key, uint64_t value) {
+                                     (void)key;
+                                     found_value = value;
+                                     return true;
+                                   });
+    auto it = ids.find(id);
+    if (it == ids.end() ? ret != 0 : ret != 1 || found_value != it->second)
+      id_mismatches++;
+  }
+
+  std::set<std::pair<uint64_t, uint64_t>> found_groups;
+  idxs.group_idx
+      ->lookup<BTreeRangeType::kOpen, BTreeRangeType::kOpen, false>(
+          &tx, {0, 0}, {0, 0}, false,
+          [&](const std::pair<uint64_t, uint64_t>& key, uint64_t value) {
+            (void)value;
+            found_groups.insert(key);
+            return true;
+          });
+
+  std::map<uint64_t, uint64_t> found_ranks;
+  idxs.rank_idx->lookup<BTreeRangeType::kOpen, BTreeRangeType::kOpen, false>(
+      &tx, 0, 0, false, [&](const uint64_t& key, uint64_t value) {
+        found_ranks[key] = value;
+        return true;
+      });
+
+  check(tx.commit(), "commit lookups");
+  check(id_mismatches == 0, "unique hash index entries");
+  check(found_groups == groups, "non-unique btree index entries");
+  check(found_ranks == ranks, "olc btree index entries");
+}
+
+static Row make_row(std::mt19937_64& rng) {
+  Row row;
+  row.id = rng() % kIDRange;
+  row.group = rng() % kGroupRange;
+  row.rank = rng() % kRankRange;
+  row.payload = rng();
+  return row;
+}
+
+// Runs a transaction of random inserts, updates, and deletes.  It is aborted
+// by the application once in a while.  Returns the result of commit(), or
+// kAbortedByGetRow for an abort before it.
+static Result run_tx(Transaction* tx, Table* tbl,
+                     std::map<uint64_t, Row>* rows, std::mt19937_64& rng) {
+  auto pending = *rows;
+  bool ok = tx->begin();
+  auto access_count = 1 + rng() % kMaxAccesses;
+  for (uint64_t i = 0; ok && i < access_count; i++) {
+    RowAccessHandle rah(tx);
+    auto op = rng() % 8;
+
+    if (op < 3 || pending.empty()) {
+      if (!rah.new_row(tbl, 0, Transaction::kNewRowID, true, sizeof(Row))) {
+        ok = false;
+        break;
+      }
+      auto row = make_row(rng);
+      ::memcpy(rah.data(), &row, sizeof(row));
+      pending[rah.row_id()] = row;
+      continue;
+    }
+
+    auto it = pending.lower_bound(rng() % (pending.rbegin()->first + 1));
+    if (!rah.peek_row(tbl, 0, it->first, true, true, true) ||
+        !rah.read_row() || !rah.write_row(sizeof(Row))) {
+      ok = false;
+      break;
+    }
+    Row row;
+    ::memcpy(&row, rah.cdata(), sizeof(row));
+    check(::memcmp(&row, &it->second, sizeof(row)) == 0, "read row");
+
+    if (op == 3) {
+      if (!rah.delete_row()) {
+        ok = false;
+        break;
+      }
+      pending.erase(it);
+      continue;
+    }
+
+    // Change one of the columns, possibly to the same key.
+    auto new_row = make_row(rng);
+    if (op == 4)
+      row.id = new_row.id;
+    else if (op == 5)
+      row.group = new_row.group;
+    else if (op == 6)
+      row.rank = new_row.rank;
+    else
+      row.payload = new_row.payload;
+    ::memcpy(rah.data(), &row, sizeof(row));
+    it->second = row;
+  }
+
+  if (!ok || rng() % 16 == 0) {
+    tx->abort();
+    return Result::kAbortedByGetRow;
+  }
+
+  Result result;
+  if (tx->commit(&result)) rows->swap(pending);
+  return result;
+}
+
+static void test_secondary_index(DB* db, const Indexes& idxs,
+                                 uint64_t num_txs) {
+  printf("secondary index:\n");
+
+  auto tbl = db->get_table("main");
+  std::map<uint64_t, Row> rows;
+  std::mt19937_64 rng(1);
+
+  Transaction tx(db->context(0));
+  uint64_t committed = 0;
+  uint64_t duplicates = 0;
+  for (uint64_t i = 0; i < num_txs; i++) {
+    auto result = run_tx(&tx, tbl, &rows, rng);
+    if (result == Result::kCommitted)
+      committed++;
+    else if (result == Result::kAbortedBySecondaryIndexUpdate)
+      duplicates++;
+    if ((i + 1) % kCheckInterval == 0) check_indexes(db, idxs, rows);
+  }
+  check_indexes(db, idxs, rows);
+  printf("  %" PRIu64 " committed, %" PRIu64 " aborted by duplicate keys, %zu "
+         "rows\n",
+         committed, duplicates, rows.size());
+  check(committed != 0, "commit transactions");
+  check(duplicates != 0, "abort transactions with duplicate keys");
+
+  // rebuild() must drop an entry that is not in the table.
+  auto stray_rank = kRankRange;
+  tx.begin();
+  check(idxs.rank_idx->insert(&tx, stray_rank, 0) == 1, "insert stray entry");
+  check(tx.commit(), "commit stray entry");
+  db->deactivate(0);
+  check(idxs.rank_idx->rebuild(), "rebuild olc btree index");
+  db->activate(0);
+  check_indexes(db, idxs, rows);
+
+  // The filter of the hash index as well.
+  db->deactivate(0);
+  db->rebuild_volatile_indexes();
+  db->activate(0);
+  check_indexes(db, idxs, rows);
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc != 2) {
+    printf("%s NUM-TXS\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  auto config = ::mica::util::Config::load_file("test_tx.json");
+
+  uint64_t num_txs = static_cast<uint64_t>(atol(argv[1]));
+
+  Alloc alloc(config.get("alloc"));
+  PagePool* page_pools[2];
+  page_pools[0] = new PagePool(&alloc, uint64_t(1073741824), 0);
+  page_pools[1] = nullptr;
+
+  ::mica::util::lcore.pin_thread(0);
+
+  sw.init_start();
+  sw.init_end();
+
+  DBConfig::Logger logger;
+  DB db(page_pools, &logger, &sw, 1);
+
+  const uint64_t kDataSizes[] = {sizeof(Row)};
+  bool ret = db.create_table("main", 1, kDataSizes);
+  assert(ret);
+  auto tbl = db.get_table("main");
+
+  ret = db.create_btree_index_nonunique_u64("group_idx", tbl);
+  assert(ret);
+  ret = db.create_olc_btree_index_unique_u64("rank_idx", tbl);
+  assert(ret);
+  ret = db.create_hash_index_unique_u64("id_idx", tbl, kIDRange);
+  assert(ret);
+  (void)ret;
+
+  Indexes idxs;
+  idxs.id_idx = db.get_hash_index_unique_u64("id_idx");
+  idxs.group_idx = db.get_btree_index_nonunique_u64("group_idx");
+  idxs.rank_idx = db.get_olc_btree_index_unique_u64("rank_idx");
+
+  // The unique hash index is updated last so that a duplicate id aborts a
+  // commit after the other indexes have been updated.
+  tbl->add_secondary_index(0, offsetof(Row, group), idxs.group_idx);
+  tbl->add_secondary_index(0, offsetof(Row, rank), idxs.rank_idx);
+  tbl->add_secondary_index(0, offsetof(Row, id), idxs.id_idx);
+
+  db.activate(0);
+  {
+    Transaction tx(db.context(0));
+    idxs.id_idx->init(&tx);
+    idxs.group_idx->init(&tx);
+  }
+  test_secondary_index(&db, idxs, num_txs);
+  db.deactivate(0);
+
+  if (failure_count != 0) {
+    printf("%" PRIu64 " checks failed\n", failure_count);
+    return EXIT_FAILURE;
+  }
+  printf("all checks passed\n");
+  return EXIT_SUCCESS;
+}
@@ -102,6 +102,11 @@ class VerificationLogger
     return true;
   }
 
+  bool sync(uint16_t thread_id) {
+    (void)thread_id;
+    return true;
+  }
+
   std::vector<Task>* tasks;
 };
 
@@ -469,91 +474,126 @@ int main(int argc, const char* argv[]) {
   {
     printf("initializing table\n");
 
-    std::vector<std::thread> threads;
-    uint64_t init_num_threads = std::min(uint64_t(2), num_threads);
-    for (uint64_t thread_id = 0; thread_id < init_num_threads; thread_id++) {
-      threads.emplace_back([&, thread_id] {
-        ::mica::util::lcore.pin_thread(thread_id);
+    if (kBulkLoad && !kUseBTreeIndex) {
+      // Bulk loading requires all threads to be inactive.
+      db.deactivate(0);
 
-        db.activate(static_cast<uint16_t>(thread_id));
-        while (db.active_thread_count() < init_num_threads) {
-          ::mica::util::pause();
-          db.idle(static_cast<uint16_t>(thread_id));
-        }
+      ::mica::transaction::BulkLoader<DBConfig> loader(
+          &db, static_cast<uint16_t>(num_threads));
+      std::vector<std::vector<std::pair<uint64_t, uint64_t>>> entries(
+          num_threads);
 
+      bool ret = loader.run([&](uint16_t thread_id) {
         // Randomize the data layout by shuffling row insert order.
         std::mt19937 g(thread_id);
         std::vector<uint64_t> row_ids;
-        row_ids.reserve((num_rows + init_num_threads - 1) / init_num_threads);
-        for (uint64_t i = thread_id; i < num_rows; i += init_num_threads)
+        row_ids.reserve((num_rows + num_threads - 1) / num_threads);
+        for (uint64_t i = thread_id; i < num_rows; i += num_threads)
           row_ids.push_back(i);
         std::shuffle(row_ids.begin(), row_ids.end(), g);
 
-        Transaction tx(db.context(static_cast<uint16_t>(thread_id)));
-        const uint64_t kBatchSize = 16;
-        for (uint64_t i = 0; i < row_ids.size(); i += kBatchSize) {
-          while (true) {
-            bool ret = tx.begin();
-            if (!ret) {
-              printf("failed to start a transaction\n");
-              continue;
-            }
+        if (kUseHashIndex) entries[thread_id].reserve(row_ids.size());
+        for (auto key : row_ids) {
+          char* data;
+          auto row_id = loader.new_row(thread_id, tbl, 0, loader.kNewRowID,
+                                       kDataSize, &data);
+          if (row_id == loader.kNullRowID) return false;
+          if (kUseHashIndex) entries[thread_id].emplace_back(key, row_id);
+        }
+        return true;
+      });
+      if (ret && kUseHashIndex) ret = hash_idx->bulk_load(&loader, entries);
+      if (!ret) {
+        printf("failed to bulk load the table\n");
+        return EXIT_FAILURE;
+      }
+    } else {
+      std::vector<std::thread> threads;
+      uint64_t init_num_threads = std::min(uint64_t(2), num_threads);
+      for (uint64_t thread_id = 0; thread_id < init_num_threads; thread_id++) {
+        threads.emplace_back([&, thread_id] {
+          ::mica::util::lcore.pin_thread(thread_id);
+
+          db.activate(static_cast<uint16_t>(thread_id));
+          while (db.active_thread_count() < init_num_threads) {
+            ::mica::util::pause();
+            db.idle(static_cast<uint16_t>(thread_id));
+          }
 
-            bool aborted = false;
-            auto i_end = std::min(i + kBatchSize, row_ids.size());
-            for (uint64_t j = i; j < i_end; j++) {
-              RowAccessHandle rah(&tx);
-              if (!rah.new_row(tbl, 0, Transaction::kNewRowID, true,
-                               kDataSize)) {
-                // printf("failed to insert rows at new_row(), row = %" PRIu64
-                //        "\n",
-                //        j);
-                aborted = true;
-                tx.abort();
-                break;
+          // Randomize the data layout by shuffling row insert order.
+          std::mt19937 g(thread_id);
+          std::vector<uint64_t> row_ids;
+          row_ids.reserve((num_rows + init_num_threads - 1) / init_num_threads);
+          for (uint64_t i = thread_id; i < num_rows; i += init_num_threads)
+            row_ids.push_back(i);
+          std::shuffle(row_ids.begin(), row_ids.end(), g);
+
+          Transaction tx(db.context(static_cast<uint16_t>(thread_id)));
+          const uint64_t kBatchSize = 16;
+          for (uint64_t i = 0; i < row_ids.size(); i += kBatchSize) {
+            while (true) {
+              bool ret = tx.begin();
+              if (!ret) {
+                printf("failed to start a transaction\n");
+                continue;
               }
 
-              if (kUseHashIndex) {
-                auto ret = hash_idx->insert(&tx, row_ids[j], rah.row_id());
-                if (ret != 1 || ret == HashIndex::kHaveToAbort) {
-                  // printf("failed to update index row = %" PRIu64 "\n", j);
+              bool aborted = false;
+              auto i_end = std::min(i + kBatchSize, row_ids.size());
+              for (uint64_t j = i; j < i_end; j++) {
+                RowAccessHandle rah(&tx);
+                if (!rah.new_row(tbl, 0, Transaction::kNewRowID, true,
+                                 kDataSize)) {
+                  // printf("failed to insert rows at new_row(), row = %" PRIu64
+                  //        "\n",
+                  //        j);
                   aborted = true;
                   tx.abort();
                   break;
                 }
-              }
-              if (kUseBTreeIndex) {
-                auto ret = btree_idx->insert(&tx, row_ids[j], rah.row_id());
-                if (ret != 1 || ret == BTreeIndex::kHaveToAbort) {
-                  // printf("failed to update index row = %" PRIu64 "\n", j);
-                  aborted = true;
-                  tx.abort();
-                  break;
+
+                if (kUseHashIndex) {
+                  auto ret = hash_idx->insert(&tx, row_ids[j], rah.row_id());
+                  if (ret != 1 || ret == HashIndex::kHaveToAbort) {
+                    // printf("failed to update index row = %" PRIu64 "\n", j);
+                    aborted = true;
+                    tx.abort();
+                    break;
+                  }
+                }
+                if (kUseBTreeIndex) {
+                  auto ret = btree_idx->insert(&tx, row_ids[j], rah.row_id());
+                  if (ret != 1 || ret == BTreeIndex::kHaveToAbort) {
+                    // printf("failed to update index row = %" PRIu64 "\n", j);
+                    aborted = true;
+                    tx.abort();
+                    break;
+                  }
                 }
               }
-            }
 
-            if (aborted) continue;
+              if (aborted) continue;
 
-            Result result;
-            if (!tx.commit(&result)) {
-              // printf("failed to insert rows at commit(), row = %" PRIu64
-              //        "; result=%d\n",
-              //        i_end - 1, static_cast<int>(result));
-              continue;
+              Result result;
+              if (!tx.commit(&result)) {
+                // printf("failed to insert rows at commit(), row = %" PRIu64
+                //        "; result=%d\n",
+                //        i_end - 1, static_cast<int>(result));
+                continue;
+              }
+              break;
             }
-            break;
           }
-        }
 
-        db.deactivate(static_cast<uint16_t>(thread_id));
-        return 0;
-      });
-    }
+          db.deactivate(static_cast<uint16_t>(thread_id));
+          return 0;
+        });
+      }
 
-    while (threads.size() > 0) {
-      threads.back().join();
-      threads.pop_back();
+      while (threads.size() > 0) {
+        threads.back().join();
+        threads.pop_back();
+      }
     }
 
     // TODO: Use multiple threads to renew rows for more balanced memory access.
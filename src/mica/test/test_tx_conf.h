@@ -103,6 +103,7 @@ struct DBConfig : public ::mica::transaction::BasicDBConfig {
 
   // Switch this for verification.
   typedef ::mica::transaction::NullLogger<DBConfig> Logger;
+  // typedef ::mica::transaction::ParallelLogger<DBConfig> Logger;
   // typedef VerificationLogger<DBConfig> Logger;
 };
 
@@ -149,6 +150,10 @@ static constexpr bool kSkipValidationForIndexAccess = true;
 // static constexpr bool kUseSnapshot = false;
 static constexpr bool kUseSnapshot = true;
 
+// Load the table without transactions unless a B-tree index is used.
+static constexpr bool kBulkLoad = false;
+// static constexpr bool kBulkLoad = true;
+
 static constexpr bool kUseContendedSet = false;
 // static constexpr bool kUseContendedSet = true;
 static constexpr uint64_t kContendedSetSize = 64;
@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <cstring>
 #include <random>
 #include <thread>
 #include "mica/transaction/db.h"
@@ -19,6 +20,8 @@ typedef ::mica::transaction::DB<DBConfig> DB;
 typedef ::mica::transaction::Table<DBConfig> Table;
 typedef DB::HashIndexUniqueU64 HashIndex;
 typedef DB::BTreeIndexUniqueU64 BTreeIndex;
+typedef DB::ARTIndexUniqueU64 ARTIndex;
+typedef DB::OLCBTreeIndexUniqueU64 OLCBTreeIndex;
 typedef ::mica::transaction::RowVersion<DBConfig> RowVersion;
 typedef ::mica::transaction::RowAccessHandle<DBConfig> RowAccessHandle;
 typedef ::mica::transaction::RowAccessHandlePeekOnly<DBConfig>
@@ -36,29 +39,21 @@ enum OpType : int {
   kLookupSnapshot,
   kScan,
   kScanSnapshot,
+  kMultiLookup,
+  kScanBatch,
   kMax
 };
-static const char* op_type_names[] = {"Insert",  "Remove", "Lookup",
-                                      "LookupS", "Scan",   "ScanS"};
+static const char* op_type_names[] = {"Insert", "Remove", "Lookup",
+                                      "LookupS", "Scan",  "ScanS",
+                                      "MLookup", "ScanB"};
 
 // For the main table.  Not really used.
 static const uint64_t kDataSize = 8;
 static const uint64_t kScanLen = 100;
+static const uint64_t kMultiLookupLen = 16;
 
 static const bool kShowPoolStats = false;
 
-#if 0
-
-static const bool kUseHashIndex = true;
-static const bool kUseBTreeIndex = false;
-
-#else
-
-static const bool kUseHashIndex = false;
-static const bool kUseBTreeIndex = true;
-
-#endif
-
 static const bool kCheckIndex = false;
 // static const bool kCheckIndex = true;
 
@@ -68,6 +63,8 @@ struct Task {
   DB* db;
   HashIndex* hash_idx;
   BTreeIndex* btree_idx;
+  ARTIndex* art_idx;
+  OLCBTreeIndex* olc_idx;
 
   uint64_t thread_id;
   uint64_t num_threads;
@@ -99,6 +96,8 @@ void worker_proc(Task* task) {
 
   auto hash_idx = task->hash_idx;
   auto btree_idx = task->btree_idx;
+  auto art_idx = task->art_idx;
+  auto olc_idx = task->olc_idx;
 
   double thresholds[OpType::kMax];
   thresholds[0] = task->op_frac[0];
@@ -160,6 +159,13 @@ void worker_proc(Task* task) {
     else
       return false;
   };
+  uint64_t multi_keys[kMultiLookupLen];
+  auto multi_lookup_consumer = [&row_id, &suspicious, &multi_keys, make_value](
+      auto i, auto& k, auto& v) {
+    row_id = v;
+    if (k != multi_keys[i] || row_id != make_value(k)) suspicious = true;
+    return false;
+  };
   const uint64_t max_key = static_cast<uint64_t>(-1);
 
   Transaction tx(ctx);
@@ -184,6 +190,15 @@ void worker_proc(Task* task) {
       uint64_t key = zg.next();
       if (task->hash_keys) key = (key * 0x9ddfea08eb382d69ULL) % num_keys;
       key += key_offset;
+      if (op_type == OpType::kMultiLookup) {
+        multi_keys[0] = key;
+        for (uint64_t j = 1; j < kMultiLookupLen; j++) {
+          uint64_t other_key = zg.next();
+          if (task->hash_keys)
+            other_key = (other_key * 0x9ddfea08eb382d69ULL) % num_keys;
+          multi_keys[j] = other_key + key_offset;
+        }
+      }
       // printf("lcore %" PRIu64 " key=%" PRIu64 "\n", task->thread_id, key);
 
       int trial = 0;
@@ -214,18 +229,30 @@ void worker_proc(Task* task) {
           case OpType::kInsert:
             if (hash_idx != nullptr)
               op_result = hash_idx->insert(&tx, key, make_value(key));
+            else if (art_idx != nullptr)
+              op_result = art_idx->insert(&tx, key, make_value(key));
+            else if (olc_idx != nullptr)
+              op_result = olc_idx->insert(&tx, key, make_value(key));
             else
               op_result = btree_idx->insert(&tx, key, make_value(key));
             break;
           case OpType::kRemove:
             if (hash_idx != nullptr)
               op_result = hash_idx->remove(&tx, key, make_value(key));
+            else if (art_idx != nullptr)
+              op_result = art_idx->remove(&tx, key, make_value(key));
+            else if (olc_idx != nullptr)
+              op_result = olc_idx->remove(&tx, key, make_value(key));
             else
               op_result = btree_idx->remove(&tx, key, make_value(key));
             break;
           case OpType::kLookup:
             if (hash_idx != nullptr)
               op_result = hash_idx->lookup(&tx, key, false, lookup_consumer);
+            else if (art_idx != nullptr)
+              op_result = art_idx->lookup(&tx, key, false, lookup_consumer);
+            else if (olc_idx != nullptr)
+              op_result = olc_idx->lookup(&tx, key, false, lookup_consumer);
             else
               op_result = btree_idx->lookup(&tx, key, false, lookup_consumer);
             if (op_result != 0 && row_id != make_value(key)) suspicious = true;
@@ -233,13 +260,26 @@ void worker_proc(Task* task) {
           case OpType::kLookupSnapshot:
             if (hash_idx != nullptr)
               op_result = hash_idx->lookup(&tx, key, true, lookup_consumer);
+            else if (art_idx != nullptr)
+              op_result = art_idx->lookup(&tx, key, true, lookup_consumer);
+            else if (olc_idx != nullptr)
+              op_result = olc_idx->lookup(&tx, key, true, lookup_consumer);
             else
               op_result = btree_idx->lookup(&tx, key, true, lookup_consumer);
             if (op_result != 0 && row_id != make_value(key)) suspicious = true;
             break;
           case OpType::kScan:
+            left = kScanLen;
             if (hash_idx != nullptr)
               op_result = 0;  // Not implemented.
+            else if (art_idx != nullptr)
+              op_result = art_idx->lookup<BTreeRangeType::kInclusive,
+                                          BTreeRangeType::kOpen, false>(
+                  &tx, key, max_key, false, scan_consumer);
+            else if (olc_idx != nullptr)
+              op_result = olc_idx->lookup<BTreeRangeType::kInclusive,
+                                          BTreeRangeType::kOpen, false>(
+                  &tx, key, max_key, false, scan_consumer);
             else
               op_result = btree_idx->lookup<BTreeRangeType::kInclusive,
                                             BTreeRangeType::kOpen, false>(
@@ -249,17 +289,62 @@ void worker_proc(Task* task) {
             left = kScanLen;
             if (hash_idx != nullptr)
               op_result = 0;  // Not implemented.
+            else if (art_idx != nullptr)
+              op_result = art_idx->lookup<BTreeRangeType::kInclusive,
+                                          BTreeRangeType::kOpen, false>(
+                  &tx, key, max_key, true, scan_consumer);
+            else if (olc_idx != nullptr)
+              op_result = olc_idx->lookup<BTreeRangeType::kInclusive,
+                                          BTreeRangeType::kOpen, false>(
+                  &tx, key, max_key, true, scan_consumer);
             else
               op_result = btree_idx->lookup<BTreeRangeType::kInclusive,
                                             BTreeRangeType::kOpen, false>(
                   &tx, key, max_key, true, scan_consumer);
             break;
+          case OpType::kMultiLookup:
+            if (art_idx != nullptr || olc_idx != nullptr)
+              op_result = 0;  // Not implemented.
+            else if (hash_idx != nullptr)
+              op_result = hash_idx->multi_lookup(
+                  &tx, multi_keys, kMultiLookupLen, false, multi_lookup_consumer);
+            else
+              op_result = btree_idx->multi_lookup(
+                  &tx, multi_keys, kMultiLookupLen, false, multi_lookup_consumer);
+            break;
+          case OpType::kScanBatch:
+            if (hash_idx != nullptr || art_idx != nullptr ||
+                olc_idx != nullptr)
+              op_result = 0;  // Not implemented.
+            else {
+              BTreeIndex::Scanner scanner(
+                  btree_idx, &tx, BTreeRangeType::kInclusive, key,
+                  BTreeRangeType::kOpen, max_key, false, false);
+              scanner.set_limit(kScanLen);
+              BTreeIndex::ScanSlice slice;
+              op_result = 0;
+              while (true) {
+                auto n = scanner.next(&slice);
+                if (n == 0 || n == BTreeIndex::kHaveToAbort) {
+                  if (n != 0) op_result = n;
+                  break;
+                }
+                for (uint64_t j = 0; j < n; j++) {
+                  row_id = slice.value(j);
+                  if (row_id != make_value(slice.key(j))) suspicious = true;
+                }
+                op_result += n;
+              }
+            }
+            break;
           default:
             assert(false);
         }
 
         if ((hash_idx != nullptr && op_result == HashIndex::kHaveToAbort) ||
-            (btree_idx != nullptr && op_result == BTreeIndex::kHaveToAbort))
+            (btree_idx != nullptr && op_result == BTreeIndex::kHaveToAbort) ||
+            (art_idx != nullptr && op_result == ARTIndex::kHaveToAbort) ||
+            (olc_idx != nullptr && op_result == OLCBTreeIndex::kHaveToAbort))
           have_to_abort = true;
 
         Result result;
@@ -269,12 +354,14 @@ void worker_proc(Task* task) {
 
           if (trial == 10000) {
             printf("warning: many aborts with key=%" PRIu64 "\n", key);
-            if (!tx.begin(true)) assert(false);
-            btree_idx->check(&tx);
-            printf("=== dump start ===\n");
-            btree_idx->dump_tree(&tx);
-            printf("=== dump end ===\n");
-            tx.abort();
+            if (btree_idx) {
+              if (!tx.begin(true)) assert(false);
+              btree_idx->check(&tx);
+              printf("=== dump start ===\n");
+              btree_idx->dump_tree(&tx);
+              printf("=== dump end ===\n");
+              tx.abort();
+            }
             assert(false);
           }
           continue;
@@ -313,31 +400,47 @@ void worker_proc(Task* task) {
     if (!tx.begin(false)) assert(false);
     if (task->post_condition == 1) {
       for (uint64_t key = 0; key < task->num_keys; key++) {
+        // Hash index lookups access a different bucket for each key, so they
+        // do not fit in one transaction's access set unless peeked.
         if (hash_idx != nullptr)
-          op_result = hash_idx->lookup(&tx, key, false, lookup_consumer);
+          op_result = hash_idx->lookup(&tx, key, true, lookup_consumer);
+        else if (art_idx != nullptr)
+          op_result = art_idx->lookup(&tx, key, false, lookup_consumer);
+        else if (olc_idx != nullptr)
+          op_result = olc_idx->lookup(&tx, key, false, lookup_consumer);
         else
           op_result = btree_idx->lookup(&tx, key, false, lookup_consumer);
 
         if (op_result != 1) {
           printf("invalid post condition for key %" PRIu64 "\n", key);
-          printf("=== dump start ===\n");
-          btree_idx->dump_tree(&tx);
-          printf("=== dump end ===\n");
+          if (btree_idx) {
+            printf("=== dump start ===\n");
+            btree_idx->dump_tree(&tx);
+            printf("=== dump end ===\n");
+          }
           assert(false);
         }
       }
     } else if (task->post_condition == 2) {
       for (uint64_t key = 0; key < task->num_keys; key++) {
+        // Hash index lookups access a different bucket for each key, so they
+        // do not fit in one transaction's access set unless peeked.
         if (hash_idx != nullptr)
-          op_result = hash_idx->lookup(&tx, key, false, lookup_consumer);
+          op_result = hash_idx->lookup(&tx, key, true, lookup_consumer);
+        else if (art_idx != nullptr)
+          op_result = art_idx->lookup(&tx, key, false, lookup_consumer);
+        else if (olc_idx != nullptr)
+          op_result = olc_idx->lookup(&tx, key, false, lookup_consumer);
         else
           op_result = btree_idx->lookup(&tx, key, false, lookup_consumer);
 
         if (op_result != 0) {
           printf("invalid post condition for key %" PRIu64 "\n", key);
-          printf("=== dump start ===\n");
-          btree_idx->dump_tree(&tx);
-          printf("=== dump end ===\n");
+          if (btree_idx) {
+            printf("=== dump start ===\n");
+            btree_idx->dump_tree(&tx);
+            printf("=== dump end ===\n");
+          }
           assert(false);
         }
       }
@@ -353,8 +456,23 @@ void worker_proc(Task* task) {
 }
 
 int main(int argc, const char* argv[]) {
-  if (argc != 5) {
-    printf("%s NUM-KEYS ZIPF-THETA TX-COUNT THREAD-COUNT\n", argv[0]);
+  if (argc != 5 && argc != 6) {
+    printf(
+        "%s NUM-KEYS ZIPF-THETA TX-COUNT THREAD-COUNT "
+        "[hash|btree|art|olc_btree]\n",
+        argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // The B+tree index is tested by default.
+  const char* index_type = argc == 6 ? argv[5] : "btree";
+  bool use_hash_index = strcmp(index_type, "hash") == 0;
+  bool use_btree_index = strcmp(index_type, "btree") == 0;
+  bool use_art_index = strcmp(index_type, "art") == 0;
+  bool use_olc_btree_index = strcmp(index_type, "olc_btree") == 0;
+  if (!use_hash_index && !use_btree_index && !use_art_index &&
+      !use_olc_btree_index) {
+    printf("unknown index type: %s\n", index_type);
     return EXIT_FAILURE;
   }
 
@@ -385,6 +503,7 @@ int main(int argc, const char* argv[]) {
   printf("zipf_theta = %lf\n", zipf_theta);
   printf("tx_count = %" PRIu64 "\n", tx_count);
   printf("num_threads = %" PRIu64 "\n", num_threads);
+  printf("index_type = %s\n", index_type);
 #ifndef NDEBUG
   printf("!NDEBUG\n");
 #endif
@@ -403,7 +522,7 @@ int main(int argc, const char* argv[]) {
   db.activate(0);
 
   HashIndex* hash_idx = nullptr;
-  if (kUseHashIndex) {
+  if (use_hash_index) {
     bool ret = db.create_hash_index_unique_u64("main_idx", tbl, num_keys);
     assert(ret);
     (void)ret;
@@ -414,7 +533,7 @@ int main(int argc, const char* argv[]) {
   }
 
   BTreeIndex* btree_idx = nullptr;
-  if (kUseBTreeIndex) {
+  if (use_btree_index) {
     bool ret = db.create_btree_index_unique_u64("main_idx", tbl);
     assert(ret);
     (void)ret;
@@ -424,6 +543,26 @@ int main(int argc, const char* argv[]) {
     btree_idx->init(&tx);
   }
 
+  ARTIndex* art_idx = nullptr;
+  if (use_art_index) {
+    bool ret = db.create_art_index_unique_u64("main_idx", tbl);
+    assert(ret);
+    (void)ret;
+
+    art_idx = db.get_art_index_unique_u64("main_idx");
+    Transaction tx(db.context(0));
+    art_idx->init(&tx);
+  }
+
+  OLCBTreeIndex* olc_idx = nullptr;
+  if (use_olc_btree_index) {
+    bool ret = db.create_olc_btree_index_unique_u64("main_idx", tbl);
+    assert(ret);
+    (void)ret;
+
+    olc_idx = db.get_olc_btree_index_unique_u64("main_idx");
+  }
+
   struct Workload {
     const char* name;
     uint64_t tx_count;
@@ -562,6 +701,20 @@ int main(int argc, const char* argv[]) {
        zipf_theta,
        {0.3333, 0.3333, 0., 0.3334, 0., 0.},
        0},
+      {"[14] Random multi-lookups (mixed success)",
+       tx_count / kMultiLookupLen,
+       false,
+       true,
+       zipf_theta,
+       {0., 0., 0., 0., 0., 0., 1.},
+       0},
+      {"[15] Random batch scans (mixed success)",
+       tx_count / kScanLen,
+       false,
+       true,
+       zipf_theta,
+       {0., 0., 0., 0., 0., 0., 0., 1.},
+       0},
   };
 
   size_t run_perf = 10000;
@@ -575,6 +728,8 @@ int main(int argc, const char* argv[]) {
       tasks[thread_id].db = &db;
       tasks[thread_id].hash_idx = hash_idx;
       tasks[thread_id].btree_idx = btree_idx;
+      tasks[thread_id].art_idx = art_idx;
+      tasks[thread_id].olc_idx = olc_idx;
 
       tasks[thread_id].num_keys = num_keys;
 
@@ -690,6 +845,9 @@ int main(int argc, const char* argv[]) {
 
   if (hash_idx != nullptr) hash_idx->index_table()->print_table_status();
   if (btree_idx != nullptr) btree_idx->index_table()->print_table_status();
+  if (art_idx != nullptr) art_idx->index_table()->print_table_status();
+  if (olc_idx != nullptr)
+    printf("OLC B+tree nodes: %" PRIu64 "\n", olc_idx->node_count());
 
   if (kShowPoolStats) db.print_pool_status();
 
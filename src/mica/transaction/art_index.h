@@ -0,0 +1,237 @@
+#pragma once
+#ifndef MICA_TRANSACTION_ART_INDEX_H_
+#define MICA_TRANSACTION_ART_INDEX_H_
+
+#include <immintrin.h>
+#include "mica/common.h"
+#include "mica/transaction/btree_index.h"
+#include "mica/util/memcpy.h"
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+class ARTIndex;
+
+template <class StaticConfig>
+class ARTIndexNodeCopier {
+ public:
+  typedef ARTIndex<StaticConfig> ARTIndexT;
+  typedef typename ARTIndexT::Node Node;
+
+  bool operator()(uint16_t cf_id, RowVersion<StaticConfig>* dest,
+                  const RowVersion<StaticConfig>* src) const {
+    (void)cf_id;
+    if (dest->data_size == 0) return true;
+
+    // Only the used part of the node needs to be copied.
+    auto src_node = reinterpret_cast<const Node*>(src->data);
+    ::mica::util::memcpy(dest->data, src->data,
+                         ARTIndexT::used_size(src_node));
+    return true;
+  }
+};
+
+// An adaptive radix tree (ART) index for unique uint64_t keys.
+//
+// Each node branches on one byte of the key, starting from the most
+// significant byte, and takes a row of the index table.  A node is created as
+// Node4 and is replaced with the next larger type (Node16, Node48, Node256)
+// when it becomes full, and with a smaller type when it becomes sparse.  An
+// update makes a new version of one node whose size follows its type, instead
+// of a whole 1 KiB node of BTreeIndex.  A node keeps every key byte above its
+// depth as its prefix, so a path skips the bytes that all keys below a node
+// share (path compression).  Nodes at kLeafDepth hold values instead of child
+// row IDs.  The root is a Node256 at row 0 that is never replaced.
+template <class StaticConfig>
+class ARTIndex {
+ public:
+  typedef ARTIndexNodeCopier<StaticConfig> DataCopier;
+
+  typedef typename StaticConfig::Timing Timing;
+  typedef ::mica::transaction::RowAccessHandle<StaticConfig> RowAccessHandle;
+  typedef ::mica::transaction::RowAccessHandlePeekOnly<StaticConfig>
+      RowAccessHandlePeekOnly;
+  typedef ::mica::transaction::Transaction<StaticConfig> Transaction;
+
+  enum class NodeType : uint8_t {
+    kNode4 = 0,
+    kNode16,
+    kNode48,
+    kNode256,
+  };
+
+  struct Node {
+    NodeType type;
+    // The key byte that this node branches on (0 for the most significant
+    // byte).
+    uint8_t depth;
+    uint16_t count;
+    uint32_t reserved;
+    // The key bytes above depth that all keys in this node share; the other
+    // bytes are zero.
+    uint64_t prefix;
+  };
+
+  // Node4 and Node16 keep the key bytes of their children in ascending order.
+  template <size_t MaxCount>
+  struct SmallNodeT : public Node {
+    static constexpr size_t kMaxCount = MaxCount;
+
+    uint8_t keys[kMaxCount];
+    uint64_t children[kMaxCount];
+  };
+  typedef SmallNodeT<4> Node4;
+  typedef SmallNodeT<16> Node16;
+
+  struct Node48 : public Node {
+    static constexpr size_t kMaxCount = 48;
+
+    // child_index[b] - 1 is the slot of the child for key byte b, or 0 if
+    // there is no such child.  Slots [0, count) are in use.
+    uint8_t child_index[256];
+    uint64_t children[kMaxCount];
+  };
+
+  struct Node256 : public Node {
+    static constexpr size_t kMaxCount = 256;
+
+    // kNullRowID if there is no child for the key byte.
+    uint64_t children[kMaxCount];
+  };
+
+  // The data size hint of the index table.  Node4 and Node16 use inlined row
+  // versions; larger nodes are rare and use separate row versions.
+  static constexpr uint64_t kDataSize = sizeof(Node16);
+
+  static constexpr uint8_t kLeafDepth = 7;
+
+  // A node is replaced with the next smaller type when its count drops to
+  // these.  They are below the capacity of the smaller type so that keys
+  // inserted and removed around the boundary do not replace the node every
+  // time.
+  static constexpr uint16_t kNode16ShrinkCount = 3;
+  static constexpr uint16_t kNode48ShrinkCount = 12;
+  static constexpr uint16_t kNode256ShrinkCount = 37;
+
+  static constexpr uint64_t kNullRowID = static_cast<uint64_t>(-1);
+
+  static constexpr uint64_t kHaveToAbort = static_cast<uint64_t>(-1);
+
+  // art_index_impl/init.h
+  ARTIndex(DB<StaticConfig>* db, Table<StaticConfig>* main_tbl,
+           Table<StaticConfig>* idx_tbl);
+
+  bool init(Transaction* tx);
+
+  // art_index_impl/insert.h
+  uint64_t insert(Transaction* tx, uint64_t key, uint64_t value);
+
+  // art_index_impl/remove.h
+  uint64_t remove(Transaction* tx, uint64_t key, uint64_t value);
+
+  // art_index_impl/lookup.h
+  template <typename Func>
+  uint64_t lookup(Transaction* tx, uint64_t key, bool skip_validation,
+                  const Func& func);
+
+  template <BTreeRangeType LeftRangeType, BTreeRangeType RightRangeType,
+            bool Reversed, typename Func>
+  uint64_t lookup(Transaction* tx, uint64_t min_key, uint64_t max_key,
+                  bool skip_validation, const Func& func);
+
+  // art_index_impl/node.h
+  static uint64_t node_size(NodeType type);
+  static uint64_t used_size(const Node* node);
+
+  Table<StaticConfig>* main_table() { return main_tbl_; }
+  const Table<StaticConfig>* main_table() const { return main_tbl_; }
+
+  Table<StaticConfig>* index_table() { return idx_tbl_; }
+  const Table<StaticConfig>* index_table() const { return idx_tbl_; }
+
+ private:
+  DB<StaticConfig>* db_;
+  Table<StaticConfig>* main_tbl_;
+  Table<StaticConfig>* idx_tbl_;
+
+  DataCopier data_copier_;
+
+  // art_index_impl/node.h
+  static uint8_t key_byte(uint64_t key, uint8_t depth);
+  static uint64_t prefix_mask(uint8_t depth);
+  static bool matches_prefix(const Node* node, uint64_t key);
+
+  Node* make_node(RowAccessHandle& rah, NodeType type, uint8_t depth,
+                  uint64_t prefix);
+  uint64_t make_leaf(Transaction* tx, uint64_t key, uint64_t value);
+  bool free_node(RowAccessHandle& rah);
+
+  template <typename RowAccessHandleT>
+  const Node* get_node(RowAccessHandleT& rah, uint64_t row_id) const;
+
+  Node* get_writable_node(RowAccessHandle& rah);
+
+  template <typename RowAccessHandleT>
+  bool validate_read(RowAccessHandleT& rah);
+
+  static bool is_full(const Node* node);
+  static NodeType grown_type(NodeType type);
+  static NodeType shrunk_type(NodeType type, uint16_t count);
+
+  static const uint64_t* find_child(const Node* node, uint8_t b);
+  static uint64_t* find_child(Node* node, uint8_t b);
+
+  // Calls func(b, child) for the children with key bytes in [first, last] in
+  // order until func returns false.  Returns false if func has returned
+  // false.
+  template <bool Reversed, typename Func>
+  static bool for_each_child(const Node* node, uint8_t first, uint8_t last,
+                             const Func& func);
+  template <bool Reversed, typename NodeT, typename Func>
+  static bool for_each_small_child(const NodeT* node, uint8_t first,
+                                   uint8_t last, const Func& func);
+
+  static void add_child_to(Node* node, uint8_t b, uint64_t child);
+  static void remove_child_from(Node* node, uint8_t b);
+  static void copy_children(Node* dest, const Node* src, int skip_b);
+
+  bool set_child(RowAccessHandle& rah, uint8_t b, uint64_t child);
+
+  // art_index_impl/insert.h
+  uint64_t insert_recursive(Transaction* tx, RowAccessHandle* rah_parent,
+                            uint8_t parent_b, RowAccessHandle& rah,
+                            const Node* node, uint64_t key, uint64_t value);
+  bool add_child(Transaction* tx, RowAccessHandle* rah_parent,
+                 uint8_t parent_b, RowAccessHandle& rah, uint8_t b,
+                 uint64_t child);
+
+  // art_index_impl/remove.h
+  uint64_t remove_recursive(Transaction* tx, RowAccessHandle* rah_parent,
+                            uint8_t parent_b, RowAccessHandle& rah,
+                            const Node* node, uint64_t key, uint64_t value,
+                            bool* emptied);
+  bool remove_child(Transaction* tx, RowAccessHandle* rah_parent,
+                    uint8_t parent_b, RowAccessHandle& rah, uint8_t b,
+                    bool* emptied);
+
+  // art_index_impl/lookup.h
+  template <typename Func, typename RowAccessHandleT>
+  uint64_t lookup_point(RowAccessHandleT& rah_a, RowAccessHandleT& rah_b,
+                        uint64_t key, bool skip_validation, const Func& func);
+
+  template <bool Reversed, typename Func, typename RowAccessHandleT>
+  uint64_t lookup_recursive(Transaction* tx, RowAccessHandleT& rah,
+                            const Node* node, uint64_t min_key,
+                            uint64_t max_key, bool skip_validation,
+                            const Func& func, bool* done);
+};
+}
+}
+
+#include "art_index_impl/init.h"
+#include "art_index_impl/node.h"
+#include "art_index_impl/insert.h"
+#include "art_index_impl/remove.h"
+#include "art_index_impl/lookup.h"
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+#ifndef MICA_TRANSACTION_ART_INDEX_IMPL_INIT_H_
+#define MICA_TRANSACTION_ART_INDEX_IMPL_INIT_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+ARTIndex<StaticConfig>::ARTIndex(DB<StaticConfig>* db,
+                                 Table<StaticConfig>* main_tbl,
+                                 Table<StaticConfig>* idx_tbl)
+    : db_(db), main_tbl_(main_tbl), idx_tbl_(idx_tbl) {
+  static_assert(sizeof(Node) == 16, "unexpected node header size");
+  static_assert(Node256::kMaxCount <= (1 << 16), "too many children");
+}
+
+template <class StaticConfig>
+bool ARTIndex<StaticConfig>::init(Transaction* tx) {
+  Timing t(tx->context()->timing_stack(), &Stats::index_write);
+
+  bool ret = tx->begin();
+  if (!ret) return false;
+
+  RowAccessHandle rah_root(tx);
+  auto root = make_node(rah_root, NodeType::kNode256, 0, 0);
+  if (!root || rah_root.row_id() != 0) {
+    printf("failed to create root\n");
+    return false;
+  }
+
+  if (!tx->commit()) {
+    printf("failed to initialize a new ARTIndex\n");
+    return false;
+  }
+  return true;
+}
+}
+}
+
+#endif
@@ -0,0 +1,109 @@
+#pragma once
+#ifndef MICA_TRANSACTION_ART_INDEX_IMPL_INSERT_H_
+#define MICA_TRANSACTION_ART_INDEX_IMPL_INSERT_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+uint64_t ARTIndex<StaticConfig>::insert(Transaction* tx, uint64_t key,
+                                        uint64_t value) {
+  Timing t(tx->context()->timing_stack(), &Stats::index_write);
+  assert(value != kNullRowID);
+
+  RowAccessHandle rah_root(tx);
+  auto root = get_node(rah_root, 0);
+  if (!root) return kHaveToAbort;
+
+  return insert_recursive(tx, nullptr, 0, rah_root, root, key, value);
+}
+
+template <class StaticConfig>
+uint64_t ARTIndex<StaticConfig>::insert_recursive(
+    Transaction* tx, RowAccessHandle* rah_parent, uint8_t parent_b,
+    RowAccessHandle& rah, const Node* node, uint64_t key, uint64_t value) {
+  auto b = key_byte(key, node->depth);
+  auto child_p = find_child(node, b);
+
+  if (node->depth == kLeafDepth) {
+    if (child_p) {
+      // We need to track the node that has the existing key.
+      if (!validate_read(rah)) return kHaveToAbort;
+      return 0;
+    }
+    if (!add_child(tx, rah_parent, parent_b, rah, b, value))
+      return kHaveToAbort;
+    return 1;
+  }
+
+  if (!child_p) {
+    auto leaf_row_id = make_leaf(tx, key, value);
+    if (leaf_row_id == kNullRowID) return kHaveToAbort;
+    if (!add_child(tx, rah_parent, parent_b, rah, b, leaf_row_id))
+      return kHaveToAbort;
+    return 1;
+  }
+
+  auto child_row_id = *child_p;
+  RowAccessHandle rah_child(tx);
+  auto child = get_node(rah_child, child_row_id);
+  if (!child) return kHaveToAbort;
+
+  if (!matches_prefix(child, key)) {
+    // Split the compressed path at the first differing key byte with a new
+    // Node4 that holds the child and a leaf for the key.
+    if (!validate_read(rah_child)) return kHaveToAbort;
+
+    auto depth = static_cast<uint8_t>(
+        __builtin_clzll((key ^ child->prefix) & prefix_mask(child->depth)) /
+        8);
+    assert(depth > node->depth && depth < child->depth);
+
+    RowAccessHandle rah_new(tx);
+    auto new_node =
+        make_node(rah_new, NodeType::kNode4, depth, key & prefix_mask(depth));
+    if (!new_node) return kHaveToAbort;
+
+    auto leaf_row_id = make_leaf(tx, key, value);
+    if (leaf_row_id == kNullRowID) return kHaveToAbort;
+
+    add_child_to(new_node, key_byte(child->prefix, depth), child_row_id);
+    add_child_to(new_node, key_byte(key, depth), leaf_row_id);
+
+    if (!set_child(rah, b, rah_new.row_id())) return kHaveToAbort;
+    return 1;
+  }
+
+  return insert_recursive(tx, &rah, b, rah_child, child, key, value);
+}
+
+template <class StaticConfig>
+bool ARTIndex<StaticConfig>::add_child(Transaction* tx,
+                                       RowAccessHandle* rah_parent,
+                                       uint8_t parent_b, RowAccessHandle& rah,
+                                       uint8_t b, uint64_t child) {
+  auto node_c = reinterpret_cast<const Node*>(rah.cdata());
+  if (!is_full(node_c)) {
+    auto node = get_writable_node(rah);
+    if (!node) return false;
+    add_child_to(node, b, child);
+    return true;
+  }
+
+  // Replace the full node with a larger one.  The root never becomes full.
+  assert(rah_parent != nullptr);
+
+  RowAccessHandle rah_new(tx);
+  auto new_node = make_node(rah_new, grown_type(node_c->type), node_c->depth,
+                            node_c->prefix);
+  if (!new_node) return false;
+
+  copy_children(new_node, node_c, -1);
+  add_child_to(new_node, b, child);
+
+  if (!free_node(rah)) return false;
+  return set_child(*rah_parent, parent_b, rah_new.row_id());
+}
+}
+}
+
+#endif
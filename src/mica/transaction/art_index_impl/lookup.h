@@ -0,0 +1,162 @@
+#pragma once
+#ifndef MICA_TRANSACTION_ART_INDEX_IMPL_LOOKUP_H_
+#define MICA_TRANSACTION_ART_INDEX_IMPL_LOOKUP_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+template <typename Func>
+uint64_t ARTIndex<StaticConfig>::lookup(Transaction* tx, uint64_t key,
+                                        bool skip_validation,
+                                        const Func& func) {
+  Timing t(tx->context()->timing_stack(), &Stats::index_read);
+
+  if (skip_validation) {
+    RowAccessHandlePeekOnly rah_a(tx);
+    RowAccessHandlePeekOnly rah_b(tx);
+    return lookup_point(rah_a, rah_b, key, skip_validation, func);
+  } else {
+    RowAccessHandle rah_a(tx);
+    RowAccessHandle rah_b(tx);
+    return lookup_point(rah_a, rah_b, key, skip_validation, func);
+  }
+}
+
+template <class StaticConfig>
+template <typename Func, typename RowAccessHandleT>
+uint64_t ARTIndex<StaticConfig>::lookup_point(RowAccessHandleT& rah_a,
+                                              RowAccessHandleT& rah_b,
+                                              uint64_t key,
+                                              bool skip_validation,
+                                              const Func& func) {
+  // Only the last node on the path decides the result, except that a key
+  // missing due to a prefix mismatch would be inserted to the parent; the two
+  // handles keep the current node and its parent.
+  auto rah = &rah_a;
+  auto rah_parent = &rah_b;
+
+  auto node = get_node(*rah, 0);
+  if (!node) return kHaveToAbort;
+
+  while (true) {
+    auto child_p = find_child(node, key_byte(key, node->depth));
+    if (!child_p) {
+      if (!skip_validation && !validate_read(*rah)) return kHaveToAbort;
+      return 0;
+    }
+
+    if (node->depth == kLeafDepth) {
+      auto value = *child_p;
+      if (!skip_validation && !validate_read(*rah)) return kHaveToAbort;
+      const uint64_t found_key = key;
+      func(found_key, value);
+      return 1;
+    }
+
+    auto child_row_id = *child_p;
+    std::swap(rah, rah_parent);
+    rah->reset();
+    node = get_node(*rah, child_row_id);
+    if (!node) return kHaveToAbort;
+
+    if (!matches_prefix(node, key)) {
+      if (!skip_validation && !validate_read(*rah_parent)) return kHaveToAbort;
+      return 0;
+    }
+  }
+}
+
+template <class StaticConfig>
+template <BTreeRangeType LeftRangeType, BTreeRangeType RightRangeType,
+          bool Reversed, typename Func>
+uint64_t ARTIndex<StaticConfig>::lookup(Transaction* tx, uint64_t min_key,
+                                        uint64_t max_key, bool skip_validation,
+                                        const Func& func) {
+  Timing t(tx->context()->timing_stack(), &Stats::index_read);
+
+  // Turn the range into [min_key, max_key].
+  if (LeftRangeType == BTreeRangeType::kOpen)
+    min_key = 0;
+  else if (LeftRangeType == BTreeRangeType::kExclusive) {
+    if (min_key == static_cast<uint64_t>(-1)) return 0;
+    min_key++;
+  }
+  if (RightRangeType == BTreeRangeType::kOpen)
+    max_key = static_cast<uint64_t>(-1);
+  else if (RightRangeType == BTreeRangeType::kExclusive) {
+    if (max_key == 0) return 0;
+    max_key--;
+  }
+  if (min_key > max_key) return 0;
+
+  bool done = false;
+  if (skip_validation) {
+    RowAccessHandlePeekOnly rah(tx);
+    auto root = get_node(rah, 0);
+    if (!root) return kHaveToAbort;
+
+    return lookup_recursive<Reversed>(tx, rah, root, min_key, max_key,
+                                      skip_validation, func, &done);
+  } else {
+    RowAccessHandle rah(tx);
+    auto root = get_node(rah, 0);
+    if (!root) return kHaveToAbort;
+
+    return lookup_recursive<Reversed>(tx, rah, root, min_key, max_key,
+                                      skip_validation, func, &done);
+  }
+}
+
+template <class StaticConfig>
+template <bool Reversed, typename Func, typename RowAccessHandleT>
+uint64_t ARTIndex<StaticConfig>::lookup_recursive(
+    Transaction* tx, RowAccessHandleT& rah, const Node* node, uint64_t min_key,
+    uint64_t max_key, bool skip_validation, const Func& func, bool* done) {
+  // We need to track every node used for finding matches.
+  if (!skip_validation && !validate_read(rah)) return kHaveToAbort;
+
+  // The keys under this node are in [node_min, node_max].
+  auto node_min = node->prefix;
+  auto node_max = node->prefix | ~prefix_mask(node->depth);
+  if (node_max < min_key || max_key < node_min) return 0;
+
+  uint8_t first = min_key > node_min ? key_byte(min_key, node->depth) : 0;
+  uint8_t last = max_key < node_max ? key_byte(max_key, node->depth) : 255;
+
+  uint64_t found = 0;
+  bool aborted = false;
+  for_each_child<Reversed>(node, first, last, [&](uint8_t b, uint64_t child) {
+    if (node->depth == kLeafDepth) {
+      found++;
+      const uint64_t key = node->prefix | b;
+      if (!func(key, child)) {
+        *done = true;
+        return false;
+      }
+      return true;
+    }
+
+    RowAccessHandleT rah_child(tx);
+    auto child_node = get_node(rah_child, child);
+    if (!child_node) {
+      aborted = true;
+      return false;
+    }
+
+    auto ret = lookup_recursive<Reversed>(tx, rah_child, child_node, min_key,
+                                          max_key, skip_validation, func, done);
+    if (ret == kHaveToAbort) {
+      aborted = true;
+      return false;
+    }
+    found += ret;
+    return !*done;
+  });
+
+  if (aborted) return kHaveToAbort;
+  return found;
+}
+}
+}
+
+#endif
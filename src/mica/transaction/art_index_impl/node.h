@@ -0,0 +1,389 @@
+#pragma once
+#ifndef MICA_TRANSACTION_ART_INDEX_IMPL_NODE_H_
+#define MICA_TRANSACTION_ART_INDEX_IMPL_NODE_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+uint64_t ARTIndex<StaticConfig>::node_size(NodeType type) {
+  switch (type) {
+    case NodeType::kNode4:
+      return sizeof(Node4);
+    case NodeType::kNode16:
+      return sizeof(Node16);
+    case NodeType::kNode48:
+      return sizeof(Node48);
+    case NodeType::kNode256:
+    default:
+      return sizeof(Node256);
+  }
+}
+
+template <class StaticConfig>
+uint64_t ARTIndex<StaticConfig>::used_size(const Node* node) {
+  // children is the last member and needs no tail padding, so the unused
+  // children are at the end of the node.  (offsetof() is not valid for the
+  // node types because they derive from Node.)
+  auto unused = [node](uint64_t max_count) {
+    return sizeof(uint64_t) * (max_count - static_cast<uint64_t>(node->count));
+  };
+  switch (node->type) {
+    case NodeType::kNode4:
+      return sizeof(Node4) - unused(Node4::kMaxCount);
+    case NodeType::kNode16:
+      return sizeof(Node16) - unused(Node16::kMaxCount);
+    case NodeType::kNode48:
+      return sizeof(Node48) - unused(Node48::kMaxCount);
+    case NodeType::kNode256:
+    default:
+      return sizeof(Node256);
+  }
+}
+
+template <class StaticConfig>
+uint8_t ARTIndex<StaticConfig>::key_byte(uint64_t key, uint8_t depth) {
+  return static_cast<uint8_t>(key >> (56 - 8 * depth));
+}
+
+template <class StaticConfig>
+uint64_t ARTIndex<StaticConfig>::prefix_mask(uint8_t depth) {
+  if (depth == 0) return 0;
+  return ~uint64_t(0) << (64 - 8 * depth);
+}
+
+template <class StaticConfig>
+bool ARTIndex<StaticConfig>::matches_prefix(const Node* node, uint64_t key) {
+  return (key & prefix_mask(node->depth)) == node->prefix;
+}
+
+template <class StaticConfig>
+typename ARTIndex<StaticConfig>::Node* ARTIndex<StaticConfig>::make_node(
+    RowAccessHandle& rah, NodeType type, uint8_t depth, uint64_t prefix) {
+  if (!rah.new_row(idx_tbl_, 0, Transaction::kNewRowID, true,
+                   node_size(type)))
+    return nullptr;
+
+  auto node = reinterpret_cast<Node*>(rah.data());
+
+  node->type = type;
+  node->depth = depth;
+  node->count = 0;
+  node->reserved = 0;
+  node->prefix = prefix;
+
+  if (type == NodeType::kNode48) {
+    auto node48 = static_cast<Node48*>(node);
+    ::mica::util::memset(node48->child_index, 0, sizeof(node48->child_index));
+  } else if (type == NodeType::kNode256) {
+    auto node256 = static_cast<Node256*>(node);
+    for (size_t i = 0; i < Node256::kMaxCount; i++)
+      node256->children[i] = kNullRowID;
+  }
+  return node;
+}
+
+template <class StaticConfig>
+uint64_t ARTIndex<StaticConfig>::make_leaf(Transaction* tx, uint64_t key,
+                                           uint64_t value) {
+  // A key with no other key sharing its first kLeafDepth bytes gets a leaf
+  // node holding the key alone, which is placed right below the deepest node
+  // that the key shares a prefix with.
+  RowAccessHandle rah(tx);
+  auto node = make_node(rah, NodeType::kNode4, kLeafDepth,
+                        key & prefix_mask(kLeafDepth));
+  if (!node) return kNullRowID;
+
+  add_child_to(node, key_byte(key, kLeafDepth), value);
+  return rah.row_id();
+}
+
+template <class StaticConfig>
+bool ARTIndex<StaticConfig>::free_node(RowAccessHandle& rah) {
+  return rah.read_row(data_copier_) && rah.write_row(0, data_copier_) &&
+         rah.delete_row();
+}
+
+template <class StaticConfig>
+template <typename RowAccessHandleT>
+const typename ARTIndex<StaticConfig>::Node* ARTIndex<StaticConfig>::get_node(
+    RowAccessHandleT& rah, uint64_t row_id) const {
+  if (!rah.peek_row(idx_tbl_, 0, row_id, true, false, false)) return nullptr;
+  assert(rah.cdata() != nullptr);
+  return reinterpret_cast<const Node*>(rah.cdata());
+}
+
+template <class StaticConfig>
+typename ARTIndex<StaticConfig>::Node*
+ARTIndex<StaticConfig>::get_writable_node(RowAccessHandle& rah) {
+  if (!rah.read_row(data_copier_)) return nullptr;
+  // A node keeps its type for its lifetime, so the size of a new version is
+  // the size of the current one.
+  auto type = reinterpret_cast<const Node*>(rah.cdata())->type;
+  if (!rah.write_row(node_size(type), data_copier_)) return nullptr;
+  return reinterpret_cast<Node*>(rah.data());
+}
+
+template <class StaticConfig>
+template <typename RowAccessHandleT>
+bool ARTIndex<StaticConfig>::validate_read(RowAccessHandleT& rah) {
+  return rah.read_row(data_copier_);
+}
+
+template <class StaticConfig>
+bool ARTIndex<StaticConfig>::is_full(const Node* node) {
+  switch (node->type) {
+    case NodeType::kNode4:
+      return node->count == Node4::kMaxCount;
+    case NodeType::kNode16:
+      return node->count == Node16::kMaxCount;
+    case NodeType::kNode48:
+      return node->count == Node48::kMaxCount;
+    case NodeType::kNode256:
+    default:
+      return false;
+  }
+}
+
+template <class StaticConfig>
+typename ARTIndex<StaticConfig>::NodeType ARTIndex<StaticConfig>::grown_type(
+    NodeType type) {
+  switch (type) {
+    case NodeType::kNode4:
+      return NodeType::kNode16;
+    case NodeType::kNode16:
+      return NodeType::kNode48;
+    case NodeType::kNode48:
+    default:
+      return NodeType::kNode256;
+  }
+}
+
+template <class StaticConfig>
+typename ARTIndex<StaticConfig>::NodeType ARTIndex<StaticConfig>::shrunk_type(
+    NodeType type, uint16_t count) {
+  if (type == NodeType::kNode16 && count <= kNode16ShrinkCount)
+    return NodeType::kNode4;
+  if (type == NodeType::kNode48 && count <= kNode48ShrinkCount)
+    return NodeType::kNode16;
+  if (type == NodeType::kNode256 && count <= kNode256ShrinkCount)
+    return NodeType::kNode48;
+  return type;
+}
+
+template <class StaticConfig>
+const uint64_t* ARTIndex<StaticConfig>::find_child(const Node* node,
+                                                   uint8_t b) {
+  switch (node->type) {
+    case NodeType::kNode4: {
+      auto n = static_cast<const Node4*>(node);
+      for (uint16_t i = 0; i < n->count; i++)
+        if (n->keys[i] == b) return &n->children[i];
+      return nullptr;
+    }
+    case NodeType::kNode16: {
+      auto n = static_cast<const Node16*>(node);
+      // Compare all key bytes at once.
+      auto cmp = _mm_cmpeq_epi8(
+          _mm_set1_epi8(static_cast<char>(b)),
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(n->keys)));
+      auto mask = static_cast<uint32_t>(_mm_movemask_epi8(cmp)) &
+                  ((uint32_t(1) << n->count) - 1);
+      if (mask == 0) return nullptr;
+      return &n->children[__builtin_ctz(mask)];
+    }
+    case NodeType::kNode48: {
+      auto n = static_cast<const Node48*>(node);
+      auto slot = n->child_index[b];
+      if (slot == 0) return nullptr;
+      return &n->children[slot - 1];
+    }
+    case NodeType::kNode256:
+    default: {
+      auto n = static_cast<const Node256*>(node);
+      if (n->children[b] == kNullRowID) return nullptr;
+      return &n->children[b];
+    }
+  }
+}
+
+template <class StaticConfig>
+uint64_t* ARTIndex<StaticConfig>::find_child(Node* node, uint8_t b) {
+  return const_cast<uint64_t*>(find_child(const_cast<const Node*>(node), b));
+}
+
+template <class StaticConfig>
+template <bool Reversed, typename Func>
+bool ARTIndex<StaticConfig>::for_each_child(const Node* node, uint8_t first,
+                                            uint8_t last, const Func& func) {
+  switch (node->type) {
+    case NodeType::kNode4:
+      return for_each_small_child<Reversed>(static_cast<const Node4*>(node),
+                                            first, last, func);
+    case NodeType::kNode16:
+      return for_each_small_child<Reversed>(static_cast<const Node16*>(node),
+                                            first, last, func);
+    case NodeType::kNode48: {
+      auto n = static_cast<const Node48*>(node);
+      for (int i = first; i <= last; i++) {
+        auto b = static_cast<uint8_t>(Reversed ? first + last - i : i);
+        auto slot = n->child_index[b];
+        if (slot != 0 && !func(b, n->children[slot - 1])) return false;
+      }
+      return true;
+    }
+    case NodeType::kNode256:
+    default: {
+      auto n = static_cast<const Node256*>(node);
+      for (int i = first; i <= last; i++) {
+        auto b = static_cast<uint8_t>(Reversed ? first + last - i : i);
+        if (n->children[b] != kNullRowID && !func(b, n->children[b]))
+          return false;
+      }
+      return true;
+    }
+  }
+}
+
+template <class StaticConfig>
+template <bool Reversed, typename NodeT, typename Func>
+bool ARTIndex<StaticConfig>::for_each_small_child(const NodeT* node,
+                                                  uint8_t first, uint8_t last,
+                                                  const Func& func) {
+  int count = node->count;
+  if (!Reversed) {
+    for (int i = 0; i < count; i++) {
+      if (node->keys[i] < first) continue;
+      if (node->keys[i] > last) break;
+      if (!func(node->keys[i], node->children[i])) return false;
+    }
+  } else {
+    for (int i = count - 1; i >= 0; i--) {
+      if (node->keys[i] > last) continue;
+      if (node->keys[i] < first) break;
+      if (!func(node->keys[i], node->children[i])) return false;
+    }
+  }
+  return true;
+}
+
+template <class StaticConfig>
+void ARTIndex<StaticConfig>::add_child_to(Node* node, uint8_t b,
+                                          uint64_t child) {
+  assert(!is_full(node));
+  assert(find_child(node, b) == nullptr);
+
+  switch (node->type) {
+    case NodeType::kNode4:
+    case NodeType::kNode16: {
+      // Node4 and Node16 have the same layout up to the count of keys.
+      uint8_t* keys;
+      uint64_t* children;
+      if (node->type == NodeType::kNode4) {
+        keys = static_cast<Node4*>(node)->keys;
+        children = static_cast<Node4*>(node)->children;
+      } else {
+        keys = static_cast<Node16*>(node)->keys;
+        children = static_cast<Node16*>(node)->children;
+      }
+      int count = node->count;
+      int j = 0;
+      while (j < count && keys[j] < b) j++;
+      ::mica::util::memmove(keys + j + 1, keys + j,
+                            static_cast<size_t>(count - j));
+      ::mica::util::memmove(children + j + 1, children + j,
+                            sizeof(uint64_t) * static_cast<size_t>(count - j));
+      keys[j] = b;
+      children[j] = child;
+      break;
+    }
+    case NodeType::kNode48: {
+      auto n = static_cast<Node48*>(node);
+      n->children[n->count] = child;
+      n->child_index[b] = static_cast<uint8_t>(n->count + 1);
+      break;
+    }
+    case NodeType::kNode256:
+    default: {
+      assert(child != kNullRowID);
+      static_cast<Node256*>(node)->children[b] = child;
+      break;
+    }
+  }
+  node->count++;
+}
+
+template <class StaticConfig>
+void ARTIndex<StaticConfig>::remove_child_from(Node* node, uint8_t b) {
+  assert(find_child(node, b) != nullptr);
+
+  switch (node->type) {
+    case NodeType::kNode4:
+    case NodeType::kNode16: {
+      uint8_t* keys;
+      uint64_t* children;
+      if (node->type == NodeType::kNode4) {
+        keys = static_cast<Node4*>(node)->keys;
+        children = static_cast<Node4*>(node)->children;
+      } else {
+        keys = static_cast<Node16*>(node)->keys;
+        children = static_cast<Node16*>(node)->children;
+      }
+      int count = node->count;
+      int j = 0;
+      while (keys[j] != b) j++;
+      ::mica::util::memmove(keys + j, keys + j + 1,
+                            static_cast<size_t>(count - j - 1));
+      ::mica::util::memmove(
+          children + j, children + j + 1,
+          sizeof(uint64_t) * static_cast<size_t>(count - j - 1));
+      break;
+    }
+    case NodeType::kNode48: {
+      // Keep the used slots contiguous by moving the last slot into the hole.
+      auto n = static_cast<Node48*>(node);
+      auto slot = n->child_index[b] - 1;
+      auto last_slot = n->count - 1;
+      if (slot != last_slot) {
+        n->children[slot] = n->children[last_slot];
+        for (size_t i = 0; i < 256; i++)
+          if (n->child_index[i] == last_slot + 1) {
+            n->child_index[i] = static_cast<uint8_t>(slot + 1);
+            break;
+          }
+      }
+      n->child_index[b] = 0;
+      break;
+    }
+    case NodeType::kNode256:
+    default: {
+      static_cast<Node256*>(node)->children[b] = kNullRowID;
+      break;
+    }
+  }
+  node->count--;
+}
+
+template <class StaticConfig>
+void ARTIndex<StaticConfig>::copy_children(Node* dest, const Node* src,
+                                           int skip_b) {
+  for_each_child<false>(src, 0, 255, [dest, skip_b](uint8_t b, uint64_t child) {
+    if (b != skip_b) add_child_to(dest, b, child);
+    return true;
+  });
+}
+
+template <class StaticConfig>
+bool ARTIndex<StaticConfig>::set_child(RowAccessHandle& rah, uint8_t b,
+                                       uint64_t child) {
+  auto node = get_writable_node(rah);
+  if (!node) return false;
+
+  auto child_p = find_child(node, b);
+  assert(child_p != nullptr);
+  *child_p = child;
+  return true;
+}
+}
+}
+
+#endif
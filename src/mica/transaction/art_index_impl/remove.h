@@ -0,0 +1,121 @@
+#pragma once
+#ifndef MICA_TRANSACTION_ART_INDEX_IMPL_REMOVE_H_
+#define MICA_TRANSACTION_ART_INDEX_IMPL_REMOVE_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+uint64_t ARTIndex<StaticConfig>::remove(Transaction* tx, uint64_t key,
+                                        uint64_t value) {
+  Timing t(tx->context()->timing_stack(), &Stats::index_write);
+
+  RowAccessHandle rah_root(tx);
+  auto root = get_node(rah_root, 0);
+  if (!root) return kHaveToAbort;
+
+  bool emptied = false;
+  auto ret =
+      remove_recursive(tx, nullptr, 0, rah_root, root, key, value, &emptied);
+  // The root is never removed.
+  assert(!emptied);
+  return ret;
+}
+
+template <class StaticConfig>
+uint64_t ARTIndex<StaticConfig>::remove_recursive(
+    Transaction* tx, RowAccessHandle* rah_parent, uint8_t parent_b,
+    RowAccessHandle& rah, const Node* node, uint64_t key, uint64_t value,
+    bool* emptied) {
+  auto b = key_byte(key, node->depth);
+  auto child_p = find_child(node, b);
+
+  if (!child_p || (node->depth == kLeafDepth && *child_p != value)) {
+    // We need to track the node that lacks the key.
+    if (!validate_read(rah)) return kHaveToAbort;
+    return 0;
+  }
+
+  if (node->depth == kLeafDepth) {
+    if (!remove_child(tx, rah_parent, parent_b, rah, b, emptied))
+      return kHaveToAbort;
+    return 1;
+  }
+
+  auto child_row_id = *child_p;
+  RowAccessHandle rah_child(tx);
+  auto child = get_node(rah_child, child_row_id);
+  if (!child) return kHaveToAbort;
+
+  if (!matches_prefix(child, key)) {
+    // An insert of the key would split the path right below this node.
+    if (!validate_read(rah) || !validate_read(rah_child)) return kHaveToAbort;
+    return 0;
+  }
+
+  bool child_emptied = false;
+  auto ret = remove_recursive(tx, &rah, b, rah_child, child, key, value,
+                              &child_emptied);
+  if (ret != 1 || !child_emptied) return ret;
+
+  // The child has been freed; remove it from this node.
+  if (!remove_child(tx, rah_parent, parent_b, rah, b, emptied))
+    return kHaveToAbort;
+  return 1;
+}
+
+template <class StaticConfig>
+bool ARTIndex<StaticConfig>::remove_child(Transaction* tx,
+                                          RowAccessHandle* rah_parent,
+                                          uint8_t parent_b,
+                                          RowAccessHandle& rah, uint8_t b,
+                                          bool* emptied) {
+  auto node_c = reinterpret_cast<const Node*>(rah.cdata());
+  auto count = static_cast<uint16_t>(node_c->count - 1);
+
+  // The root keeps its type and stays even if it becomes empty.
+  if (rah_parent != nullptr) {
+    if (count == 0) {
+      // Let the caller remove this node from the parent.
+      if (!free_node(rah)) return false;
+      *emptied = true;
+      return true;
+    }
+
+    if (count == 1 && node_c->depth != kLeafDepth) {
+      // The remaining child has the full prefix and can replace this node.
+      uint64_t remaining = kNullRowID;
+      for_each_child<false>(node_c, 0, 255,
+                            [b, &remaining](uint8_t b2, uint64_t child) {
+                              if (b2 == b) return true;
+                              remaining = child;
+                              return false;
+                            });
+      assert(remaining != kNullRowID);
+
+      if (!free_node(rah)) return false;
+      return set_child(*rah_parent, parent_b, remaining);
+    }
+
+    auto type = shrunk_type(node_c->type, count);
+    if (type != node_c->type) {
+      // Replace the sparse node with a smaller one.
+      RowAccessHandle rah_new(tx);
+      auto new_node = make_node(rah_new, type, node_c->depth, node_c->prefix);
+      if (!new_node) return false;
+
+      copy_children(new_node, node_c, b);
+
+      if (!free_node(rah)) return false;
+      return set_child(*rah_parent, parent_b, rah_new.row_id());
+    }
+  }
+
+  auto node = get_writable_node(rah);
+  if (!node) return false;
+  remove_child_from(node, b);
+  return true;
+}
+}
+}
+
+#endif
@@ -2,7 +2,10 @@
 #ifndef MICA_TRANSACTION_BTREE_INDEX_H_
 #define MICA_TRANSACTION_BTREE_INDEX_H_
 
+#include <vector>
 #include "mica/common.h"
+#include "mica/transaction/btree_simd_search.h"
+#include "mica/transaction/btree_string_key.h"
 #include "mica/util/type_traits.h"
 
 namespace mica {
@@ -22,6 +25,7 @@ class BTreeIndexNodeCopier {
   typedef typename BTreeIndex<StaticConfig, HasValue, Key, Compare>::LeafNode
       LeafNode;
   static constexpr bool kUseIndirection = BTreeIndexT::kUseIndirection;
+  static constexpr bool kUseSubtreeCounts = BTreeIndexT::kUseSubtreeCounts;
 
   bool operator()(uint16_t cf_id, RowVersion<StaticConfig>* dest,
                   const RowVersion<StaticConfig>* src) const {
@@ -49,6 +53,10 @@ class BTreeIndexNodeCopier {
       ::mica::util::memcpy(
           dest_node->child_row_ids, src_node->child_row_ids,
           sizeof(uint64_t) * (static_cast<size_t>(src_node->count) + 1));
+      if (kUseSubtreeCounts)
+        ::mica::util::memcpy(
+            dest_node->child_counts, src_node->child_counts,
+            sizeof(uint64_t) * (static_cast<size_t>(src_node->count) + 1));
     } else {
       auto src_node = BTreeIndexT::as_leaf(src_node_b);
       auto dest_node = reinterpret_cast<LeafNode*>(dest->data);
@@ -75,6 +83,15 @@ class BTreeIndexNodeCopier {
   }
 };
 
+// Returns a key k such that left < k <= right to be used as the split key
+// between two leaf nodes whose boundary keys are left and right.  Key types
+// may overload this to use a shorter split key (see btree_string_key.h).
+template <class Key>
+const Key& btree_separator(const Key& left, const Key& right) {
+  (void)left;
+  return right;
+}
+
 enum class BTreeRangeType {
   kOpen = 0,
   kInclusive,
@@ -117,6 +134,20 @@ class BTreeIndex {
   static constexpr bool kUseIndirection = false;
   // static constexpr bool kUseIndirection = true;
 
+  // Search nodes with vectorized compare-and-count for integer keys (see
+  // btree_simd_search.h).  Counting all keys of a node is faster than
+  // narrowing the range with binary search first, which is only done for
+  // nodes with more than kSIMDSearchThreshold keys.
+  static constexpr bool kUseSIMDSearch =
+      StaticConfig::kBTreeSIMDSearch && !kUseIndirection &&
+      std::is_same<Compare, std::less<Key>>::value &&
+      BTreeSIMDSearch<Key>::kSupported;
+  static const int kSIMDSearchThreshold = 64;
+
+  // Keep subtree counts in internal nodes for count_range(), rank(), and
+  // select() (see BasicDBConfig::kBTreeSubtreeCounts).
+  static constexpr bool kUseSubtreeCounts = StaticConfig::kBTreeSubtreeCounts;
+
   enum class NodeType : uint8_t {
     kInternal = 0,
     kLeaf,
@@ -151,6 +182,9 @@ class BTreeIndex {
     //     < keys[i + 1]
     Key keys[kMaxCount];
     uint64_t child_row_ids[kMaxCount + 1];
+    // The number of keys in the subtree of each child, in the same order as
+    // child_row_ids.
+    uint64_t child_counts[kUseSubtreeCounts ? kMaxCount + 1 : 0];
 
     template <typename IndexType>
     Key& key(IndexType i) {
@@ -180,10 +214,31 @@ class BTreeIndex {
       } else
         return child_row_ids[i];
     }
+    template <typename IndexType>
+    uint64_t& child_count(IndexType i) {
+      if (kUseIndirection) {
+        if (i == 0)
+          return child_counts[0];
+        else
+          return child_counts[indir[i - 1] + 1];
+      } else
+        return child_counts[i];
+    }
+    template <typename IndexType>
+    const uint64_t& child_count(IndexType i) const {
+      if (kUseIndirection) {
+        if (i == 0)
+          return child_counts[0];
+        else
+          return child_counts[indir[i - 1] + 1];
+      } else
+        return child_counts[i];
+    }
   };
 
   static constexpr size_t kInternalNodeMaxCount =
-      (1024 - 40 - 40) / (sizeof(Key) + sizeof(uint64_t));
+      (1024 - 40 - 40) /
+      (sizeof(Key) + sizeof(uint64_t) * (kUseSubtreeCounts ? 2 : 1));
   typedef InternalNodeT<kInternalNodeMaxCount> InternalNode;
   typedef InternalNodeT<kInternalNodeMaxCount * 2 + 1> InternalNodeBuffer;
 
@@ -240,6 +295,124 @@ class BTreeIndex {
 
   static constexpr uint64_t kHaveToAbort = static_cast<uint64_t>(-1);
 
+  // The number of keys whose lookups multi_lookup() interleaves.
+  static constexpr uint64_t kMultiLookupBatchSize = 16;
+
+  // The number of nodes that a bulk load creates in a transaction.
+  static constexpr uint64_t kBulkLoadBatchSize = 64;
+
+  // Leaf nodes built from a sorted key range by bulk_load_leaves().
+  struct BulkLoadRun {
+    std::vector<uint64_t> row_ids;
+    // The split keys between adjacent leaf nodes.
+    std::vector<Key> split_keys;
+    Key first_key;
+    Key last_key;
+  };
+
+  // A run of matching entries in a leaf node returned by Scanner::next().
+  // The entries are at positions [begin, begin + size) of the node in key
+  // order, and key(i) and value(i) return the i-th entry in scan order.  A
+  // slice remains valid until the transaction ends.
+  class ScanSlice {
+   public:
+    uint64_t size() const { return size_; }
+    bool reversed() const { return reversed_; }
+
+    // The entries in key order; only usable without indirection.
+    const Key* keys() const { return node_->keys + begin_; }
+    const uint64_t* values() const { return node_->values + begin_; }
+
+    const Key& key(uint64_t i) const { return node_->key(pos(i)); }
+    uint64_t value(uint64_t i) const {
+      return HasValue ? node_->value(pos(i)) : 0;
+    }
+
+   private:
+    friend class BTreeIndex;
+
+    uint64_t pos(uint64_t i) const {
+      return reversed_ ? begin_ + size_ - 1 - i : begin_ + i;
+    }
+
+    const LeafNode* node_;
+    uint64_t begin_;
+    uint64_t size_;
+    bool reversed_;
+  };
+
+  // The position of a Scanner, from which another scanner can continue the
+  // scan (e.g., in a later transaction).
+  struct ScanCursor {
+    // Whether any entry has been returned.
+    bool has_last_key;
+    Key last_key;
+    // Whether the whole range has been returned.
+    bool end;
+  };
+
+  // A pull-based range scan that returns the matching entries one leaf slice
+  // at a time.  The sibling leaf is prefetched while the caller consumes a
+  // slice.  The bounds are checked once per leaf instead of once per entry.
+  class Scanner {
+   public:
+    static constexpr uint64_t kNoLimit = static_cast<uint64_t>(-1);
+
+    // btree_index_impl/scan.h
+    Scanner(BTreeIndex* idx, Transaction* tx, BTreeRangeType left_type,
+            const Key& min_key, BTreeRangeType right_type, const Key& max_key,
+            bool reversed, bool skip_validation);
+
+    // Skips the first offset matching entries and returns at most limit
+    // entries.
+    void set_offset(uint64_t offset) { offset_ = offset; }
+    void set_limit(uint64_t limit) { limit_ = limit; }
+    // Prefetches the main table rows of each slice, whose row IDs are the
+    // values.
+    void set_prefetch_rows(bool prefetch_rows) {
+      prefetch_rows_ = prefetch_rows;
+    }
+    // Continues the scan after the last entry of the cursor.  Must be called
+    // before next().
+    void resume(const ScanCursor& cursor);
+
+    // Stores the next slice and returns its size, which is 0 if the scan has
+    // finished.  Returns kHaveToAbort if the transaction has to abort.
+    uint64_t next(ScanSlice* slice);
+
+    const ScanCursor& cursor() const { return cursor_; }
+
+   private:
+    template <typename RowAccessHandleT>
+    uint64_t next_slice(RowAccessHandleT& rah, ScanSlice* slice);
+    template <typename RowAccessHandleT>
+    const LeafNode* descend(RowAccessHandleT& rah);
+
+    int lower_pos(const LeafNode* node) const;
+    int upper_pos(const LeafNode* node) const;
+    bool beyond_left(const Key& key) const;
+    bool beyond_right(const Key& key) const;
+
+    BTreeIndex* idx_;
+    Transaction* tx_;
+    BTreeRangeType left_type_;
+    Key min_key_;
+    BTreeRangeType right_type_;
+    Key max_key_;
+    bool reversed_;
+    bool skip_validation_;
+
+    uint64_t offset_;
+    uint64_t limit_;
+    bool prefetch_rows_;
+
+    RowAccessHandle rah_;
+    RowAccessHandlePeekOnly rah_peek_;
+    const LeafNode* node_;
+    bool started_;
+    ScanCursor cursor_;
+  };
+
   // btree_index_impl/init.h
   BTreeIndex(DB<StaticConfig>* db, Table<StaticConfig>* main_tbl,
              Table<StaticConfig>* idx_tbl, const Compare& comp = Compare());
@@ -262,9 +435,52 @@ class BTreeIndex {
   uint64_t lookup(Transaction* tx, const Key& min_key, const Key& max_key,
                   bool skip_validation, const Func& func);
 
+  // Looks up n keys with their cache misses overlapped.  func(i, key, value)
+  // is called for each match of keys[i]; returning false skips the remaining
+  // matches of keys[i].  If prefetch_rows is true, the values must be row IDs
+  // of the main table, and their rows are prefetched before func is called.
+  template <typename Func>
+  uint64_t multi_lookup(Transaction* tx, const Key* keys, uint64_t n,
+                        bool skip_validation, const Func& func,
+                        bool prefetch_rows = false);
+
+  // btree_index_impl/rank.h
+  // These require kUseSubtreeCounts and visit one node per level.  The nodes
+  // used are validated unless skip_validation is true, so any insert or
+  // remove by another transaction conflicts with them.
+
+  // Returns the number of keys in the range.
+  template <BTreeRangeType LeftRangeType, BTreeRangeType RightRangeType>
+  uint64_t count_range(Transaction* tx, const Key& min_key, const Key& max_key,
+                       bool skip_validation);
+
+  // Returns the number of keys smaller than the key.
+  uint64_t rank(Transaction* tx, const Key& key, bool skip_validation);
+
+  // Calls func(key, value) for the k-th smallest key (starting from 0).
+  // Returns 1, or 0 if the index has no more than k keys.
+  template <typename Func>
+  uint64_t select(Transaction* tx, uint64_t k, bool skip_validation,
+                  const Func& func);
+
   // btree_index_impl/prefetch.h
   void prefetch(Transaction* tx, const Key& key);
 
+  // btree_index_impl/bulk_load.h
+  // Loads n sorted, distinct keys into an empty index, filling each node up
+  // to fill_factor, which is raised to about 0.5 if lower.  values is not
+  // used if HasValue is false.
+  bool bulk_load(Transaction* tx, const Key* keys, const uint64_t* values,
+                 uint64_t n, double fill_factor = 1.);
+  // Parallel loading: each thread builds a run for a disjoint key range, and
+  // one thread finishes the tree with all runs in key order.  A run with
+  // fewer keys than a quarter of a leaf node leaves an underfull leaf node.
+  bool bulk_load_leaves(Transaction* tx, const Key* keys,
+                        const uint64_t* values, uint64_t n, double fill_factor,
+                        BulkLoadRun* run);
+  bool bulk_load_finish(Transaction* tx, const std::vector<BulkLoadRun>& runs,
+                        double fill_factor);
+
   // btree_index_impl/check.h
   bool check(Transaction* tx) const;
   bool dump_tree(Transaction* tx) const;
@@ -320,6 +536,33 @@ class BTreeIndex {
                         const Key& min_key, const Key& max_key,
                         bool skip_validation, const Func& func);
 
+  template <typename RowAccessHandleT, typename Func>
+  uint64_t multi_lookup_batch(Transaction* tx, const Key* keys, uint64_t base,
+                              uint64_t n, bool skip_validation,
+                              bool prefetch_rows, const Func& func);
+
+  // btree_index_impl/rank.h
+  // Returns the number of keys smaller than the key (no larger than the key
+  // if Inclusive), or the number of all keys if Open.
+  template <bool Inclusive, bool Open>
+  uint64_t count_up_to(Transaction* tx, const Key& key, bool skip_validation);
+  template <bool Inclusive, bool Open, typename RowAccessHandleT>
+  uint64_t count_recursive(Transaction* tx, RowAccessHandleT& rah,
+                           const Node* node_b, const Key& key,
+                           bool skip_validation);
+  template <typename Func, typename RowAccessHandleT>
+  uint64_t select_recursive(Transaction* tx, RowAccessHandleT& rah,
+                            const Node* node_b, uint64_t k, bool is_root,
+                            bool skip_validation, const Func& func);
+
+  // btree_index_impl/bulk_load.h
+  template <typename Func>
+  bool bulk_load_level(Transaction* tx, uint64_t node_count, const Func& func,
+                       bool leaf, std::vector<uint64_t>* row_ids);
+  static uint64_t bulk_load_node_count(uint64_t item_count, uint64_t max_count,
+                                       double fill_factor);
+  static Key bulk_load_split_key(const Key& left, const Key& right);
+
   // btree_index_impl/fixup.h
   template <bool RightOpen, bool RightExclusive, typename RowAccessHandleT>
   bool fixup_internal(RowAccessHandleT& rah, const Node*& node_b,
@@ -380,6 +623,9 @@ class BTreeIndex {
 
   void prefetch_node(const Node* node) const;
 
+  static uint64_t subtree_count(const Node* node_b);
+  uint64_t subtree_count(Transaction* tx, uint64_t row_id) const;
+
   static bool is_internal(const Node* node);
   static bool is_leaf(const Node* node);
 
@@ -430,6 +676,9 @@ class BTreeIndex {
 #include "btree_index_impl/remove.h"
 #include "btree_index_impl/lookup.h"
 #include "btree_index_impl/prefetch.h"
+#include "btree_index_impl/bulk_load.h"
+#include "btree_index_impl/scan.h"
+#include "btree_index_impl/rank.h"
 #include "btree_index_impl/check.h"
 
 #endif
@@ -0,0 +1,292 @@
+#pragma once
+#ifndef MICA_TRANSACTION_BTREE_INDEX_IMPL_BULK_LOAD_H_
+#define MICA_TRANSACTION_BTREE_INDEX_IMPL_BULK_LOAD_H_
+
+namespace mica {
+namespace transaction {
+// Bulk loading builds the tree bottom-up from sorted keys instead of
+// inserting keys one by one.  The new nodes are created by transactions that
+// each create up to kBulkLoadBatchSize nodes; they are unreachable until
+// bulk_load_finish() makes the head node point to the new root, so they can
+// be committed early.  The index must be empty (just initialized) and must not
+// be modified by other threads while it is loaded.  If loading fails, the
+// nodes created so far are not freed; the index must be created again.
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::bulk_load(
+    Transaction* tx, const Key* keys, const uint64_t* values, uint64_t n,
+    double fill_factor) {
+  std::vector<BulkLoadRun> runs(1);
+  if (!bulk_load_leaves(tx, keys, values, n, fill_factor, &runs[0]))
+    return false;
+  return bulk_load_finish(tx, runs, fill_factor);
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::bulk_load_leaves(
+    Transaction* tx, const Key* keys, const uint64_t* values, uint64_t n,
+    double fill_factor, BulkLoadRun* run) {
+  Timing t(tx->context()->timing_stack(), &Stats::index_write);
+
+  run->row_ids.clear();
+  run->split_keys.clear();
+  if (n == 0) return true;
+
+  for (uint64_t i = 1; i < n; i++)
+    if (!comp_lt(keys[i - 1], keys[i])) {
+      printf("BTreeIndex::bulk_load_leaves(): keys are not sorted\n");
+      return false;
+    }
+
+  auto node_count =
+      bulk_load_node_count(n, LeafNode::kMaxCount, fill_factor);
+  run->split_keys.reserve(node_count - 1);
+  for (uint64_t k = 1; k < node_count; k++) {
+    auto i = n * k / node_count;
+    run->split_keys.push_back(bulk_load_split_key(keys[i - 1], keys[i]));
+  }
+  run->first_key = keys[0];
+  run->last_key = keys[n - 1];
+
+  // The first and last leaf nodes are linked to other runs later.
+  return bulk_load_level(
+      tx, node_count,
+      [keys, values, n, node_count, run](Node* node_b, uint64_t k) {
+        auto node = as_leaf(node_b);
+        auto begin = n * k / node_count;
+        auto end = n * (k + 1) / node_count;
+        auto count = static_cast<size_t>(end - begin);
+
+        node->count = static_cast<uint8_t>(count);
+        if (kUseIndirection)
+          for (size_t i = 0; i < count; i++)
+            node->indir[i] = static_cast<uint8_t>(i);
+        ::mica::util::memcpy(node->keys, keys + begin, sizeof(Key) * count);
+        if (HasValue)
+          ::mica::util::memcpy(node->values, values + begin,
+                               sizeof(uint64_t) * count);
+
+        node->min_key = k == 0 ? Key{} : run->split_keys[k - 1];
+        node->max_key = k == node_count - 1 ? Key{} : run->split_keys[k];
+      },
+      true, &run->row_ids);
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::bulk_load_finish(
+    Transaction* tx, const std::vector<BulkLoadRun>& runs,
+    double fill_factor) {
+  Timing t(tx->context()->timing_stack(), &Stats::index_write);
+
+  // Concatenate the runs into one level of leaf nodes.
+  std::vector<uint64_t> row_ids;
+  std::vector<Key> split_keys;
+  const BulkLoadRun* prev_run = nullptr;
+  for (auto& run : runs) {
+    if (run.row_ids.empty()) continue;
+
+    if (prev_run != nullptr) {
+      if (!comp_lt(prev_run->last_key, run.first_key)) {
+        printf("BTreeIndex::bulk_load_finish(): runs are not sorted\n");
+        return false;
+      }
+      auto split_key = bulk_load_split_key(prev_run->last_key, run.first_key);
+
+      // Link the last leaf node of the previous run and the first leaf node
+      // of this run.
+      if (!tx->begin()) return false;
+
+      RowAccessHandle rah_left(tx);
+      RowAccessHandle rah_right(tx);
+      LeafNode* left = nullptr;
+      LeafNode* right = nullptr;
+      if (get_node(rah_left, prev_run->row_ids.back()))
+        left = as_leaf(get_writable_node(rah_left));
+      if (left && get_node(rah_right, run.row_ids.front()))
+        right = as_leaf(get_writable_node(rah_right));
+      if (!right) {
+        tx->abort();
+        return false;
+      }
+
+      left->next = rah_right.row_id();
+      left->max_key = split_key;
+      right->prev = rah_left.row_id();
+      right->min_key = split_key;
+
+      if (!tx->commit()) return false;
+
+      split_keys.push_back(split_key);
+    }
+
+    row_ids.insert(row_ids.end(), run.row_ids.begin(), run.row_ids.end());
+    split_keys.insert(split_keys.end(), run.split_keys.begin(),
+                      run.split_keys.end());
+    prev_run = &run;
+  }
+  if (row_ids.empty()) return true;
+
+  // Build the internal levels.  The split key between two adjacent internal
+  // nodes moves up to the parent level instead of being stored in the nodes.
+  while (row_ids.size() > 1) {
+    auto child_count = static_cast<uint64_t>(row_ids.size());
+    auto node_count =
+        bulk_load_node_count(child_count, InternalNode::kMaxCount + 1,
+                             fill_factor);
+
+    std::vector<uint64_t> parent_row_ids;
+    std::vector<Key> parent_split_keys;
+    parent_split_keys.reserve(node_count - 1);
+    for (uint64_t k = 1; k < node_count; k++)
+      parent_split_keys.push_back(split_keys[child_count * k / node_count - 1]);
+
+    bool ret = bulk_load_level(
+        tx, node_count,
+        [this, tx, &row_ids, &split_keys, child_count, node_count](
+            Node* node_b, uint64_t k) {
+          auto node = as_internal(node_b);
+          auto begin = child_count * k / node_count;
+          auto end = child_count * (k + 1) / node_count;
+          auto count = static_cast<size_t>(end - begin - 1);
+
+          node->count = static_cast<uint8_t>(count);
+          if (kUseIndirection)
+            for (size_t i = 0; i < count; i++)
+              node->indir[i] = static_cast<uint8_t>(i);
+          ::mica::util::memcpy(node->keys, &split_keys[begin],
+                               sizeof(Key) * count);
+          ::mica::util::memcpy(node->child_row_ids, &row_ids[begin],
+                               sizeof(uint64_t) * (count + 1));
+          // The children have been committed by earlier batches.
+          if (kUseSubtreeCounts)
+            for (size_t i = 0; i < count + 1; i++)
+              node->child_counts[i] = subtree_count(tx, row_ids[begin + i]);
+
+          node->min_key = begin == 0 ? Key{} : split_keys[begin - 1];
+          node->max_key = end == child_count ? Key{} : split_keys[end - 1];
+        },
+        false, &parent_row_ids);
+    if (!ret) return false;
+
+    row_ids.swap(parent_row_ids);
+    split_keys.swap(parent_split_keys);
+  }
+
+  // Publish the new root and free the empty root created by init().
+  if (!tx->begin()) return false;
+
+  RowAccessHandle rah_head(tx);
+  InternalNode* head = nullptr;
+  if (get_node(rah_head, 0)) head = as_internal(get_writable_node(rah_head));
+  if (!head) {
+    tx->abort();
+    return false;
+  }
+
+  RowAccessHandle rah_old_root(tx);
+  auto old_root_b = get_node(rah_old_root, head->child_row_id(0));
+  if (!old_root_b || !is_leaf(old_root_b) || old_root_b->count != 0) {
+    printf("BTreeIndex::bulk_load_finish(): index is not empty\n");
+    tx->abort();
+    return false;
+  }
+  if (!free_node(rah_old_root)) {
+    tx->abort();
+    return false;
+  }
+
+  head->child_row_id(0) = row_ids[0];
+
+  return tx->commit();
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+template <typename Func>
+bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::bulk_load_level(
+    Transaction* tx, uint64_t node_count, const Func& func, bool leaf,
+    std::vector<uint64_t>* row_ids) {
+  // Creates node_count nodes filled by func(node, k) and links them in order.
+  row_ids->clear();
+  row_ids->reserve(node_count);
+
+  // The last node created, which is writable until its batch commits.
+  Node* prev_node = nullptr;
+
+  for (uint64_t k = 0; k < node_count; k++) {
+    if (k % kBulkLoadBatchSize == 0) {
+      if (!tx->begin()) return false;
+    }
+
+    RowAccessHandle rah(tx);
+    Node* node;
+    if (leaf)
+      node = make_leaf_node(rah);
+    else
+      node = make_internal_node(rah);
+    if (!node) {
+      tx->abort();
+      return false;
+    }
+
+    func(node, k);
+    if (leaf) {
+      as_leaf(node)->prev = k == 0 ? kNullRowID : row_ids->back();
+      as_leaf(node)->next = kNullRowID;
+    } else
+      as_internal(node)->next = kNullRowID;
+
+    if (k != 0) {
+      if (k % kBulkLoadBatchSize == 0) {
+        // The previous node was committed by the previous batch.
+        RowAccessHandle rah_prev(tx);
+        prev_node = nullptr;
+        if (get_node(rah_prev, row_ids->back()))
+          prev_node = get_writable_node(rah_prev);
+        if (!prev_node) {
+          tx->abort();
+          return false;
+        }
+      }
+      if (leaf)
+        as_leaf(prev_node)->next = rah.row_id();
+      else
+        as_internal(prev_node)->next = rah.row_id();
+    }
+
+    row_ids->push_back(rah.row_id());
+    prev_node = node;
+
+    if (k % kBulkLoadBatchSize == kBulkLoadBatchSize - 1 ||
+        k == node_count - 1) {
+      if (!tx->commit()) return false;
+    }
+  }
+  return true;
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::bulk_load_node_count(
+    uint64_t item_count, uint64_t max_count, double fill_factor) {
+  // Items are spread evenly over the nodes so that the last node is not left
+  // nearly empty.  Each node then gets at least half of per_node items, which
+  // keeps non-root nodes at least a quarter full (as check() requires) and
+  // internal nodes with at least one key even for a tiny fill_factor.
+  auto per_node = static_cast<uint64_t>(static_cast<double>(max_count) *
+                                        fill_factor);
+  if (per_node < max_count / 2 + 2) per_node = max_count / 2 + 2;
+  if (per_node > max_count) per_node = max_count;
+  return (item_count + per_node - 1) / per_node;
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+Key BTreeIndex<StaticConfig, HasValue, Key, Compare>::bulk_load_split_key(
+    const Key& left, const Key& right) {
+  // The same split key as scatter() would choose between the two keys.
+  if (std::is_same<Compare, std::less<Key>>::value)
+    return btree_separator(left, right);
+  return right;
+}
+}
+}
+
+#endif
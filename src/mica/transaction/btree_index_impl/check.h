@@ -173,6 +173,17 @@ bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::check_recursive(
         }
       }
 
+      // Check the subtree count, which is correct if the child's own counts
+      // are.
+      if (kUseSubtreeCounts && node->child_count(i) != subtree_count(child)) {
+        printf("BTreeIndex::check(): node_row_id=%" PRIu64
+               ": invalid count: child_counts[%zu](%" PRIu64
+               ") != %" PRIu64 "\n",
+               rah.row_id(), i, node->child_count(i), subtree_count(child));
+        dump(rah, node);
+        return false;
+      }
+
       // Check the child recursively.
       const Key* child_expected_min_key;
       const Key* child_expected_max_key;
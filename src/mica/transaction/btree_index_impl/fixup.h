@@ -37,7 +37,8 @@ bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::fixup_internal(
     if ((kVerbose & VerboseFlag::kFixup)) fixup_len++;
   }
 
-  if (!comp_le(node->min_key, key)) return false;
+  // An open right bound has no key to check.
+  if (!RightOpen && !comp_le(node->min_key, key)) return false;
 
   if ((kVerbose & VerboseFlag::kFixup))
     if (fixup_len > 100)
@@ -97,7 +98,8 @@ bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::fixup_leaf(
     if ((kVerbose & VerboseFlag::kFixup)) fixup_len++;
   }
 
-  if (!comp_le(node->min_key, key)) return false;
+  // An open right bound has no key to check.
+  if (!RightOpen && !comp_le(node->min_key, key)) return false;
 
   if ((kVerbose & VerboseFlag::kFixup))
     if (fixup_len > 100)
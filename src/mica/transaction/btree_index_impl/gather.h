@@ -19,6 +19,10 @@ void BTreeIndex<StaticConfig, HasValue, Key, Compare>::copy(
   ::mica::util::memcpy(
       dest->child_row_ids, left->child_row_ids,
       sizeof(uint64_t) * (static_cast<size_t>(left->count) + 1));
+  if (kUseSubtreeCounts)
+    ::mica::util::memcpy(
+        dest->child_counts, left->child_counts,
+        sizeof(uint64_t) * (static_cast<size_t>(left->count) + 1));
 
   dest->count = left->count;
   dest->min_key = left->min_key;
@@ -57,6 +61,10 @@ void BTreeIndex<StaticConfig, HasValue, Key, Compare>::gather(
   ::mica::util::memcpy(
       dest->child_row_ids, left->child_row_ids,
       sizeof(uint64_t) * (static_cast<size_t>(left->count) + 1));
+  if (kUseSubtreeCounts)
+    ::mica::util::memcpy(
+        dest->child_counts, left->child_counts,
+        sizeof(uint64_t) * (static_cast<size_t>(left->count) + 1));
 
   if (kUseIndirection) {
     dest->indir[left->count] = left->count;
@@ -75,6 +83,11 @@ void BTreeIndex<StaticConfig, HasValue, Key, Compare>::gather(
       dest->child_row_ids + static_cast<size_t>(left->count) + 1,
       right->child_row_ids,
       sizeof(uint64_t) * (static_cast<size_t>(right->count) + 1));
+  if (kUseSubtreeCounts)
+    ::mica::util::memcpy(
+        dest->child_counts + static_cast<size_t>(left->count) + 1,
+        right->child_counts,
+        sizeof(uint64_t) * (static_cast<size_t>(right->count) + 1));
 
   dest->count = static_cast<uint8_t>(static_cast<size_t>(left->count) + 1 +
                                      static_cast<size_t>(right->count));
@@ -128,24 +141,35 @@ void BTreeIndex<StaticConfig, HasValue, Key, Compare>::scatter(
 
   if (kUseIndirection) {
     left->child_row_ids[0] = src->child_row_id(0);
+    if (kUseSubtreeCounts) left->child_counts[0] = src->child_count(0);
     for (size_t i = 0; i < new_left_count; i++) {
       left->indir[i] = static_cast<uint8_t>(i);
       left->keys[i] = src->key(i);
       left->child_row_ids[i + 1] = src->child_row_id(i + 1);
+      if (kUseSubtreeCounts)
+        left->child_counts[i + 1] = src->child_count(i + 1);
     }
 
     right->child_row_ids[0] = src->child_row_id(new_left_count + 1);
+    if (kUseSubtreeCounts)
+      right->child_counts[0] = src->child_count(new_left_count + 1);
     for (size_t i = 0; i < new_right_count; i++) {
       right->indir[i] = static_cast<uint8_t>(i);
       right->keys[i] = src->key(new_left_count + 1 + i);
       right->child_row_ids[i + 1] =
           src->child_row_id(new_left_count + 1 + i + 1);
+      if (kUseSubtreeCounts)
+        right->child_counts[i + 1] =
+            src->child_count(new_left_count + 1 + i + 1);
     }
   } else {
     // for (size_t i = 0; i < new_left_count; i++) left->keys[i] = src->keys[i];
     ::mica::util::memcpy(left->keys, src->keys, sizeof(Key) * new_left_count);
     ::mica::util::memcpy(left->child_row_ids, src->child_row_ids,
                          sizeof(uint64_t) * (new_left_count + 1));
+    if (kUseSubtreeCounts)
+      ::mica::util::memcpy(left->child_counts, src->child_counts,
+                           sizeof(uint64_t) * (new_left_count + 1));
 
     // for (size_t i = 0; i < new_right_count; i++)
     //   right->keys[i] = src->keys[new_left_count + 1 + i];
@@ -154,6 +178,10 @@ void BTreeIndex<StaticConfig, HasValue, Key, Compare>::scatter(
     ::mica::util::memcpy(right->child_row_ids,
                          src->child_row_ids + new_left_count + 1,
                          sizeof(uint64_t) * (new_right_count + 1));
+    if (kUseSubtreeCounts)
+      ::mica::util::memcpy(right->child_counts,
+                           src->child_counts + new_left_count + 1,
+                           sizeof(uint64_t) * (new_right_count + 1));
   }
 
   left->min_key = src->min_key;
@@ -204,10 +232,16 @@ void BTreeIndex<StaticConfig, HasValue, Key, Compare>::scatter(
                            sizeof(uint64_t) * new_right_count);
   }
 
+  // Any key between the two boundary keys can split the leaf nodes; use a
+  // shorter one if the key type provides it.
+  Key split_key = src->key(new_left_count);
+  if (new_left_count != 0 && std::is_same<Compare, std::less<Key>>::value)
+    split_key = btree_separator(src->key(new_left_count - 1), split_key);
+
   left->min_key = src->min_key;
-  left->max_key = src->key(new_left_count);
+  left->max_key = split_key;
 
-  right->min_key = src->key(new_left_count);
+  right->min_key = split_key;
   right->max_key = src->max_key;
 
   left->count = static_cast<uint8_t>(new_left_count);
@@ -21,6 +21,9 @@ uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::insert(
   auto root_b =
       get_node_with_fixup<false, false>(rah_root, head->child_row_id(0), key);
   if (!root_b) return kHaveToAbort;
+  // Subtree counts require the nodes on the path to be consistent.
+  if (kUseSubtreeCounts && rah_root.row_id() != head->child_row_id(0))
+    return kHaveToAbort;
 
   Key up_key_from_child{};
   uint64_t up_row_id_from_child = kNullRowID;
@@ -35,6 +38,15 @@ uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::insert(
              "\n",
              key_info(key), key_info(up_key_from_child), up_row_id_from_child);
 
+    uint64_t left_count = 0;
+    uint64_t right_count = 0;
+    if (kUseSubtreeCounts) {
+      left_count = subtree_count(tx, head->child_row_id(0));
+      right_count = subtree_count(tx, up_row_id_from_child);
+      if (left_count == kHaveToAbort || right_count == kHaveToAbort)
+        return kHaveToAbort;
+    }
+
     // Replace the root.
     RowAccessHandle rah_head(tx);
     if (!get_node(rah_head, 0)) return kHaveToAbort;
@@ -53,6 +65,10 @@ uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::insert(
     // Do not use a fixed-up node (previous rah_root and root_b); the root's row ID comes directly from the head node.
     root->child_row_id(0) = head->child_row_id(0);
     root->child_row_id(1) = up_row_id_from_child;
+    if (kUseSubtreeCounts) {
+      root->child_count(0) = left_count;
+      root->child_count(1) = right_count;
+    }
     root->next = kNullRowID;
     root->min_key = Key{};
     root->max_key = Key{};
@@ -94,6 +110,8 @@ uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::insert_recursive(
     auto child_b =
         get_node_with_fixup<false, false>(rah_child, child_row_id, key);
     if (!child_b) return kHaveToAbort;
+    if (kUseSubtreeCounts && rah_child.row_id() != child_row_id)
+      return kHaveToAbort;
     child_row_id = rah_child.row_id();
 
     Key up_key_from_child{};
@@ -110,13 +128,19 @@ uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::insert_recursive(
                key_info(key), key_info(up_key_from_child),
                up_row_id_from_child);
 
+      auto row_id = rah.row_id();
       if (!fixup_internal<false, false>(rah, node_b, up_key_from_child))
         return kHaveToAbort;
+      if (kUseSubtreeCounts && rah.row_id() != row_id) return kHaveToAbort;
       node = as_internal(node_b);
 
       if (!insert_child(tx, rah, node, up_key_from_child, up_row_id_from_child,
                         up_key, up_row_id))
         return kHaveToAbort;
+    } else if (kUseSubtreeCounts && ret == 1) {
+      auto wnode = as_internal(get_writable_node(rah));
+      if (!wnode) return kHaveToAbort;
+      wnode->child_count(j)++;
     }
   } else {
     auto node = as_leaf(node_b);
@@ -138,6 +162,16 @@ bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::insert_child(
   // Find the insert position for the split key.
   size_t j = static_cast<size_t>(search_leftmost<true>(node_r, key));
 
+  // The split child at j and the new child now share the child's keys.
+  uint64_t left_count = 0;
+  uint64_t right_count = 0;
+  if (kUseSubtreeCounts) {
+    left_count = subtree_count(tx, node_r->child_row_id(j));
+    right_count = subtree_count(tx, child_row_id);
+    if (left_count == kHaveToAbort || right_count == kHaveToAbort)
+      return false;
+  }
+
   // Obtain a writable version of node.
   auto node = as_internal(get_writable_node(rah));
   if (!node) return false;
@@ -174,10 +208,18 @@ bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::insert_child(
       ::mica::util::memmove(
           buf.child_row_ids + j + 2, buf.child_row_ids + j + 1,
           sizeof(uint64_t) * (static_cast<size_t>(buf.count) - j));
+      if (kUseSubtreeCounts)
+        ::mica::util::memmove(
+            buf.child_counts + j + 2, buf.child_counts + j + 1,
+            sizeof(uint64_t) * (static_cast<size_t>(buf.count) - j));
     }
     buf.key(j) = key;
     buf.child_row_id(j + 1) = child_row_id;
     buf.count++;
+    if (kUseSubtreeCounts) {
+      buf.child_count(j) = left_count;
+      buf.child_count(j + 1) = right_count;
+    }
 
     // Adjust the left node size if the new child will be on the left node.
     if (j < new_left_count) new_left_count++;
@@ -212,10 +254,18 @@ bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::insert_child(
       ::mica::util::memmove(
           node->child_row_ids + j + 2, node->child_row_ids + j + 1,
           sizeof(uint64_t) * (static_cast<size_t>(node->count) - j));
+      if (kUseSubtreeCounts)
+        ::mica::util::memmove(
+            node->child_counts + j + 2, node->child_counts + j + 1,
+            sizeof(uint64_t) * (static_cast<size_t>(node->count) - j));
     }
     node->key(j) = key;
     node->child_row_id(j + 1) = child_row_id;
     node->count++;
+    if (kUseSubtreeCounts) {
+      node->child_count(j) = left_count;
+      node->child_count(j + 1) = right_count;
+    }
 
     if ((kVerbose & VerboseFlag::kInsert)) dump_node(rah, node);
   }
@@ -310,9 +360,9 @@ uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::insert_item(
 
     if ((kVerbose & VerboseFlag::kInsert)) dump_node(rah_right, right);
 
-    // The first key of the (new) right node needs to be inserted in the
-    // parent node.
-    *up_key = right->key(0);
+    // The split key (no larger than the first key of the (new) right node)
+    // needs to be inserted in the parent node.
+    *up_key = right->min_key;
     *up_row_id = rah_right.row_id();
   } else {
     // Insert the new key at j.
@@ -154,13 +154,13 @@ uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::return_range(
 
       assert(j + 1 < 0 || j + 1 >= node->count ||
              comp_lt(max_key, node->key(j + 1)));
-      assert(j < 0 || j >= node->count || comp_le(node->key(j + 1), max_key));
+      assert(j < 0 || j >= node->count || comp_le(node->key(j), max_key));
     } else /*if (RightRangeType == BTreeRangeType::kExclusive)*/ {
       j = search_rightmost<true>(node, max_key);
 
       assert(j + 1 < 0 || j + 1 >= node->count ||
              comp_le(max_key, node->key(j + 1)));
-      assert(j < 0 || j >= node->count || comp_lt(node->key(j + 1), max_key));
+      assert(j < 0 || j >= node->count || comp_lt(node->key(j), max_key));
     }
   }
 
@@ -257,6 +257,103 @@ uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::return_range(
 
   return found;
 }
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+template <typename Func>
+uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::multi_lookup(
+    Transaction* tx, const Key* keys, uint64_t n, bool skip_validation,
+    const Func& func, bool prefetch_rows) {
+  uint64_t found = 0;
+  for (uint64_t base = 0; base < n; base += kMultiLookupBatchSize) {
+    auto batch_n = std::min(n, base + kMultiLookupBatchSize) - base;
+    uint64_t ret;
+    if (skip_validation)
+      ret = multi_lookup_batch<RowAccessHandlePeekOnly>(
+          tx, keys + base, base, batch_n, skip_validation, prefetch_rows, func);
+    else
+      ret = multi_lookup_batch<RowAccessHandle>(
+          tx, keys + base, base, batch_n, skip_validation, prefetch_rows, func);
+    if (ret == kHaveToAbort) return kHaveToAbort;
+    found += ret;
+  }
+  return found;
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+template <typename RowAccessHandleT, typename Func>
+uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::multi_lookup_batch(
+    Transaction* tx, const Key* keys, uint64_t base, uint64_t n,
+    bool skip_validation, bool prefetch_rows, const Func& func) {
+  // Descends the tree for all keys one level at a time.  At each level, the
+  // child rows of all keys are prefetched before any of them is visited so
+  // that the node misses of different keys overlap.  The tree has the same
+  // height for every key in the transaction's snapshot.
+  assert(n <= kMultiLookupBatchSize);
+
+  struct Match {
+    uint64_t i;
+    Key key;
+    uint64_t value;
+  };
+
+  RowAccessHandleT rahs[kMultiLookupBatchSize];
+  const Node* nodes[kMultiLookupBatchSize];
+  uint64_t child_row_ids[kMultiLookupBatchSize];
+  std::vector<Match> matches;
+
+  {
+    Timing t(tx->context()->timing_stack(), &Stats::index_read);
+
+    for (uint64_t i = 0; i < n; i++) {
+      rahs[i] = RowAccessHandleT(tx);
+      nodes[i] = as_internal(get_node(rahs[i], 0));
+      if (!nodes[i]) return kHaveToAbort;
+    }
+
+    while (is_internal(nodes[0])) {
+      for (uint64_t i = 0; i < n; i++) {
+        auto node = as_internal(nodes[i]);
+        auto j = search_leftmost<true>(node, keys[i]);
+        child_row_ids[i] = node->child_row_id(j);
+        prefetch_row(rahs[i], child_row_ids[i]);
+      }
+      for (uint64_t i = 0; i < n; i++) {
+        rahs[i].reset();
+        nodes[i] = get_node_with_fixup<false, false>(rahs[i], child_row_ids[i],
+                                                     keys[i]);
+        if (!nodes[i]) return kHaveToAbort;
+        assert(is_internal(nodes[i]) == is_internal(nodes[0]));
+      }
+    }
+
+    // Collect the matches while prefetching their main table rows.
+    matches.reserve(n);
+    for (uint64_t i = 0; i < n; i++) {
+      auto ret = return_range<BTreeRangeType::kInclusive,
+                              BTreeRangeType::kInclusive, false>(
+          rahs[i], nodes[i], keys[i], keys[i], skip_validation,
+          [this, tx, base, i, prefetch_rows, &matches](const Key& key,
+                                                       uint64_t value) {
+            if (HasValue && prefetch_rows) {
+              RowAccessHandlePeekOnly rah(tx);
+              rah.prefetch_row(main_tbl_, 0, value, 0, 0);
+            }
+            matches.push_back(Match{base + i, key, value});
+            return true;
+          });
+      if (ret == kHaveToAbort) return kHaveToAbort;
+    }
+  }
+
+  uint64_t found = 0;
+  uint64_t stopped_i = static_cast<uint64_t>(-1);
+  for (auto& match : matches) {
+    if (match.i == stopped_i) continue;
+    found++;
+    if (!func(match.i, match.key, match.value)) stopped_i = match.i;
+  }
+  return found;
+}
 }
 }
 
@@ -101,6 +101,28 @@ void BTreeIndex<StaticConfig, HasValue, Key, Compare>::prefetch_node(
   (void)node;
 }
 
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::subtree_count(
+    const Node* node_b) {
+  if (is_leaf(node_b)) return node_b->count;
+
+  auto node = as_internal(node_b);
+  uint64_t count = 0;
+  for (size_t i = 0; i < static_cast<size_t>(node->count) + 1; i++)
+    count += node->child_count(i);
+  return count;
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::subtree_count(
+    Transaction* tx, uint64_t row_id) const {
+  // The node may have been written by the transaction, whose version is used.
+  RowAccessHandle rah(tx);
+  auto node_b = get_node(rah, row_id);
+  if (!node_b) return kHaveToAbort;
+  return subtree_count(node_b);
+}
+
 template <class StaticConfig, bool HasValue, class Key, class Compare>
 bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::is_internal(
     const Node* node) {
@@ -150,7 +172,9 @@ int BTreeIndex<StaticConfig, HasValue, Key, Compare>::search_leftmost(
   int left = 0;
   int right = node->count;
   if (kUseBinarySearch)
-    while (left + kBinarySearchThreshold <= right) {
+    while (left + (kUseSIMDSearch ? kSIMDSearchThreshold
+                                  : kBinarySearchThreshold) <=
+           right) {
       int mid = (left + right) >> 1;
       bool result;
       if (Exclusive)
@@ -163,6 +187,16 @@ int BTreeIndex<StaticConfig, HasValue, Key, Compare>::search_leftmost(
         left = mid + 1;  // Inspect the right partition excluding mid.
     }
 
+  if (kUseSIMDSearch) {
+    // Skip the keys that do not satisfy the condition.
+    if (Exclusive)
+      return right - BTreeSIMDSearch<Key>::template count<true>(
+                         node->keys + left, right - left, key);
+    else
+      return left + BTreeSIMDSearch<Key>::template count<false>(
+                        node->keys + left, right - left, key);
+  }
+
   if (Exclusive) {
     for (; left < right; left++)
       if (comp_lt(key, node->key(left))) break;
@@ -181,7 +215,9 @@ int BTreeIndex<StaticConfig, HasValue, Key, Compare>::search_rightmost(
   int left = -1;
   int right = node->count - 1;
   if (kUseBinarySearch)
-    while (left + kBinarySearchThreshold <= right) {
+    while (left + (kUseSIMDSearch ? kSIMDSearchThreshold
+                                  : kBinarySearchThreshold) <=
+           right) {
       int mid = (left + right + 1) >> 1;
       bool result;
       if (Exclusive)
@@ -194,6 +230,16 @@ int BTreeIndex<StaticConfig, HasValue, Key, Compare>::search_rightmost(
         right = mid - 1;  // Inspect the left partition excluding mid.
     }
 
+  if (kUseSIMDSearch) {
+    // Take the keys in (left, right] that satisfy the condition.
+    if (Exclusive)
+      return left + BTreeSIMDSearch<Key>::template count<false>(
+                        node->keys + left + 1, right - left, key);
+    else
+      return right - BTreeSIMDSearch<Key>::template count<true>(
+                         node->keys + left + 1, right - left, key);
+  }
+
   if (Exclusive) {
     for (; right > left; right--)
       if (comp_lt(node->key(right), key)) break;
@@ -0,0 +1,207 @@
+#pragma once
+#ifndef MICA_TRANSACTION_BTREE_INDEX_IMPL_RANK_H_
+#define MICA_TRANSACTION_BTREE_INDEX_IMPL_RANK_H_
+
+namespace mica {
+namespace transaction {
+// Order statistics descend a single path using the subtree counts of internal
+// nodes.  Unlike lookups, they do not fix up nodes because a parent's counts
+// only describe the children it points to; instead, every node used is
+// validated so that the transaction aborts if the path has changed.  Inserts
+// and removes write all nodes on their path when the counts are kept.
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+template <BTreeRangeType LeftRangeType, BTreeRangeType RightRangeType>
+uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::count_range(
+    Transaction* tx, const Key& min_key, const Key& max_key,
+    bool skip_validation) {
+  static_assert(kUseSubtreeCounts,
+                "BTreeIndex::count_range() requires kBTreeSubtreeCounts");
+  Timing t(tx->context()->timing_stack(), &Stats::index_read);
+
+  // The number of keys that are not beyond the right end.
+  uint64_t upper;
+  if (RightRangeType == BTreeRangeType::kOpen)
+    upper = count_up_to<false, true>(tx, max_key, skip_validation);
+  else if (RightRangeType == BTreeRangeType::kInclusive)
+    upper = count_up_to<true, false>(tx, max_key, skip_validation);
+  else /* if (RightRangeType == BTreeRangeType::kExclusive) */
+    upper = count_up_to<false, false>(tx, max_key, skip_validation);
+  if (upper == kHaveToAbort) return kHaveToAbort;
+
+  // The number of keys that are beyond the left end.
+  uint64_t lower;
+  if (LeftRangeType == BTreeRangeType::kOpen)
+    lower = 0;
+  else if (LeftRangeType == BTreeRangeType::kInclusive)
+    lower = count_up_to<false, false>(tx, min_key, skip_validation);
+  else /* if (LeftRangeType == BTreeRangeType::kExclusive) */
+    lower = count_up_to<true, false>(tx, min_key, skip_validation);
+  if (lower == kHaveToAbort) return kHaveToAbort;
+
+  // The range is empty if min_key > max_key.
+  return upper > lower ? upper - lower : 0;
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::rank(
+    Transaction* tx, const Key& key, bool skip_validation) {
+  static_assert(kUseSubtreeCounts,
+                "BTreeIndex::rank() requires kBTreeSubtreeCounts");
+  Timing t(tx->context()->timing_stack(), &Stats::index_read);
+
+  return count_up_to<false, false>(tx, key, skip_validation);
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+template <typename Func>
+uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::select(
+    Transaction* tx, uint64_t k, bool skip_validation, const Func& func) {
+  static_assert(kUseSubtreeCounts,
+                "BTreeIndex::select() requires kBTreeSubtreeCounts");
+  Timing t(tx->context()->timing_stack(), &Stats::index_read);
+
+  if (skip_validation) {
+    RowAccessHandlePeekOnly rah_head(tx);
+    auto head = as_internal(get_node(rah_head, 0));
+    if (!head) return kHaveToAbort;
+
+    RowAccessHandlePeekOnly rah(tx);
+    auto root_b = get_node(rah, head->child_row_id(0));
+    if (!root_b) return kHaveToAbort;
+
+    return select_recursive(tx, rah, root_b, k, true, skip_validation, func);
+  } else {
+    RowAccessHandle rah_head(tx);
+    auto head = as_internal(get_node(rah_head, 0));
+    if (!head) return kHaveToAbort;
+
+    RowAccessHandle rah(tx);
+    auto root_b = get_node(rah, head->child_row_id(0));
+    if (!root_b) return kHaveToAbort;
+
+    return select_recursive(tx, rah, root_b, k, true, skip_validation, func);
+  }
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+template <bool Inclusive, bool Open>
+uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::count_up_to(
+    Transaction* tx, const Key& key, bool skip_validation) {
+  if (skip_validation) {
+    RowAccessHandlePeekOnly rah_head(tx);
+    auto head = as_internal(get_node(rah_head, 0));
+    if (!head) return kHaveToAbort;
+
+    RowAccessHandlePeekOnly rah(tx);
+    auto root_b = get_node(rah, head->child_row_id(0));
+    if (!root_b) return kHaveToAbort;
+
+    return count_recursive<Inclusive, Open>(tx, rah, root_b, key,
+                                            skip_validation);
+  } else {
+    RowAccessHandle rah_head(tx);
+    auto head = as_internal(get_node(rah_head, 0));
+    if (!head) return kHaveToAbort;
+
+    RowAccessHandle rah(tx);
+    auto root_b = get_node(rah, head->child_row_id(0));
+    if (!root_b) return kHaveToAbort;
+
+    return count_recursive<Inclusive, Open>(tx, rah, root_b, key,
+                                            skip_validation);
+  }
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+template <bool Inclusive, bool Open, typename RowAccessHandleT>
+uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::count_recursive(
+    Transaction* tx, RowAccessHandleT& rah, const Node* node_b, const Key& key,
+    bool skip_validation) {
+  if (!skip_validation) {
+    // Internal nodes need validation too because their counts are used.
+    if (!validate_read(rah)) return kHaveToAbort;
+  }
+
+  if (is_internal(node_b)) {
+    auto node = as_internal(node_b);
+
+    // Find the child that may have both matching and non-matching keys.
+    // Every key in the children before it matches.
+    size_t j;
+    if (Open)
+      j = node->count;
+    else
+      j = static_cast<size_t>(search_leftmost<true>(node, key));
+
+    uint64_t count = 0;
+    for (size_t i = 0; i < j; i++) count += node->child_count(i);
+
+    RowAccessHandleT rah_child(tx);
+    auto child_b = get_node(rah_child, node->child_row_id(j));
+    if (!child_b) return kHaveToAbort;
+
+    auto ret = count_recursive<Inclusive, Open>(tx, rah_child, child_b, key,
+                                                skip_validation);
+    if (ret == kHaveToAbort) return kHaveToAbort;
+    return count + ret;
+  } else {
+    auto node = as_leaf(node_b);
+
+    if (Open)
+      return node->count;
+    else if (Inclusive)
+      return static_cast<uint64_t>(search_leftmost<true>(node, key));
+    else
+      return static_cast<uint64_t>(search_leftmost<false>(node, key));
+  }
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+template <typename Func, typename RowAccessHandleT>
+uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::select_recursive(
+    Transaction* tx, RowAccessHandleT& rah, const Node* node_b, uint64_t k,
+    bool is_root, bool skip_validation, const Func& func) {
+  if (!skip_validation) {
+    if (!validate_read(rah)) return kHaveToAbort;
+  }
+
+  if (is_internal(node_b)) {
+    auto node = as_internal(node_b);
+
+    size_t j;
+    for (j = 0; j < static_cast<size_t>(node->count) + 1; j++) {
+      if (k < node->child_count(j)) break;
+      k -= node->child_count(j);
+    }
+    if (j == static_cast<size_t>(node->count) + 1) {
+      // A child has fewer keys than its parent counted if we are seeing an
+      // inconsistent state.
+      return is_root ? 0 : kHaveToAbort;
+    }
+
+    RowAccessHandleT rah_child(tx);
+    auto child_b = get_node(rah_child, node->child_row_id(j));
+    if (!child_b) return kHaveToAbort;
+
+    return select_recursive(tx, rah_child, child_b, k, false, skip_validation,
+                            func);
+  } else {
+    auto node = as_leaf(node_b);
+
+    if (k >= node->count) return is_root ? 0 : kHaveToAbort;
+
+    uint64_t value;
+    if (HasValue)
+      value = node->value(k);
+    else
+      value = 0;
+
+    func(node->key(k), value);
+    return 1;
+  }
+}
+}
+}
+
+#endif
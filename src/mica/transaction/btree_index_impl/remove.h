@@ -21,6 +21,9 @@ uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::remove(
   auto root_b =
       get_node_with_fixup<false, false>(rah_root, head->child_row_id(0), key);
   if (!root_b) return kHaveToAbort;
+  // Subtree counts require the nodes on the path to be consistent.
+  if (kUseSubtreeCounts && rah_root.row_id() != head->child_row_id(0))
+    return kHaveToAbort;
 
   bool up_rebalancing_from_child = false;
   auto ret = remove_recursive(tx, rah_root, root_b, key, value,
@@ -94,6 +97,8 @@ uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::remove_recursive(
     auto child_b =
         get_node_with_fixup<false, false>(rah_child, child_row_id, key);
     if (!child_b) return kHaveToAbort;
+    if (kUseSubtreeCounts && rah_child.row_id() != child_row_id)
+      return kHaveToAbort;
     child_row_id = rah_child.row_id();
 
     bool up_rebalancing_from_child = false;
@@ -101,6 +106,13 @@ uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::remove_recursive(
                            &up_rebalancing_from_child);
     if (ret == kHaveToAbort) return kHaveToAbort;
 
+    if (kUseSubtreeCounts && ret == 1) {
+      auto wnode = as_internal(get_writable_node(rah));
+      if (!wnode) return kHaveToAbort;
+      wnode->child_count(j)--;
+      node = wnode;
+    }
+
     if (up_rebalancing_from_child) {
       if ((kVerbose & VerboseFlag::kRemove))
         printf("BTreeIndex::remove_recursive(): key=%" PRIu64
@@ -268,6 +280,9 @@ bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::rebalance(
         parent->keys[parent->indir[j]] = parent->keys[parent->count - 1];
         parent->child_row_ids[parent->indir[j] + 1] =
             parent->child_row_ids[parent->count - 1 + 1];
+        if (kUseSubtreeCounts)
+          parent->child_counts[parent->indir[j] + 1] =
+              parent->child_counts[parent->count - 1 + 1];
         parent->indir[fill_in] = parent->indir[j];
       }
       if (j != static_cast<size_t>(parent->count) - 1)
@@ -286,8 +301,13 @@ bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::rebalance(
       ::mica::util::memmove(
           parent->child_row_ids + j + 1, parent->child_row_ids + j + 2,
           sizeof(uint64_t) * (static_cast<size_t>(parent->count) - j - 1));
+      if (kUseSubtreeCounts)
+        ::mica::util::memmove(
+            parent->child_counts + j + 1, parent->child_counts + j + 2,
+            sizeof(uint64_t) * (static_cast<size_t>(parent->count) - j - 1));
     }
     parent->count--;
+    if (kUseSubtreeCounts) parent->child_count(j) = subtree_count(left_b);
 
     // This merge has made the parent node have too few keys.
     // Perform rebalancing in the grandparent node recursively.
@@ -299,6 +319,11 @@ bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::rebalance(
   } else {
     // Fix the split key.
     parent->key(j) = *left_max_key;
+    if (kUseSubtreeCounts) {
+      parent->child_count(j) = subtree_count(left_b);
+      parent->child_count(k) =
+          subtree_count(reinterpret_cast<const Node*>(rah_right.cdata()));
+    }
 
     if ((kVerbose & VerboseFlag::kRemove)) dump_node(rah_parent, parent);
 
@@ -0,0 +1,265 @@
+#pragma once
+#ifndef MICA_TRANSACTION_BTREE_INDEX_IMPL_SCAN_H_
+#define MICA_TRANSACTION_BTREE_INDEX_IMPL_SCAN_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+BTreeIndex<StaticConfig, HasValue, Key, Compare>::Scanner::Scanner(
+    BTreeIndex* idx, Transaction* tx, BTreeRangeType left_type,
+    const Key& min_key, BTreeRangeType right_type, const Key& max_key,
+    bool reversed, bool skip_validation)
+    : idx_(idx),
+      tx_(tx),
+      left_type_(left_type),
+      min_key_(min_key),
+      right_type_(right_type),
+      max_key_(max_key),
+      reversed_(reversed),
+      skip_validation_(skip_validation),
+      offset_(0),
+      limit_(kNoLimit),
+      prefetch_rows_(false),
+      rah_(tx),
+      rah_peek_(tx),
+      node_(nullptr),
+      started_(false) {
+  cursor_.has_last_key = false;
+  cursor_.last_key = Key{};
+  cursor_.end = false;
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+void BTreeIndex<StaticConfig, HasValue, Key, Compare>::Scanner::resume(
+    const ScanCursor& cursor) {
+  assert(!started_);
+
+  cursor_ = cursor;
+  if (!cursor.has_last_key) return;
+
+  // Keys are unique in the tree, so the scan continues right after the last
+  // key.
+  if (!reversed_) {
+    left_type_ = BTreeRangeType::kExclusive;
+    min_key_ = cursor.last_key;
+  } else {
+    right_type_ = BTreeRangeType::kExclusive;
+    max_key_ = cursor.last_key;
+  }
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::Scanner::next(
+    ScanSlice* slice) {
+  if (skip_validation_)
+    return next_slice(rah_peek_, slice);
+  else
+    return next_slice(rah_, slice);
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+template <typename RowAccessHandleT>
+uint64_t BTreeIndex<StaticConfig, HasValue, Key, Compare>::Scanner::next_slice(
+    RowAccessHandleT& rah, ScanSlice* slice) {
+  Timing t(tx_->context()->timing_stack(), &Stats::index_read);
+
+  if (cursor_.end || limit_ == 0) return 0;
+
+  bool first_node = !started_;
+  if (first_node) {
+    started_ = true;
+    node_ = descend(rah);
+    if (!node_) return kHaveToAbort;
+  }
+
+  while (true) {
+    if (!first_node) {
+      // Move to the sibling of the node used last.
+      auto row_id = reversed_ ? node_->prev : node_->next;
+      rah.reset();
+      node_ = as_leaf(idx_->get_node(rah, row_id));
+      if (!node_) return kHaveToAbort;
+    }
+
+    // We need to track every node used for finding matches.
+    if (!skip_validation_ && !idx_->validate_read(rah)) return kHaveToAbort;
+
+    // Find the matching entries [begin, end) of the node.  Only the first node
+    // needs a search for the starting bound.  The ending bound needs a search
+    // only if the node's last entry in scan order is out of the range, and
+    // the split key to the sibling tells whether the sibling can have any
+    // matching entry without visiting it.
+    auto node = node_;
+    int count = node->count;
+    int begin;
+    int end;
+    bool last;
+    if (!reversed_) {
+      begin = first_node ? lower_pos(node) : 0;
+      if (count != 0 && !beyond_right(node->key(count - 1)))
+        end = count;
+      else
+        end = upper_pos(node);
+      last = end < count || node->next == kNullRowID ||
+             beyond_right(node->max_key);
+    } else {
+      end = first_node ? upper_pos(node) : count;
+      if (count != 0 && !beyond_left(node->key(0)))
+        begin = 0;
+      else
+        begin = lower_pos(node);
+      last = begin > 0 || node->prev == kNullRowID ||
+             (left_type_ != BTreeRangeType::kOpen &&
+              idx_->comp_le(node->min_key, min_key_));
+    }
+    if (end < begin) end = begin;
+
+    auto n = static_cast<uint64_t>(end - begin);
+
+    auto skip = std::min(offset_, n);
+    offset_ -= skip;
+    n -= skip;
+    if (!reversed_)
+      begin += static_cast<int>(skip);
+    else
+      end -= static_cast<int>(skip);
+
+    bool truncated = false;
+    if (n > limit_) {
+      truncated = true;
+      n = limit_;
+      if (!reversed_)
+        end = begin + static_cast<int>(n);
+      else
+        begin = end - static_cast<int>(n);
+    }
+    if (limit_ != kNoLimit) limit_ -= n;
+
+    if (last && !truncated) cursor_.end = true;
+
+    if (n != 0) {
+      if (kPrefetchNode && !cursor_.end && limit_ != 0) {
+        // Overlap fetching the sibling with the caller's use of this slice.
+        auto row_id = reversed_ ? node->prev : node->next;
+        tx_->prefetch_row(idx_->idx_tbl_, 0, row_id, 0, sizeof(LeafNode));
+      }
+      if (HasValue && prefetch_rows_)
+        for (auto j = begin; j < end; j++)
+          tx_->prefetch_row(idx_->main_tbl_, 0, node->value(j), 0, 0);
+
+      slice->node_ = node;
+      slice->begin_ = static_cast<uint64_t>(begin);
+      slice->size_ = n;
+      slice->reversed_ = reversed_;
+
+      cursor_.has_last_key = true;
+      cursor_.last_key = slice->key(n - 1);
+      return n;
+    }
+
+    if (cursor_.end) return 0;
+    first_node = false;
+  }
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+template <typename RowAccessHandleT>
+const typename BTreeIndex<StaticConfig, HasValue, Key, Compare>::LeafNode*
+BTreeIndex<StaticConfig, HasValue, Key, Compare>::Scanner::descend(
+    RowAccessHandleT& rah) {
+  // Find the leaf node where the scan starts in the same way as lookup().
+  auto node_b = idx_->get_node(rah, 0);
+  if (!node_b) return nullptr;
+
+  while (is_internal(node_b)) {
+    auto node = as_internal(node_b);
+
+    int j;
+    if (!reversed_) {
+      if (left_type_ == BTreeRangeType::kOpen)
+        j = 0;
+      else
+        j = idx_->template search_leftmost<true>(node, min_key_);
+    } else {
+      if (right_type_ == BTreeRangeType::kOpen)
+        j = node->count;
+      else if (right_type_ == BTreeRangeType::kInclusive)
+        j = idx_->template search_rightmost<false>(node, max_key_) + 1;
+      else /* if (right_type_ == BTreeRangeType::kExclusive) */
+        j = idx_->template search_rightmost<true>(node, max_key_) + 1;
+    }
+
+    auto child_row_id = node->child_row_id(j);
+
+    rah.reset();
+    if (!reversed_) {
+      if (left_type_ == BTreeRangeType::kOpen)
+        node_b = idx_->get_node(rah, child_row_id);
+      else
+        node_b = idx_->template get_node_with_fixup<false, false>(
+            rah, child_row_id, min_key_);
+    } else {
+      if (right_type_ == BTreeRangeType::kOpen)
+        node_b = idx_->template get_node_with_fixup<true, false>(
+            rah, child_row_id, max_key_);
+      else if (right_type_ == BTreeRangeType::kInclusive)
+        node_b = idx_->template get_node_with_fixup<false, false>(
+            rah, child_row_id, max_key_);
+      else /* if (right_type_ == BTreeRangeType::kExclusive) */
+        node_b = idx_->template get_node_with_fixup<false, true>(
+            rah, child_row_id, max_key_);
+    }
+    if (!node_b) return nullptr;
+  }
+  return as_leaf(node_b);
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+int BTreeIndex<StaticConfig, HasValue, Key, Compare>::Scanner::lower_pos(
+    const LeafNode* node) const {
+  // The first position that satisfies the left bound.
+  if (left_type_ == BTreeRangeType::kOpen)
+    return 0;
+  else if (left_type_ == BTreeRangeType::kInclusive)
+    return idx_->template search_leftmost<false>(node, min_key_);
+  else /* if (left_type_ == BTreeRangeType::kExclusive) */
+    return idx_->template search_leftmost<true>(node, min_key_);
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+int BTreeIndex<StaticConfig, HasValue, Key, Compare>::Scanner::upper_pos(
+    const LeafNode* node) const {
+  // One past the last position that satisfies the right bound.
+  if (right_type_ == BTreeRangeType::kOpen)
+    return node->count;
+  else if (right_type_ == BTreeRangeType::kInclusive)
+    return idx_->template search_rightmost<false>(node, max_key_) + 1;
+  else /* if (right_type_ == BTreeRangeType::kExclusive) */
+    return idx_->template search_rightmost<true>(node, max_key_) + 1;
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::Scanner::beyond_left(
+    const Key& key) const {
+  if (left_type_ == BTreeRangeType::kOpen)
+    return false;
+  else if (left_type_ == BTreeRangeType::kInclusive)
+    return idx_->comp_lt(key, min_key_);
+  else /* if (left_type_ == BTreeRangeType::kExclusive) */
+    return idx_->comp_le(key, min_key_);
+}
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+bool BTreeIndex<StaticConfig, HasValue, Key, Compare>::Scanner::beyond_right(
+    const Key& key) const {
+  if (right_type_ == BTreeRangeType::kOpen)
+    return false;
+  else if (right_type_ == BTreeRangeType::kInclusive)
+    return idx_->comp_lt(max_key_, key);
+  else /* if (right_type_ == BTreeRangeType::kExclusive) */
+    return idx_->comp_le(max_key_, key);
+}
+}
+}
+
+#endif
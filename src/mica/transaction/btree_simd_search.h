@@ -0,0 +1,151 @@
+#pragma once
+#ifndef MICA_TRANSACTION_BTREE_SIMD_SEARCH_H_
+#define MICA_TRANSACTION_BTREE_SIMD_SEARCH_H_
+
+#include <cassert>
+#include <immintrin.h>
+#include <utility>
+#include "mica/common.h"
+
+namespace mica {
+namespace transaction {
+// Vectorized compare-and-count over the sorted keys of a BTreeIndex node.
+//
+// count<false>(keys, n, key) returns the number of keys[i] < key, and
+// count<true>(keys, n, key) returns the number of keys[i] > key, for i in
+// [0, n).  Since the keys are sorted, these counts give the search position
+// without data-dependent branches.  AVX-512 is used when available, AVX2
+// otherwise; kSupported is false for other key types or CPUs.
+template <class Key>
+struct BTreeSIMDSearch {
+  static constexpr bool kSupported = false;
+
+  template <bool Greater>
+  static int count(const Key* keys, int n, const Key& key) {
+    (void)keys;
+    (void)n;
+    (void)key;
+    assert(false);
+    return 0;
+  }
+};
+
+template <>
+struct BTreeSIMDSearch<uint64_t> {
+#if defined(__AVX512F__) || defined(__AVX2__)
+  static constexpr bool kSupported = true;
+#else
+  static constexpr bool kSupported = false;
+#endif
+
+  template <bool Greater>
+  static int count(const uint64_t* keys, int n, uint64_t key) {
+    int c = 0;
+    int i = 0;
+#if defined(__AVX512F__)
+    __m512i k = _mm512_set1_epi64(static_cast<long long>(key));
+    for (; i + 8 <= n; i += 8) {
+      __m512i v = _mm512_loadu_si512(keys + i);
+      c += __builtin_popcount(Greater ? _mm512_cmpgt_epu64_mask(v, k)
+                                      : _mm512_cmplt_epu64_mask(v, k));
+    }
+    if (i < n) {
+      auto m = static_cast<__mmask8>((1U << (n - i)) - 1);
+      __m512i v = _mm512_maskz_loadu_epi64(m, keys + i);
+      c += __builtin_popcount(Greater ? _mm512_mask_cmpgt_epu64_mask(m, v, k)
+                                      : _mm512_mask_cmplt_epu64_mask(m, v, k));
+      i = n;
+    }
+#elif defined(__AVX2__)
+    // AVX2 only has signed comparisons; flip the sign bits to compare
+    // unsigned integers.
+    const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(1ULL << 63));
+    __m256i k = _mm256_xor_si256(
+        _mm256_set1_epi64x(static_cast<long long>(key)), sign);
+    for (; i + 4 <= n; i += 4) {
+      __m256i v = _mm256_xor_si256(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)),
+          sign);
+      __m256i r = Greater ? _mm256_cmpgt_epi64(v, k) : _mm256_cmpgt_epi64(k, v);
+      c += __builtin_popcount(
+          static_cast<unsigned int>(_mm256_movemask_pd(_mm256_castsi256_pd(r))));
+    }
+#endif
+    for (; i < n; i++) c += Greater ? (keys[i] > key) : (keys[i] < key);
+    return c;
+  }
+};
+
+template <>
+struct BTreeSIMDSearch<std::pair<uint64_t, uint64_t>> {
+  typedef std::pair<uint64_t, uint64_t> Key;
+  static_assert(sizeof(Key) == 16, "unexpected pair layout");
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+  static constexpr bool kSupported = true;
+#else
+  static constexpr bool kSupported = false;
+#endif
+
+  // Lane 2 * j holds keys[j].first and lane 2 * j + 1 holds keys[j].second.
+  // keys[j] < key iff (first < key.first) or (first == key.first and
+  // second < key.second); the result is taken from the even bits.
+  static unsigned int combine(unsigned int cmp, unsigned int eq,
+                              unsigned int even) {
+    return (cmp | (eq & (cmp >> 1))) & even;
+  }
+
+  template <bool Greater>
+  static int count(const Key* keys, int n, const Key& key) {
+    int c = 0;
+    int i = 0;
+#if defined(__AVX512F__)
+    __m512i k = _mm512_set_epi64(
+        static_cast<long long>(key.second), static_cast<long long>(key.first),
+        static_cast<long long>(key.second), static_cast<long long>(key.first),
+        static_cast<long long>(key.second), static_cast<long long>(key.first),
+        static_cast<long long>(key.second), static_cast<long long>(key.first));
+    for (; i + 4 <= n; i += 4) {
+      __m512i v = _mm512_loadu_si512(keys + i);
+      unsigned int cmp = Greater ? _mm512_cmpgt_epu64_mask(v, k)
+                                 : _mm512_cmplt_epu64_mask(v, k);
+      unsigned int eq = _mm512_cmpeq_epu64_mask(v, k);
+      c += __builtin_popcount(combine(cmp, eq, 0x55));
+    }
+    if (i < n) {
+      auto m = static_cast<__mmask8>((1U << (2 * (n - i))) - 1);
+      __m512i v = _mm512_maskz_loadu_epi64(m, keys + i);
+      unsigned int cmp = Greater ? _mm512_mask_cmpgt_epu64_mask(m, v, k)
+                                 : _mm512_mask_cmplt_epu64_mask(m, v, k);
+      unsigned int eq = _mm512_mask_cmpeq_epu64_mask(m, v, k);
+      c += __builtin_popcount(combine(cmp, eq, 0x55));
+      i = n;
+    }
+#elif defined(__AVX2__)
+    const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(1ULL << 63));
+    __m256i k = _mm256_xor_si256(
+        _mm256_set_epi64x(static_cast<long long>(key.second),
+                          static_cast<long long>(key.first),
+                          static_cast<long long>(key.second),
+                          static_cast<long long>(key.first)),
+        sign);
+    for (; i + 2 <= n; i += 2) {
+      __m256i v = _mm256_xor_si256(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)),
+          sign);
+      __m256i r = Greater ? _mm256_cmpgt_epi64(v, k) : _mm256_cmpgt_epi64(k, v);
+      auto cmp = static_cast<unsigned int>(
+          _mm256_movemask_pd(_mm256_castsi256_pd(r)));
+      auto eq = static_cast<unsigned int>(_mm256_movemask_pd(
+          _mm256_castsi256_pd(_mm256_cmpeq_epi64(v, k))));
+      c += __builtin_popcount(combine(cmp, eq, 0x5));
+    }
+#endif
+    for (; i < n; i++) c += Greater ? (key < keys[i]) : (keys[i] < key);
+    return c;
+  }
+};
+}
+}
+
+#endif
@@ -0,0 +1,124 @@
+#pragma once
+#ifndef MICA_TRANSACTION_BTREE_STRING_KEY_H_
+#define MICA_TRANSACTION_BTREE_STRING_KEY_H_
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include "mica/common.h"
+
+namespace mica {
+namespace transaction {
+// A byte-string key of up to MaxLength bytes for BTreeIndex.
+//
+// Keys are ordered like memcmp() with a shorter key ordered first when it is a
+// prefix of the other key.  The first 8 bytes are kept as a big-endian integer
+// so that most comparisons in a node are decided by a single integer
+// comparison without touching the rest of the key.  The unused bytes are kept
+// zero so that a key can be copied and compared as a fixed-size POD.
+//
+// Composite keys are built by appending fields; append_u64() encodes an
+// integer in big-endian so that the byte order matches the integer order.
+template <size_t MaxLength>
+struct BTreeStringKey {
+  static_assert(MaxLength >= 8 && MaxLength <= 255, "invalid max key length");
+  static constexpr size_t kMaxLength = MaxLength;
+  static constexpr size_t kPrefixLength = 8;
+
+  uint64_t prefix;
+  char suffix[MaxLength - kPrefixLength];
+  uint8_t len;
+
+  size_t length() const { return len; }
+
+  uint8_t at(size_t i) const {
+    if (i < kPrefixLength)
+      return static_cast<uint8_t>(prefix >> (56 - 8 * i));
+    else
+      return static_cast<uint8_t>(suffix[i - kPrefixLength]);
+  }
+
+  void clear() { *this = BTreeStringKey{}; }
+
+  // Returns false without changing the key if the result is too long.
+  bool append(const void* data, size_t size) {
+    if (static_cast<size_t>(len) + size > MaxLength) return false;
+    auto p = reinterpret_cast<const uint8_t*>(data);
+    size_t i = 0;
+    for (; i < size && len < kPrefixLength; i++, len++)
+      prefix |= static_cast<uint64_t>(p[i]) << (56 - 8 * len);
+    if (i < size) {
+      ::memcpy(suffix + (len - kPrefixLength), p + i, size - i);
+      len = static_cast<uint8_t>(len + (size - i));
+    }
+    return true;
+  }
+  bool append(const std::string& s) { return append(s.data(), s.size()); }
+
+  bool append_u64(uint64_t v) {
+    uint8_t buf[8];
+    for (size_t i = 0; i < 8; i++)
+      buf[i] = static_cast<uint8_t>(v >> (56 - 8 * i));
+    return append(buf, sizeof(buf));
+  }
+
+  // Keeps only the first new_len bytes.
+  void truncate(size_t new_len) {
+    if (new_len >= len) return;
+    if (new_len < kPrefixLength) {
+      prefix = new_len == 0 ? 0 : prefix & (~uint64_t(0) << (64 - 8 * new_len));
+      ::memset(suffix, 0, sizeof(suffix));
+    } else
+      ::memset(suffix + (new_len - kPrefixLength), 0, len - new_len);
+    len = static_cast<uint8_t>(new_len);
+  }
+
+  std::string str() const {
+    std::string s(len, '\0');
+    for (size_t i = 0; i < len; i++) s[i] = static_cast<char>(at(i));
+    return s;
+  }
+
+  bool operator<(const BTreeStringKey& o) const {
+    if (prefix != o.prefix) return prefix < o.prefix;
+    size_t min_len = len < o.len ? len : o.len;
+    if (min_len > kPrefixLength) {
+      int r = ::memcmp(suffix, o.suffix, min_len - kPrefixLength);
+      if (r != 0) return r < 0;
+    }
+    return len < o.len;
+  }
+  bool operator==(const BTreeStringKey& o) const {
+    return prefix == o.prefix && len == o.len &&
+           (len <= kPrefixLength ||
+            ::memcmp(suffix, o.suffix, len - kPrefixLength) == 0);
+  }
+  bool operator!=(const BTreeStringKey& o) const { return !(*this == o); }
+};
+
+// Returns the shortest prefix of right that is larger than left.  This makes
+// split keys in internal nodes short and cheap to compare.
+template <size_t MaxLength>
+BTreeStringKey<MaxLength> btree_separator(
+    const BTreeStringKey<MaxLength>& left,
+    const BTreeStringKey<MaxLength>& right) {
+  // right cannot be a prefix of left because left < right.
+  size_t i = 0;
+  while (i < left.length() && left.at(i) == right.at(i)) i++;
+  auto sep = right;
+  sep.truncate(i + 1);
+  return sep;
+}
+
+// For non-unique indexes.  The row ID part is not needed if the keys differ.
+template <size_t MaxLength>
+std::pair<BTreeStringKey<MaxLength>, uint64_t> btree_separator(
+    const std::pair<BTreeStringKey<MaxLength>, uint64_t>& left,
+    const std::pair<BTreeStringKey<MaxLength>, uint64_t>& right) {
+  if (left.first == right.first) return right;
+  return std::make_pair(btree_separator(left.first, right.first), uint64_t(0));
+}
+}
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef MICA_TRANSACTION_BULK_LOADER_H_
+#define MICA_TRANSACTION_BULK_LOADER_H_
+
+#include "mica/common.h"
+#include "mica/transaction/db.h"
+
+namespace mica {
+namespace transaction {
+// Loads an initial dataset without going through transactions.
+//
+// Loading threads create rows whose first versions are installed as committed
+// directly, as Recovery does, so loading involves no validation or contention
+// between threads.  Each loading thread uses the context of its thread ID,
+// which allocates rows from its own pages and row versions from its own pool.
+// Index entries are collected by the loading threads and added to an index
+// afterward by a partitioned build (e.g., HashIndex::bulk_load()).
+//
+// No thread may be active while a BulkLoader is used; indexes must have been
+// initialized with init() beforehand.  Loaded rows are not logged, so a
+// checkpoint should be taken after loading if the dataset must be durable.
+template <class StaticConfig>
+class BulkLoader {
+ public:
+  typedef typename StaticConfig::Timestamp Timestamp;
+
+  static constexpr uint64_t kNewRowID = static_cast<uint64_t>(-1);
+  static constexpr uint64_t kNullRowID = static_cast<uint64_t>(-1);
+
+  // bulk_loader_impl.h
+  BulkLoader(DB<StaticConfig>* db, uint16_t num_threads);
+
+  // Runs func(thread_id) on num_threads threads (with contexts 0 to
+  // num_threads - 1) and waits for them.  Returns false if any call returns
+  // false.
+  template <typename Func>
+  bool run(const Func& func);
+
+  // Creates a row that has a committed version of data_size bytes and
+  // returns its row ID, or kNullRowID if memory is exhausted.  A new row ID is
+  // allocated for column family 0 (row_id must be kNewRowID); other column
+  // families take the row ID returned for column family 0.  The caller fills
+  // *data before loading finishes.  Only the thread with thread_id may call
+  // this.
+  uint64_t new_row(uint16_t thread_id, Table<StaticConfig>* tbl,
+                   uint16_t cf_id, uint64_t row_id, uint64_t data_size,
+                   char** data);
+
+  DB<StaticConfig>* db() { return db_; }
+  uint16_t num_threads() const { return num_threads_; }
+  // The timestamp of the loaded versions.
+  const Timestamp& ts() const { return ts_; }
+
+ private:
+  DB<StaticConfig>* db_;
+  uint16_t num_threads_;
+  Timestamp ts_;
+};
+}
+}
+
+#include "bulk_loader_impl.h"
+
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+#ifndef MICA_TRANSACTION_BULK_LOADER_IMPL_H_
+#define MICA_TRANSACTION_BULK_LOADER_IMPL_H_
+
+#include <thread>
+#include "mica/util/lcore.h"
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+BulkLoader<StaticConfig>::BulkLoader(DB<StaticConfig>* db,
+                                     uint16_t num_threads)
+    : db_(db), num_threads_(num_threads) {
+  assert(num_threads > 0 && num_threads <= db_->thread_count());
+  assert(db_->active_thread_count() == 0);
+
+  // Make transactions started after loading see the loaded versions.
+  ts_ = db_->min_wts();
+  db_->advance_clock(ts_);
+}
+
+template <class StaticConfig>
+template <typename Func>
+bool BulkLoader<StaticConfig>::run(const Func& func) {
+  assert(db_->active_thread_count() == 0);
+
+  std::vector<char> succeeded(num_threads_);
+  std::vector<std::thread> threads;
+  for (uint16_t thread_id = 0; thread_id < num_threads_; thread_id++) {
+    threads.emplace_back([&, thread_id] {
+      ::mica::util::lcore.pin_thread(thread_id);
+      succeeded[thread_id] = func(thread_id);
+    });
+  }
+  while (threads.size() > 0) {
+    threads.back().join();
+    threads.pop_back();
+  }
+
+  for (auto ok : succeeded)
+    if (!ok) return false;
+  return true;
+}
+
+template <class StaticConfig>
+uint64_t BulkLoader<StaticConfig>::new_row(uint16_t thread_id,
+                                           Table<StaticConfig>* tbl,
+                                           uint16_t cf_id, uint64_t row_id,
+                                           uint64_t data_size, char** data) {
+  assert(thread_id < num_threads_);
+  assert(cf_id < tbl->cf_count());
+  assert((cf_id == 0) == (row_id == kNewRowID));
+
+  auto ctx = db_->context(thread_id);
+  if (cf_id == 0) {
+    // This also initializes the GC information of the row.
+    row_id = ctx->allocate_row(tbl);
+    if (row_id == kNullRowID) return kNullRowID;
+  }
+
+  auto head = tbl->head(cf_id, row_id);
+  assert(head->older_rv == nullptr);
+
+  auto rv =
+      ctx->allocate_version_for_new_row(tbl, cf_id, row_id, head, data_size);
+  if (rv == nullptr) {
+    // Not enough memory.
+    if (cf_id == 0) ctx->deallocate_row(tbl, row_id);
+    return kNullRowID;
+  }
+
+  rv->older_rv = nullptr;
+  rv->wts = ts_;
+  rv->rts.init(ts_);
+  rv->status = RowVersionStatus::kCommitted;
+
+  head->older_rv = rv;
+
+  if (StaticConfig::kTrackDirtyPages) tbl->mark_dirty(row_id);
+
+  *data = rv->data;
+  return row_id;
+}
+}
+}
+
+#endif
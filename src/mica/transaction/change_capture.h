@@ -0,0 +1,108 @@
+#pragma once
+#ifndef MICA_TRANSACTION_CHANGE_CAPTURE_H_
+#define MICA_TRANSACTION_CHANGE_CAPTURE_H_
+
+#include <vector>
+#include "mica/common.h"
+#include "mica/transaction/db.h"
+#include "mica/transaction/logging.h"
+
+namespace mica {
+namespace transaction {
+enum class ChangeOp : uint8_t {
+  kInsert = 0,
+  kUpdate,
+  kDelete,
+};
+
+// A committed change of a row.  data_size bytes of the new row data (none for
+// kDelete) follow this in the ring, padded to a multiple of 8 bytes.
+template <class StaticConfig>
+struct ChangeRecord {
+  typename StaticConfig::Timestamp ts;
+  uint64_t row_id;
+  uint32_t data_size;
+  uint16_t table_id;
+  uint16_t cf_id;
+  ChangeOp op;
+  uint8_t last;  // The last change of the transaction.
+  uint8_t reserved[6];
+};
+
+// Change data capture.  Used as the logger of DB, it publishes the changes of
+// each committing transaction into a single-producer single-consumer ring of
+// the committing thread, and passes the transaction on to BaseLogger (if
+// given) for durability.  The commit path takes no locks.
+//
+// A transaction whose changes do not fit in the free space of the ring still
+// commits, but its changes are dropped and counted in dropped_tx_count().
+// Aborting it instead would fail every write while the consumer falls behind
+// (or forever without a consumer), and waiting for space could stall the
+// consumer itself, which needs DB::min_wts() to advance past the waiting
+// commit.  A consumer that sees dropped_tx_count() increase has missed
+// changes and must resynchronize, e.g., from a checkpoint.
+//
+// A single consumer calls poll() to merge the rings.  Each ring is in
+// timestamp order because a thread commits in timestamp order, and any
+// transaction earlier than DB::min_wts() has finished committing, so poll()
+// emits the transactions earlier than min_wts in timestamp order across
+// threads.  Consumers in other processes can be fed by copying the emitted
+// changes to shared memory.
+template <class StaticConfig, class BaseLogger = NullLogger<StaticConfig>>
+class ChangeCapture : public LoggerInterface<StaticConfig> {
+ public:
+  typedef typename StaticConfig::Timestamp Timestamp;
+
+  // change_capture_impl.h
+  ChangeCapture(BaseLogger* base_logger = nullptr,
+                uint64_t ring_size = 16 * 1048576);
+  ~ChangeCapture();
+
+  bool log(const Transaction<StaticConfig>* tx);
+  bool sync(uint16_t thread_id);
+
+  // Calls f(const ChangeRecord<StaticConfig>& rec, const char* data) for the
+  // changes of up to max_tx_count transactions that are earlier than
+  // db->min_wts(), in timestamp order.  Returns the number of transactions.
+  // Must not be called concurrently.
+  template <class Func>
+  uint64_t poll(DB<StaticConfig>* db, const Func& f,
+                uint64_t max_tx_count = static_cast<uint64_t>(-1));
+
+  // The number of bytes of a thread's ring that are not consumed yet.
+  uint64_t pending_size(uint16_t thread_id) const {
+    return rings_[thread_id].tail - rings_[thread_id].head;
+  }
+
+  // The number of committed transactions of a thread whose changes have been
+  // dropped because its ring was full.
+  uint64_t dropped_tx_count(uint16_t thread_id) const {
+    return rings_[thread_id].dropped_tx_count;
+  }
+
+ private:
+  void write_ring(uint16_t thread_id, uint64_t off, const void* src,
+                  uint64_t len);
+  void read_ring(uint16_t thread_id, uint64_t off, void* dest, uint64_t len);
+
+  struct Ring {
+    char* buf;  // Allocated by the producer thread.
+    volatile uint64_t tail __attribute__((aligned(64)));  // Producer.
+    volatile uint64_t dropped_tx_count;                    // Producer.
+    volatile uint64_t head __attribute__((aligned(64)));  // Consumer.
+  } __attribute__((aligned(64)));
+
+  BaseLogger* base_logger_;
+  uint64_t ring_size_;
+  uint64_t ring_size_mask_;
+
+  Ring rings_[StaticConfig::kMaxLCoreCount];
+
+  std::vector<char> data_buf_;
+};
+}
+}
+
+#include "change_capture_impl.h"
+
+#endif
@@ -0,0 +1,207 @@
+#pragma once
+#ifndef MICA_TRANSACTION_CHANGE_CAPTURE_IMPL_H_
+#define MICA_TRANSACTION_CHANGE_CAPTURE_IMPL_H_
+
+#include <algorithm>
+#include "mica/util/barrier.h"
+#include "mica/util/memcpy.h"
+#include "mica/util/roundup.h"
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig, class BaseLogger>
+ChangeCapture<StaticConfig, BaseLogger>::ChangeCapture(BaseLogger* base_logger,
+                                                       uint64_t ring_size)
+    : base_logger_(base_logger) {
+  ring_size_ = ::mica::util::next_power_of_two(ring_size);
+  ring_size_mask_ = ring_size_ - 1;
+
+  for (size_t thread_id = 0; thread_id < StaticConfig::kMaxLCoreCount;
+       thread_id++) {
+    auto& r = rings_[thread_id];
+    r.buf = nullptr;
+    r.tail = 0;
+    r.dropped_tx_count = 0;
+    r.head = 0;
+  }
+}
+
+template <class StaticConfig, class BaseLogger>
+ChangeCapture<StaticConfig, BaseLogger>::~ChangeCapture() {
+  for (size_t thread_id = 0; thread_id < StaticConfig::kMaxLCoreCount;
+       thread_id++)
+    delete[] rings_[thread_id].buf;
+}
+
+template <class StaticConfig, class BaseLogger>
+void ChangeCapture<StaticConfig, BaseLogger>::write_ring(uint16_t thread_id,
+                                                         uint64_t off,
+                                                         const void* src,
+                                                         uint64_t len) {
+  auto& r = rings_[thread_id];
+  auto pos = off & ring_size_mask_;
+  auto len1 = std::min(len, ring_size_ - pos);
+  auto p = reinterpret_cast<const char*>(src);
+  ::mica::util::memcpy(r.buf + pos, p, len1);
+  if (len1 != len) ::mica::util::memcpy(r.buf, p + len1, len - len1);
+}
+
+template <class StaticConfig, class BaseLogger>
+void ChangeCapture<StaticConfig, BaseLogger>::read_ring(uint16_t thread_id,
+                                                        uint64_t off,
+                                                        void* dest,
+                                                        uint64_t len) {
+  auto& r = rings_[thread_id];
+  auto pos = off & ring_size_mask_;
+  auto len1 = std::min(len, ring_size_ - pos);
+  auto p = reinterpret_cast<char*>(dest);
+  ::mica::util::memcpy(p, r.buf + pos, len1);
+  if (len1 != len) ::mica::util::memcpy(p + len1, r.buf, len - len1);
+}
+
+template <class StaticConfig, class BaseLogger>
+bool ChangeCapture<StaticConfig, BaseLogger>::log(
+    const Transaction<StaticConfig>* tx) {
+  if (tx->wset_size() == 0 && tx->iset_size() == 0)
+    return base_logger_ == nullptr || base_logger_->log(tx);
+
+  auto thread_id = tx->context()->thread_id();
+  auto& r = rings_[thread_id];
+  // Allocated by the owner thread so that the ring is on its NUMA node.
+  if (r.buf == nullptr) r.buf = new char[ring_size_];
+
+  auto accesses = tx->accesses();
+
+  auto get_op = [](const RowAccessItem<StaticConfig>* item) {
+    if (item->state == RowAccessState::kNew)
+      return ChangeOp::kInsert;
+    else if (item->state == RowAccessState::kDelete ||
+             item->state == RowAccessState::kReadDelete)
+      return ChangeOp::kDelete;
+    else
+      return ChangeOp::kUpdate;
+  };
+
+  auto record_size = [&get_op](const RowAccessItem<StaticConfig>* item) {
+    uint64_t data_size = 0;
+    if (get_op(item) != ChangeOp::kDelete)
+      data_size = item->write_rv->data_size;
+    return sizeof(ChangeRecord<StaticConfig>) +
+           ::mica::util::roundup<8>(data_size);
+  };
+
+  // Skip new rows that have been deleted by the same transaction.
+  uint64_t size = 0;
+  const RowAccessItem<StaticConfig>* last_item = nullptr;
+  for (auto j = 0; j < tx->wset_size(); j++) {
+    last_item = &accesses[tx->wset_idx()[j]];
+    size += record_size(last_item);
+  }
+  for (auto j = 0; j < tx->iset_size(); j++) {
+    auto item = &accesses[tx->iset_idx()[j]];
+    if (item->state == RowAccessState::kInvalid) continue;
+    last_item = item;
+    size += record_size(item);
+  }
+
+  if (base_logger_ != nullptr && !base_logger_->log(tx)) return false;
+  if (last_item == nullptr) return true;
+
+  // Drop the changes of a transaction that does not fit instead of aborting it
+  // (see ChangeCapture).
+  uint64_t tail = r.tail;
+  if (size > ring_size_ - (tail - r.head)) {
+    r.dropped_tx_count = r.dropped_tx_count + 1;
+    return true;
+  }
+
+  auto append = [&](const RowAccessItem<StaticConfig>* item) {
+    ChangeRecord<StaticConfig> rec;
+    rec.ts = tx->ts();
+    rec.row_id = item->row_id;
+    rec.table_id = item->tbl->id();
+    rec.cf_id = item->cf_id;
+    rec.op = get_op(item);
+    rec.last = item == last_item ? 1 : 0;
+    rec.data_size = rec.op == ChangeOp::kDelete ? 0 : item->write_rv->data_size;
+    write_ring(thread_id, tail, &rec, sizeof(rec));
+    if (rec.data_size != 0)
+      write_ring(thread_id, tail + sizeof(rec), item->write_rv->data,
+                 rec.data_size);
+    tail += sizeof(rec) + ::mica::util::roundup<8>(uint64_t(rec.data_size));
+  };
+
+  for (auto j = 0; j < tx->wset_size(); j++)
+    append(&accesses[tx->wset_idx()[j]]);
+  for (auto j = 0; j < tx->iset_size(); j++) {
+    auto item = &accesses[tx->iset_idx()[j]];
+    if (item->state == RowAccessState::kInvalid) continue;
+    append(item);
+  }
+
+  // Publish the changes after they are written.
+  ::mica::util::memory_barrier();
+  r.tail = tail;
+  return true;
+}
+
+template <class StaticConfig, class BaseLogger>
+bool ChangeCapture<StaticConfig, BaseLogger>::sync(uint16_t thread_id) {
+  if (base_logger_ != nullptr) return base_logger_->sync(thread_id);
+  return true;
+}
+
+template <class StaticConfig, class BaseLogger>
+template <class Func>
+uint64_t ChangeCapture<StaticConfig, BaseLogger>::poll(DB<StaticConfig>* db,
+                                                       const Func& f,
+                                                       uint64_t max_tx_count) {
+  auto watermark = db->min_wts();
+  auto thread_count = db->thread_count();
+
+  uint64_t tx_count = 0;
+  while (tx_count < max_tx_count) {
+    // Find the earliest transaction.
+    uint16_t min_thread_id = thread_count;
+    Timestamp min_ts = watermark;
+    for (uint16_t thread_id = 0; thread_id < thread_count; thread_id++) {
+      auto& r = rings_[thread_id];
+      if (r.head == r.tail) continue;
+      ::mica::util::memory_barrier();
+
+      ChangeRecord<StaticConfig> rec;
+      read_ring(thread_id, r.head, &rec, sizeof(rec));
+      if (rec.ts < min_ts) {
+        min_thread_id = thread_id;
+        min_ts = rec.ts;
+      }
+    }
+    if (min_thread_id == thread_count) break;
+
+    auto& r = rings_[min_thread_id];
+    uint64_t head = r.head;
+    while (true) {
+      ChangeRecord<StaticConfig> rec;
+      read_ring(min_thread_id, head, &rec, sizeof(rec));
+      head += sizeof(rec);
+
+      if (data_buf_.size() < rec.data_size) data_buf_.resize(rec.data_size);
+      if (rec.data_size != 0)
+        read_ring(min_thread_id, head, data_buf_.data(), rec.data_size);
+      head += ::mica::util::roundup<8>(uint64_t(rec.data_size));
+
+      f(rec, data_buf_.data());
+      if (rec.last) break;
+    }
+
+    // Free the space after the changes are read.
+    ::mica::util::memory_barrier();
+    r.head = head;
+    tx_count++;
+  }
+  return tx_count;
+}
+}
+}
+
+#endif
@@ -0,0 +1,108 @@
+#pragma once
+#ifndef MICA_TRANSACTION_CHECKPOINT_H_
+#define MICA_TRANSACTION_CHECKPOINT_H_
+
+#include <string>
+#include <vector>
+#include "mica/common.h"
+#include "mica/transaction/db.h"
+#include "mica/transaction/logging.h"
+
+namespace mica {
+namespace transaction {
+// Writes online checkpoints of all tables (including those for indexes).
+//
+// Each checkpoint thread repeatedly takes a page of a table and copies the
+// rows visible to a short peek-only transaction into its checkpoint file.
+// Using a new transaction for each page keeps the checkpoint from holding back
+// min_rts, so different pages may be taken at different snapshots.  The
+// checkpoint is thus fuzzy, but each page is written with its snapshot
+// timestamp in the log format of ParallelLogger, and recovery that keeps the
+// latest version of each row restores a consistent state when the checkpoint
+// files are replayed together with the log entries since checkpoint_ts().
+//
+// A checkpoint consists of files named path_prefix + thread index and an info
+// file named path_prefix + "info" that is written last.
+//
+// An incremental checkpoint writes only the pages that have been written since
+// the previous checkpoint started (tracked by Table::mark_dirty() when
+// StaticConfig::kTrackDirtyPages is set; a full checkpoint is taken otherwise),
+// and its info file names the previous checkpoint so that paths() returns the
+// files of the whole chain.  Rows in these pages that are not visible are
+// written as deleted records so that they are not restored from an earlier
+// checkpoint in the chain.  Pages written during the previous checkpoint are
+// included again because its per-page snapshots may have missed such writes.
+template <class StaticConfig>
+class Checkpointer {
+ public:
+  typedef typename StaticConfig::Timestamp Timestamp;
+
+  static constexpr size_t kMaxPathPrefixLength = 256;
+
+  struct Info {
+    Timestamp checkpoint_ts;
+    uint64_t file_count;
+    uint8_t incremental;
+    // The previous checkpoint in the chain if incremental.
+    char base_path_prefix[kMaxPathPrefixLength];
+  };
+
+  // checkpoint_impl.h
+  Checkpointer(DB<StaticConfig>* db);
+
+  // Writes a checkpoint using one thread for each of thread_ids.  The contexts
+  // of thread_ids must not be used by other threads during checkpointing.  If
+  // incremental is true, only dirty pages are written on top of the last
+  // checkpoint made by this Checkpointer; the first checkpoint is always full.
+  bool checkpoint(const std::string& path_prefix,
+                  const std::vector<uint16_t>& thread_ids,
+                  bool incremental = false);
+
+  // The earliest snapshot timestamp of the last checkpoint, no later than
+  // DB::min_wts() when the checkpoint started.  Log entries earlier than this
+  // are not needed for recovery with this checkpoint.
+  const Timestamp& checkpoint_ts() const { return checkpoint_ts_; }
+
+  uint64_t row_count() const { return row_count_; }
+  uint64_t page_count() const { return page_count_; }
+  uint64_t written_size() const { return written_size_; }
+
+  static bool read_info(const std::string& path_prefix, Info* out_info);
+  // The files of a checkpoint and the checkpoints it is based on to give to
+  // Recovery::replay().  Returns an empty vector if the chain is broken.
+  static std::vector<std::string> paths(const std::string& path_prefix,
+                                        const Info& info);
+
+ private:
+  struct ThreadState {
+    bool failed;
+    bool has_checkpoint_ts;
+    Timestamp checkpoint_ts;
+    uint64_t row_count;
+    uint64_t page_count;
+    uint64_t written_size;
+  };
+
+  void checkpoint_thread(uint16_t thread_id, const std::string& path,
+                         const std::vector<uint64_t>& page_offsets,
+                         const std::vector<uint32_t>* dirty_since,
+                         ThreadState& ts);
+
+  DB<StaticConfig>* db_;
+
+  volatile uint64_t next_page_ __attribute__((aligned(64)));
+
+  Timestamp checkpoint_ts_;
+  uint64_t row_count_;
+  uint64_t page_count_;
+  uint64_t written_size_;
+
+  bool has_last_checkpoint_;
+  std::string last_path_prefix_;
+};
+}
+}
+
+#include "checkpoint_impl.h"
+
+#endif
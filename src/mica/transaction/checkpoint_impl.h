@@ -0,0 +1,296 @@
+#pragma once
+#ifndef MICA_TRANSACTION_CHECKPOINT_IMPL_H_
+#define MICA_TRANSACTION_CHECKPOINT_IMPL_H_
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include "mica/util/lcore.h"
+#include "mica/util/memcpy.h"
+#include "mica/util/roundup.h"
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+Checkpointer<StaticConfig>::Checkpointer(DB<StaticConfig>* db)
+    : db_(db),
+      next_page_(0),
+      row_count_(0),
+      page_count_(0),
+      written_size_(0),
+      has_last_checkpoint_(false) {}
+
+template <class StaticConfig>
+bool Checkpointer<StaticConfig>::checkpoint(
+    const std::string& path_prefix, const std::vector<uint16_t>& thread_ids,
+    bool incremental) {
+  assert(thread_ids.size() > 0);
+
+  if (path_prefix.size() >= kMaxPathPrefixLength) {
+    printf("too long checkpoint path prefix %s\n", path_prefix.c_str());
+    return false;
+  }
+  // Without dirty page tracking, every page must be written.
+  if (!has_last_checkpoint_ || !StaticConfig::kTrackDirtyPages)
+    incremental = false;
+
+  // Start a new dirty epoch.  Pages marked with the previous epoch or later
+  // have been written since the previous checkpoint started.
+  std::vector<uint32_t> dirty_since;
+  for (uint16_t table_id = 0; table_id < db_->table_count(); table_id++) {
+    auto tbl = db_->get_table_by_id(table_id);
+    dirty_since.push_back(tbl->advance_dirty_epoch() - 1);
+  }
+  ::mica::util::memory_barrier();
+
+  // A transaction that marks a page only after the page is skipped as clean
+  // can have a timestamp earlier than every page snapshot, but no earlier
+  // than min_wts now.  The log from this point must be kept for such writes.
+  auto start_min_wts = db_->min_wts();
+
+  // Number the pages of all tables.  Pages allocated after this point contain
+  // only rows inserted later, which are found in the log.
+  std::vector<uint64_t> page_offsets;
+  page_offsets.push_back(0);
+  for (uint16_t table_id = 0; table_id < db_->table_count(); table_id++) {
+    auto tbl = db_->get_table_by_id(table_id);
+    uint64_t page_count =
+        (tbl->row_count() + tbl->page_row_count() - 1) / tbl->page_row_count();
+    page_offsets.push_back(page_offsets.back() + page_count);
+  }
+
+  next_page_ = 0;
+  ::mica::util::memory_barrier();
+
+  std::vector<ThreadState> states(thread_ids.size());
+  {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < thread_ids.size(); i++) {
+      threads.emplace_back([&, i] {
+        checkpoint_thread(thread_ids[i], path_prefix + std::to_string(i),
+                          page_offsets, incremental ? &dirty_since : nullptr,
+                          states[i]);
+      });
+    }
+    while (threads.size() > 0) {
+      threads.back().join();
+      threads.pop_back();
+    }
+  }
+
+  bool has_checkpoint_ts = false;
+  row_count_ = 0;
+  page_count_ = 0;
+  written_size_ = 0;
+  for (auto& state : states) {
+    if (state.failed) return false;
+    if (state.has_checkpoint_ts &&
+        (!has_checkpoint_ts || state.checkpoint_ts < checkpoint_ts_)) {
+      checkpoint_ts_ = state.checkpoint_ts;
+      has_checkpoint_ts = true;
+    }
+    row_count_ += state.row_count;
+    page_count_ += state.page_count;
+    written_size_ += state.written_size;
+  }
+  if (!has_checkpoint_ts || start_min_wts < checkpoint_ts_)
+    checkpoint_ts_ = start_min_wts;
+
+  // Write the info file last so that an incomplete checkpoint is never used.
+  Info info;
+  ::mica::util::memset(&info, 0, sizeof(info));
+  info.checkpoint_ts = checkpoint_ts_;
+  info.file_count = thread_ids.size();
+  info.incremental = incremental ? 1 : 0;
+  if (incremental)
+    ::mica::util::memcpy(info.base_path_prefix, last_path_prefix_.c_str(),
+                         last_path_prefix_.size());
+
+  auto info_path = path_prefix + "info";
+  auto tmp_path = info_path + ".tmp";
+  int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    printf("failed to open checkpoint info file %s\n", tmp_path.c_str());
+    return false;
+  }
+  bool ok = ::write(fd, &info, sizeof(info)) == sizeof(info) &&
+            ::fdatasync(fd) == 0;
+  ::close(fd);
+  if (!ok || ::rename(tmp_path.c_str(), info_path.c_str()) != 0) {
+    printf("failed to write checkpoint info file %s\n", info_path.c_str());
+    return false;
+  }
+
+  has_last_checkpoint_ = true;
+  last_path_prefix_ = path_prefix;
+  return true;
+}
+
+template <class StaticConfig>
+void Checkpointer<StaticConfig>::checkpoint_thread(
+    uint16_t thread_id, const std::string& path,
+    const std::vector<uint64_t>& page_offsets,
+    const std::vector<uint32_t>* dirty_since, ThreadState& state) {
+  state.failed = false;
+  state.has_checkpoint_ts = false;
+  state.row_count = 0;
+  state.page_count = 0;
+  state.written_size = 0;
+
+  ::mica::util::lcore.pin_thread(thread_id);
+
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    printf("failed to open checkpoint file %s\n", path.c_str());
+    state.failed = true;
+    return;
+  }
+
+  db_->activate(thread_id);
+
+  Transaction<StaticConfig> tx(db_->context(thread_id));
+  std::vector<char> buf;
+
+  uint64_t page_count = page_offsets.back();
+  while (!state.failed) {
+    uint64_t page = __sync_fetch_and_add(&next_page_, 1);
+    if (page >= page_count) break;
+
+    auto table_id = static_cast<uint16_t>(
+        std::upper_bound(page_offsets.begin(), page_offsets.end(), page) -
+        page_offsets.begin() - 1);
+    auto tbl = db_->get_table_by_id(table_id);
+    uint64_t table_page = page - page_offsets[table_id];
+    if (dirty_since != nullptr &&
+        !tbl->is_page_dirty(table_page, (*dirty_since)[table_id]))
+      continue;
+
+    uint64_t row_id_begin = table_page * tbl->page_row_count();
+    uint64_t row_id_end = row_id_begin + tbl->page_row_count();
+
+    if (!tx.begin(true)) {
+      state.failed = true;
+      break;
+    }
+
+    buf.resize(sizeof(LogTxHeader<StaticConfig>));
+    uint32_t record_count = 0;
+
+    auto append = [&](uint64_t row_id, uint16_t cf_id, const char* data,
+                      uint64_t data_size, RowVersionStatus status) {
+      auto off = buf.size();
+      buf.resize(off + sizeof(LogRecordHeader) +
+                 ::mica::util::roundup<8>(data_size));
+
+      auto rec_h = reinterpret_cast<LogRecordHeader*>(&buf[off]);
+      rec_h->row_id = row_id;
+      rec_h->data_size = static_cast<uint32_t>(data_size);
+      rec_h->table_id = table_id;
+      rec_h->cf_id = cf_id;
+      rec_h->status = status;
+      rec_h->is_delta = 0;
+      rec_h->data_off = 0;
+      if (data_size != 0) ::mica::util::memcpy(rec_h + 1, data, data_size);
+
+      record_count++;
+    };
+
+    for (uint16_t cf_id = 0; cf_id < tbl->cf_count(); cf_id++) {
+      // Rows skipped by the scan are written as deleted in an incremental
+      // checkpoint to hide them in the earlier checkpoints.
+      uint64_t next_row_id = row_id_begin;
+      auto append_deleted = [&](uint64_t row_id_end2) {
+        if (dirty_since == nullptr) return;
+        for (; next_row_id < row_id_end2; next_row_id++)
+          append(next_row_id, cf_id, nullptr, 0, RowVersionStatus::kDeleted);
+      };
+
+      tbl->scan(&tx, cf_id, 0, tbl->data_size_hint(cf_id), row_id_begin,
+                row_id_end, [&](auto& rah) {
+                  append_deleted(rah.row_id());
+                  append(rah.row_id(), cf_id, rah.cdata(), rah.size(),
+                         RowVersionStatus::kCommitted);
+                  next_row_id = rah.row_id() + 1;
+                });
+      append_deleted(std::min(row_id_end, tbl->row_count()));
+    }
+
+    auto snapshot_ts = tx.ts();
+    if (!tx.commit()) {
+      state.failed = true;
+      break;
+    }
+
+    if (record_count == 0) continue;
+
+    auto tx_h = reinterpret_cast<LogTxHeader<StaticConfig>*>(buf.data());
+    tx_h->ts = snapshot_ts;
+    tx_h->record_count = record_count;
+    tx_h->size = static_cast<uint32_t>(buf.size());
+
+    uint64_t off = 0;
+    while (off < buf.size()) {
+      auto ret = ::write(fd, buf.data() + off, buf.size() - off);
+      if (ret == -1) {
+        printf("failed to write checkpoint file %s\n", path.c_str());
+        state.failed = true;
+        break;
+      }
+      off += static_cast<uint64_t>(ret);
+    }
+
+    if (!state.has_checkpoint_ts || snapshot_ts < state.checkpoint_ts) {
+      state.checkpoint_ts = snapshot_ts;
+      state.has_checkpoint_ts = true;
+    }
+    state.row_count += record_count;
+    state.page_count++;
+    state.written_size += buf.size();
+  }
+
+  db_->deactivate(thread_id);
+
+  if (::fdatasync(fd) != 0) {
+    printf("failed to sync checkpoint file %s\n", path.c_str());
+    state.failed = true;
+  }
+  ::close(fd);
+}
+
+template <class StaticConfig>
+bool Checkpointer<StaticConfig>::read_info(const std::string& path_prefix,
+                                           Info* out_info) {
+  auto info_path = path_prefix + "info";
+  int fd = ::open(info_path.c_str(), O_RDONLY);
+  if (fd == -1) return false;
+  bool ok = ::read(fd, out_info, sizeof(Info)) == sizeof(Info);
+  ::close(fd);
+  if (ok) out_info->base_path_prefix[kMaxPathPrefixLength - 1] = '\0';
+  return ok;
+}
+
+template <class StaticConfig>
+std::vector<std::string> Checkpointer<StaticConfig>::paths(
+    const std::string& path_prefix, const Info& info) {
+  std::vector<std::string> paths;
+  std::string prefix = path_prefix;
+  Info cur = info;
+  while (true) {
+    for (uint64_t i = 0; i < cur.file_count; i++)
+      paths.push_back(prefix + std::to_string(i));
+    if (!cur.incremental) break;
+
+    prefix = cur.base_path_prefix;
+    if (!read_info(prefix, &cur)) {
+      printf("failed to read base checkpoint info %sinfo\n", prefix.c_str());
+      return std::vector<std::string>();
+    }
+  }
+  return paths;
+}
+}
+}
+
+#endif
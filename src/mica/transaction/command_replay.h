@@ -0,0 +1,66 @@
+#pragma once
+#ifndef MICA_TRANSACTION_COMMAND_REPLAY_H_
+#define MICA_TRANSACTION_COMMAND_REPLAY_H_
+
+#include <string>
+#include <vector>
+#include "mica/common.h"
+#include "mica/transaction/db.h"
+#include "mica/transaction/logging.h"
+
+namespace mica {
+namespace transaction {
+// Re-executes the stored procedures recorded by CommandLogger.
+//
+// The commands of all log files are merged and executed one by one in the
+// order of their original commit timestamps.  Because Cicada serializes
+// transactions in timestamp order, serial re-execution of deterministic
+// procedures reproduces the logged state.  Replay must start from the state
+// right before the first replayed command: an empty database, or one restored
+// from a transaction-consistent snapshot at min_ts.  (The fuzzy checkpoints of
+// Checkpointer are not such snapshots.)
+template <class StaticConfig>
+class CommandReplay {
+ public:
+  typedef typename StaticConfig::Timestamp Timestamp;
+
+  // command_replay_impl.h
+  CommandReplay(DB<StaticConfig>* db);
+
+  // Replays the command log files on the context of thread_id, which must not
+  // be active.  For each command, f(tx, proc_id, args, args_size) must run the
+  // procedure with tx until it commits and return true; false stops replay.
+  // The replayed transactions get new timestamps.  max_ts and min_ts work as
+  // in Recovery::replay().  An incomplete command at the end of a log file is
+  // ignored.
+  template <class Func>
+  bool replay(const std::vector<std::string>& paths, uint16_t thread_id,
+              const Func& f, const Timestamp* max_ts = nullptr,
+              const Timestamp* min_ts = nullptr);
+
+  uint64_t command_count() const { return command_count_; }
+  // The original timestamp of the last replayed command.
+  const Timestamp& last_ts() const { return last_ts_; }
+
+ private:
+  struct Entry {
+    Timestamp ts;
+    const CommandRecordHeader* cmd;
+  };
+
+  bool read_log(const std::string& path, const Timestamp* max_ts,
+                const Timestamp* min_ts, std::vector<Entry>& entries);
+
+  DB<StaticConfig>* db_;
+
+  std::vector<std::vector<char>> bufs_;
+
+  uint64_t command_count_;
+  Timestamp last_ts_;
+};
+}
+}
+
+#include "command_replay_impl.h"
+
+#endif
@@ -0,0 +1,118 @@
+#pragma once
+#ifndef MICA_TRANSACTION_COMMAND_REPLAY_IMPL_H_
+#define MICA_TRANSACTION_COMMAND_REPLAY_IMPL_H_
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+CommandReplay<StaticConfig>::CommandReplay(DB<StaticConfig>* db)
+    : db_(db), command_count_(0) {}
+
+template <class StaticConfig>
+template <class Func>
+bool CommandReplay<StaticConfig>::replay(const std::vector<std::string>& paths,
+                                         uint16_t thread_id, const Func& f,
+                                         const Timestamp* max_ts,
+                                         const Timestamp* min_ts) {
+  assert(!db_->is_active(thread_id));
+
+  std::vector<Entry> entries;
+  for (auto& path : paths)
+    if (!read_log(path, max_ts, min_ts, entries)) return false;
+
+  // Timestamps are unique, so this is the original serialization order.
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) { return a.ts < b.ts; });
+
+  command_count_ = 0;
+
+  db_->activate(thread_id);
+  Transaction<StaticConfig> tx(db_->context(thread_id));
+
+  bool ok = true;
+  for (auto& e : entries) {
+    if (!f(&tx, e.cmd->proc_id, reinterpret_cast<const char*>(e.cmd + 1),
+           e.cmd->args_size)) {
+      printf("failed to replay command %" PRIu16 "\n", e.cmd->proc_id);
+      ok = false;
+      break;
+    }
+    command_count_++;
+    last_ts_ = e.ts;
+  }
+
+  if (tx.has_began()) tx.abort();
+  db_->deactivate(thread_id);
+
+  bufs_.clear();
+
+  if (StaticConfig::kVerbose)
+    printf("replayed %" PRIu64 " commands\n", command_count_);
+  return ok;
+}
+
+template <class StaticConfig>
+bool CommandReplay<StaticConfig>::read_log(const std::string& path,
+                                           const Timestamp* max_ts,
+                                           const Timestamp* min_ts,
+                                           std::vector<Entry>& entries) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    printf("failed to open log file %s\n", path.c_str());
+    return false;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    printf("failed to stat log file %s\n", path.c_str());
+    ::close(fd);
+    return false;
+  }
+
+  bufs_.emplace_back(static_cast<size_t>(st.st_size));
+  auto& buf = bufs_.back();
+
+  uint64_t len = 0;
+  while (len < buf.size()) {
+    auto ret = ::read(fd, buf.data() + len, buf.size() - len);
+    if (ret <= 0) break;
+    len += static_cast<uint64_t>(ret);
+  }
+  ::close(fd);
+
+  uint64_t off = 0;
+  while (off + sizeof(LogTxHeader<StaticConfig>) <= len) {
+    auto tx_h =
+        reinterpret_cast<const LogTxHeader<StaticConfig>*>(buf.data() + off);
+    // Ignore an incomplete command at the end.
+    if (tx_h->size < sizeof(LogTxHeader<StaticConfig>) ||
+        off + tx_h->size > len)
+      break;
+
+    auto cmd_h = reinterpret_cast<const CommandRecordHeader*>(tx_h + 1);
+    const uint64_t kHeaderSize =
+        sizeof(LogTxHeader<StaticConfig>) + sizeof(CommandRecordHeader);
+    if (tx_h->record_count != 1 || tx_h->size < kHeaderSize ||
+        kHeaderSize + uint64_t(cmd_h->args_size) > tx_h->size) {
+      printf("invalid command log entry in %s\n", path.c_str());
+      return false;
+    }
+
+    if ((max_ts == nullptr || !(*max_ts < tx_h->ts)) &&
+        (min_ts == nullptr || !(tx_h->ts < *min_ts)))
+      entries.push_back(Entry{tx_h->ts, cmd_h});
+
+    off += tx_h->size;
+  }
+  return true;
+}
+}
+}
+
+#endif
@@ -0,0 +1,195 @@
+#pragma once
+#ifndef MICA_TRANSACTION_COMPOSITE_KEY_H_
+#define MICA_TRANSACTION_COMPOSITE_KEY_H_
+
+#include <array>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "mica/common.h"
+#include "mica/transaction/btree_simd_search.h"
+
+namespace mica {
+namespace transaction {
+// The compile-time layout of CompositeKey<Fields...>.
+template <class... Fields>
+struct CompositeKeyLayout {
+  static constexpr size_t kFieldCount = sizeof...(Fields);
+
+  static constexpr bool valid() {
+    const bool integral[] = {std::is_integral<Fields>::value...};
+    for (size_t j = 0; j < kFieldCount; j++)
+      if (!integral[j]) return false;
+    return true;
+  }
+
+  // Returns the word index * 64 + the bit shift of field i, or the number of
+  // words used if i == kFieldCount.
+  static constexpr size_t position(size_t i) {
+    const size_t bits[] = {8 * sizeof(Fields)...};
+    size_t word = 0;
+    size_t used = 0;
+    for (size_t j = 0; j < kFieldCount; j++) {
+      if (used + bits[j] > 64) {
+        word++;
+        used = 0;
+      }
+      used += bits[j];
+      if (j == i) return word * 64 + (64 - used);
+    }
+    return word + 1;
+  }
+};
+
+// A multi-column key made of fixed-width integer fields, such as
+// CompositeKey<uint16_t, uint8_t, uint32_t> for a TPC-C (w_id, d_id, o_id)
+// key.
+//
+// The fields are packed into 64-bit words at compile time, from the most
+// significant bits of the first word in the field order; a field that does
+// not fit in the rest of a word starts a new word.  Signed fields are stored
+// with their sign bit flipped.  Comparing the words in order as unsigned
+// integers therefore orders keys like comparing the fields in order, and the
+// keys of up to two words use the SIMD node search of BTreeIndex in the same
+// way as uint64_t and std::pair<uint64_t, uint64_t> keys.
+template <class... Fields>
+class CompositeKey {
+ public:
+  typedef CompositeKeyLayout<Fields...> Layout;
+  static_assert(sizeof...(Fields) > 0, "no fields");
+  static_assert(Layout::valid(), "fields must be integers");
+
+  static constexpr size_t kFieldCount = sizeof...(Fields);
+  static constexpr size_t kWordCount = Layout::position(kFieldCount);
+
+  template <size_t I>
+  using Field = typename std::tuple_element<I, std::tuple<Fields...>>::type;
+
+  // The type whose layout and order match the words.
+  typedef typename std::conditional<
+      kWordCount == 1, uint64_t,
+      typename std::conditional<kWordCount == 2, std::pair<uint64_t, uint64_t>,
+                                std::array<uint64_t, kWordCount>>::type>::type
+      Words;
+
+  CompositeKey() : words_{} {}
+  CompositeKey(Fields... fields) : words_{} {
+    set_all(std::index_sequence_for<Fields...>(), fields...);
+  }
+
+  template <size_t I>
+  Field<I> get() const {
+    typedef typename std::make_unsigned<Field<I>>::type U;
+    constexpr size_t pos = Layout::position(I);
+    auto v = static_cast<U>(words_[pos / 64] >> (pos % 64));
+    if (std::is_signed<Field<I>>::value) v ^= sign_bit<Field<I>>();
+    return static_cast<Field<I>>(v);
+  }
+
+  template <size_t I>
+  void set(Field<I> v) {
+    typedef typename std::make_unsigned<Field<I>>::type U;
+    auto u = static_cast<U>(v);
+    if (std::is_signed<Field<I>>::value) u ^= sign_bit<Field<I>>();
+    constexpr size_t pos = Layout::position(I);
+    auto& word = words_[pos / 64];
+    auto shift = pos % 64;
+    word &= ~(static_cast<uint64_t>(static_cast<U>(~U(0))) << shift);
+    word |= static_cast<uint64_t>(u) << shift;
+  }
+
+  const uint64_t* words() const { return words_; }
+
+  bool operator<(const CompositeKey& o) const {
+    for (size_t i = 0; i < kWordCount; i++)
+      if (words_[i] != o.words_[i]) return words_[i] < o.words_[i];
+    return false;
+  }
+  bool operator==(const CompositeKey& o) const {
+    for (size_t i = 0; i < kWordCount; i++)
+      if (words_[i] != o.words_[i]) return false;
+    return true;
+  }
+  bool operator!=(const CompositeKey& o) const { return !(*this == o); }
+
+ private:
+  template <class T>
+  static constexpr typename std::make_unsigned<T>::type sign_bit() {
+    return static_cast<typename std::make_unsigned<T>::type>(
+        typename std::make_unsigned<T>::type(1) << (sizeof(T) * 8 - 1));
+  }
+
+  template <size_t... Is>
+  void set_all(std::index_sequence<Is...>, Fields... fields) {
+    int dummy[] = {(set<Is>(fields), 0)...};
+    (void)dummy;
+  }
+
+  uint64_t words_[kWordCount];
+};
+
+// Keys of one or two words are searched as uint64_t or
+// std::pair<uint64_t, uint64_t> keys, which have the same layout and order.
+template <class... Fields>
+struct BTreeSIMDSearch<CompositeKey<Fields...>> {
+  typedef CompositeKey<Fields...> Key;
+  typedef typename Key::Words Words;
+  static_assert(sizeof(Key) == sizeof(Words), "unexpected key layout");
+
+  static constexpr bool kSupported = BTreeSIMDSearch<Words>::kSupported;
+
+  template <bool Greater>
+  static int count(const Key* keys, int n, const Key& key) {
+    return BTreeSIMDSearch<Words>::template count<Greater>(
+        reinterpret_cast<const Words*>(keys), n,
+        *reinterpret_cast<const Words*>(&key));
+  }
+};
+
+// For non-unique BTree indexes with one-word keys.
+template <class... Fields>
+struct BTreeSIMDSearch<std::pair<CompositeKey<Fields...>, uint64_t>> {
+  typedef std::pair<CompositeKey<Fields...>, uint64_t> Key;
+  typedef std::pair<uint64_t, uint64_t> Words;
+
+  static constexpr bool kSupported =
+      CompositeKey<Fields...>::kWordCount == 1 &&
+      BTreeSIMDSearch<Words>::kSupported;
+
+  template <bool Greater>
+  static int count(const Key* keys, int n, const Key& key) {
+    return BTreeSIMDSearch<Words>::template count<Greater>(
+        reinterpret_cast<const Words*>(keys), n,
+        *reinterpret_cast<const Words*>(&key));
+  }
+};
+}
+}
+
+namespace std {
+// The fields are packed from the most significant bits, so all words are
+// mixed to make the low bits that HashIndex uses for bucket IDs depend on
+// every field.
+template <class... Fields>
+struct hash<::mica::transaction::CompositeKey<Fields...>> {
+  size_t operator()(
+      const ::mica::transaction::CompositeKey<Fields...>& key) const {
+    const uint64_t kMul = 0x9ddfea08eb382d69ULL;
+    auto words = key.words();
+    uint64_t h = 0;
+    for (size_t i = 0;
+         i < ::mica::transaction::CompositeKey<Fields...>::kWordCount; i++) {
+      // CityHash's Hash128to64().
+      uint64_t a = (words[i] ^ h) * kMul;
+      a ^= (a >> 47);
+      uint64_t b = (h ^ a) * kMul;
+      b ^= (b >> 47);
+      h = b * kMul;
+    }
+    return static_cast<size_t>(h);
+  }
+};
+}
+
+#endif
@@ -3,6 +3,7 @@
 #define MICA_TRANSACTION_CONTEXT_H_
 
 #include <queue>
+#include <unordered_map>
 #include "mica/transaction/stats.h"
 #include "mica/transaction/row.h"
 #include "mica/transaction/table.h"
@@ -64,6 +65,7 @@ class Context {
   ~Context() {}
 
   DB<StaticConfig>* db() { return db_; }
+  const DB<StaticConfig>* db() const { return db_; }
 
   uint64_t clock() const { return clock_; }
 
@@ -180,14 +182,54 @@ class Context {
   uint64_t allocate_row(Table<StaticConfig>* tbl) {
     auto& free_row_ids = free_rows_[tbl];
     if (free_row_ids.empty()) {
-      if (!tbl->allocate_rows(this, free_row_ids))
+      if (!allocate_free_rows(tbl, free_row_ids))
         return static_cast<uint64_t>(-1);
     }
     auto row_id = free_row_ids.back();
     free_row_ids.pop_back();
+    auto pos = free_row_pos(tbl);
+    if (pos != nullptr) pos->erase(row_id);
 
     if (StaticConfig::kVerbose) printf("new row ID = %" PRIu64 "\n", row_id);
 
+    init_row(tbl, row_id);
+    return row_id;
+  }
+
+  // Allocates the given row ID for a replica that must use the same row IDs
+  // as its primary.  Fails if the row is not in the free rows of this context,
+  // which includes a deleted row that is not reclaimed by GC yet.
+  uint64_t allocate_row(Table<StaticConfig>* tbl, uint64_t row_id) {
+    auto& free_row_ids = free_rows_[tbl];
+    // Index the free rows of the table on the first use.
+    auto& pos = free_row_pos_[tbl];
+    if (pos.size() != free_row_ids.size()) {
+      pos.clear();
+      for (size_t i = 0; i < free_row_ids.size(); i++)
+        pos[free_row_ids[i]] = i;
+    }
+
+    while (tbl->row_count() <= row_id) {
+      if (!allocate_free_rows(tbl, free_row_ids))
+        return static_cast<uint64_t>(-1);
+    }
+
+    auto it = pos.find(row_id);
+    if (it == pos.end()) return static_cast<uint64_t>(-1);
+    auto i = it->second;
+    pos.erase(it);
+    auto last_row_id = free_row_ids.back();
+    free_row_ids.pop_back();
+    if (i != free_row_ids.size()) {
+      free_row_ids[i] = last_row_id;
+      pos[last_row_id] = i;
+    }
+
+    init_row(tbl, row_id);
+    return row_id;
+  }
+
+  void init_row(Table<StaticConfig>* tbl, uint64_t row_id) {
     // gc_ts needs to be initialized with a near-past timestamp.
     auto min_wts = db_->min_wts();
     for (uint16_t cf_id = 0; cf_id < tbl->cf_count(); cf_id++) {
@@ -197,12 +239,13 @@ class Context {
 
       assert(tbl->head(cf_id, row_id)->older_rv == nullptr);
     }
-
-    return row_id;
   }
 
   void deallocate_row(Table<StaticConfig>* tbl, uint64_t row_id) {
-    free_rows_[tbl].push_back(row_id);
+    auto& free_row_ids = free_rows_[tbl];
+    auto pos = free_row_pos(tbl);
+    if (pos != nullptr) (*pos)[row_id] = free_row_ids.size();
+    free_row_ids.push_back(row_id);
 
     // TODO: Defragement and return a group of rows.
   }
@@ -285,6 +328,7 @@ class Context {
   void idle() { db_->idle(thread_id_); }
 
  private:
+  friend class DB<StaticConfig>;
   friend class Table<StaticConfig>;
   friend class Transaction<StaticConfig>;
 
@@ -305,6 +349,30 @@ class Context {
 
   std::unordered_map<const Table<StaticConfig>*, std::vector<uint64_t>>
       free_rows_;
+  // The positions in free_rows_ of the tables whose rows are allocated with
+  // explicit row IDs.
+  std::unordered_map<const Table<StaticConfig>*,
+                     std::unordered_map<uint64_t, size_t>>
+      free_row_pos_;
+
+  std::unordered_map<uint64_t, size_t>* free_row_pos(
+      const Table<StaticConfig>* tbl) {
+    if (free_row_pos_.empty()) return nullptr;
+    auto it = free_row_pos_.find(tbl);
+    if (it == free_row_pos_.end()) return nullptr;
+    return &it->second;
+  }
+
+  bool allocate_free_rows(Table<StaticConfig>* tbl,
+                          std::vector<uint64_t>& free_row_ids) {
+    auto old_size = free_row_ids.size();
+    if (!tbl->allocate_rows(this, free_row_ids)) return false;
+    auto pos = free_row_pos(tbl);
+    if (pos != nullptr)
+      for (auto i = old_size; i < free_row_ids.size(); i++)
+        (*pos)[free_row_ids[i]] = i;
+    return true;
+  }
 
   struct GCItem {
     // uint64_t gc_epoch;
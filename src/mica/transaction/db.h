@@ -2,7 +2,12 @@
 #ifndef MICA_TRANSACTION_DB_H_
 #define MICA_TRANSACTION_DB_H_
 
+#include <deque>
+#include <functional>
+#include <type_traits>
+#include <typeinfo>
 #include <unordered_map>
+#include <vector>
 #include "mica/common.h"
 #include "mica/transaction/timestamp.h"
 #include "mica/alloc/hugetlbfs_shm.h"
@@ -12,7 +17,16 @@
 #include "mica/transaction/transaction.h"
 #include "mica/transaction/hash_index.h"
 #include "mica/transaction/btree_index.h"
+#include "mica/transaction/art_index.h"
+#include "mica/transaction/olc_btree_index.h"
+#include "mica/transaction/composite_key.h"
 #include "mica/transaction/logging.h"
+#include "mica/transaction/recovery.h"
+#include "mica/transaction/bulk_loader.h"
+#include "mica/transaction/checkpoint.h"
+#include "mica/transaction/command_replay.h"
+#include "mica/transaction/change_capture.h"
+#include "mica/transaction/log_shipping.h"
 #include "mica/util/lcore.h"
 
 namespace mica {
@@ -51,6 +65,9 @@ struct BasicDBConfig {
   // static constexpr uint64_t kInlineThreshold = 4096 - 40;
   // Use an alternative location for the inlining.
   static constexpr bool kInlineWithAltRow = false;
+  // Mark table pages dirty on commit for incremental checkpoints.  Without
+  // it, Checkpointer::checkpoint() always takes a full checkpoint.
+  static constexpr bool kTrackDirtyPages = false;
   // Promote a non-inlined version into an inlined version during read.
   static constexpr bool kPromoteNonInlinedVersion = true;
 
@@ -88,6 +105,29 @@ struct BasicDBConfig {
   // The maximum number of numa nodes to support.
   static constexpr size_t kMaxNUMACount = 8;
 
+  // Search BTree index nodes with SIMD instructions (AVX2 or AVX-512) for
+  // u64 keys.  Faster when enabled.
+  static constexpr bool kBTreeSIMDSearch = true;
+
+  // Keep the number of keys under each child of BTree index internal nodes,
+  // which BTreeIndex::count_range(), rank(), and select() use.  Every insert
+  // and remove then writes all nodes on its path, including the root.
+  static constexpr bool kBTreeSubtreeCounts = false;
+
+  // The maximum number of times that a HashIndex bucket can be split as the
+  // index grows beyond its expected size.  0 disables splitting.
+  static constexpr uint64_t kHashIndexMaxSplitLevel = 10;
+
+  // The size of the filter in front of each HashIndex in bits per expected
+  // row, which lets lookups and removes of absent keys skip the buckets.  0
+  // disables the filter.  Inserts abort if a later transaction has seen
+  // their key absent.
+  static constexpr uint64_t kHashIndexFilterBitsPerKey = 0;
+
+  // The maximum length of keys of string BTree indexes (bytes).  Each key
+  // takes kBTreeStringKeyMaxLength + 1 bytes in a node.
+  static constexpr size_t kBTreeStringKeyMaxLength = 31;
+
   // The maximum number of column families.
   static constexpr uint16_t kMaxColumnFamilyCount = 8;
 
@@ -123,6 +163,12 @@ struct BasicDBConfig {
   // (us).
   static constexpr int64_t kMinClockSyncInterval = 100;
 
+  // The default minimum interval to make each thread's log durable in
+  // quiescence() (us; see DB::set_log_sync_interval()).  A longer interval
+  // spreads the sync cost over more transactions at the cost of longer
+  // durability latency.
+  static constexpr int64_t kMinLogSyncInterval = 1000;
+
   // Collect commit-related statistics.  Required by kBackoff.
   static constexpr bool kCollectCommitStats = true;
   // Collect extra commit/abort latencies.
@@ -175,6 +221,22 @@ class DB {
   typedef BTreeIndex<StaticConfig, true, uint64_t> BTreeIndexUniqueU64;
   typedef BTreeIndex<StaticConfig, false, std::pair<uint64_t, uint64_t>>
       BTreeIndexNonuniqueU64;
+  typedef BTreeStringKey<StaticConfig::kBTreeStringKeyMaxLength> StringKey;
+  typedef BTreeIndex<StaticConfig, true, StringKey> BTreeIndexUniqueString;
+  typedef BTreeIndex<StaticConfig, false, std::pair<StringKey, uint64_t>>
+      BTreeIndexNonuniqueString;
+  typedef ARTIndex<StaticConfig> ARTIndexUniqueU64;
+  typedef OLCBTreeIndex<StaticConfig> OLCBTreeIndexUniqueU64;
+
+  // Indexes with any key type such as CompositeKey.  A non-unique BTree index
+  // appends the row ID to the key as BTreeIndexNonuniqueU64 does.
+  template <class Key, bool UniqueKey = true>
+  using HashIndexT = HashIndex<StaticConfig, UniqueKey, Key>;
+  template <class Key, bool UniqueKey = true>
+  using BTreeIndexT = BTreeIndex<
+      StaticConfig, UniqueKey,
+      typename std::conditional<UniqueKey, Key,
+                                std::pair<Key, uint64_t>>::type>;
 
   DB(PagePool<StaticConfig>** page_pools, Logger* logger, Stopwatch* sw,
      uint16_t num_threads);
@@ -224,6 +286,10 @@ class DB {
   void activate(uint16_t thread_id);
   void deactivate(uint16_t thread_id);
   void reset_clock(uint16_t thread_id);
+  // Makes all timestamps generated later be after ts.  Used after recovery to
+  // continue the timestamps of the recovered database.  All threads must be
+  // inactive.
+  void advance_clock(const Timestamp& ts);
   void idle(uint16_t thread_id);
 
   Context<StaticConfig>* context(uint16_t thread_id) {
@@ -241,6 +307,17 @@ class DB {
     return tables_[name];
   }
 
+  // Includes tables created for indexes.
+  uint16_t table_count() const {
+    return static_cast<uint16_t>(tables_by_id_.size());
+  }
+  Table<StaticConfig>* get_table_by_id(uint16_t table_id) {
+    return tables_by_id_[table_id];
+  }
+  const Table<StaticConfig>* get_table_by_id(uint16_t table_id) const {
+    return tables_by_id_[table_id];
+  }
+
   bool create_hash_index_unique_u64(std::string name,
                                     Table<StaticConfig>* main_tbl,
                                     uint64_t expected_num_rows);
@@ -283,6 +360,65 @@ class DB {
     return btree_idxs_nonunique_u64_[name];
   }
 
+  bool create_btree_index_unique_string(std::string name,
+                                        Table<StaticConfig>* main_tbl);
+
+  auto get_btree_index_unique_string(std::string name) {
+    return btree_idxs_unique_string_[name];
+  }
+  auto get_btree_index_unique_string(std::string name) const {
+    return btree_idxs_unique_string_[name];
+  }
+
+  bool create_btree_index_nonunique_string(std::string name,
+                                           Table<StaticConfig>* main_tbl);
+
+  auto get_btree_index_nonunique_string(std::string name) {
+    return btree_idxs_nonunique_string_[name];
+  }
+  auto get_btree_index_nonunique_string(std::string name) const {
+    return btree_idxs_nonunique_string_[name];
+  }
+
+  bool create_art_index_unique_u64(std::string name,
+                                   Table<StaticConfig>* main_tbl);
+
+  auto get_art_index_unique_u64(std::string name) {
+    return art_idxs_unique_u64_[name];
+  }
+  auto get_art_index_unique_u64(std::string name) const {
+    return art_idxs_unique_u64_[name];
+  }
+
+  bool create_olc_btree_index_unique_u64(std::string name,
+                                         Table<StaticConfig>* main_tbl);
+
+  auto get_olc_btree_index_unique_u64(std::string name) {
+    return olc_btree_idxs_unique_u64_[name];
+  }
+  auto get_olc_btree_index_unique_u64(std::string name) const {
+    return olc_btree_idxs_unique_u64_[name];
+  }
+
+  // Indexes with any key type (see HashIndexT and BTreeIndexT).  get_*()
+  // returns nullptr if there is no index of the name with the key type.
+  template <class Key, bool UniqueKey = true>
+  bool create_hash_index(std::string name, Table<StaticConfig>* main_tbl,
+                         uint64_t expected_num_rows);
+
+  template <class Key, bool UniqueKey = true>
+  HashIndexT<Key, UniqueKey>* get_hash_index(std::string name) const {
+    return get_typed_index<HashIndexT<Key, UniqueKey>>(hash_idxs_, name);
+  }
+
+  template <class Key, bool UniqueKey = true>
+  bool create_btree_index(std::string name, Table<StaticConfig>* main_tbl);
+
+  template <class Key, bool UniqueKey = true>
+  BTreeIndexT<Key, UniqueKey>* get_btree_index(std::string name) const {
+    return get_typed_index<BTreeIndexT<Key, UniqueKey>>(btree_idxs_, name);
+  }
+
   void quiescence(uint16_t thread_id);
 
   void update_backoff(uint16_t thread_id);
@@ -293,8 +429,52 @@ class DB {
   Timestamp min_wts() const { return min_wts_.get(); }
   Timestamp min_rts() const { return min_rts_.get(); }
 
+  // All committed transactions whose timestamp is no later than durable_ts()
+  // have been made durable by the logger.
+  Timestamp durable_ts() const { return durable_ts_.get(); }
+
+  // Makes the log of the thread durable and publishes the timestamp of its
+  // last transaction to durable_ts().  This must be called by the thread when
+  // it is not running a transaction.  quiescence() calls this at most every
+  // log sync interval, and deactivate() calls this before the thread stops.
+  bool sync_log(uint16_t thread_id);
+  // Sets the minimum interval of sync_log() in quiescence() (us).  Each call
+  // blocks the thread on the log device (e.g., fdatasync()), so a thread
+  // that would rather choose when to pay it can use kNoPeriodicLogSync and
+  // call sync_log() by itself; durable_ts() advances only on these calls.
+  static constexpr int64_t kNoPeriodicLogSync = -1;
+  void set_log_sync_interval(int64_t us) { log_sync_interval_ = us; }
+  int64_t log_sync_interval() const { return log_sync_interval_; }
+
+  // Waits until durable_ts() reaches ts.  This must be called by a thread
+  // that is not running a transaction.
+  void wait_for_durability(uint16_t thread_id, const Timestamp& ts);
+  // Calls callback in thread_id's quiescence() once durable_ts() reaches ts.
+  // Callbacks must be registered in the timestamp order for each thread.
+  void on_durable(uint16_t thread_id, const Timestamp& ts,
+                  std::function<void()> callback);
+
   // uint64_t gc_epoch() const { return gc_epoch_; }
 
+  // Warm restart (db_warm_restart.h).  detach() saves the state of the DB that
+  // is not in page pools into page pool 0 and detaches all page pools (which
+  // must have been created with names) for a later process; no thread may be
+  // active, and the DB may only be destroyed afterward.  After reattaching the
+  // page pools and creating all tables (including those for indexes) in the
+  // same order without initializing indexes with init(), reattach() restores
+  // the saved state.  As with Recovery, the DB must not be used if it fails.
+  bool detach();
+  bool reattach();
+
+  // Restores the index state that is neither in tables nor logged: the
+  // entries of OLCBTreeIndex (see OLCBTreeIndex::rebuild()) and the filters of
+  // HashIndex.  Recovery and reattach() call this at the end, so such indexes
+  // must be created (and declared as secondary indexes) before them.  No
+  // thread may be active.
+  void rebuild_volatile_indexes();
+  // Stops using the filters of HashIndex (see ReplicaApplier).
+  void disable_index_filters();
+
   // db_print_stats.h
   void reset_stats();
   void print_stats(double elapsed_time, double total_time) const;
@@ -318,6 +498,7 @@ class DB {
       row_version_pools_[StaticConfig::kMaxLCoreCount];
 
   std::unordered_map<std::string, Table<StaticConfig>*> tables_;
+  std::vector<Table<StaticConfig>*> tables_by_id_;
 
   std::unordered_map<std::string, HashIndexUniqueU64*> hash_idxs_unique_u64_;
   std::unordered_map<std::string, HashIndexNonuniqueU64*>
@@ -326,6 +507,34 @@ class DB {
   std::unordered_map<std::string, BTreeIndexUniqueU64*> btree_idxs_unique_u64_;
   std::unordered_map<std::string, BTreeIndexNonuniqueU64*>
       btree_idxs_nonunique_u64_;
+  std::unordered_map<std::string, BTreeIndexUniqueString*>
+      btree_idxs_unique_string_;
+  std::unordered_map<std::string, BTreeIndexNonuniqueString*>
+      btree_idxs_nonunique_string_;
+
+  std::unordered_map<std::string, ARTIndexUniqueU64*> art_idxs_unique_u64_;
+  std::unordered_map<std::string, OLCBTreeIndexUniqueU64*>
+      olc_btree_idxs_unique_u64_;
+
+  // Indexes created by create_hash_index() and create_btree_index().
+  struct TypedIndex {
+    const std::type_info* type;
+    void* idx;
+    // For hash indexes only.
+    void (*rebuild_filter)(void* idx);
+    void (*disable_filter)(void* idx);
+  };
+  std::unordered_map<std::string, TypedIndex> hash_idxs_;
+  std::unordered_map<std::string, TypedIndex> btree_idxs_;
+
+  template <class Index>
+  static Index* get_typed_index(
+      const std::unordered_map<std::string, TypedIndex>& idxs,
+      const std::string& name) {
+    auto it = idxs.find(name);
+    if (it == idxs.end() || *it->second.type != typeid(Index)) return nullptr;
+    return static_cast<Index*>(it->second.idx);
+  }
 
   // Modified by leader/worker threads very infrequently.
   volatile uint16_t leader_thread_id_;
@@ -336,9 +545,12 @@ class DB {
   // Modified by the leader thread.
   ConcurrentTimestamp min_wts_ __attribute__((aligned(64)));
   ConcurrentTimestamp min_rts_;
+  ConcurrentTimestamp durable_ts_;
   volatile uint64_t ref_clock_;
   // volatile uint64_t gc_epoch_;
 
+  volatile int64_t log_sync_interval_;
+
   volatile double backoff_;
   uint64_t last_backoff_print_;
   uint64_t last_backoff_update_;
@@ -352,6 +564,16 @@ class DB {
   // Modified by worker threads.
   struct ThreadState {
     volatile bool quiescence;
+
+    // The timestamp of the last transaction of this thread when its log was
+    // made durable.
+    ConcurrentTimestamp durable_ts;
+    uint64_t last_log_sync;
+    // Set if the thread was deactivated with a log that could not be made
+    // durable; its durable_ts then holds back durable_ts() until a later
+    // sync_log() succeeds.
+    volatile bool log_unsynced;
+    std::deque<std::pair<Timestamp, std::function<void()>>> durable_callbacks;
   } __attribute__((aligned(64)));
 
   ThreadState thread_states_[StaticConfig::kMaxLCoreCount];
@@ -362,5 +584,6 @@ class DB {
 
 #include "db_impl.h"
 #include "db_print_stats.h"
+#include "db_warm_restart.h"
 
 #endif
@@ -53,7 +53,14 @@ DB<StaticConfig>::DB(PagePool<StaticConfig>** page_pools, Logger* logger,
 
   min_wts_.init(ctxs_[0]->generate_timestamp());
   min_rts_.init(min_wts_.get());
+  durable_ts_.init(min_wts_.get());
+  for (uint16_t thread_id = 0; thread_id < num_threads_; thread_id++) {
+    thread_states_[thread_id].durable_ts.init(min_wts_.get());
+    thread_states_[thread_id].last_log_sync = 0;
+    thread_states_[thread_id].log_unsynced = false;
+  }
   ref_clock_ = 0;
+  log_sync_interval_ = StaticConfig::kMinLogSyncInterval;
   // gc_epoch_ = 0;
 }
 
@@ -139,6 +146,108 @@ bool DB<StaticConfig>::create_btree_index_nonunique_u64(
   return true;
 }
 
+template <class StaticConfig>
+bool DB<StaticConfig>::create_btree_index_unique_string(
+    std::string name, Table<StaticConfig>* main_tbl) {
+  if (btree_idxs_unique_string_.find(name) != btree_idxs_unique_string_.end())
+    return false;
+
+  const uint64_t kDataSizes[] = {BTreeIndexUniqueString::kDataSize};
+  auto idx = new BTreeIndexUniqueString(
+      this, main_tbl, new Table<StaticConfig>(this, 1, kDataSizes));
+  btree_idxs_unique_string_[name] = idx;
+  return true;
+}
+
+template <class StaticConfig>
+bool DB<StaticConfig>::create_btree_index_nonunique_string(
+    std::string name, Table<StaticConfig>* main_tbl) {
+  if (btree_idxs_nonunique_string_.find(name) !=
+      btree_idxs_nonunique_string_.end())
+    return false;
+
+  const uint64_t kDataSizes[] = {BTreeIndexNonuniqueString::kDataSize};
+  auto idx = new BTreeIndexNonuniqueString(
+      this, main_tbl, new Table<StaticConfig>(this, 1, kDataSizes));
+  btree_idxs_nonunique_string_[name] = idx;
+  return true;
+}
+
+template <class StaticConfig>
+bool DB<StaticConfig>::create_art_index_unique_u64(
+    std::string name, Table<StaticConfig>* main_tbl) {
+  if (art_idxs_unique_u64_.find(name) != art_idxs_unique_u64_.end())
+    return false;
+
+  const uint64_t kDataSizes[] = {ARTIndexUniqueU64::kDataSize};
+  auto idx = new ARTIndexUniqueU64(
+      this, main_tbl, new Table<StaticConfig>(this, 1, kDataSizes));
+  art_idxs_unique_u64_[name] = idx;
+  return true;
+}
+
+template <class StaticConfig>
+bool DB<StaticConfig>::create_olc_btree_index_unique_u64(
+    std::string name, Table<StaticConfig>* main_tbl) {
+  if (olc_btree_idxs_unique_u64_.find(name) !=
+      olc_btree_idxs_unique_u64_.end())
+    return false;
+
+  // The index does not need an index table.
+  auto idx = new OLCBTreeIndexUniqueU64(this, main_tbl);
+  olc_btree_idxs_unique_u64_[name] = idx;
+  return true;
+}
+
+template <class StaticConfig>
+void DB<StaticConfig>::rebuild_volatile_indexes() {
+  for (auto& it : olc_btree_idxs_unique_u64_) it.second->rebuild();
+
+  for (auto& it : hash_idxs_unique_u64_) it.second->rebuild_filter();
+  for (auto& it : hash_idxs_nonunique_u64_) it.second->rebuild_filter();
+  for (auto& it : hash_idxs_) it.second.rebuild_filter(it.second.idx);
+}
+
+template <class StaticConfig>
+void DB<StaticConfig>::disable_index_filters() {
+  for (auto& it : hash_idxs_unique_u64_) it.second->disable_filter();
+  for (auto& it : hash_idxs_nonunique_u64_) it.second->disable_filter();
+  for (auto& it : hash_idxs_) it.second.disable_filter(it.second.idx);
+}
+
+template <class StaticConfig>
+template <class Key, bool UniqueKey>
+bool DB<StaticConfig>::create_hash_index(std::string name,
+                                         Table<StaticConfig>* main_tbl,
+                                         uint64_t expected_row_count) {
+  typedef HashIndexT<Key, UniqueKey> Index;
+  if (hash_idxs_.find(name) != hash_idxs_.end()) return false;
+
+  const uint64_t kDataSizes[] = {Index::kDataSize};
+  auto idx =
+      new Index(this, main_tbl, new Table<StaticConfig>(this, 1, kDataSizes),
+                expected_row_count);
+  hash_idxs_[name] = TypedIndex{
+      &typeid(Index), idx,
+      [](void* p) { static_cast<Index*>(p)->rebuild_filter(); },
+      [](void* p) { static_cast<Index*>(p)->disable_filter(); }};
+  return true;
+}
+
+template <class StaticConfig>
+template <class Key, bool UniqueKey>
+bool DB<StaticConfig>::create_btree_index(std::string name,
+                                          Table<StaticConfig>* main_tbl) {
+  typedef BTreeIndexT<Key, UniqueKey> Index;
+  if (btree_idxs_.find(name) != btree_idxs_.end()) return false;
+
+  const uint64_t kDataSizes[] = {Index::kDataSize};
+  auto idx =
+      new Index(this, main_tbl, new Table<StaticConfig>(this, 1, kDataSizes));
+  btree_idxs_[name] = TypedIndex{&typeid(Index), idx, nullptr, nullptr};
+  return true;
+}
+
 template <class StaticConfig>
 void DB<StaticConfig>::activate(uint16_t thread_id) {
   // printf("DB::activate(): thread_id=%hu\n", thread_id);
@@ -194,6 +303,15 @@ void DB<StaticConfig>::deactivate(uint16_t thread_id) {
     quiescence(thread_id);
   }
 
+  // The leader ignores inactive threads when advancing durable_ts, so the log
+  // of this thread must be durable before it stops.
+  if (!sync_log(thread_id)) {
+    printf("DB::deactivate(): failed to sync the log of thread %" PRIu16 "\n",
+           thread_id);
+    thread_states_[thread_id].log_unsynced = true;
+  }
+  ::mica::util::memory_barrier();
+
   thread_active_[thread_id] = false;
 
   if (leader_thread_id_ == thread_id)
@@ -208,6 +326,23 @@ void DB<StaticConfig>::reset_clock(uint16_t thread_id) {
   clock_init_[thread_id] = false;
 }
 
+template <class StaticConfig>
+void DB<StaticConfig>::advance_clock(const Timestamp& ts) {
+  assert(active_thread_count_ == 0);
+
+  if (static_cast<int64_t>(ts.clock() + 1 - ref_clock_) > 0)
+    ref_clock_ = ts.clock() + 1;
+  for (uint16_t thread_id = 0; thread_id < num_threads_; thread_id++)
+    clock_init_[thread_id] = false;
+
+  if (min_wts_.get() < ts) min_wts_.write(ts);
+  if (min_rts_.get() < ts) min_rts_.write(ts);
+  if (durable_ts_.get() < ts) durable_ts_.write(ts);
+  for (uint16_t thread_id = 0; thread_id < num_threads_; thread_id++)
+    if (thread_states_[thread_id].durable_ts.get() < ts)
+      thread_states_[thread_id].durable_ts.write(ts);
+}
+
 template <class StaticConfig>
 void DB<StaticConfig>::idle(uint16_t thread_id) {
   quiescence(thread_id);
@@ -218,6 +353,28 @@ void DB<StaticConfig>::idle(uint16_t thread_id) {
 
 template <class StaticConfig>
 void DB<StaticConfig>::quiescence(uint16_t thread_id) {
+  auto& state = thread_states_[thread_id];
+
+  // Group commit.
+  auto log_sync_interval = log_sync_interval_;
+  if (log_sync_interval != kNoPeriodicLogSync) {
+    auto now = sw_->now();
+    if (now - state.last_log_sync >=
+        static_cast<uint64_t>(log_sync_interval) * sw_->c_1_usec()) {
+      sync_log(thread_id);
+      state.last_log_sync = now;
+    }
+  }
+
+  if (!state.durable_callbacks.empty()) {
+    auto durable_ts = durable_ts_.get();
+    while (!state.durable_callbacks.empty() &&
+           state.durable_callbacks.front().first <= durable_ts) {
+      state.durable_callbacks.front().second();
+      state.durable_callbacks.pop_front();
+    }
+  }
+
   ::mica::util::memory_barrier();
 
   thread_states_[thread_id].quiescence = true;
@@ -248,19 +405,35 @@ void DB<StaticConfig>::quiescence(uint16_t thread_id) {
   bool first = true;
   Timestamp min_wts;
   Timestamp min_rts;
+  Timestamp min_durable_ts;
+  bool has_unsynced = false;
+  Timestamp min_unsynced_ts;
 
   for (i = 0; i < num_threads_; i++) {
-    if (!thread_active_[i]) continue;
+    if (!thread_active_[i]) {
+      // This thread has commits that are not durable yet.
+      if (thread_states_[i].log_unsynced) {
+        auto thread_durable_ts = thread_states_[i].durable_ts.get();
+        if (!has_unsynced || min_unsynced_ts > thread_durable_ts)
+          min_unsynced_ts = thread_durable_ts;
+        has_unsynced = true;
+      }
+      continue;
+    }
 
     auto wts = ctxs_[i]->wts();
     auto rts = ctxs_[i]->rts();
+    auto thread_durable_ts = thread_states_[i].durable_ts.get();
     if (first) {
       min_wts = wts;
       min_rts = rts;
+      min_durable_ts = thread_durable_ts;
       first = false;
     } else {
       if (min_wts > wts) min_wts = wts;
       if (min_rts > rts) min_rts = rts;
+      if (min_durable_ts > thread_durable_ts)
+        min_durable_ts = thread_durable_ts;
     }
 
     thread_states_[i].quiescence = false;
@@ -278,6 +451,12 @@ void DB<StaticConfig>::quiescence(uint16_t thread_id) {
 
     if (min_wts_.get() < min_wts) min_wts_.write(min_wts);
 
+    // A thread's durable_ts is no later than its wts, so this does not
+    // exceed min_wts; any future commit will have a later timestamp.
+    if (has_unsynced && min_durable_ts > min_unsynced_ts)
+      min_durable_ts = min_unsynced_ts;
+    if (durable_ts_.get() < min_durable_ts) durable_ts_.write(min_durable_ts);
+
     if (min_rts_.get() <= min_rts) {
       min_rts_.write(min_rts);
 
@@ -287,6 +466,37 @@ void DB<StaticConfig>::quiescence(uint16_t thread_id) {
   }
 }
 
+template <class StaticConfig>
+bool DB<StaticConfig>::sync_log(uint16_t thread_id) {
+  auto& state = thread_states_[thread_id];
+
+  // No transaction of this thread is running here, so syncing the log makes
+  // all transactions up to the current wts durable.
+  auto wts = ctxs_[thread_id]->wts();
+  if (!logger_->sync(thread_id)) return false;
+  if (state.durable_ts.get() < wts) state.durable_ts.write(wts);
+  ::mica::util::memory_barrier();
+  state.log_unsynced = false;
+  return true;
+}
+
+template <class StaticConfig>
+void DB<StaticConfig>::wait_for_durability(uint16_t thread_id,
+                                           const Timestamp& ts) {
+  while (durable_ts() < ts) {
+    ::mica::util::pause();
+
+    // Keep the clock and timestamps advancing so that durable_ts can catch up.
+    idle(thread_id);
+  }
+}
+
+template <class StaticConfig>
+void DB<StaticConfig>::on_durable(uint16_t thread_id, const Timestamp& ts,
+                                  std::function<void()> callback) {
+  thread_states_[thread_id].durable_callbacks.emplace_back(ts, callback);
+}
+
 template <class StaticConfig>
 void DB<StaticConfig>::update_backoff(uint16_t thread_id) {
   if (leader_thread_id_ != thread_id) return;
@@ -0,0 +1,198 @@
+#pragma once
+#ifndef MICA_TRANSACTION_DB_WARM_RESTART_H_
+#define MICA_TRANSACTION_DB_WARM_RESTART_H_
+
+#include <algorithm>
+#include "mica/transaction/saved_state.h"
+
+namespace mica {
+namespace transaction {
+// The saved state is kept in a chain of pages of page pool 0.
+struct SavedStatePage {
+  static constexpr uint64_t kMagic = 0x4554415453424455ULL;  // "UDBSTATE"
+
+  char* next;
+  uint64_t len;
+};
+
+template <class StaticConfig>
+bool DB<StaticConfig>::detach() {
+  if (active_thread_count_ != 0) {
+    printf("cannot detach the database with active threads\n");
+    return false;
+  }
+  for (uint8_t numa_id = 0; numa_id < num_numa_; numa_id++) {
+    if (!page_pools_[numa_id]->is_persistent()) {
+      printf("page pool %" PRIu8 " is not persistent\n", numa_id);
+      return false;
+    }
+  }
+
+  SavedStateWriter w;
+  w.write(uint64_t(SavedStatePage::kMagic));
+  w.write(num_numa_);
+  w.write(table_count());
+
+  // Later timestamps must follow those in the saved rows.
+  Timestamp last_ts = min_wts();
+  for (uint16_t thread_id = 0; thread_id < num_threads_; thread_id++)
+    if (last_ts < ctxs_[thread_id]->wts()) last_ts = ctxs_[thread_id]->wts();
+  w.write(last_ts);
+
+  for (uint16_t thread_id = 0; thread_id < num_threads_; thread_id++)
+    row_version_pools_[thread_id]->return_all();
+  for (uint8_t numa_id = 0; numa_id < num_numa_; numa_id++)
+    shared_row_version_pools_[numa_id]->save_state(w);
+
+  for (auto tbl : tables_by_id_) tbl->save_state(w);
+
+  // Free rows and pending GC of each context refer to tables by ID.
+  w.write(num_threads_);
+  for (uint16_t thread_id = 0; thread_id < num_threads_; thread_id++) {
+    auto ctx = ctxs_[thread_id];
+
+    w.write(uint64_t(ctx->free_rows_.size()));
+    for (auto& e : ctx->free_rows_) {
+      w.write(e.first->id());
+      w.write_vector(e.second);
+    }
+
+    auto gc_items = ctx->gc_items_;
+    w.write(uint64_t(gc_items.size()));
+    while (!gc_items.empty()) {
+      auto& item = gc_items.front();
+      w.write(item.wts);
+      w.write(item.tbl->id());
+      w.write(item.cf_id);
+      w.write(item.deleted);
+      w.write(item.row_id);
+      w.write(item.head);
+      w.write(item.write_rv);
+      gc_items.pop();
+    }
+  }
+
+  auto& buf = w.buf();
+  auto pool = page_pools_[0];
+  constexpr uint64_t kChunkSize =
+      PagePool<StaticConfig>::kPageSize - sizeof(SavedStatePage);
+
+  char* first_page = nullptr;
+  char** link = &first_page;
+  for (uint64_t off = 0; off < buf.size(); off += kChunkSize) {
+    auto page = pool->allocate();
+    if (page == nullptr) {
+      printf("failed to allocate pages to save the database state\n");
+      return false;
+    }
+    auto page_h = reinterpret_cast<SavedStatePage*>(page);
+    page_h->next = nullptr;
+    page_h->len = std::min(kChunkSize, uint64_t(buf.size() - off));
+    ::mica::util::memcpy(page_h + 1, buf.data() + off, page_h->len);
+
+    *link = page;
+    link = &page_h->next;
+  }
+
+  for (uint8_t numa_id = 0; numa_id < num_numa_; numa_id++)
+    page_pools_[numa_id]->detach(numa_id == 0 ? first_page : nullptr);
+
+  printf("detached the database (%zu bytes of state)\n", buf.size());
+  return true;
+}
+
+template <class StaticConfig>
+bool DB<StaticConfig>::reattach() {
+  if (active_thread_count_ != 0) {
+    printf("cannot reattach the database with active threads\n");
+    return false;
+  }
+  for (uint8_t numa_id = 0; numa_id < num_numa_; numa_id++) {
+    if (!page_pools_[numa_id]->is_reattached()) {
+      printf("page pool %" PRIu8 " is not reattached\n", numa_id);
+      return false;
+    }
+  }
+
+  auto pool = page_pools_[0];
+  std::vector<char> buf;
+  std::vector<char*> pages;
+  for (auto page = pool->saved_state(); page != nullptr;
+       page = reinterpret_cast<SavedStatePage*>(page)->next) {
+    auto page_h = reinterpret_cast<SavedStatePage*>(page);
+    auto p = reinterpret_cast<const char*>(page_h + 1);
+    buf.insert(buf.end(), p, p + page_h->len);
+    pages.push_back(page);
+  }
+
+  SavedStateReader r(buf.data(), buf.size());
+  uint64_t magic;
+  uint8_t numa_count;
+  uint16_t table_count;
+  Timestamp last_ts;
+  if (!r.read(&magic) || magic != SavedStatePage::kMagic ||
+      !r.read(&numa_count) || !r.read(&table_count) || !r.read(&last_ts)) {
+    printf("invalid saved database state\n");
+    return false;
+  }
+  if (numa_count != num_numa_ || table_count != this->table_count()) {
+    printf("saved database state does not match the database\n");
+    return false;
+  }
+
+  for (uint8_t numa_id = 0; numa_id < num_numa_; numa_id++)
+    if (!shared_row_version_pools_[numa_id]->restore_state(r)) return false;
+
+  for (auto tbl : tables_by_id_)
+    if (!tbl->restore_state(r)) return false;
+
+  // The state of contexts is given to the contexts with the same thread ID
+  // modulo the current thread count.
+  uint16_t thread_count;
+  if (!r.read(&thread_count)) return false;
+  for (uint16_t thread_id = 0; thread_id < thread_count; thread_id++) {
+    auto ctx = ctxs_[thread_id % num_threads_];
+
+    uint64_t free_rows_count;
+    if (!r.read(&free_rows_count)) return false;
+    for (uint64_t i = 0; i < free_rows_count; i++) {
+      uint16_t table_id;
+      std::vector<uint64_t> row_ids;
+      if (!r.read(&table_id) || table_id >= table_count ||
+          !r.read_vector(&row_ids))
+        return false;
+      auto& free_row_ids = ctx->free_rows_[tables_by_id_[table_id]];
+      free_row_ids.insert(free_row_ids.end(), row_ids.begin(), row_ids.end());
+    }
+
+    uint64_t gc_item_count;
+    if (!r.read(&gc_item_count)) return false;
+    for (uint64_t i = 0; i < gc_item_count; i++) {
+      typename Context<StaticConfig>::GCItem item;
+      uint16_t table_id;
+      if (!r.read(&item.wts) || !r.read(&table_id) ||
+          table_id >= table_count || !r.read(&item.cf_id) ||
+          !r.read(&item.deleted) || !r.read(&item.row_id) ||
+          !r.read(&item.head) || !r.read(&item.write_rv))
+        return false;
+      item.tbl = tables_by_id_[table_id];
+      ctx->gc_items_.push(item);
+    }
+  }
+  if (!r.at_end()) {
+    printf("invalid saved database state\n");
+    return false;
+  }
+
+  for (auto page : pages) pool->free(page);
+
+  advance_clock(last_ts);
+  rebuild_volatile_indexes();
+
+  printf("reattached the database (%zu bytes of state)\n", buf.size());
+  return true;
+}
+}
+}
+
+#endif
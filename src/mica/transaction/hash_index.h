@@ -2,6 +2,9 @@
 #ifndef MICA_TRANSACTION_HASH_INDEX_H_
 #define MICA_TRANSACTION_HASH_INDEX_H_
 
+#include <immintrin.h>
+#include <utility>
+#include <vector>
 #include "mica/common.h"
 #include "mica/util/type_traits.h"
 
@@ -11,6 +14,9 @@ template <class StaticConfig, bool UniqueKey, class Key,
           class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>>
 class HashIndex;
 
+template <class StaticConfig>
+class BulkLoader;
+
 template <class StaticConfig, bool UniqueKey, class Key,
           class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>>
 class HashIndexBucketCopier {
@@ -26,7 +32,8 @@ class HashIndexBucketCopier {
     auto dest_bucket = reinterpret_cast<Bucket*>(dest->data);
     auto src_bucket = reinterpret_cast<const Bucket*>(src->data);
 
-    dest_bucket->next = src_bucket->next;
+    // Copy the chain pointer, fingerprints, and split information at once.
+    ::mica::util::memcpy(dest_bucket, src_bucket, Bucket::kHeaderSize);
 
     ::mica::util::memcpy(dest_bucket->keys, src_bucket->keys,
                          sizeof(Bucket::keys));
@@ -53,28 +60,128 @@ class HashIndex {
   typedef ::mica::transaction::RowAccessHandlePeekOnly<StaticConfig>
       RowAccessHandlePeekOnly;
   typedef ::mica::transaction::Transaction<StaticConfig> Transaction;
+  typedef typename StaticConfig::ConcurrentTimestamp ConcurrentTimestamp;
 
+  // A bucket keeps a 1-byte fingerprint of each slot next to the chain
+  // pointer so that a lookup can find candidate slots with one SIMD compare
+  // before touching any key.  An empty slot has kEmptyFingerprint.
+  //
+  // The index grows by splitting full buckets (hash_index_impl/split.h).  A
+  // bucket with index i at level l holds the keys whose hash satisfies
+  // hash % (bucket_count_ << l) == i; splitting it moves the keys with the
+  // next hash bit set to a new bucket i + (bucket_count_ << l), and both end
+  // up at level l + 1.  Overflow buckets in a chain have kOverflowIndex.
+  //
+  // With u64 keys, a bucket is 128 bytes (two cache lines): the header with
+  // the fingerprints and the first key share the first line.  Seven slots
+  // would make it 160 bytes, touching a third line for the last slots.
   struct Bucket {
-    // static constexpr size_t kBucketSize = 13;	// (216 - 8) / 16
-    // static constexpr size_t kBucketSize = 9;	// (152 - 8) / 16
-    // static constexpr size_t kBucketSize = 5;	// (88 - 8) / 16
-    static constexpr size_t kBucketSize = 1;  // (24 - 8) / 16
+    // static constexpr size_t kBucketSize = 1;  // (64 - 48) / 16
+    // static constexpr size_t kBucketSize = 3;  // (96 - 48) / 16
+    static constexpr size_t kBucketSize = 5;  // (128 - 48) / 16
 
     uint64_t next;
 
+    uint8_t fingerprints[8];
+
+    uint64_t index;
+    uint64_t level;
+    // The bucket created by the latest split of this bucket.
+    uint64_t split_row_id;
+    // The bucket created by the split of the parent bucket just before the
+    // one that created this bucket.
+    uint64_t prev_split_row_id;
+
+    static constexpr size_t kHeaderSize = 48;
+
     Key keys[kBucketSize];
     uint64_t values[kBucketSize];
   };
   static constexpr uint64_t kDataSize = sizeof(Bucket);
+  static_assert(Bucket::kBucketSize <= 8, "too many slots for fingerprints");
+  static_assert(offsetof(Bucket, keys) == Bucket::kHeaderSize,
+                "unexpected bucket layout");
+  static_assert(sizeof(Key) != 8 || sizeof(Bucket) == 128,
+                "a bucket must be two cache lines with u64 keys");
+
+  // A non-unique index has one slot per key like a unique index.  A key with
+  // a single value keeps it in the slot.  Once a key has more values, the
+  // slot has the row ID of the head block of the key's posting list
+  // (hash_index_impl/posting.h) tagged with kPostingListTag.  The blocks are
+  // index table rows of the same size as buckets, so a posting list costs at
+  // least one more row and one more row access per lookup or update of the
+  // key.  A block stores each value as a zigzag varint of its difference from
+  // the previous value in the block, so row IDs inserted in roughly ascending
+  // order take 1-2 bytes each.  The head block also points to the last
+  // block, to which new values are appended.  A posting list is not turned
+  // back into a single value when values are removed.
+  struct PostingBlock {
+    uint64_t next;
+    // The last block of the posting list; only valid in the head block.
+    uint64_t tail;
+    // The value that the next appended value is encoded against.
+    uint64_t last_value;
+    uint32_t count;
+    uint32_t size;
+
+    static constexpr size_t kHeaderSize = 32;
+
+    uint8_t data[sizeof(Bucket) - kHeaderSize];
+  };
+  static_assert(sizeof(PostingBlock) == sizeof(Bucket),
+                "unexpected posting block size");
+  static_assert(offsetof(PostingBlock, data) == PostingBlock::kHeaderSize,
+                "unexpected posting block layout");
+
+  // Every value takes at least one byte.
+  static constexpr size_t kMaxPostingBlockValues = sizeof(PostingBlock::data);
+
+  // Marks a slot value of a non-unique index as a posting list.  Values of a
+  // non-unique index must not have this bit set (row IDs never do).
+  static constexpr uint64_t kPostingListTag = uint64_t(1) << 63;
+
+  // The filter (hash_index_impl/filter.h) is a blocked Bloom filter outside
+  // the index table that answers whether a key has ever been inserted.  A key
+  // sets kFilterHashCount bits in one word of a block, so a single atomic OR
+  // adds it.  Bits are never cleared; removed keys and keys of aborted
+  // inserts only cause false positives.  A transaction that has relied on
+  // a key's absence raises the rts of the block, and an insert aborts if it
+  // finds the rts above its timestamp after setting its bits, as writing a
+  // row version would.  One rts covers all keys hashed to the block (about
+  // 56 keys at 8 bits per key), so a read of any absent key aborts every
+  // insert of those keys with an earlier timestamp.
+  struct FilterBlock {
+    ConcurrentTimestamp rts;
+    volatile uint64_t
+        words[(64 - sizeof(ConcurrentTimestamp)) / sizeof(uint64_t)];
+  };
+  static_assert(sizeof(FilterBlock) <= 64, "filter block too large");
+
+  static constexpr bool kUseFilter =
+      StaticConfig::kHashIndexFilterBitsPerKey != 0;
+  static constexpr uint64_t kFilterWordsPerBlock =
+      sizeof(FilterBlock::words) / sizeof(uint64_t);
+  static constexpr uint64_t kFilterHashCount = 4;
+
+  static constexpr uint8_t kEmptyFingerprint = 0;
 
   static constexpr uint64_t kNullRowID = static_cast<uint64_t>(-1);
 
+  static constexpr uint64_t kOverflowIndex = static_cast<uint64_t>(-1);
+
+  // The number of directory entries allocated at once.
+  static constexpr uint64_t kDirectoryChunkSize = 4096;
+
   static constexpr uint64_t kHaveToAbort = static_cast<uint64_t>(-1);
 
+  // The number of keys whose lookups multi_lookup() interleaves.
+  static constexpr uint64_t kMultiLookupBatchSize = 16;
+
   // hash_index_impl/init.h
   HashIndex(DB<StaticConfig>* db, Table<StaticConfig>* main_tbl,
             Table<StaticConfig>* idx_tbl, uint64_t expected_num_rows,
             const Hash& hash = Hash(), const KeyEqual& key_equal = KeyEqual());
+  ~HashIndex();
 
   bool init(Transaction* tx);
 
@@ -89,9 +196,41 @@ class HashIndex {
   uint64_t lookup(Transaction* tx, const Key& key, bool skip_validation,
                   const Func& func);
 
+  // Looks up n keys with their cache misses overlapped.  func(i, key, value)
+  // is called for each match of keys[i]; returning false skips the remaining
+  // matches of keys[i].  If prefetch_rows is true, the values must be row IDs
+  // of the main table, and their rows are prefetched before func is called.
+  template <typename Func>
+  uint64_t multi_lookup(Transaction* tx, const Key* keys, uint64_t n,
+                        bool skip_validation, const Func& func,
+                        bool prefetch_rows = false);
+
+  // hash_index_impl/bulk_load.h
+  // Adds the entries collected by loading threads without transactions (see
+  // BulkLoader).  The entries are partitioned by bucket and each loading
+  // thread fills the buckets of its partition.  The index must not have been
+  // split; size it with expected_num_rows to avoid long chains.  For a unique
+  // index, only the first entry of a key in entries is added unless the key
+  // already exists.  The number of added entries is stored in inserted if
+  // given.
+  bool bulk_load(
+      BulkLoader<StaticConfig>* loader,
+      const std::vector<std::vector<std::pair<Key, uint64_t>>>& entries,
+      uint64_t* inserted = nullptr);
+
   // hash_index_impl/prefetch.h
   void prefetch(Transaction* tx, const Key& key);
 
+  // hash_index_impl/filter.h
+  // Sets the filter bits from the keys in the buckets.  The filter is not in
+  // the index table, so it must be rebuilt after the table has been restored
+  // without the index (see DB::rebuild_volatile_indexes()).  No transaction
+  // may be running.
+  void rebuild_filter();
+  // Stops using the filter for good, e.g., on a replica whose buckets are
+  // written from shipped logs without going through the index.
+  void disable_filter() { filter_enabled_ = false; }
+
   Table<StaticConfig>* main_table() { return main_tbl_; }
   const Table<StaticConfig>* main_table() const { return main_tbl_; }
 
@@ -110,20 +249,101 @@ class HashIndex {
 
   DataCopier data_copier_;
 
+  // The number of buckets at level 0.
   uint64_t bucket_count_;
   uint64_t bucket_count_mask_;
+  uint64_t bucket_count_bits_;
+
+  // The row IDs of buckets at levels above 0, indexed by the bucket index.
+  // This is only a hint; entries are validated against the bucket.
+  volatile uint64_t** directory_;
+  uint64_t directory_chunk_count_;
+  volatile uint64_t max_level_;
+
+  // The filter blocks, aligned to cache lines inside filter_mem_.
+  char* filter_mem_;
+  FilterBlock* filter_;
+  uint64_t filter_block_mask_;
+  volatile bool filter_enabled_;
 
   // hash_index_impl/bucket.h
-  uint64_t get_bucket_id(const Key& key) const;
+  uint64_t get_hash(const Key& key) const;
+  uint64_t get_bucket_id(uint64_t hash) const;
+  static uint8_t get_fingerprint(uint64_t hash);
+  static uint32_t match_fingerprints(const Bucket* bkt, uint8_t fingerprint);
+  static void init_bucket(Bucket* bkt, uint64_t index, uint64_t level);
+  bool covers(const Bucket* bkt, uint64_t index, uint64_t hash) const;
+
+  // hash_index_impl/filter.h
+  FilterBlock* get_filter_word(uint64_t hash, volatile uint64_t** word,
+                               uint64_t* mask) const;
+  // Returns false if no key with the hash has been inserted.  Unless
+  // skip_validation, an absent key stays absent until the transaction ends.
+  bool filter_may_contain(Transaction* tx, uint64_t hash,
+                          bool skip_validation);
+  // Returns false if the transaction has to abort.
+  bool filter_add(Transaction* tx, uint64_t hash);
+  void filter_load(uint64_t hash);
+  void filter_load_buckets(uint64_t row_id);
+  bool use_filter() const { return kUseFilter && filter_enabled_; }
+
+  // hash_index_impl/split.h
+  uint64_t get_directory(uint64_t index) const;
+  void set_directory(uint64_t index, uint64_t level, uint64_t row_id);
+  uint64_t known_bucket(uint64_t hash, uint64_t max_level, uint64_t* index,
+                        uint64_t* level) const;
+  const Bucket* peek_bucket(Transaction* tx, uint64_t row_id,
+                            uint64_t index);
+  bool find_bucket(Transaction* tx, uint64_t hash, uint64_t* index,
+                   uint64_t* row_id);
+  bool split(Transaction* tx, uint64_t index, uint64_t row_id);
+
+  // hash_index_impl/posting.h
+  static bool is_posting_list(uint64_t slot_value) {
+    return !UniqueKey && (slot_value & kPostingListTag) != 0;
+  }
+  static uint64_t posting_head_id(uint64_t slot_value) {
+    return slot_value & ~kPostingListTag;
+  }
+  static void init_posting_block(PostingBlock* blk);
+  // Returns false if the block has no room for the value.
+  static bool append_posting_value(PostingBlock* blk, uint64_t value);
+  // Calls func(value) for each value in the block until func returns false.
+  // Returns false if func has returned false.
+  template <typename Func>
+  static bool for_each_posting_value(const PostingBlock* blk,
+                                     const Func& func);
+  uint64_t new_posting_list(Transaction* tx, uint64_t value1,
+                            uint64_t value2);
+  uint64_t insert_posting(Transaction* tx, uint64_t head_id, uint64_t value);
+  uint64_t remove_posting(Transaction* tx, uint64_t head_id, uint64_t value,
+                          bool* emptied);
+  template <typename Func>
+  uint64_t lookup_posting(Transaction* tx, const Key& key, uint64_t head_id,
+                          bool skip_validation, const Func& func);
+
+  // hash_index_impl/bulk_load.h
+  char* loaded_data(uint64_t row_id);
+  Bucket* loaded_bucket(uint64_t row_id);
+  PostingBlock* loaded_posting_block(uint64_t row_id);
+  uint64_t load_posting_list(BulkLoader<StaticConfig>* loader,
+                             uint16_t thread_id, uint64_t value1,
+                             uint64_t value2);
+  bool load_posting_value(BulkLoader<StaticConfig>* loader, uint16_t thread_id,
+                          uint64_t head_id, uint64_t value);
 };
 }
 }
 
 #include "hash_index_impl/init.h"
 #include "hash_index_impl/bucket.h"
+#include "hash_index_impl/filter.h"
+#include "hash_index_impl/split.h"
+#include "hash_index_impl/posting.h"
 #include "hash_index_impl/insert.h"
 #include "hash_index_impl/remove.h"
 #include "hash_index_impl/lookup.h"
 #include "hash_index_impl/prefetch.h"
+#include "hash_index_impl/bulk_load.h"
 
 #endif
@@ -6,13 +6,64 @@ namespace mica {
 namespace transaction {
 template <class StaticConfig, bool UniqueKey, class Key, class Hash,
           class KeyEqual>
-uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash,
-                   KeyEqual>::get_bucket_id(const Key& key) const {
+uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::get_hash(
+    const Key& key) const {
   // Constant from CityHash.
-  return (hash_(key) * 0x9ddfea08eb382d69ULL) & bucket_count_mask_;
-  // return (key * 0x9ddfea08eb382d69ULL) % bucket_count_;
+  return static_cast<uint64_t>(hash_(key)) * 0x9ddfea08eb382d69ULL;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash,
+                   KeyEqual>::get_bucket_id(uint64_t hash) const {
+  return hash & bucket_count_mask_;
+  // return hash % bucket_count_;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+uint8_t HashIndex<StaticConfig, UniqueKey, Key, Hash,
+                  KeyEqual>::get_fingerprint(uint64_t hash) {
+  // Use the top bits, which do not overlap with the bucket ID.
+  auto fingerprint = static_cast<uint8_t>(hash >> 56);
+  if (fingerprint == kEmptyFingerprint) fingerprint = 1;
+  return fingerprint;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+uint32_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::
+    match_fingerprints(const Bucket* bkt, uint8_t fingerprint) {
+  // Returns a bitmask of the slots that have the given fingerprint.
+  __m128i v =
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bkt->fingerprints));
+  __m128i r = _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(fingerprint)));
+  return static_cast<uint32_t>(_mm_movemask_epi8(r)) &
+         ((1U << Bucket::kBucketSize) - 1);
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+void HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::init_bucket(
+    Bucket* bkt, uint64_t index, uint64_t level) {
+  bkt->next = kNullRowID;
+  for (size_t j = 0; j < sizeof(Bucket::fingerprints); j++)
+    bkt->fingerprints[j] = kEmptyFingerprint;
+  bkt->index = index;
+  bkt->level = level;
+  bkt->split_row_id = kNullRowID;
+  bkt->prev_split_row_id = kNullRowID;
+  for (size_t j = 0; j < Bucket::kBucketSize; j++) bkt->values[j] = kNullRowID;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+bool HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::covers(
+    const Bucket* bkt, uint64_t index, uint64_t hash) const {
+  return bkt->index == index &&
+         (hash & ((bucket_count_ << bkt->level) - 1)) == index;
 }
 }
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,252 @@
+#pragma once
+#ifndef MICA_TRANSACTION_HASH_INDEX_IMPL_BULK_LOAD_H_
+#define MICA_TRANSACTION_HASH_INDEX_IMPL_BULK_LOAD_H_
+
+#include <algorithm>
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+bool HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::bulk_load(
+    BulkLoader<StaticConfig>* loader,
+    const std::vector<std::vector<std::pair<Key, uint64_t>>>& entries,
+    uint64_t* inserted) {
+  struct Item {
+    uint64_t hash;
+    Key key;
+    uint64_t value;
+  };
+
+  if (max_level_ != 0) {
+    printf("HashIndex::bulk_load(): index has been split\n");
+    return false;
+  }
+
+  auto num_threads = loader->num_threads();
+
+  // Partition the entries by bucket ID range so that no two threads write to
+  // the same bucket chain.  parts[t][p] holds the items partitioned by thread
+  // t for partition p.
+  std::vector<std::vector<std::vector<Item>>> parts(num_threads);
+  loader->run([&](uint16_t thread_id) {
+    auto& my_parts = parts[thread_id];
+    my_parts.resize(num_threads);
+    auto i_begin = entries.size() * thread_id / num_threads;
+    auto i_end = entries.size() * (thread_id + 1) / num_threads;
+    for (auto i = i_begin; i < i_end; i++) {
+      for (auto& e : entries[i]) {
+        auto hash = get_hash(e.first);
+        if (kUseFilter) filter_load(hash);
+        auto p = get_bucket_id(hash) * num_threads / bucket_count_;
+        my_parts[p].push_back(Item{hash, e.first, e.second});
+      }
+    }
+    return true;
+  });
+
+  // Fill the buckets of each partition.
+  std::vector<uint64_t> inserted_counts(num_threads, 0);
+  bool ret = loader->run([&](uint16_t thread_id) {
+    std::vector<Item> items;
+    size_t item_count = 0;
+    for (uint16_t t = 0; t < num_threads; t++)
+      item_count += parts[t][thread_id].size();
+    items.reserve(item_count);
+    for (uint16_t t = 0; t < num_threads; t++) {
+      auto& part = parts[t][thread_id];
+      items.insert(items.end(), part.begin(), part.end());
+      std::vector<Item>().swap(part);
+    }
+
+    // Visit the buckets in order for locality.  Keeping the order of entries
+    // for the same bucket makes the first of duplicate keys win.
+    std::stable_sort(items.begin(), items.end(),
+                     [this](const Item& a, const Item& b) {
+                       return get_bucket_id(a.hash) < get_bucket_id(b.hash);
+                     });
+
+    for (auto& item : items) {
+      auto fingerprint = get_fingerprint(item.hash);
+
+      // Level 0 buckets use their index as the row ID.
+      auto bkt_id = get_bucket_id(item.hash);
+      auto bkt = loaded_bucket(bkt_id);
+
+      // Find any duplicate key and the first empty slot in the chain.
+      Bucket* free_bkt = nullptr;
+      uint64_t free_bkt_id = kNullRowID;
+      uint64_t free_j = 0;
+      Bucket* dup_bkt = nullptr;
+      uint64_t dup_bkt_id = kNullRowID;
+      uint64_t dup_j = 0;
+      while (true) {
+        auto mask = match_fingerprints(bkt, fingerprint);
+        while (mask != 0) {
+          auto j = static_cast<uint64_t>(__builtin_ctz(mask));
+          mask &= mask - 1;
+          if (key_equal_(bkt->keys[j], item.key)) {
+            dup_bkt = bkt;
+            dup_bkt_id = bkt_id;
+            dup_j = j;
+            break;
+          }
+        }
+        if (dup_bkt != nullptr) break;
+
+        if (free_bkt == nullptr) {
+          auto empty_mask = match_fingerprints(bkt, kEmptyFingerprint);
+          if (empty_mask != 0) {
+            free_bkt = bkt;
+            free_bkt_id = bkt_id;
+            free_j = static_cast<uint64_t>(__builtin_ctz(empty_mask));
+          }
+        }
+
+        if (bkt->next == kNullRowID) break;
+        bkt_id = bkt->next;
+        bkt = loaded_bucket(bkt_id);
+      }
+      if (dup_bkt != nullptr) {
+        if (UniqueKey) continue;
+
+        // Add the value to the posting list of the key.
+        auto slot_value = dup_bkt->values[dup_j];
+        if (is_posting_list(slot_value)) {
+          if (!load_posting_value(loader, thread_id,
+                                  posting_head_id(slot_value), item.value))
+            return false;
+        } else {
+          auto head_id =
+              load_posting_list(loader, thread_id, slot_value, item.value);
+          if (head_id == kNullRowID) return false;
+          dup_bkt->values[dup_j] = head_id | kPostingListTag;
+          if (StaticConfig::kTrackDirtyPages) idx_tbl_->mark_dirty(dup_bkt_id);
+        }
+        inserted_counts[thread_id]++;
+        continue;
+      }
+
+      if (free_bkt == nullptr) {
+        char* data;
+        auto new_bkt_id = loader->new_row(
+            thread_id, idx_tbl_, 0, BulkLoader<StaticConfig>::kNewRowID,
+            kDataSize, &data);
+        if (new_bkt_id == kNullRowID) return false;
+        auto new_bkt = reinterpret_cast<Bucket*>(data);
+        init_bucket(new_bkt, kOverflowIndex, 0);
+
+        bkt->next = new_bkt_id;
+        if (StaticConfig::kTrackDirtyPages) idx_tbl_->mark_dirty(bkt_id);
+
+        free_bkt = new_bkt;
+        free_bkt_id = new_bkt_id;
+        free_j = 0;
+      }
+
+      free_bkt->fingerprints[free_j] = fingerprint;
+      free_bkt->keys[free_j] = item.key;
+      free_bkt->values[free_j] = item.value;
+      if (StaticConfig::kTrackDirtyPages) idx_tbl_->mark_dirty(free_bkt_id);
+
+      inserted_counts[thread_id]++;
+    }
+    return true;
+  });
+
+  if (inserted != nullptr) {
+    *inserted = 0;
+    for (auto count : inserted_counts) *inserted += count;
+  }
+  return ret;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+char* HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::loaded_data(
+    uint64_t row_id) {
+  // Bulk loading writes to the latest committed version of the row in place
+  // because no transaction can be running.
+  auto rv = const_cast<RowVersion<StaticConfig>*>(
+      idx_tbl_->latest_rv(0, row_id));
+  assert(rv != nullptr && rv->status == RowVersionStatus::kCommitted);
+  return rv->data;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+typename HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::Bucket*
+HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::loaded_bucket(
+    uint64_t row_id) {
+  return reinterpret_cast<Bucket*>(loaded_data(row_id));
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+typename HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::PostingBlock*
+HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::loaded_posting_block(
+    uint64_t row_id) {
+  return reinterpret_cast<PostingBlock*>(loaded_data(row_id));
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash,
+                   KeyEqual>::load_posting_list(BulkLoader<StaticConfig>*
+                                                    loader,
+                                                uint16_t thread_id,
+                                                uint64_t value1,
+                                                uint64_t value2) {
+  // Returns the row ID of the head block, or kNullRowID if memory is
+  // exhausted.
+  char* data;
+  auto head_id =
+      loader->new_row(thread_id, idx_tbl_, 0,
+                      BulkLoader<StaticConfig>::kNewRowID, kDataSize, &data);
+  if (head_id == kNullRowID) return kNullRowID;
+
+  auto head = reinterpret_cast<PostingBlock*>(data);
+  init_posting_block(head);
+  head->tail = head_id;
+  append_posting_value(head, value1);
+  append_posting_value(head, value2);
+  if (StaticConfig::kTrackDirtyPages) idx_tbl_->mark_dirty(head_id);
+  return head_id;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+bool HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::
+    load_posting_value(BulkLoader<StaticConfig>* loader, uint16_t thread_id,
+                       uint64_t head_id, uint64_t value) {
+  auto head = loaded_posting_block(head_id);
+  auto tail_id = head->tail;
+  auto tail = loaded_posting_block(tail_id);
+  if (append_posting_value(tail, value)) {
+    if (StaticConfig::kTrackDirtyPages) idx_tbl_->mark_dirty(tail_id);
+    return true;
+  }
+
+  char* data;
+  auto new_blk_id =
+      loader->new_row(thread_id, idx_tbl_, 0,
+                      BulkLoader<StaticConfig>::kNewRowID, kDataSize, &data);
+  if (new_blk_id == kNullRowID) return false;
+
+  auto new_blk = reinterpret_cast<PostingBlock*>(data);
+  init_posting_block(new_blk);
+  append_posting_value(new_blk, value);
+
+  tail->next = new_blk_id;
+  head->tail = new_blk_id;
+  if (StaticConfig::kTrackDirtyPages) {
+    idx_tbl_->mark_dirty(tail_id);
+    idx_tbl_->mark_dirty(head_id);
+    idx_tbl_->mark_dirty(new_blk_id);
+  }
+  return true;
+}
+}
+}
+
+#endif
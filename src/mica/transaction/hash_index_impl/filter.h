@@ -0,0 +1,119 @@
+#pragma once
+#ifndef MICA_TRANSACTION_HASH_INDEX_IMPL_FILTER_H_
+#define MICA_TRANSACTION_HASH_INDEX_IMPL_FILTER_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+typename HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::FilterBlock*
+HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::get_filter_word(
+    uint64_t hash, volatile uint64_t** word, uint64_t* mask) const {
+  // Remix the hash because the bucket ID and the fingerprint use its bits.
+  auto h = (hash ^ (hash >> 31)) * 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 29;
+  auto blk = &filter_[h & filter_block_mask_];
+
+  // The high bits of another product do not depend on the block only.
+  auto h2 = h * 0x9e3779b97f4a7c15ULL;
+  *word = &blk->words[(((h2 >> 32) & 0xff) * kFilterWordsPerBlock) >> 8];
+
+  uint64_t m = 0;
+  for (uint64_t i = 0; i < kFilterHashCount; i++)
+    m |= uint64_t(1) << ((h2 >> (40 + 6 * i)) & 63);
+  *mask = m;
+  return blk;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+bool HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::
+    filter_may_contain(Transaction* tx, uint64_t hash, bool skip_validation) {
+  volatile uint64_t* word;
+  uint64_t mask;
+  auto blk = get_filter_word(hash, &word, &mask);
+  if ((*word & mask) == mask) return true;
+  if (skip_validation) return false;
+
+  // Make any insert of the key with an earlier timestamp abort before
+  // checking again.  An insert sets its bits before reading the rts, so one
+  // of the two sees the other.
+  blk->rts.update(tx->ts());
+  ::mica::util::mfence();
+  return (*word & mask) == mask;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+bool HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::filter_add(
+    Transaction* tx, uint64_t hash) {
+  volatile uint64_t* word;
+  uint64_t mask;
+  auto blk = get_filter_word(hash, &word, &mask);
+  if ((*word & mask) != mask) __sync_fetch_and_or(word, mask);
+
+  // The rts must be checked even if the bits were already set because they
+  // may have been set by a transaction with a later timestamp.
+  return !(blk->rts.get() > tx->ts());
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+void HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::filter_load(
+    uint64_t hash) {
+  // Loading threads may share a filter word.
+  volatile uint64_t* word;
+  uint64_t mask;
+  get_filter_word(hash, &word, &mask);
+  if ((*word & mask) != mask) __sync_fetch_and_or(word, mask);
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+void HashIndex<StaticConfig, UniqueKey, Key, Hash,
+               KeyEqual>::rebuild_filter() {
+  if (!kUseFilter) return;
+
+  // Keep the rts of blocks; clearing them could let an earlier insert miss a
+  // later read that is still running.
+  for (uint64_t i = 0; i <= filter_block_mask_; i++)
+    for (uint64_t j = 0; j < kFilterWordsPerBlock; j++)
+      filter_[i].words[j] = 0;
+
+  // Level 0 buckets use their index as the row ID.
+  for (uint64_t i = 0; i < bucket_count_; i++) filter_load_buckets(i);
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+void HashIndex<StaticConfig, UniqueKey, Key, Hash,
+               KeyEqual>::filter_load_buckets(uint64_t row_id) {
+  // Loads the keys of the bucket, its overflow chain, and the buckets split
+  // from them.
+  while (row_id != kNullRowID) {
+    auto rv = idx_tbl_->latest_rv(0, row_id);
+    if (rv == nullptr || rv->status != RowVersionStatus::kCommitted) return;
+    auto bkt = reinterpret_cast<const Bucket*>(rv->data);
+
+    for (size_t j = 0; j < Bucket::kBucketSize; j++)
+      if (bkt->fingerprints[j] != kEmptyFingerprint)
+        filter_load(get_hash(bkt->keys[j]));
+
+    // The latest split child links to the earlier ones.
+    for (auto child_id = bkt->split_row_id; child_id != kNullRowID;) {
+      filter_load_buckets(child_id);
+      auto child_rv = idx_tbl_->latest_rv(0, child_id);
+      if (child_rv == nullptr ||
+          child_rv->status != RowVersionStatus::kCommitted)
+        break;
+      child_id =
+          reinterpret_cast<const Bucket*>(child_rv->data)->prev_split_row_id;
+    }
+
+    row_id = bkt->next;
+  }
+}
+}
+}
+
+#endif
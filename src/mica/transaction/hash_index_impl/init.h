@@ -28,6 +28,41 @@ HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::HashIndex(
 
   bucket_count_ = ::mica::util::next_power_of_two(bucket_count_);
   bucket_count_mask_ = bucket_count_ - 1;
+  bucket_count_bits_ =
+      static_cast<uint64_t>(__builtin_ctzll(bucket_count_));
+
+  directory_chunk_count_ =
+      ((bucket_count_ << StaticConfig::kHashIndexMaxSplitLevel) +
+       kDirectoryChunkSize - 1) /
+      kDirectoryChunkSize;
+  directory_ = new volatile uint64_t*[directory_chunk_count_]();
+  max_level_ = 0;
+
+  if (kUseFilter) {
+    uint64_t block_count = expected_num_rows *
+                           StaticConfig::kHashIndexFilterBitsPerKey /
+                           (kFilterWordsPerBlock * 64);
+    block_count = ::mica::util::next_power_of_two(block_count);
+    filter_block_mask_ = block_count - 1;
+
+    filter_mem_ = new char[block_count * sizeof(FilterBlock) + 63]();
+    filter_ = reinterpret_cast<FilterBlock*>(::mica::util::roundup<64>(
+        reinterpret_cast<uintptr_t>(filter_mem_)));
+  } else {
+    filter_mem_ = nullptr;
+    filter_ = nullptr;
+    filter_block_mask_ = 0;
+  }
+  filter_enabled_ = kUseFilter;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::~HashIndex() {
+  for (uint64_t i = 0; i < directory_chunk_count_; i++)
+    delete[] directory_[i];
+  delete[] directory_;
+  delete[] filter_mem_;
 }
 
 template <class StaticConfig, bool UniqueKey, class Key, class Hash,
@@ -54,9 +89,7 @@ bool HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::init(
     }
 
     auto new_bkt = reinterpret_cast<Bucket*>(rah.data());
-    for (uint64_t j = 0; j < Bucket::kBucketSize; j++)
-      new_bkt->values[j] = kNullRowID;
-    new_bkt->next = kNullRowID;
+    init_bucket(new_bkt, i, 0);
 
     if (i % kBatchSize == kBatchSize - 1 || i == bucket_count_ - 1) {
       if (!tx->commit()) {
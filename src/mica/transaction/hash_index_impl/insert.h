@@ -10,67 +10,105 @@ uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::insert(
     Transaction* tx, const Key& key, uint64_t value) {
   Timing t(tx->context()->timing_stack(), &Stats::index_write);
 
-  auto bkt_id = get_bucket_id(key);
-  RowAccessHandle rah(tx);
+  assert(UniqueKey || (value & kPostingListTag) == 0);
 
-  if (!rah.peek_row(idx_tbl_, 0, bkt_id, true, true, false) ||
-      !rah.read_row(data_copier_))
-    return kHaveToAbort;
-  // printf("HashIndex::insert() 1\n");
-  auto cbkt = reinterpret_cast<const Bucket*>(rah.cdata());
+  auto hash = get_hash(key);
+  auto fingerprint = get_fingerprint(hash);
 
-  // Find any duplicate key or the last bucket in the chain.
+  if (use_filter() && !filter_add(tx, hash)) return kHaveToAbort;
+
+  // Split the bucket at most once instead of adding an overflow bucket.
+  bool split_tried = false;
   while (true) {
-    if (UniqueKey) {
-      for (uint64_t j = 0; j < Bucket::kBucketSize; j++)
-        if (cbkt->values[j] != kNullRowID && key_equal_(cbkt->keys[j], key)) {
-          // A duplicate key has been found.  Do not insert anything.
-          return 0;
-        }
-    }
+    uint64_t index;
+    uint64_t bkt_id;
+    if (!find_bucket(tx, hash, &index, &bkt_id)) return kHaveToAbort;
+    auto head_bkt_id = bkt_id;
 
-    if (cbkt->next == kNullRowID) break;
-    bkt_id = cbkt->next;
+    RowAccessHandle rah(tx);
 
-    rah.reset();
     if (!rah.peek_row(idx_tbl_, 0, bkt_id, true, true, false) ||
         !rah.read_row(data_copier_))
       return kHaveToAbort;
-    // printf("HashIndex::insert() 2\n");
-    cbkt = reinterpret_cast<const Bucket*>(rah.cdata());
-  }
+    // printf("HashIndex::insert() 1\n");
+    auto cbkt = reinterpret_cast<const Bucket*>(rah.cdata());
+    if (!covers(cbkt, index, hash)) return kHaveToAbort;
 
-  // Note that we did not specify write_hint earlier before calling
-  // write_row().  It may have better or worse insert speed, but it is totally
-  // safe to do so.
-  rah.write_row(kDataSize, data_copier_);
-  // printf("HashIndex::insert() 3\n");
-  auto bkt = reinterpret_cast<Bucket*>(rah.data());
+    // Find any duplicate key or the last bucket in the chain.
+    while (true) {
+      auto mask = match_fingerprints(cbkt, fingerprint);
+      while (mask != 0) {
+        auto j = static_cast<uint64_t>(__builtin_ctz(mask));
+        mask &= mask - 1;
+        if (key_equal_(cbkt->keys[j], key)) {
+          // A duplicate key has been found.  Do not insert anything.
+          if (UniqueKey) return 0;
 
-  uint64_t j;
-  for (j = 0; j < Bucket::kBucketSize; j++)
-    if (bkt->values[j] == kNullRowID) break;
+          // Add the value to the posting list of the key.
+          auto slot_value = cbkt->values[j];
+          if (is_posting_list(slot_value))
+            return insert_posting(tx, posting_head_id(slot_value), value);
 
-  if (j == Bucket::kBucketSize) {
-    RowAccessHandle new_rah(tx);
-    if (!new_rah.new_row(idx_tbl_, 0, Transaction::kNewRowID, true, kDataSize))
-      return kHaveToAbort;
+          // Move the value in the slot and the new one to a posting list.
+          auto head_id = new_posting_list(tx, slot_value, value);
+          if (head_id == kNullRowID) return kHaveToAbort;
+          if (!rah.write_row(kDataSize, data_copier_)) return kHaveToAbort;
+          reinterpret_cast<Bucket*>(rah.data())->values[j] =
+              head_id | kPostingListTag;
+          return 1;
+        }
+      }
+
+      if (cbkt->next == kNullRowID) break;
+      bkt_id = cbkt->next;
 
-    // printf("HashIndex::insert() 4\n");
+      rah.reset();
+      if (!rah.peek_row(idx_tbl_, 0, bkt_id, true, true, false) ||
+          !rah.read_row(data_copier_))
+        return kHaveToAbort;
+      // printf("HashIndex::insert() 2\n");
+      cbkt = reinterpret_cast<const Bucket*>(rah.cdata());
+    }
 
-    auto new_bkt = reinterpret_cast<Bucket*>(new_rah.data());
-    for (j = 0; j < Bucket::kBucketSize; j++) new_bkt->values[j] = kNullRowID;
-    new_bkt->next = kNullRowID;
-    j = 0;
+    auto empty_mask = match_fingerprints(cbkt, kEmptyFingerprint);
+    if (empty_mask == 0 && !split_tried) {
+      split_tried = true;
+      if (!split(tx, index, head_bkt_id)) return kHaveToAbort;
+      continue;
+    }
 
-    bkt->next = new_rah.row_id();
-    bkt = new_bkt;
-  }
+    // Note that we did not specify write_hint earlier before calling
+    // write_row().  It may have better or worse insert speed, but it is
+    // totally safe to do so.
+    if (!rah.write_row(kDataSize, data_copier_)) return kHaveToAbort;
+    // printf("HashIndex::insert() 3\n");
+    auto bkt = reinterpret_cast<Bucket*>(rah.data());
+
+    uint64_t j;
+    if (empty_mask != 0)
+      j = static_cast<uint64_t>(__builtin_ctz(empty_mask));
+    else {
+      RowAccessHandle new_rah(tx);
+      if (!new_rah.new_row(idx_tbl_, 0, Transaction::kNewRowID, true,
+                           kDataSize))
+        return kHaveToAbort;
+
+      // printf("HashIndex::insert() 4\n");
 
-  bkt->keys[j] = key;
-  bkt->values[j] = value;
-  // printf("HashIndex::insert() 5\n");
-  return 1;
+      auto new_bkt = reinterpret_cast<Bucket*>(new_rah.data());
+      init_bucket(new_bkt, kOverflowIndex, 0);
+      j = 0;
+
+      bkt->next = new_rah.row_id();
+      bkt = new_bkt;
+    }
+
+    bkt->fingerprints[j] = fingerprint;
+    bkt->keys[j] = key;
+    bkt->values[j] = value;
+    // printf("HashIndex::insert() 5\n");
+    return 1;
+  }
 }
 }
 }
@@ -18,14 +18,20 @@ uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::lookup(
   uint64_t found = 0;
 
   const Bucket* bkt;
-  auto bkt_id = get_bucket_id(key);
+  auto hash = get_hash(key);
+  auto fingerprint = get_fingerprint(hash);
+  uint64_t index;
+  uint64_t bkt_id;
+  if (use_filter() && !filter_may_contain(tx, hash, skip_validation))
+    return found;
+  if (!find_bucket(tx, hash, &index, &bkt_id)) return kHaveToAbort;
 
   while (true) {
     if (StaticConfig::kCollectProcessingStats) chain_len++;
 
     if (skip_validation) {
       RowAccessHandlePeekOnly rah(tx);
-      if (!rah.peek_row(idx_tbl_, 0, bkt_id, false, false, false))
+      if (!rah.peek_row(idx_tbl_, 0, bkt_id, true, false, false))
         return kHaveToAbort;
       bkt = reinterpret_cast<const Bucket*>(rah.cdata());
     } else {
@@ -35,15 +41,23 @@ uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::lookup(
         return kHaveToAbort;
       bkt = reinterpret_cast<const Bucket*>(rah.cdata());
     }
+    if (index != kOverflowIndex) {
+      if (!covers(bkt, index, hash)) return kHaveToAbort;
+      index = kOverflowIndex;
+    }
+
+    // Only inspect the slots whose fingerprint matches; empty slots never
+    // match because they have kEmptyFingerprint.
+    auto mask = match_fingerprints(bkt, fingerprint);
+    while (mask != 0) {
+      auto j = static_cast<size_t>(__builtin_ctz(mask));
+      mask &= mask - 1;
 
-    for (size_t j = 0; j < Bucket::kBucketSize; j++) {
       // printf("HashIndex::lookup() key=%" PRIu64 " bucket_key=%" PRIu64
       //        " value=%" PRIu64 "\n",
-      //        key, bkt->keys[i], bkt->values[i]);
+      //        key, bkt->keys[j], bkt->values[j]);
       if (!key_equal_(bkt->keys[j], key)) continue;
 
-      if (bkt->values[j] == kNullRowID) continue;
-
       auto value = bkt->values[j];
 
       if (StaticConfig::kCollectProcessingStats) {
@@ -51,15 +65,16 @@ uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::lookup(
           tx->context()->stats().max_hash_index_chain_len = chain_len;
       }
 
-      found++;
-      if (!func(bkt->keys[j], value)) return found;
-      if (UniqueKey) {
-        // There will be no matching key.
-        return found;
+      if (is_posting_list(value)) {
+        // Keys are unique in the chain; the values are in the posting list.
+        return lookup_posting(tx, bkt->keys[j], posting_head_id(value),
+                              skip_validation, func);
       }
 
-      // To omit checking j if the bucket has only one item.
-      if (Bucket::kBucketSize == 1) break;
+      found++;
+      func(bkt->keys[j], value);
+      // There will be no matching key.
+      return found;
     }
 
     bkt_id = bkt->next;
@@ -72,6 +87,71 @@ uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::lookup(
     }
   }
 }
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+template <typename Func>
+uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::multi_lookup(
+    Transaction* tx, const Key* keys, uint64_t n, bool skip_validation,
+    const Func& func, bool prefetch_rows) {
+  // Looks up keys in batches.  Each batch runs in stages so that the cache
+  // misses of different keys overlap: the bucket rows of all keys are
+  // prefetched first, then the buckets are probed while prefetching the
+  // main table rows of the matches if requested, and then func is called on
+  // the matches.
+  struct Match {
+    uint64_t i;
+    Key key;
+    uint64_t value;
+  };
+
+  std::vector<Match> matches;
+  matches.reserve(kMultiLookupBatchSize);
+
+  uint64_t found = 0;
+  for (uint64_t base = 0; base < n; base += kMultiLookupBatchSize) {
+    auto batch_end = std::min(n, base + kMultiLookupBatchSize);
+
+    {
+      Timing t(tx->context()->timing_stack(), &Stats::index_read);
+      auto max_level = max_level_;
+      RowAccessHandlePeekOnly rah(tx);
+      for (auto i = base; i < batch_end; i++) {
+        auto hash = get_hash(keys[i]);
+        // lookup() will not touch the buckets for absent keys.
+        if (use_filter() && !filter_may_contain(tx, hash, true)) continue;
+
+        uint64_t index;
+        uint64_t level;
+        auto bkt_id = known_bucket(hash, max_level, &index, &level);
+        rah.prefetch_row(idx_tbl_, 0, bkt_id, 0, sizeof(Bucket));
+      }
+    }
+
+    matches.clear();
+    for (auto i = base; i < batch_end; i++) {
+      auto ret = lookup(tx, keys[i], skip_validation,
+                        [this, tx, i, prefetch_rows, &matches](const Key& key,
+                                                               uint64_t value) {
+                          if (prefetch_rows) {
+                            RowAccessHandlePeekOnly rah(tx);
+                            rah.prefetch_row(main_tbl_, 0, value, 0, 0);
+                          }
+                          matches.push_back(Match{i, key, value});
+                          return true;
+                        });
+      if (ret == kHaveToAbort) return kHaveToAbort;
+    }
+
+    uint64_t stopped_i = static_cast<uint64_t>(-1);
+    for (auto& match : matches) {
+      if (match.i == stopped_i) continue;
+      found++;
+      if (!func(match.i, match.key, match.value)) stopped_i = match.i;
+    }
+  }
+  return found;
+}
 }
 }
 
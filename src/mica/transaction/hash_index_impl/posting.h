@@ -0,0 +1,264 @@
+#pragma once
+#ifndef MICA_TRANSACTION_HASH_INDEX_IMPL_POSTING_H_
+#define MICA_TRANSACTION_HASH_INDEX_IMPL_POSTING_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+void HashIndex<StaticConfig, UniqueKey, Key, Hash,
+               KeyEqual>::init_posting_block(PostingBlock* blk) {
+  blk->next = kNullRowID;
+  blk->tail = kNullRowID;
+  blk->last_value = 0;
+  blk->count = 0;
+  blk->size = 0;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+bool HashIndex<StaticConfig, UniqueKey, Key, Hash,
+               KeyEqual>::append_posting_value(PostingBlock* blk,
+                                               uint64_t value) {
+  // The difference wraps around for a smaller value, which zigzag encoding
+  // turns into a small number again.
+  auto delta = value - blk->last_value;
+  auto zigzag =
+      (delta << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(delta) >> 63);
+
+  uint32_t len = 1;
+  for (auto v = zigzag >> 7; v != 0; v >>= 7) len++;
+  if (blk->size + len > sizeof(blk->data)) return false;
+
+  auto p = blk->data + blk->size;
+  while (zigzag >= 0x80) {
+    *p++ = static_cast<uint8_t>(zigzag | 0x80);
+    zigzag >>= 7;
+  }
+  *p = static_cast<uint8_t>(zigzag);
+
+  blk->size += len;
+  blk->count++;
+  blk->last_value = value;
+  return true;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+template <typename Func>
+bool HashIndex<StaticConfig, UniqueKey, Key, Hash,
+               KeyEqual>::for_each_posting_value(const PostingBlock* blk,
+                                                 const Func& func) {
+  const uint8_t* p = blk->data;
+  uint64_t value = 0;
+  for (uint32_t i = 0; i < blk->count; i++) {
+    uint64_t zigzag = 0;
+    for (uint32_t shift = 0;; shift += 7) {
+      auto b = *p++;
+      zigzag |= static_cast<uint64_t>(b & 0x7f) << shift;
+      if ((b & 0x80) == 0) break;
+    }
+    value += (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+    if (!func(value)) return false;
+  }
+  return true;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash,
+                   KeyEqual>::new_posting_list(Transaction* tx,
+                                               uint64_t value1,
+                                               uint64_t value2) {
+  // Returns the row ID of the head block, or kNullRowID if the transaction
+  // has to abort.
+  RowAccessHandle rah(tx);
+  if (!rah.new_row(idx_tbl_, 0, Transaction::kNewRowID, true, kDataSize))
+    return kNullRowID;
+
+  auto blk = reinterpret_cast<PostingBlock*>(rah.data());
+  init_posting_block(blk);
+  blk->tail = rah.row_id();
+  append_posting_value(blk, value1);
+  append_posting_value(blk, value2);
+  return rah.row_id();
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash,
+                   KeyEqual>::insert_posting(Transaction* tx, uint64_t head_id,
+                                             uint64_t value) {
+  // Only the head and tail blocks are accessed regardless of the length of
+  // the posting list.
+  RowAccessHandle rah_head(tx);
+  if (!rah_head.peek_row(idx_tbl_, 0, head_id, true, true, false) ||
+      !rah_head.read_row())
+    return kHaveToAbort;
+  auto chead = reinterpret_cast<const PostingBlock*>(rah_head.cdata());
+
+  RowAccessHandle rah_tail = rah_head;
+  if (chead->tail != head_id) {
+    rah_tail = RowAccessHandle(tx);
+    if (!rah_tail.peek_row(idx_tbl_, 0, chead->tail, true, true, false) ||
+        !rah_tail.read_row())
+      return kHaveToAbort;
+  }
+
+  if (!rah_tail.write_row(kDataSize)) return kHaveToAbort;
+  auto tail = reinterpret_cast<PostingBlock*>(rah_tail.data());
+  if (append_posting_value(tail, value)) return 1;
+
+  // The tail block is full.  Append a new block.
+  RowAccessHandle rah_new(tx);
+  if (!rah_new.new_row(idx_tbl_, 0, Transaction::kNewRowID, true, kDataSize))
+    return kHaveToAbort;
+  auto new_blk = reinterpret_cast<PostingBlock*>(rah_new.data());
+  init_posting_block(new_blk);
+  append_posting_value(new_blk, value);
+
+  tail->next = rah_new.row_id();
+
+  if (!rah_head.write_row(kDataSize)) return kHaveToAbort;
+  reinterpret_cast<PostingBlock*>(rah_head.data())->tail = rah_new.row_id();
+  return 1;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash,
+                   KeyEqual>::remove_posting(Transaction* tx, uint64_t head_id,
+                                             uint64_t value, bool* emptied) {
+  // Removes one occurrence of the value.  *emptied is set if the posting
+  // list has become empty and its head block has been deleted; the caller
+  // must then remove the key from the bucket.
+  *emptied = false;
+
+  RowAccessHandle rah_head(tx);
+  if (!rah_head.peek_row(idx_tbl_, 0, head_id, true, true, false) ||
+      !rah_head.read_row())
+    return kHaveToAbort;
+
+  RowAccessHandle rah_prev(tx);
+  RowAccessHandle rah = rah_head;
+
+  // The remaining values of the block that has the value.
+  uint64_t values[kMaxPostingBlockValues];
+  uint64_t count;
+  while (true) {
+    auto cblk = reinterpret_cast<const PostingBlock*>(rah.cdata());
+    bool found = false;
+    count = 0;
+    for_each_posting_value(cblk, [&](uint64_t v) {
+      if (!found && v == value)
+        found = true;
+      else
+        values[count++] = v;
+      return true;
+    });
+    if (found) break;
+
+    if (cblk->next == kNullRowID) return 0;
+    auto next = cblk->next;
+
+    rah_prev = rah;
+    rah = RowAccessHandle(tx);
+    if (!rah.peek_row(idx_tbl_, 0, next, true, true, false) ||
+        !rah.read_row())
+      return kHaveToAbort;
+  }
+
+  if (!rah.write_row(kDataSize)) return kHaveToAbort;
+  auto blk = reinterpret_cast<PostingBlock*>(rah.data());
+
+  if (count != 0) {
+    // Re-encode the block.  Merging two differences never takes more bytes
+    // than the two did, so the remaining values always fit.
+    blk->last_value = 0;
+    blk->count = 0;
+    blk->size = 0;
+    for (uint64_t i = 0; i < count; i++) {
+      bool ret = append_posting_value(blk, values[i]);
+      assert(ret);
+      (void)ret;
+    }
+    return 1;
+  }
+
+  // The block has become empty.
+  auto next = blk->next;
+
+  if (!rah_prev) {
+    if (next == kNullRowID) {
+      if (!rah.delete_row()) return kHaveToAbort;
+      *emptied = true;
+      return 1;
+    }
+
+    // Move the next block into the head block, which the bucket points to.
+    RowAccessHandle rah_next(tx);
+    if (!rah_next.peek_row(idx_tbl_, 0, next, true, true, false) ||
+        !rah_next.read_row())
+      return kHaveToAbort;
+
+    auto tail = blk->tail == next ? head_id : blk->tail;
+    ::mica::util::memcpy(blk, rah_next.cdata(), sizeof(PostingBlock));
+    blk->tail = tail;
+
+    if (!rah_next.write_row(kDataSize) || !rah_next.delete_row())
+      return kHaveToAbort;
+    return 1;
+  }
+
+  // Unlink the block.
+  if (!rah_prev.write_row(kDataSize)) return kHaveToAbort;
+  reinterpret_cast<PostingBlock*>(rah_prev.data())->next = next;
+
+  if (next == kNullRowID) {
+    if (!rah_head.write_row(kDataSize)) return kHaveToAbort;
+    reinterpret_cast<PostingBlock*>(rah_head.data())->tail = rah_prev.row_id();
+  }
+
+  if (!rah.delete_row()) return kHaveToAbort;
+  return 1;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+template <typename Func>
+uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash,
+                   KeyEqual>::lookup_posting(Transaction* tx, const Key& key,
+                                             uint64_t head_id,
+                                             bool skip_validation,
+                                             const Func& func) {
+  uint64_t found = 0;
+  auto blk_id = head_id;
+  while (blk_id != kNullRowID) {
+    const PostingBlock* blk;
+    if (skip_validation) {
+      RowAccessHandlePeekOnly rah(tx);
+      if (!rah.peek_row(idx_tbl_, 0, blk_id, true, false, false))
+        return kHaveToAbort;
+      blk = reinterpret_cast<const PostingBlock*>(rah.cdata());
+    } else {
+      RowAccessHandle rah(tx);
+      if (!rah.peek_row(idx_tbl_, 0, blk_id, true, true, false) ||
+          !rah.read_row())
+        return kHaveToAbort;
+      blk = reinterpret_cast<const PostingBlock*>(rah.cdata());
+    }
+
+    bool cont = for_each_posting_value(blk, [&](uint64_t value) {
+      found++;
+      return func(key, value);
+    });
+    if (!cont) break;
+
+    blk_id = blk->next;
+  }
+  return found;
+}
+}
+}
+
+#endif
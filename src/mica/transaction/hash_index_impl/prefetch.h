@@ -10,7 +10,12 @@ void HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::prefetch(
     Transaction* tx, const Key& key) {
   Timing t(tx->context()->timing_stack(), &Stats::index_read);
 
-  auto bkt_id = get_bucket_id(key);
+  auto hash = get_hash(key);
+  if (use_filter() && !filter_may_contain(tx, hash, true)) return;
+
+  uint64_t index;
+  uint64_t level;
+  auto bkt_id = known_bucket(hash, max_level_, &index, &level);
 
   RowAccessHandlePeekOnly rah(tx);
   rah.prefetch_row(idx_tbl_, 0, bkt_id, 0, sizeof(Bucket));
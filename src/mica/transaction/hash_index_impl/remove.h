@@ -10,7 +10,12 @@ uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::remove(
     Transaction* tx, const Key& key, uint64_t value) {
   Timing t(tx->context()->timing_stack(), &Stats::index_write);
 
-  auto bkt_id = get_bucket_id(key);
+  auto hash = get_hash(key);
+  auto fingerprint = get_fingerprint(hash);
+  uint64_t index;
+  uint64_t bkt_id;
+  if (use_filter() && !filter_may_contain(tx, hash, false)) return 0;
+  if (!find_bucket(tx, hash, &index, &bkt_id)) return kHaveToAbort;
   RowAccessHandle rah(tx);
   RowAccessHandle rah_prev(tx);
 
@@ -19,15 +24,23 @@ uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::remove(
     return kHaveToAbort;
   // printf("HashIndex::remove() 1\n");
   auto cbkt = reinterpret_cast<const Bucket*>(rah.cdata());
+  if (!covers(cbkt, index, hash)) return kHaveToAbort;
 
   // Find the existing key.
   uint64_t existing_key_j = Bucket::kBucketSize;
   while (true) {
-    for (uint64_t j = 0; j < Bucket::kBucketSize; j++)
-      if (cbkt->values[j] == value && key_equal_(cbkt->keys[j], key)) {
+    auto mask = match_fingerprints(cbkt, fingerprint);
+    while (mask != 0) {
+      auto j = static_cast<uint64_t>(__builtin_ctz(mask));
+      mask &= mask - 1;
+      // A non-unique index may have the value in the posting list of the
+      // key.
+      if ((is_posting_list(cbkt->values[j]) || cbkt->values[j] == value) &&
+          key_equal_(cbkt->keys[j], key)) {
         existing_key_j = j;
         break;
       }
+    }
     if (existing_key_j != Bucket::kBucketSize) break;
 
     if (cbkt->next == kNullRowID) break;
@@ -45,6 +58,14 @@ uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::remove(
   // No existing key found.
   if (existing_key_j == Bucket::kBucketSize) return 0;
 
+  if (is_posting_list(cbkt->values[existing_key_j])) {
+    // Remove the key only if its posting list has become empty.
+    bool emptied;
+    auto ret = remove_posting(
+        tx, posting_head_id(cbkt->values[existing_key_j]), value, &emptied);
+    if (ret != 1 || !emptied) return ret;
+  }
+
   // If this is not the last bucket in the chain, find a key from the last bucket to fill the slot of this deleted key.
 
   if (cbkt->next != kNullRowID) {
@@ -62,17 +83,13 @@ uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::remove(
       cbkt = reinterpret_cast<const Bucket*>(rah.cdata());
     }
 
-    uint64_t last_j = Bucket::kBucketSize;
-    for (uint64_t j = 0; j < Bucket::kBucketSize; j++)
-      if (cbkt->values[j] != kNullRowID) {
-        if (last_j == Bucket::kBucketSize) {
-          last_j = j;
-          break;
-        }
-      }
-    assert(last_j != Bucket::kBucketSize);
+    auto used_mask = ~match_fingerprints(cbkt, kEmptyFingerprint) &
+                     ((1U << Bucket::kBucketSize) - 1);
+    assert(used_mask != 0);
+    auto last_j = static_cast<uint64_t>(__builtin_ctz(used_mask));
 
     // Fill the slot.
+    filled_in_bkt->fingerprints[existing_key_j] = cbkt->fingerprints[last_j];
     filled_in_bkt->keys[existing_key_j] = cbkt->keys[last_j];
     filled_in_bkt->values[existing_key_j] = cbkt->values[last_j];
 
@@ -85,32 +102,27 @@ uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::remove(
   if (!rah_prev)
     will_delete_bucket = false;
   else {
-    will_delete_bucket = true;
-    for (uint64_t j = 0; j < Bucket::kBucketSize; j++)
-      if (cbkt->values[j] != kNullRowID) {
-        if (j == existing_key_j)
-          continue;
-        else {
-          will_delete_bucket = false;
-          break;
-        }
-      }
+    auto used_mask = ~match_fingerprints(cbkt, kEmptyFingerprint) &
+                     ((1U << Bucket::kBucketSize) - 1);
+    will_delete_bucket = (used_mask & ~(1U << existing_key_j)) == 0;
   }
 
   if (!will_delete_bucket) {
     // Simply make the slot as empty.
     if (!rah.write_row(kDataSize, data_copier_)) return kHaveToAbort;
     auto bkt = reinterpret_cast<Bucket*>(rah.data());
+    bkt->fingerprints[existing_key_j] = kEmptyFingerprint;
     bkt->values[existing_key_j] = kNullRowID;
   } else {
     // Unlink this bucket from the previous bucket.
-    if (!rah_prev.write_row(0, data_copier_)) return kHaveToAbort;
-    auto prev_bkt = reinterpret_cast<Bucket*>(rah.data());
+    if (!rah_prev.write_row(kDataSize, data_copier_)) return kHaveToAbort;
+    auto prev_bkt = reinterpret_cast<Bucket*>(rah_prev.data());
 
     prev_bkt->next = kNullRowID;
 
     // Delete this bucket.
-    if (!rah.delete_row()) return kHaveToAbort;
+    if (!rah.write_row(kDataSize, data_copier_) || !rah.delete_row())
+      return kHaveToAbort;
   }
 
   return 1;
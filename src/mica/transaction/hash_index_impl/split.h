@@ -0,0 +1,262 @@
+#pragma once
+#ifndef MICA_TRANSACTION_HASH_INDEX_IMPL_SPLIT_H_
+#define MICA_TRANSACTION_HASH_INDEX_IMPL_SPLIT_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash,
+                   KeyEqual>::get_directory(uint64_t index) const {
+  auto chunk = directory_[index / kDirectoryChunkSize];
+  if (chunk == nullptr) return kNullRowID;
+  return chunk[index % kDirectoryChunkSize];
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+void HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::set_directory(
+    uint64_t index, uint64_t level, uint64_t row_id) {
+  auto& chunk = directory_[index / kDirectoryChunkSize];
+  if (chunk == nullptr) {
+    auto new_chunk = new volatile uint64_t[kDirectoryChunkSize];
+    for (uint64_t i = 0; i < kDirectoryChunkSize; i++)
+      new_chunk[i] = kNullRowID;
+    if (!__sync_bool_compare_and_swap(&chunk, nullptr, new_chunk))
+      delete[] new_chunk;
+  }
+  chunk[index % kDirectoryChunkSize] = row_id;
+
+  uint64_t max_level = max_level_;
+  while (max_level < level) {
+    if (__sync_bool_compare_and_swap(&max_level_, max_level, level)) break;
+    max_level = max_level_;
+  }
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+uint64_t HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::known_bucket(
+    uint64_t hash, uint64_t max_level, uint64_t* index,
+    uint64_t* level) const {
+  // Find the deepest bucket for the hash that the directory knows, at or
+  // below max_level.  A bucket at level l has this hash bit set.
+  for (auto l = max_level; l > 0; l--) {
+    if ((hash & (bucket_count_ << (l - 1))) == 0) continue;
+    auto i = hash & ((bucket_count_ << l) - 1);
+    auto row_id = get_directory(i);
+    if (row_id == kNullRowID) continue;
+    *index = i;
+    *level = l;
+    return row_id;
+  }
+  *index = get_bucket_id(hash);
+  *level = 0;
+  // Level 0 buckets use their index as the row ID.
+  return *index;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+const typename HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::Bucket*
+HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::peek_bucket(
+    Transaction* tx, uint64_t row_id, uint64_t index) {
+  // Returns nullptr if the row is not visible or is not the bucket.
+  RowAccessHandlePeekOnly rah(tx);
+  if (!rah.peek_row(idx_tbl_, 0, row_id, true, false, false)) return nullptr;
+  auto bkt = reinterpret_cast<const Bucket*>(rah.cdata());
+  if (bkt->index != index) return nullptr;
+  return bkt;
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+bool HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::find_bucket(
+    Transaction* tx, uint64_t hash, uint64_t* index, uint64_t* row_id) {
+  // Finds the bucket that holds the hash as of this transaction's timestamp.
+  // The buckets on the way are only peeked; the caller reads the final bucket
+  // so that a concurrent split of it is detected by validation.  Splitting
+  // other buckets does not change which bucket holds the hash.
+
+  // Start from the deepest bucket known to the directory.  It may be too new
+  // for this transaction or may be left by an aborted split, so fall back to
+  // shallower buckets.
+  const Bucket* bkt;
+  uint64_t level = max_level_;
+  while (true) {
+    *row_id = known_bucket(hash, level, index, &level);
+    bkt = peek_bucket(tx, *row_id, *index);
+    if (bkt != nullptr) break;
+    if (level == 0) return false;
+    level--;
+  }
+
+  // Descend to the bucket that took over the hash by splits.
+  while (true) {
+    auto masked_hash = hash & ((bucket_count_ << bkt->level) - 1);
+    if (masked_hash == *index) return true;
+
+    // The earliest split since this bucket was created that moved the hash.
+    auto split_level = static_cast<uint64_t>(
+        __builtin_ctzll((masked_hash ^ *index) >> bucket_count_bits_));
+    auto child_index = *index + (bucket_count_ << split_level);
+
+    auto child_row_id = get_directory(child_index);
+    const Bucket* child_bkt = nullptr;
+    if (child_row_id != kNullRowID)
+      child_bkt = peek_bucket(tx, child_row_id, child_index);
+
+    if (child_bkt == nullptr) {
+      // Follow the buckets created by earlier splits from the latest one.
+      child_row_id = bkt->split_row_id;
+      for (auto l = bkt->level - 1;; l--) {
+        if (child_row_id == kNullRowID) return false;
+        child_bkt =
+            peek_bucket(tx, child_row_id, *index + (bucket_count_ << l));
+        if (child_bkt == nullptr) return false;
+        if (l == split_level) break;
+        child_row_id = child_bkt->prev_split_row_id;
+      }
+      set_directory(child_index, split_level + 1, child_row_id);
+    }
+
+    *index = child_index;
+    *row_id = child_row_id;
+    bkt = child_bkt;
+  }
+}
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+bool HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>::split(
+    Transaction* tx, uint64_t index, uint64_t row_id) {
+  // Splits the bucket and its chain into two buckets by the next hash bit.
+  // Returns false if the transaction has to abort.
+  Timing t(tx->context()->timing_stack(), &Stats::index_write);
+
+  struct Item {
+    uint64_t hash;
+    uint8_t fingerprint;
+    Key key;
+    uint64_t value;
+  };
+
+  std::vector<RowAccessHandle> chain;
+  std::vector<Item> items;
+
+  chain.emplace_back(tx);
+  if (!chain.back().peek_row(idx_tbl_, 0, row_id, true, true, false) ||
+      !chain.back().read_row(data_copier_))
+    return false;
+  auto cbkt = reinterpret_cast<const Bucket*>(chain.back().cdata());
+  if (cbkt->index != index) return false;
+
+  auto level = cbkt->level;
+  if (level >= StaticConfig::kHashIndexMaxSplitLevel) return true;
+
+  while (true) {
+    for (size_t j = 0; j < Bucket::kBucketSize; j++)
+      if (cbkt->fingerprints[j] != kEmptyFingerprint)
+        items.push_back(Item{get_hash(cbkt->keys[j]), cbkt->fingerprints[j],
+                             cbkt->keys[j], cbkt->values[j]});
+
+    if (cbkt->next == kNullRowID) break;
+
+    auto next = cbkt->next;
+    chain.emplace_back(tx);
+    if (!chain.back().peek_row(idx_tbl_, 0, next, true, true, false) ||
+        !chain.back().read_row(data_copier_))
+      return false;
+    cbkt = reinterpret_cast<const Bucket*>(chain.back().cdata());
+  }
+
+  // Splitting does not help if all keys have the same hash.
+  bool same_hash = true;
+  for (auto& item : items)
+    if (item.hash != items[0].hash) {
+      same_hash = false;
+      break;
+    }
+  if (same_hash) return true;
+
+  auto split_bit = bucket_count_ << level;
+  auto new_index = index + split_bit;
+
+  // Create the new bucket.
+  RowAccessHandle new_rah(tx);
+  if (!new_rah.new_row(idx_tbl_, 0, Transaction::kNewRowID, true, kDataSize))
+    return false;
+  auto new_bkt = reinterpret_cast<Bucket*>(new_rah.data());
+  init_bucket(new_bkt, new_index, level + 1);
+  new_bkt->prev_split_row_id =
+      reinterpret_cast<const Bucket*>(chain[0].cdata())->split_row_id;
+
+  // Move the items with the split bit set to the new bucket's chain, and
+  // compact the remaining items in the old chain.
+  size_t old_i = 0;
+  size_t old_j = 0;
+  Bucket* old_bkt = nullptr;
+  size_t new_j = 0;
+  for (auto& item : items) {
+    Bucket* bkt;
+    size_t j;
+    if ((item.hash & split_bit) == 0) {
+      if (old_bkt == nullptr || old_j == Bucket::kBucketSize) {
+        if (old_bkt != nullptr) old_i++;
+        if (!chain[old_i].write_row(kDataSize, data_copier_)) return false;
+        old_bkt = reinterpret_cast<Bucket*>(chain[old_i].data());
+        for (size_t k = 0; k < Bucket::kBucketSize; k++) {
+          old_bkt->fingerprints[k] = kEmptyFingerprint;
+          old_bkt->values[k] = kNullRowID;
+        }
+        old_j = 0;
+      }
+      bkt = old_bkt;
+      j = old_j++;
+    } else {
+      if (new_j == Bucket::kBucketSize) {
+        RowAccessHandle overflow_rah(tx);
+        if (!overflow_rah.new_row(idx_tbl_, 0, Transaction::kNewRowID, true,
+                                  kDataSize))
+          return false;
+        auto overflow_bkt = reinterpret_cast<Bucket*>(overflow_rah.data());
+        init_bucket(overflow_bkt, kOverflowIndex, 0);
+        new_bkt->next = overflow_rah.row_id();
+        new_bkt = overflow_bkt;
+        new_j = 0;
+      }
+      bkt = new_bkt;
+      j = new_j++;
+    }
+    bkt->fingerprints[j] = item.fingerprint;
+    bkt->keys[j] = item.key;
+    bkt->values[j] = item.value;
+  }
+
+  // Truncate the old chain after the last bucket in use and delete the rest.
+  if (old_bkt == nullptr) {
+    if (!chain[0].write_row(kDataSize, data_copier_)) return false;
+    old_bkt = reinterpret_cast<Bucket*>(chain[0].data());
+    for (size_t k = 0; k < Bucket::kBucketSize; k++) {
+      old_bkt->fingerprints[k] = kEmptyFingerprint;
+      old_bkt->values[k] = kNullRowID;
+    }
+  }
+  old_bkt->next = kNullRowID;
+  for (auto i = old_i + 1; i < chain.size(); i++)
+    if (!chain[i].write_row(kDataSize, data_copier_) || !chain[i].delete_row())
+      return false;
+
+  auto head_bkt = reinterpret_cast<Bucket*>(chain[0].data());
+  head_bkt->level = level + 1;
+  head_bkt->split_row_id = new_rah.row_id();
+
+  // Other transactions validate directory entries, so the new bucket can be
+  // published before this transaction commits.
+  set_directory(new_index, level + 1, new_rah.row_id());
+  return true;
+}
+}
+}
+
+#endif
@@ -0,0 +1,177 @@
+#pragma once
+#ifndef MICA_TRANSACTION_LOG_SHIPPING_H_
+#define MICA_TRANSACTION_LOG_SHIPPING_H_
+
+#include <string>
+#include "mica/common.h"
+#include "mica/alloc/hugetlbfs_shm.h"
+#include "mica/transaction/db.h"
+#include "mica/transaction/logging.h"
+
+namespace mica {
+namespace transaction {
+// Shared memory layout of log shipping: a LogShippingHeader, ring_count
+// LogShippingRings, and ring_count rings of ring_size bytes.  Each ring
+// carries the redo log entries of a primary thread in the format of
+// ParallelLogger.  An entry never wraps around; the rest of the ring is
+// skipped with a padding entry (or without one if it is smaller than
+// LogTxHeader).
+template <class StaticConfig>
+struct LogShippingHeader {
+  static constexpr uint64_t kMagic = 0x53474f4c4143494dULL;  // "MICALOGS"
+  static constexpr uint32_t kPaddingRecordCount = static_cast<uint32_t>(-1);
+
+  uint64_t magic;
+  uint64_t ring_count;
+  uint64_t ring_size;
+
+  // Every transaction earlier than this has been shipped.
+  typename StaticConfig::ConcurrentTimestamp watermark
+      __attribute__((aligned(64)));
+} __attribute__((aligned(64)));
+
+struct LogShippingRing {
+  volatile uint64_t tail __attribute__((aligned(64)));  // Primary.
+  volatile uint64_t head __attribute__((aligned(64)));  // Replica.
+} __attribute__((aligned(64)));
+
+// Ships redo log entries to a ReplicaApplier in another process.  Used as the
+// logger of the primary DB, it writes the log entry of each committing
+// transaction to the ring of the thread in a shared memory file (named name on
+// HugeTLBFS_SHM) and passes the transaction on to BaseLogger (if given) for
+// durability.  A transaction whose entry does not fit in the free space of
+// the ring is aborted.  DB::min_wts() is published as the watermark when
+// DB::quiescence() syncs the logger.
+template <class StaticConfig, class BaseLogger = NullLogger<StaticConfig>>
+class LogShipper : public LoggerInterface<StaticConfig> {
+ public:
+  typedef LogShippingHeader<StaticConfig> Header;
+
+  // log_shipping_impl.h
+  LogShipper(::mica::alloc::HugeTLBFS_SHM* shm, const std::string& name,
+             uint16_t ring_count, uint64_t ring_size = 16 * 1048576,
+             BaseLogger* base_logger = nullptr);
+  ~LogShipper();
+
+  bool log(const Transaction<StaticConfig>* tx);
+  bool sync(uint16_t thread_id);
+
+  // The number of bytes of a thread's ring that are not applied yet.
+  uint64_t pending_size(uint16_t thread_id) const {
+    return rings_[thread_id].tail - rings_[thread_id].head;
+  }
+
+  static uint64_t region_size(uint64_t ring_count, uint64_t ring_size);
+
+ private:
+  ::mica::alloc::HugeTLBFS_SHM* shm_;
+  std::string name_;
+  BaseLogger* base_logger_;
+
+  uint64_t ring_count_;
+  uint64_t ring_size_;
+  uint64_t region_size_;
+
+  Header* header_;
+  LogShippingRing* rings_;
+  char* data_;
+
+  const DB<StaticConfig>* db_;
+};
+
+// Applies the log entries shipped by LogShipper to a replica DB.
+//
+// Shipped transactions earlier than the primary's watermark are applied in
+// timestamp order, each as a transaction of the replica that uses the same
+// row IDs as the primary.  The replica can serve peek-only transactions, which
+// see a consistent prefix of the primary's history; beginning one with
+// causally_after_ts = snapshot_ts() makes it see every applied transaction.
+//
+// As for Recovery, all tables (including those for indexes) must be created in
+// the same order as in the primary, and no index may be initialized with
+// init(), before the applier is created.  Only the applier may write to the
+// replica.  Indexes without index tables (see OLCBTreeIndex) are kept up to
+// date by the applier if they are declared as secondary indexes of their main
+// tables as in the primary.  The filters of hash indexes are not used.
+template <class StaticConfig>
+class ReplicaApplier {
+ public:
+  typedef typename StaticConfig::Timestamp Timestamp;
+  typedef LogShippingHeader<StaticConfig> Header;
+
+  struct ApplyStats {
+    uint64_t tx_count;
+    uint64_t record_count;
+    uint64_t byte_count;
+    uint64_t apply_time;  // In cycles.
+  };
+
+  // log_shipping_impl.h
+  ReplicaApplier(DB<StaticConfig>* db, ::mica::alloc::HugeTLBFS_SHM* shm,
+                 const std::string& name);
+  ~ReplicaApplier();
+
+  // The number of times that a transaction is retried after a conflict in a
+  // call to apply().  The transaction is retried again by the next call.
+  static constexpr uint64_t kMaxApplyRetries = 1000;
+
+  bool is_attached() const { return header_ != nullptr; }
+
+  // Applies up to max_tx_count transactions using the context of thread_id,
+  // which must be active.  Returns the number of applied transactions.
+  uint64_t apply(uint16_t thread_id,
+                 uint64_t max_tx_count = static_cast<uint64_t>(-1));
+
+  // Whether a shipped log entry could not be applied to the replica because
+  // it is broken or does not match the replica's state.  No more transactions
+  // are applied afterward.
+  bool has_failed() const { return failed_; }
+
+  // The primary timestamp of the last applied transaction.
+  const Timestamp& applied_ts() const { return applied_ts_; }
+  // The replica timestamp of the last applied transaction.
+  const Timestamp& snapshot_ts() const { return snapshot_ts_; }
+  // The primary's watermark.
+  Timestamp primary_ts() const { return header_->watermark.get(); }
+
+  // How far the applied state is behind the primary's watermark.
+  uint64_t lag_us() const;
+  const ApplyStats& stats() const { return stats_; }
+
+ private:
+  enum class ApplyResult {
+    kApplied,
+    kConflict,  // Can succeed in a later transaction.
+    kInvalid,
+  };
+
+  ApplyResult apply_tx(uint16_t thread_id, Transaction<StaticConfig>& tx,
+                       const LogTxHeader<StaticConfig>* tx_h);
+  ApplyResult apply_record(Transaction<StaticConfig>& tx,
+                           const LogRecordHeader* rec_h);
+  const LogTxHeader<StaticConfig>* peek_entry(uint64_t ring_id,
+                                              uint64_t* head);
+
+  DB<StaticConfig>* db_;
+  ::mica::alloc::HugeTLBFS_SHM* shm_;
+
+  uint64_t ring_count_;
+  uint64_t ring_size_;
+  uint64_t region_size_;
+
+  Header* header_;
+  LogShippingRing* rings_;
+  char* data_;
+
+  bool failed_;
+  bool has_applied_ts_;
+  Timestamp applied_ts_;
+  Timestamp snapshot_ts_;
+  ApplyStats stats_;
+};
+}
+}
+
+#include "log_shipping_impl.h"
+
+#endif
@@ -0,0 +1,361 @@
+#pragma once
+#ifndef MICA_TRANSACTION_LOG_SHIPPING_IMPL_H_
+#define MICA_TRANSACTION_LOG_SHIPPING_IMPL_H_
+
+#include <cstdio>
+#include "mica/util/barrier.h"
+#include "mica/util/memcpy.h"
+#include "mica/util/roundup.h"
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig, class BaseLogger>
+uint64_t LogShipper<StaticConfig, BaseLogger>::region_size(uint64_t ring_count,
+                                                           uint64_t ring_size) {
+  return sizeof(Header) + sizeof(LogShippingRing) * ring_count +
+         ring_size * ring_count;
+}
+
+template <class StaticConfig, class BaseLogger>
+LogShipper<StaticConfig, BaseLogger>::LogShipper(
+    ::mica::alloc::HugeTLBFS_SHM* shm, const std::string& name,
+    uint16_t ring_count, uint64_t ring_size, BaseLogger* base_logger)
+    : shm_(shm),
+      name_(name),
+      base_logger_(base_logger),
+      ring_count_(ring_count),
+      ring_size_(::mica::util::roundup<8>(ring_size)),
+      db_(nullptr) {
+  assert(ring_count <= StaticConfig::kMaxLCoreCount);
+
+  region_size_ = region_size(ring_count_, ring_size_);
+  auto p = reinterpret_cast<char*>(shm_->map_shared(name_, region_size_, true));
+  if (p == nullptr) {
+    printf("failed to create log shipping region %s\n", name_.c_str());
+    header_ = nullptr;
+    rings_ = nullptr;
+    data_ = nullptr;
+    return;
+  }
+
+  header_ = reinterpret_cast<Header*>(p);
+  rings_ = reinterpret_cast<LogShippingRing*>(p + sizeof(Header));
+  data_ = p + sizeof(Header) + sizeof(LogShippingRing) * ring_count_;
+
+  for (uint64_t i = 0; i < ring_count_; i++) {
+    rings_[i].tail = 0;
+    rings_[i].head = 0;
+  }
+  header_->ring_count = ring_count_;
+  header_->ring_size = ring_size_;
+  header_->watermark.init(typename StaticConfig::Timestamp());
+
+  // Let the replica attach only after the header is complete.
+  ::mica::util::memory_barrier();
+  header_->magic = Header::kMagic;
+}
+
+template <class StaticConfig, class BaseLogger>
+LogShipper<StaticConfig, BaseLogger>::~LogShipper() {
+  if (header_ == nullptr) return;
+  shm_->unmap_shared(header_, region_size_);
+  // A replica that has mapped the region keeps it until it unmaps it.
+  shm_->remove_shared(name_);
+}
+
+template <class StaticConfig, class BaseLogger>
+bool LogShipper<StaticConfig, BaseLogger>::log(
+    const Transaction<StaticConfig>* tx) {
+  if (tx->wset_size() == 0 && tx->iset_size() == 0)
+    return base_logger_ == nullptr || base_logger_->log(tx);
+  if (header_ == nullptr) return false;
+
+  auto thread_id = tx->context()->thread_id();
+  assert(thread_id < ring_count_);
+  auto& r = rings_[thread_id];
+  auto data = data_ + ring_size_ * thread_id;
+
+  if (db_ == nullptr) db_ = tx->context()->db();
+
+  uint32_t record_count;
+  uint64_t size = LogEntry<StaticConfig>::size(tx, &record_count);
+
+  // An entry is kept contiguous by skipping the end of the ring.
+  uint64_t tail = r.tail;
+  uint64_t pos = tail % ring_size_;
+  uint64_t pad = ring_size_ - pos < size ? ring_size_ - pos : 0;
+  if (pad + size > ring_size_ - (tail - r.head)) return false;
+
+  if (base_logger_ != nullptr && !base_logger_->log(tx)) return false;
+
+  if (pad != 0) {
+    if (pad >= sizeof(LogTxHeader<StaticConfig>)) {
+      auto pad_h = reinterpret_cast<LogTxHeader<StaticConfig>*>(data + pos);
+      pad_h->ts = tx->ts();
+      pad_h->record_count = Header::kPaddingRecordCount;
+      pad_h->size = static_cast<uint32_t>(pad);
+    }
+    tail += pad;
+    pos = 0;
+  }
+
+  LogEntry<StaticConfig>::write(tx, record_count, size, data + pos);
+
+  // Publish the entry after it is written.
+  ::mica::util::memory_barrier();
+  r.tail = tail + size;
+  return true;
+}
+
+template <class StaticConfig, class BaseLogger>
+bool LogShipper<StaticConfig, BaseLogger>::sync(uint16_t thread_id) {
+  // Every transaction earlier than min_wts has finished logging, so its entry
+  // is already in a ring.
+  if (db_ != nullptr && header_ != nullptr)
+    header_->watermark.update(db_->min_wts());
+  if (base_logger_ != nullptr) return base_logger_->sync(thread_id);
+  return true;
+}
+
+template <class StaticConfig>
+ReplicaApplier<StaticConfig>::ReplicaApplier(DB<StaticConfig>* db,
+                                             ::mica::alloc::HugeTLBFS_SHM* shm,
+                                             const std::string& name)
+    : db_(db),
+      shm_(shm),
+      ring_count_(0),
+      ring_size_(0),
+      region_size_(0),
+      header_(nullptr),
+      rings_(nullptr),
+      data_(nullptr),
+      failed_(false),
+      has_applied_ts_(false) {
+  ::mica::util::memset(&stats_, 0, sizeof(stats_));
+
+  // Buckets are written from the shipped rows, which leaves the filters out
+  // of date.
+  db_->disable_index_filters();
+
+  // Read the header to find the size of the region.
+  auto h = reinterpret_cast<Header*>(shm_->map_shared(name, sizeof(Header),
+                                                      false));
+  if (h == nullptr) {
+    printf("failed to attach log shipping region %s\n", name.c_str());
+    return;
+  }
+  bool valid = h->magic == Header::kMagic;
+  ::mica::util::memory_barrier();
+  ring_count_ = h->ring_count;
+  ring_size_ = h->ring_size;
+  shm_->unmap_shared(h, sizeof(Header));
+  if (!valid) {
+    printf("log shipping region %s is not ready\n", name.c_str());
+    return;
+  }
+
+  region_size_ =
+      LogShipper<StaticConfig>::region_size(ring_count_, ring_size_);
+  auto p = reinterpret_cast<char*>(shm_->map_shared(name, region_size_, false));
+  if (p == nullptr) {
+    printf("failed to attach log shipping region %s\n", name.c_str());
+    return;
+  }
+
+  header_ = reinterpret_cast<Header*>(p);
+  rings_ = reinterpret_cast<LogShippingRing*>(p + sizeof(Header));
+  data_ = p + sizeof(Header) + sizeof(LogShippingRing) * ring_count_;
+}
+
+template <class StaticConfig>
+ReplicaApplier<StaticConfig>::~ReplicaApplier() {
+  if (header_ != nullptr) shm_->unmap_shared(header_, region_size_);
+}
+
+template <class StaticConfig>
+const LogTxHeader<StaticConfig>* ReplicaApplier<StaticConfig>::peek_entry(
+    uint64_t ring_id, uint64_t* head) {
+  auto& r = rings_[ring_id];
+  auto data = data_ + ring_size_ * ring_id;
+
+  uint64_t h = r.head;
+  while (h != r.tail) {
+    ::mica::util::memory_barrier();
+    uint64_t pos = h % ring_size_;
+    if (ring_size_ - pos < sizeof(LogTxHeader<StaticConfig>)) {
+      h += ring_size_ - pos;
+      continue;
+    }
+    auto tx_h = reinterpret_cast<const LogTxHeader<StaticConfig>*>(data + pos);
+    if (tx_h->record_count == Header::kPaddingRecordCount) {
+      h += tx_h->size;
+      continue;
+    }
+    *head = h;
+    return tx_h;
+  }
+  *head = h;
+  return nullptr;
+}
+
+template <class StaticConfig>
+uint64_t ReplicaApplier<StaticConfig>::apply(uint16_t thread_id,
+                                             uint64_t max_tx_count) {
+  if (header_ == nullptr || failed_) return 0;
+
+  auto watermark = header_->watermark.get();
+  ::mica::util::memory_barrier();
+
+  Transaction<StaticConfig> tx(db_->context(thread_id));
+  tx.set_applies_log(true);
+
+  uint64_t tx_count = 0;
+  uint64_t start_t = db_->sw()->now();
+  while (tx_count < max_tx_count) {
+    // Find the earliest transaction.
+    uint64_t min_ring_id = ring_count_;
+    uint64_t min_head = 0;
+    const LogTxHeader<StaticConfig>* min_tx_h = nullptr;
+    for (uint64_t ring_id = 0; ring_id < ring_count_; ring_id++) {
+      uint64_t head;
+      auto tx_h = peek_entry(ring_id, &head);
+      // Skip padding even if no entry follows.
+      rings_[ring_id].head = head;
+      if (tx_h == nullptr || !(tx_h->ts < watermark)) continue;
+      if (min_tx_h == nullptr || tx_h->ts < min_tx_h->ts) {
+        min_ring_id = ring_id;
+        min_head = head;
+        min_tx_h = tx_h;
+      }
+    }
+    if (min_tx_h == nullptr) break;
+
+    auto ret = apply_tx(thread_id, tx, min_tx_h);
+    if (ret != ApplyResult::kApplied) {
+      if (ret == ApplyResult::kInvalid) {
+        printf("failed to apply shipped log entry at offset %" PRIu64
+               " of ring %" PRIu64 "\n",
+               min_head, min_ring_id);
+        failed_ = true;
+      }
+      break;
+    }
+
+    applied_ts_ = min_tx_h->ts;
+    snapshot_ts_ = tx.ts();
+    has_applied_ts_ = true;
+    stats_.tx_count++;
+    stats_.record_count += min_tx_h->record_count;
+    stats_.byte_count += min_tx_h->size;
+
+    // Free the space after the entry is applied.
+    ::mica::util::memory_barrier();
+    rings_[min_ring_id].head = min_head + min_tx_h->size;
+    tx_count++;
+  }
+  stats_.apply_time += db_->sw()->now() - start_t;
+  return tx_count;
+}
+
+template <class StaticConfig>
+typename ReplicaApplier<StaticConfig>::ApplyResult
+ReplicaApplier<StaticConfig>::apply_tx(uint16_t thread_id,
+                                       Transaction<StaticConfig>& tx,
+                                       const LogTxHeader<StaticConfig>* tx_h) {
+  // Validate the records first so that a broken entry is not retried.
+  auto p = reinterpret_cast<const char*>(tx_h + 1);
+  auto end = reinterpret_cast<const char*>(tx_h) + tx_h->size;
+  for (uint32_t j = 0; j < tx_h->record_count; j++) {
+    if (p + sizeof(LogRecordHeader) > end) return ApplyResult::kInvalid;
+    auto rec_h = reinterpret_cast<const LogRecordHeader*>(p);
+    if (rec_h->table_id >= db_->table_count() ||
+        rec_h->cf_id >= db_->get_table_by_id(rec_h->table_id)->cf_count())
+      return ApplyResult::kInvalid;
+    p += sizeof(LogRecordHeader) +
+         ::mica::util::roundup<8>(uint64_t(rec_h->data_size));
+  }
+  if (p != end) return ApplyResult::kInvalid;
+
+  for (uint64_t retry = 0; retry <= kMaxApplyRetries; retry++) {
+    if (retry != 0) {
+      // Let the clock advance past the conflicting reader and GC reclaim
+      // deleted rows whose row IDs are reused.
+      db_->idle(thread_id);
+    }
+
+    if (!tx.begin()) return ApplyResult::kConflict;
+
+    auto ret = ApplyResult::kApplied;
+    p = reinterpret_cast<const char*>(tx_h + 1);
+    for (uint32_t j = 0; j < tx_h->record_count; j++) {
+      auto rec_h = reinterpret_cast<const LogRecordHeader*>(p);
+      ret = apply_record(tx, rec_h);
+      if (ret != ApplyResult::kApplied) break;
+      p += sizeof(LogRecordHeader) +
+           ::mica::util::roundup<8>(uint64_t(rec_h->data_size));
+    }
+    if (ret == ApplyResult::kApplied && tx.commit()) return ret;
+    if (tx.has_began()) tx.abort();
+    if (ret == ApplyResult::kInvalid) return ret;
+  }
+  return ApplyResult::kConflict;
+}
+
+template <class StaticConfig>
+typename ReplicaApplier<StaticConfig>::ApplyResult
+ReplicaApplier<StaticConfig>::apply_record(Transaction<StaticConfig>& tx,
+                                           const LogRecordHeader* rec_h) {
+  typedef typename Transaction<StaticConfig>::NoopDataCopier NoopDataCopier;
+
+  auto tbl = db_->get_table_by_id(rec_h->table_id);
+  auto data = reinterpret_cast<const char*>(rec_h + 1);
+
+  // Only the applier writes to the replica, so a row that the primary has
+  // seen is always found.
+  RowAccessHandle<StaticConfig> rah(&tx);
+  bool exists = rec_h->row_id < tbl->row_count() &&
+                rah.peek_row(tbl, rec_h->cf_id, rec_h->row_id, false,
+                             rec_h->is_delta != 0, true);
+
+  if (rec_h->status == RowVersionStatus::kDeleted) {
+    if (!exists) return ApplyResult::kInvalid;
+    if (!rah.write_row(0, NoopDataCopier()) || !rah.delete_row())
+      return ApplyResult::kConflict;
+    return ApplyResult::kApplied;
+  }
+
+  if (!exists) {
+    if (rec_h->is_delta) return ApplyResult::kInvalid;
+    // The row ID may not be reclaimed from an earlier deletion yet.
+    if (!rah.new_row(tbl, rec_h->cf_id, rec_h->row_id, false,
+                     rec_h->data_size, NoopDataCopier()))
+      return ApplyResult::kConflict;
+    ::mica::util::memcpy(rah.data(), data, rec_h->data_size);
+    return ApplyResult::kApplied;
+  }
+
+  if (rec_h->is_delta) {
+    if (!rah.read_row() || !rah.write_row()) return ApplyResult::kConflict;
+    if (uint64_t(rec_h->data_off) + rec_h->data_size > rah.size())
+      return ApplyResult::kInvalid;
+    ::mica::util::memcpy(rah.data() + rec_h->data_off, data, rec_h->data_size);
+    return ApplyResult::kApplied;
+  }
+
+  if (!rah.write_row(rec_h->data_size, NoopDataCopier()))
+    return ApplyResult::kConflict;
+  ::mica::util::memcpy(rah.data(), data, rec_h->data_size);
+  return ApplyResult::kApplied;
+}
+
+template <class StaticConfig>
+uint64_t ReplicaApplier<StaticConfig>::lag_us() const {
+  if (header_ == nullptr || !has_applied_ts_) return 0;
+  auto primary_ts = header_->watermark.get();
+  if (!(applied_ts_ < primary_ts)) return 0;
+  return primary_ts.clock_diff(applied_ts_) / db_->sw()->c_1_usec();
+}
+}
+}
+
+#endif
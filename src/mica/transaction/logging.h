@@ -2,6 +2,7 @@
 #ifndef MICA_TRANSACTION_LOGGING_H_
 #define MICA_TRANSACTION_LOGGING_H_
 
+#include <string>
 #include "mica/common.h"
 #include "mica/transaction/db.h"
 #include "mica/transaction/row.h"
@@ -15,6 +16,10 @@ template <class StaticConfig>
 class LoggerInterface {
  public:
   bool log(const Transaction<StaticConfig>* tx);
+
+  // Makes all log entries of the thread durable.  Called periodically by
+  // DB::quiescence() of the thread for group commit.
+  bool sync(uint16_t thread_id);
 };
 
 template <class StaticConfig>
@@ -24,8 +29,143 @@ class NullLogger : public LoggerInterface<StaticConfig> {
     (void)tx;
     return true;
   }
+
+  bool sync(uint16_t thread_id) {
+    (void)thread_id;
+    return true;
+  }
+};
+
+// On-disk format of the redo log.  Each committed transaction is written as a
+// LogTxHeader followed by record_count records.  Each record is a
+// LogRecordHeader followed by data_size bytes of the row data, padded to a
+// multiple of 8 bytes.  A delta record has only the bytes at data_off of the
+// row that are modified from its previous version.
+template <class StaticConfig>
+struct LogTxHeader {
+  typename StaticConfig::Timestamp ts;
+  uint32_t record_count;
+  uint32_t size;  // Including this header.
+};
+
+struct LogRecordHeader {
+  uint64_t row_id;
+  uint32_t data_size;
+  uint16_t table_id;
+  uint16_t cf_id;
+  RowVersionStatus status;  // kCommitted or kDeleted.
+  uint8_t is_delta;
+  uint8_t reserved[2];
+  uint32_t data_off;  // For a delta record.
+};
+
+// Serializes a committing transaction into the redo log format.
+template <class StaticConfig>
+class LogEntry {
+ public:
+  // logging_impl.h
+  // The size of the log entry of tx, including LogTxHeader.
+  static uint64_t size(const Transaction<StaticConfig>* tx,
+                       uint32_t* out_record_count);
+  static void write(const Transaction<StaticConfig>* tx, uint32_t record_count,
+                    uint64_t size, char* p);
+
+ private:
+  static bool is_delta(const RowAccessItem<StaticConfig>* item);
+};
+
+// A value logger that keeps a separate log buffer and log file for each
+// thread so that logging does not serialize threads on a single log.  A log
+// file is named path_prefix + thread ID.  Records in a single log file are in
+// the commit order of the thread, but there is no ordering across log files;
+// recovery must use the timestamp in LogTxHeader.
+template <class StaticConfig>
+class ParallelLogger : public LoggerInterface<StaticConfig> {
+ public:
+  typedef typename StaticConfig::Timestamp Timestamp;
+
+  // The size of the per-thread log buffer.  A transaction whose log entry is
+  // larger than this is aborted.
+  static constexpr uint64_t kBufferSize = 4 * 1048576;
+
+  // logging_impl.h
+  ParallelLogger(std::string path_prefix = "mica_log_");
+  ~ParallelLogger();
+
+  bool log(const Transaction<StaticConfig>* tx);
+
+  // Writes the buffered log of a thread to its log file.  This must be called
+  // by the thread that owns the log or when the thread is not committing.
+  bool flush(uint16_t thread_id);
+
+  bool sync(uint16_t thread_id);
+
+  // The total number of bytes written to the log file of a thread.
+  uint64_t written_size(uint16_t thread_id) const {
+    return logs_[thread_id].written;
+  }
+
+  std::string log_path(uint16_t thread_id) const;
+
+ protected:
+  // Returns the space for a log entry of size bytes in the buffer of the
+  // thread, or nullptr if it cannot be made.  The entry is added to the buffer
+  // by append().
+  char* reserve(uint16_t thread_id, uint64_t size);
+  void append(uint16_t thread_id, uint64_t size) {
+    logs_[thread_id].len += size;
+  }
+
+ private:
+  bool open(uint16_t thread_id);
+
+  struct ThreadLog {
+    int fd;
+    char* buf;
+    uint64_t len;
+    uint64_t written;
+    uint64_t synced;
+  } __attribute__((aligned(64)));
+
+  std::string path_prefix_;
+  ThreadLog logs_[StaticConfig::kMaxLCoreCount];
+};
+
+// On-disk format of the command log.  Each committed transaction is written as
+// a LogTxHeader with record_count of 1, followed by a CommandRecordHeader and
+// args_size bytes of the arguments, padded to a multiple of 8 bytes.
+struct CommandRecordHeader {
+  uint16_t proc_id;
+  uint16_t reserved;
+  uint32_t args_size;
+};
+
+// A command logger that writes the stored procedure and its arguments given
+// to Transaction::set_command() instead of the row data.  Log files are kept
+// for each thread as in ParallelLogger.
+//
+// The procedures must be deterministic so that CommandReplay can re-execute
+// them in timestamp order to reproduce the same state.  A transaction with
+// writes but without a command is aborted unless allow_unlogged_writes is
+// set, in which case it is not logged at all; this is only for setup work
+// that is redone before replay, such as HashIndex::init().
+template <class StaticConfig>
+class CommandLogger : public ParallelLogger<StaticConfig> {
+ public:
+  CommandLogger(std::string path_prefix = "mica_cmd_log_",
+                bool allow_unlogged_writes = false)
+      : ParallelLogger<StaticConfig>(path_prefix),
+        allow_unlogged_writes_(allow_unlogged_writes) {}
+
+  // logging_impl.h
+  bool log(const Transaction<StaticConfig>* tx);
+
+ private:
+  bool allow_unlogged_writes_;
 };
 }
 }
 
-#endif
\ No newline at end of file
+#include "logging_impl.h"
+
+#endif
@@ -0,0 +1,258 @@
+#pragma once
+#ifndef MICA_TRANSACTION_LOGGING_IMPL_H_
+#define MICA_TRANSACTION_LOGGING_IMPL_H_
+
+#include <fcntl.h>
+#include <unistd.h>
+#include "mica/util/memcpy.h"
+#include "mica/util/roundup.h"
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+ParallelLogger<StaticConfig>::ParallelLogger(std::string path_prefix)
+    : path_prefix_(path_prefix) {
+  for (size_t thread_id = 0; thread_id < StaticConfig::kMaxLCoreCount;
+       thread_id++) {
+    auto& l = logs_[thread_id];
+    l.fd = -1;
+    l.buf = nullptr;
+    l.len = 0;
+    l.written = 0;
+    l.synced = 0;
+  }
+}
+
+template <class StaticConfig>
+ParallelLogger<StaticConfig>::~ParallelLogger() {
+  for (uint16_t thread_id = 0; thread_id < StaticConfig::kMaxLCoreCount;
+       thread_id++) {
+    auto& l = logs_[thread_id];
+    if (l.buf == nullptr) continue;
+
+    sync(thread_id);
+    ::close(l.fd);
+    delete[] l.buf;
+  }
+}
+
+template <class StaticConfig>
+std::string ParallelLogger<StaticConfig>::log_path(uint16_t thread_id) const {
+  return path_prefix_ + std::to_string(thread_id);
+}
+
+template <class StaticConfig>
+bool ParallelLogger<StaticConfig>::open(uint16_t thread_id) {
+  auto& l = logs_[thread_id];
+  assert(l.buf == nullptr);
+
+  auto path = log_path(thread_id);
+  l.fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (l.fd == -1) {
+    printf("failed to open log file %s\n", path.c_str());
+    return false;
+  }
+
+  // Allocated by the owner thread so that the buffer is on its NUMA node.
+  l.buf = new char[kBufferSize];
+  l.len = 0;
+  l.written = 0;
+  l.synced = 0;
+  return true;
+}
+
+template <class StaticConfig>
+bool LogEntry<StaticConfig>::is_delta(const RowAccessItem<StaticConfig>* item) {
+  // Only the modified range is written for a row that keeps the data of its
+  // previous version except for the range marked by mark_dirty().
+  return item->state == RowAccessState::kReadWrite && item->dirty_end != 0 &&
+         item->write_rv->data_size == item->read_rv->data_size;
+}
+
+template <class StaticConfig>
+uint64_t LogEntry<StaticConfig>::size(const Transaction<StaticConfig>* tx,
+                                      uint32_t* out_record_count) {
+  auto accesses = tx->accesses();
+
+  auto record_size = [](const RowAccessItem<StaticConfig>* item) {
+    uint64_t data_size = 0;
+    if (is_delta(item))
+      data_size = item->dirty_end - item->dirty_begin;
+    else if (item->state != RowAccessState::kDelete &&
+             item->state != RowAccessState::kReadDelete)
+      data_size = item->write_rv->data_size;
+    return sizeof(LogRecordHeader) + ::mica::util::roundup<8>(data_size);
+  };
+
+  uint64_t size = sizeof(LogTxHeader<StaticConfig>);
+  uint32_t record_count = 0;
+  for (auto j = 0; j < tx->wset_size(); j++) {
+    size += record_size(&accesses[tx->wset_idx()[j]]);
+    record_count++;
+  }
+  for (auto j = 0; j < tx->iset_size(); j++) {
+    auto item = &accesses[tx->iset_idx()[j]];
+    // Skip new rows that have been deleted by the same transaction.
+    if (item->state == RowAccessState::kInvalid) continue;
+    size += record_size(item);
+    record_count++;
+  }
+
+  *out_record_count = record_count;
+  return size;
+}
+
+template <class StaticConfig>
+void LogEntry<StaticConfig>::write(const Transaction<StaticConfig>* tx,
+                                   uint32_t record_count, uint64_t size,
+                                   char* p) {
+  auto accesses = tx->accesses();
+  char* end = p + size;
+
+  auto tx_h = reinterpret_cast<LogTxHeader<StaticConfig>*>(p);
+  tx_h->ts = tx->ts();
+  tx_h->record_count = record_count;
+  tx_h->size = static_cast<uint32_t>(size);
+  p += sizeof(LogTxHeader<StaticConfig>);
+
+  auto append_record = [&p](const RowAccessItem<StaticConfig>* item) {
+    auto rec_h = reinterpret_cast<LogRecordHeader*>(p);
+    rec_h->row_id = item->row_id;
+    rec_h->table_id = item->tbl->id();
+    rec_h->cf_id = item->cf_id;
+    rec_h->is_delta = 0;
+    rec_h->data_off = 0;
+    p += sizeof(LogRecordHeader);
+
+    if (item->state == RowAccessState::kDelete ||
+        item->state == RowAccessState::kReadDelete) {
+      rec_h->data_size = 0;
+      rec_h->status = RowVersionStatus::kDeleted;
+    } else if (is_delta(item)) {
+      rec_h->data_size = item->dirty_end - item->dirty_begin;
+      rec_h->status = RowVersionStatus::kCommitted;
+      rec_h->is_delta = 1;
+      rec_h->data_off = item->dirty_begin;
+      ::mica::util::memcpy(p, item->write_rv->data + item->dirty_begin,
+                           rec_h->data_size);
+      p += ::mica::util::roundup<8>(uint64_t(rec_h->data_size));
+    } else {
+      rec_h->data_size = item->write_rv->data_size;
+      rec_h->status = RowVersionStatus::kCommitted;
+      ::mica::util::memcpy(p, item->write_rv->data, rec_h->data_size);
+      p += ::mica::util::roundup<8>(uint64_t(rec_h->data_size));
+    }
+  };
+
+  for (auto j = 0; j < tx->wset_size(); j++)
+    append_record(&accesses[tx->wset_idx()[j]]);
+  for (auto j = 0; j < tx->iset_size(); j++) {
+    auto item = &accesses[tx->iset_idx()[j]];
+    if (item->state == RowAccessState::kInvalid) continue;
+    append_record(item);
+  }
+
+  assert(p == end);
+  (void)end;
+}
+
+template <class StaticConfig>
+bool ParallelLogger<StaticConfig>::log(const Transaction<StaticConfig>* tx) {
+  if (tx->wset_size() == 0 && tx->iset_size() == 0) return true;
+
+  auto thread_id = tx->context()->thread_id();
+
+  uint32_t record_count;
+  uint64_t size = LogEntry<StaticConfig>::size(tx, &record_count);
+
+  char* p = reserve(thread_id, size);
+  if (p == nullptr) return false;
+
+  LogEntry<StaticConfig>::write(tx, record_count, size, p);
+  append(thread_id, size);
+  return true;
+}
+
+template <class StaticConfig>
+char* ParallelLogger<StaticConfig>::reserve(uint16_t thread_id,
+                                            uint64_t size) {
+  auto& l = logs_[thread_id];
+  if (l.buf == nullptr && !open(thread_id)) return nullptr;
+
+  if (size > kBufferSize) return nullptr;
+  if (l.len + size > kBufferSize && !flush(thread_id)) return nullptr;
+  return l.buf + l.len;
+}
+
+template <class StaticConfig>
+bool ParallelLogger<StaticConfig>::flush(uint16_t thread_id) {
+  auto& l = logs_[thread_id];
+  if (l.buf == nullptr) return true;
+
+  uint64_t off = 0;
+  while (off < l.len) {
+    auto ret = ::write(l.fd, l.buf + off, l.len - off);
+    if (ret == -1) {
+      printf("failed to write log file %s\n", log_path(thread_id).c_str());
+      // Keep the unwritten part.
+      ::mica::util::memmove(l.buf, l.buf + off, l.len - off);
+      l.len -= off;
+      l.written += off;
+      return false;
+    }
+    off += static_cast<uint64_t>(ret);
+  }
+
+  l.written += l.len;
+  l.len = 0;
+  return true;
+}
+
+template <class StaticConfig>
+bool ParallelLogger<StaticConfig>::sync(uint16_t thread_id) {
+  auto& l = logs_[thread_id];
+  if (l.buf == nullptr) return true;
+  if (l.len == 0 && l.synced == l.written) return true;
+
+  if (!flush(thread_id)) return false;
+  if (::fdatasync(l.fd) != 0) {
+    printf("failed to sync log file %s\n", log_path(thread_id).c_str());
+    return false;
+  }
+  l.synced = l.written;
+  return true;
+}
+
+template <class StaticConfig>
+bool CommandLogger<StaticConfig>::log(const Transaction<StaticConfig>* tx) {
+  if (tx->wset_size() == 0 && tx->iset_size() == 0) return true;
+  if (!tx->has_command()) return allow_unlogged_writes_;
+
+  auto thread_id = tx->context()->thread_id();
+
+  uint64_t size = sizeof(LogTxHeader<StaticConfig>) +
+                  sizeof(CommandRecordHeader) +
+                  ::mica::util::roundup<8>(uint64_t(tx->command_args_size()));
+
+  char* p = this->reserve(thread_id, size);
+  if (p == nullptr) return false;
+
+  auto tx_h = reinterpret_cast<LogTxHeader<StaticConfig>*>(p);
+  tx_h->ts = tx->ts();
+  tx_h->record_count = 1;
+  tx_h->size = static_cast<uint32_t>(size);
+
+  auto cmd_h = reinterpret_cast<CommandRecordHeader*>(tx_h + 1);
+  cmd_h->proc_id = tx->command_proc_id();
+  cmd_h->reserved = 0;
+  cmd_h->args_size = tx->command_args_size();
+  if (cmd_h->args_size != 0)
+    ::mica::util::memcpy(cmd_h + 1, tx->command_args(), cmd_h->args_size);
+
+  this->append(thread_id, size);
+  return true;
+}
+}
+}
+
+#endif
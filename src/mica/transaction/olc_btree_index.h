@@ -0,0 +1,277 @@
+#pragma once
+#ifndef MICA_TRANSACTION_OLC_BTREE_INDEX_H_
+#define MICA_TRANSACTION_OLC_BTREE_INDEX_H_
+
+#include <algorithm>
+#include <vector>
+#include "mica/common.h"
+#include "mica/transaction/btree_index.h"
+#include "mica/util/barrier.h"
+
+namespace mica {
+namespace transaction {
+// A B+tree index for unique uint64_t keys whose nodes are in plain memory
+// instead of the rows of an index table.
+//
+// Nodes are synchronized with optimistic lock coupling: each node has a
+// version that a writer locks and bumps, and a reader retries when a node's
+// version changes while it reads the node.  Index operations thus do not add
+// to the access set of the transaction.
+//
+// Transactions are serialized in timestamp order as for rows.  Each leaf node
+// has a read timestamp (rts) that a reader raises to its timestamp before it
+// reads the leaf node, which covers both the entries it finds and the keys
+// missing in the leaf node.  Each entry keeps the timestamp of its insert,
+// and each leaf node keeps the latest timestamp of the removals committed in
+// it.  A reader does not see entries inserted after its timestamp, and it
+// aborts if a removal after its timestamp has committed in the leaf node.
+//
+// Writes are buffered in the transaction.  Its validation installs them in
+// the leaf nodes as pending entries, which fails if a transaction with a
+// later timestamp has read the leaf node, as a write to a row version does
+// with the rts of the version.  A reader aborts on a pending entry of a
+// transaction with an earlier timestamp.  commit() makes the pending entries
+// final, and abort() undoes them (see Transaction::ExternalIndex).  A read
+// needs no validation, and writers do not abort other transactions only by
+// changing the leaf nodes they have read.
+//
+// One rts covers all keys in a leaf node, so a read of any key in the leaf
+// node makes inserts and removals of other keys in it abort if they have an
+// earlier timestamp.
+//
+// The entries are not logged.  If the index is declared as a secondary index
+// of its main table (Table::add_secondary_index()), rebuild() restores the
+// entries from the rows, which Recovery and DB::reattach() do, and a replica
+// keeps the index up to date while applying shipped logs (see
+// ReplicaApplier).  Otherwise, the application must add the entries again.
+//
+// Nodes are never freed, so a reader can follow any node pointer that it has
+// read; leaf nodes emptied by removes stay in the tree.
+template <class StaticConfig>
+class OLCBTreeIndex {
+ public:
+  typedef typename StaticConfig::Timing Timing;
+  typedef typename StaticConfig::Timestamp Timestamp;
+  typedef typename StaticConfig::ConcurrentTimestamp ConcurrentTimestamp;
+  typedef ::mica::transaction::Transaction<StaticConfig> Transaction;
+
+  static constexpr bool kUseSIMDSearch =
+      StaticConfig::kBTreeSIMDSearch && BTreeSIMDSearch<uint64_t>::kSupported;
+
+  static constexpr int kMaxCount = 32;
+
+  struct Node {
+    // Bit 0 is set while a writer holds the node, and every unlock makes a
+    // new even version.
+    volatile uint64_t version;
+    bool is_leaf;
+    volatile uint16_t count;
+    uint64_t keys[kMaxCount];
+  };
+
+  struct InternalNode : public Node {
+    // keys[i] <= (any keys in children[i + 1]) < keys[i + 1]
+    Node* volatile children[kMaxCount + 1];
+  };
+
+  // The state of an entry in a leaf node.
+  enum EntryState : uint8_t {
+    kCommitted = 0,
+    // Inserted by a transaction that has not committed yet.
+    kPendingInsert,
+    // Removed, or given a new value, by a transaction that has not committed
+    // yet.
+    kPendingRemove,
+  };
+
+  struct LeafNode : public Node {
+    // The latest timestamp of the transactions that have read the leaf node.
+    ConcurrentTimestamp rts;
+    // The latest timestamp of the removals and value changes committed in the
+    // leaf node.
+    Timestamp remove_wts;
+    volatile uint64_t values[kMaxCount];
+    // The timestamp of the transaction that has inserted the entry.
+    Timestamp wts[kMaxCount];
+    // The timestamp of the transaction that has made the entry pending.
+    Timestamp pending_ts[kMaxCount];
+    volatile uint8_t states[kMaxCount];
+  };
+
+  static constexpr uint64_t kNullRowID = static_cast<uint64_t>(-1);
+
+  static constexpr uint64_t kHaveToAbort = static_cast<uint64_t>(-1);
+
+  // olc_btree_index_impl/init.h
+  OLCBTreeIndex(DB<StaticConfig>* db, Table<StaticConfig>* main_tbl);
+  ~OLCBTreeIndex();
+
+  // olc_btree_index_impl/insert.h
+  uint64_t insert(Transaction* tx, uint64_t key, uint64_t value);
+
+  // olc_btree_index_impl/remove.h
+  uint64_t remove(Transaction* tx, uint64_t key, uint64_t value);
+
+  // olc_btree_index_impl/lookup.h
+  template <typename Func>
+  uint64_t lookup(Transaction* tx, uint64_t key, bool skip_validation,
+                  const Func& func);
+
+  template <BTreeRangeType LeftRangeType, BTreeRangeType RightRangeType,
+            bool Reversed, typename Func>
+  uint64_t lookup(Transaction* tx, uint64_t min_key, uint64_t max_key,
+                  bool skip_validation, const Func& func);
+
+  // olc_btree_index_impl/init.h
+  // Replaces the entries with those of the latest committed rows if the index
+  // is a secondary index of its main table.  Returns false otherwise.  No
+  // transaction may be running.
+  bool rebuild();
+
+  Table<StaticConfig>* main_table() { return main_tbl_; }
+  const Table<StaticConfig>* main_table() const { return main_tbl_; }
+
+  uint64_t node_count() const { return node_count_; }
+
+ private:
+  DB<StaticConfig>* db_;
+  Table<StaticConfig>* main_tbl_;
+
+  Node* volatile root_;
+  volatile uint64_t node_count_;
+
+  // A write buffered until the validation.  old_value is kNullRowID for an
+  // insert, and new_value is kNullRowID for a removal.
+  struct Write {
+    uint64_t key;
+    uint64_t old_value;
+    uint64_t new_value;
+  };
+
+  struct Entry {
+    uint64_t key;
+    uint64_t value;
+  };
+
+  // The state of the current transaction on each thread.  It is valid only if
+  // the transaction has the index as an external index.
+  struct ThreadState {
+    std::vector<Write> writes;
+    // The number of writes (from the first one) installed in the tree.
+    size_t installed;
+    // The timestamp of the transaction that has installed the writes.
+    Timestamp ts;
+  } __attribute__((aligned(64)));
+  std::vector<ThreadState> thread_states_;
+
+  // How an entry looks to a reader.
+  enum class Visibility {
+    kVisible,
+    kInvisible,
+    // The reader must abort.
+    kConflict,
+  };
+
+  // olc_btree_index_impl/node.h
+  template <class NodeT>
+  NodeT* make_node();
+  static void free_subtree(Node* node);
+
+  static bool read_lock(const Node* node, uint64_t* version);
+  static bool read_unlock(const Node* node, uint64_t version);
+  static bool upgrade_lock(Node* node, uint64_t version);
+  static void write_unlock(Node* node);
+
+  static int lower_bound(const Node* node, int count, uint64_t key);
+  static int child_pos(const InternalNode* node, int count, uint64_t key);
+
+  static InternalNode* as_internal(Node* node) {
+    return static_cast<InternalNode*>(node);
+  }
+  static const InternalNode* as_internal(const Node* node) {
+    return static_cast<const InternalNode*>(node);
+  }
+  static LeafNode* as_leaf(Node* node) { return static_cast<LeafNode*>(node); }
+  static const LeafNode* as_leaf(const Node* node) {
+    return static_cast<const LeafNode*>(node);
+  }
+
+  // Splits a full node held by the caller and adds a new right node to the
+  // parent, which must be held too unless the node is the root.  Returns the
+  // new node, which is also held.
+  Node* split(InternalNode* parent, Node* node);
+
+  // Returns the leaf node for the key and its version.  The leaf node covers
+  // the keys in [*low, *high), where a missing bound is indicated by has_low
+  // and has_high.
+  LeafNode* find_leaf(uint64_t key, uint64_t* version, bool* has_low,
+                      uint64_t* low, bool* has_high, uint64_t* high) const;
+
+  // Moves an entry between leaf nodes, or within a leaf node.
+  static void move_entry(LeafNode* dst, int dst_pos, const LeafNode* src,
+                         int src_pos);
+  static void remove_entry_at(LeafNode* leaf, int pos);
+
+  // Locks the leaf node for the key, and calls func(leaf, pos) with the
+  // lower bound of the key in it.  Returns the result of func.
+  template <typename Func>
+  bool update_leaf(uint64_t key, const Func& func);
+
+  // olc_btree_index_impl/insert.h
+  // Adds an entry with the timestamp, splitting full nodes on the way.  If
+  // pending is true, the entry is added pending, which fails if the leaf
+  // node has been read with a later timestamp.  Returns false if the key
+  // exists in any state.
+  bool insert_entry(uint64_t key, uint64_t value, const Timestamp& ts,
+                    bool pending);
+
+  // olc_btree_index_impl/lookup.h
+  // Raises the rts of the leaf node to the timestamp of the transaction.
+  static void read_leaf(Transaction* tx, LeafNode* leaf);
+
+  static Visibility get_visibility(const LeafNode* leaf, int pos,
+                                   const Timestamp& ts, bool skip_validation);
+
+  // Finds the value for the key that the transaction can see, ignoring its
+  // own writes.  Returns 1 if found, 0 if not found, or kHaveToAbort.
+  uint64_t read_entry(Transaction* tx, uint64_t key, bool skip_validation,
+                      uint64_t* value);
+
+  // Appends the entries of the leaf node with keys in [min_key, max_key] that
+  // the transaction can see.  Returns false if the leaf node has changed.
+  // *conflict is set if the transaction must abort.
+  static bool copy_entries(Transaction* tx, const LeafNode* leaf,
+                           uint64_t version, uint64_t min_key,
+                           uint64_t max_key, bool skip_validation,
+                           std::vector<Entry>* entries, bool* conflict);
+
+  // olc_btree_index_impl/tracking.h
+  // Returns the state of the transaction, or nullptr if it has not written to
+  // the index.
+  ThreadState* thread_state(Transaction* tx);
+  ThreadState& track_transaction(Transaction* tx);
+
+  static Write* find_write(ThreadState& state, uint64_t key);
+
+  // Installs the write as pending entries.  Returns false on a conflict.
+  bool install_write(const Timestamp& ts, const Write& write);
+  // Makes the installed write final if committed is true, or undoes it.
+  void finish_write(const Timestamp& ts, const Write& write, bool committed);
+  // Undoes the installed writes and clears the state.
+  void discard(ThreadState& state);
+
+  static bool validate_tx(void* idx, Transaction* tx);
+  static void commit_tx(void* idx, Transaction* tx);
+  static void abort_tx(void* idx, Transaction* tx);
+};
+}
+}
+
+#include "olc_btree_index_impl/init.h"
+#include "olc_btree_index_impl/node.h"
+#include "olc_btree_index_impl/tracking.h"
+#include "olc_btree_index_impl/insert.h"
+#include "olc_btree_index_impl/remove.h"
+#include "olc_btree_index_impl/lookup.h"
+
+#endif
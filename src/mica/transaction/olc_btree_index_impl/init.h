@@ -0,0 +1,54 @@
+#pragma once
+#ifndef MICA_TRANSACTION_OLC_BTREE_INDEX_IMPL_INIT_H_
+#define MICA_TRANSACTION_OLC_BTREE_INDEX_IMPL_INIT_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+OLCBTreeIndex<StaticConfig>::OLCBTreeIndex(DB<StaticConfig>* db,
+                                           Table<StaticConfig>* main_tbl)
+    : db_(db), main_tbl_(main_tbl), node_count_(0) {
+  thread_states_.resize(db_->thread_count());
+  for (auto& state : thread_states_) state.installed = 0;
+
+  root_ = make_node<LeafNode>();
+}
+
+template <class StaticConfig>
+OLCBTreeIndex<StaticConfig>::~OLCBTreeIndex() {
+  free_subtree(root_);
+}
+
+template <class StaticConfig>
+bool OLCBTreeIndex<StaticConfig>::rebuild() {
+  const SecondaryIndex<StaticConfig>* sidx = nullptr;
+  for (auto& s : main_tbl_->secondary_indexes())
+    if (s.idx == this) sidx = &s;
+  if (sidx == nullptr) return false;
+
+  free_subtree(root_);
+  node_count_ = 0;
+  root_ = make_node<LeafNode>();
+  for (auto& state : thread_states_) {
+    state.writes.clear();
+    state.installed = 0;
+  }
+
+  // The entries are older than any transaction that may run later.
+  auto ts = db_->min_wts();
+  auto row_count = main_tbl_->row_count();
+  for (uint64_t row_id = 0; row_id < row_count; row_id++) {
+    auto rv = main_tbl_->latest_rv(sidx->cf_id, row_id);
+    if (rv == nullptr || rv->status == RowVersionStatus::kDeleted ||
+        rv->data_size < sidx->key_offset + sizeof(uint64_t))
+      continue;
+    uint64_t key;
+    ::memcpy(&key, rv->data + sidx->key_offset, sizeof(key));
+    insert_entry(key, row_id, ts, false);
+  }
+  return true;
+}
+}
+}
+
+#endif
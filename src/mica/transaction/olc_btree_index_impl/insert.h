@@ -0,0 +1,118 @@
+#pragma once
+#ifndef MICA_TRANSACTION_OLC_BTREE_INDEX_IMPL_INSERT_H_
+#define MICA_TRANSACTION_OLC_BTREE_INDEX_IMPL_INSERT_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+uint64_t OLCBTreeIndex<StaticConfig>::insert(Transaction* tx, uint64_t key,
+                                             uint64_t value) {
+  Timing t(tx->context()->timing_stack(), &Stats::index_write);
+  assert(value != kNullRowID);
+
+  auto& state = track_transaction(tx);
+
+  auto write = find_write(state, key);
+  if (write != nullptr) {
+    if (write->new_value != kNullRowID) return 0;
+    write->new_value = value;
+    return 1;
+  }
+
+  // The key must be missing at the timestamp of the transaction.
+  uint64_t found_value;
+  auto ret = read_entry(tx, key, false, &found_value);
+  if (ret != 0) return ret == 1 ? 0 : ret;
+
+  state.writes.push_back(Write{key, kNullRowID, value});
+  return 1;
+}
+
+template <class StaticConfig>
+bool OLCBTreeIndex<StaticConfig>::insert_entry(uint64_t key, uint64_t value,
+                                               const Timestamp& ts,
+                                               bool pending) {
+  while (true) {
+    Node* node = root_;
+    uint64_t v;
+    if (!read_lock(node, &v)) continue;
+    if (node != root_) continue;
+
+    InternalNode* parent = nullptr;
+    uint64_t parent_v = 0;
+
+    while (true) {
+      if (node->count == kMaxCount) {
+        // Split full nodes on the way down so that a split always finds room
+        // in the parent.
+        if (parent != nullptr && !upgrade_lock(parent, parent_v)) break;
+        if (!upgrade_lock(node, v)) {
+          if (parent != nullptr) write_unlock(parent);
+          break;
+        }
+        if (parent == nullptr && node != root_) {
+          write_unlock(node);
+          break;
+        }
+
+        auto right = split(parent, node);
+
+        write_unlock(right);
+        write_unlock(node);
+        if (parent != nullptr) write_unlock(parent);
+        break;
+      }
+
+      if (node->is_leaf) {
+        auto leaf = as_leaf(node);
+        int count = leaf->count;
+        auto pos = lower_bound(leaf, count, key);
+
+        if (pos < count && leaf->keys[pos] == key) {
+          if (!read_unlock(leaf, v)) break;
+          return false;
+        }
+
+        // The leaf node still covers the key if it has not changed since we
+        // got its version from the parent.
+        if (!upgrade_lock(leaf, v)) break;
+
+        // The key must have been missing for any reader with a later
+        // timestamp, and no removal after the timestamp may have deleted an
+        // entry for the key.
+        if (pending && (leaf->rts.get() > ts || leaf->remove_wts > ts)) {
+          write_unlock(leaf);
+          return false;
+        }
+
+        for (int i = count; i > pos; i--) move_entry(leaf, i, leaf, i - 1);
+        leaf->keys[pos] = key;
+        leaf->values[pos] = value;
+        leaf->wts[pos] = ts;
+        leaf->pending_ts[pos] = ts;
+        leaf->states[pos] = pending ? kPendingInsert : kCommitted;
+        leaf->count = static_cast<uint16_t>(count + 1);
+
+        write_unlock(leaf);
+        return true;
+      }
+
+      auto inode = as_internal(node);
+      Node* child = inode->children[child_pos(inode, inode->count, key)];
+      if (!read_unlock(node, v)) break;
+
+      uint64_t child_v;
+      if (!read_lock(child, &child_v) || !read_unlock(node, v)) break;
+
+      parent = inode;
+      parent_v = v;
+      node = child;
+      v = child_v;
+    }
+    // Restart from the root.
+  }
+}
+}
+}
+
+#endif
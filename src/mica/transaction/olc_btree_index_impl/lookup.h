@@ -0,0 +1,211 @@
+#pragma once
+#ifndef MICA_TRANSACTION_OLC_BTREE_INDEX_IMPL_LOOKUP_H_
+#define MICA_TRANSACTION_OLC_BTREE_INDEX_IMPL_LOOKUP_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+template <typename Func>
+uint64_t OLCBTreeIndex<StaticConfig>::lookup(Transaction* tx, uint64_t key,
+                                             bool skip_validation,
+                                             const Func& func) {
+  Timing t(tx->context()->timing_stack(), &Stats::index_read);
+
+  // The writes of this transaction come first.
+  auto state = thread_state(tx);
+  auto write = state != nullptr ? find_write(*state, key) : nullptr;
+  if (write != nullptr) {
+    if (write->new_value == kNullRowID) return 0;
+    const uint64_t found_key = key;
+    func(found_key, write->new_value);
+    return 1;
+  }
+
+  uint64_t value;
+  auto ret = read_entry(tx, key, skip_validation, &value);
+  if (ret != 1) return ret;
+  const uint64_t found_key = key;
+  func(found_key, value);
+  return 1;
+}
+
+template <class StaticConfig>
+template <BTreeRangeType LeftRangeType, BTreeRangeType RightRangeType,
+          bool Reversed, typename Func>
+uint64_t OLCBTreeIndex<StaticConfig>::lookup(Transaction* tx,
+                                             uint64_t min_key,
+                                             uint64_t max_key,
+                                             bool skip_validation,
+                                             const Func& func) {
+  Timing t(tx->context()->timing_stack(), &Stats::index_read);
+
+  // Turn the range into [min_key, max_key].
+  if (LeftRangeType == BTreeRangeType::kOpen)
+    min_key = 0;
+  else if (LeftRangeType == BTreeRangeType::kExclusive) {
+    if (min_key == static_cast<uint64_t>(-1)) return 0;
+    min_key++;
+  }
+  if (RightRangeType == BTreeRangeType::kOpen)
+    max_key = static_cast<uint64_t>(-1);
+  else if (RightRangeType == BTreeRangeType::kExclusive) {
+    if (max_key == 0) return 0;
+    max_key--;
+  }
+  if (min_key > max_key) return 0;
+
+  auto state = thread_state(tx);
+
+  // Leaf nodes have no sibling pointers; the next leaf node is found from the
+  // root with the bound of the current leaf node.
+  uint64_t found = 0;
+  uint64_t key = Reversed ? max_key : min_key;
+  std::vector<Entry> entries;
+  while (true) {
+    bool has_low, has_high;
+    uint64_t low, high;
+    uint64_t leaf_min_key = Reversed ? min_key : key;
+    uint64_t leaf_max_key = Reversed ? key : max_key;
+    bool conflict;
+    while (true) {
+      uint64_t version;
+      auto leaf = find_leaf(key, &version, &has_low, &low, &has_high, &high);
+      if (!skip_validation) read_leaf(tx, leaf);
+      entries.clear();
+      if (copy_entries(tx, leaf, version, leaf_min_key, leaf_max_key,
+                       skip_validation, &entries, &conflict))
+        break;
+    }
+    if (conflict) return kHaveToAbort;
+
+    if (state != nullptr && !state->writes.empty()) {
+      // Apply the writes of this transaction to the keys covered by the leaf
+      // node.
+      if (has_low && leaf_min_key < low) leaf_min_key = low;
+      if (has_high && leaf_max_key >= high) leaf_max_key = high - 1;
+      bool added = false;
+      for (auto& write : state->writes) {
+        if (write.key < leaf_min_key || write.key > leaf_max_key) continue;
+        auto it = std::find_if(
+            entries.begin(), entries.end(),
+            [&](const Entry& entry) { return entry.key == write.key; });
+        if (it == entries.end()) {
+          if (write.new_value == kNullRowID) continue;
+          entries.push_back(Entry{write.key, write.new_value});
+          added = true;
+        } else if (write.new_value == kNullRowID)
+          entries.erase(it);
+        else
+          it->value = write.new_value;
+      }
+      if (added)
+        std::sort(entries.begin(), entries.end(),
+                  [](const Entry& a, const Entry& b) { return a.key < b.key; });
+    }
+
+    auto count = entries.size();
+    for (size_t j = 0; j < count; j++) {
+      auto& entry = entries[Reversed ? count - 1 - j : j];
+      found++;
+      const uint64_t found_key = entry.key;
+      if (!func(found_key, entry.value)) return found;
+    }
+
+    if (Reversed) {
+      if (!has_low || low <= min_key) break;
+      key = low - 1;
+    } else {
+      if (!has_high || high > max_key) break;
+      key = high;
+    }
+  }
+  return found;
+}
+
+template <class StaticConfig>
+void OLCBTreeIndex<StaticConfig>::read_leaf(Transaction* tx, LeafNode* leaf) {
+  // A writer checks the rts while holding the leaf node, so either it sees
+  // our timestamp, or we see its write when validating the version.
+  leaf->rts.update(tx->ts());
+  ::mica::util::mfence();
+}
+
+template <class StaticConfig>
+typename OLCBTreeIndex<StaticConfig>::Visibility
+OLCBTreeIndex<StaticConfig>::get_visibility(const LeafNode* leaf, int pos,
+                                            const Timestamp& ts,
+                                            bool skip_validation) {
+  auto state = leaf->states[pos];
+  if (skip_validation)
+    return state == kPendingInsert ? Visibility::kInvisible
+                                   : Visibility::kVisible;
+
+  // An earlier transaction may still commit its write, which we would miss.
+  if (state == kPendingInsert)
+    return leaf->pending_ts[pos] < ts ? Visibility::kConflict
+                                      : Visibility::kInvisible;
+  if (leaf->wts[pos] > ts) return Visibility::kInvisible;
+  if (state == kPendingRemove && leaf->pending_ts[pos] < ts)
+    return Visibility::kConflict;
+  return Visibility::kVisible;
+}
+
+template <class StaticConfig>
+uint64_t OLCBTreeIndex<StaticConfig>::read_entry(Transaction* tx,
+                                                 uint64_t key,
+                                                 bool skip_validation,
+                                                 uint64_t* value) {
+  while (true) {
+    bool has_low, has_high;
+    uint64_t low, high;
+    uint64_t v;
+    auto leaf = find_leaf(key, &v, &has_low, &low, &has_high, &high);
+    if (!skip_validation) read_leaf(tx, leaf);
+
+    auto visibility = Visibility::kInvisible;
+    // An entry removed after our timestamp is no longer in the leaf node.
+    if (!skip_validation && leaf->remove_wts > tx->ts())
+      visibility = Visibility::kConflict;
+    else {
+      int count = leaf->count;
+      auto pos = lower_bound(leaf, count, key);
+      if (pos < count && leaf->keys[pos] == key) {
+        visibility = get_visibility(leaf, pos, tx->ts(), skip_validation);
+        *value = leaf->values[pos];
+      }
+    }
+    if (!read_unlock(leaf, v)) continue;
+
+    if (visibility == Visibility::kConflict) return kHaveToAbort;
+    return visibility == Visibility::kVisible ? 1 : 0;
+  }
+}
+
+template <class StaticConfig>
+bool OLCBTreeIndex<StaticConfig>::copy_entries(
+    Transaction* tx, const LeafNode* leaf, uint64_t version, uint64_t min_key,
+    uint64_t max_key, bool skip_validation, std::vector<Entry>* entries,
+    bool* conflict) {
+  *conflict = !skip_validation && leaf->remove_wts > tx->ts();
+  int leaf_count = leaf->count;
+  for (auto i = lower_bound(leaf, leaf_count, min_key);
+       i < leaf_count && !*conflict; i++) {
+    auto key = leaf->keys[i];
+    if (key > max_key) break;
+    switch (get_visibility(leaf, i, tx->ts(), skip_validation)) {
+      case Visibility::kVisible:
+        entries->push_back(Entry{key, leaf->values[i]});
+        break;
+      case Visibility::kInvisible:
+        break;
+      case Visibility::kConflict:
+        *conflict = true;
+        break;
+    }
+  }
+  return read_unlock(leaf, version);
+}
+}
+}
+
+#endif
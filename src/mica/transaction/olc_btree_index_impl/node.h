@@ -0,0 +1,241 @@
+#pragma once
+#ifndef MICA_TRANSACTION_OLC_BTREE_INDEX_IMPL_NODE_H_
+#define MICA_TRANSACTION_OLC_BTREE_INDEX_IMPL_NODE_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+template <class NodeT>
+NodeT* OLCBTreeIndex<StaticConfig>::make_node() {
+  auto node = new NodeT();
+  node->version = 0;
+  node->is_leaf = std::is_same<NodeT, LeafNode>::value;
+  node->count = 0;
+  if (std::is_same<NodeT, LeafNode>::value) {
+    // No transaction running now can be later than min_wts.
+    auto leaf = reinterpret_cast<LeafNode*>(node);
+    leaf->rts.init(db_->min_wts());
+    leaf->remove_wts = db_->min_wts();
+  }
+  __sync_fetch_and_add(&node_count_, 1);
+  return node;
+}
+
+template <class StaticConfig>
+void OLCBTreeIndex<StaticConfig>::free_subtree(Node* node) {
+  if (node->is_leaf) {
+    delete as_leaf(node);
+    return;
+  }
+  auto inode = as_internal(node);
+  for (int i = 0; i <= inode->count; i++) free_subtree(inode->children[i]);
+  delete inode;
+}
+
+template <class StaticConfig>
+bool OLCBTreeIndex<StaticConfig>::read_lock(const Node* node,
+                                            uint64_t* version) {
+  auto v = node->version;
+  if ((v & 1) != 0) {
+    ::mica::util::pause();
+    return false;
+  }
+  ::mica::util::memory_barrier();
+  *version = v;
+  return true;
+}
+
+template <class StaticConfig>
+bool OLCBTreeIndex<StaticConfig>::read_unlock(const Node* node,
+                                              uint64_t version) {
+  ::mica::util::memory_barrier();
+  return node->version == version;
+}
+
+template <class StaticConfig>
+bool OLCBTreeIndex<StaticConfig>::upgrade_lock(Node* node, uint64_t version) {
+  return __sync_bool_compare_and_swap(&node->version, version, version + 1);
+}
+
+template <class StaticConfig>
+void OLCBTreeIndex<StaticConfig>::write_unlock(Node* node) {
+  ::mica::util::memory_barrier();
+  node->version = node->version + 1;
+}
+
+template <class StaticConfig>
+int OLCBTreeIndex<StaticConfig>::lower_bound(const Node* node, int count,
+                                             uint64_t key) {
+  // count may be stale for an optimistic read, but stays within the node.
+  if (kUseSIMDSearch)
+    return BTreeSIMDSearch<uint64_t>::template count<false>(node->keys, count,
+                                                            key);
+  return static_cast<int>(std::lower_bound(node->keys, node->keys + count,
+                                           key) -
+                          node->keys);
+}
+
+template <class StaticConfig>
+int OLCBTreeIndex<StaticConfig>::child_pos(const InternalNode* node,
+                                           int count, uint64_t key) {
+  // The number of keys <= key.
+  if (kUseSIMDSearch)
+    return count - BTreeSIMDSearch<uint64_t>::template count<true>(
+                       node->keys, count, key);
+  return static_cast<int>(std::upper_bound(node->keys, node->keys + count,
+                                           key) -
+                          node->keys);
+}
+
+template <class StaticConfig>
+typename OLCBTreeIndex<StaticConfig>::Node* OLCBTreeIndex<StaticConfig>::split(
+    InternalNode* parent, Node* node) {
+  int count = node->count;
+  assert(count == kMaxCount);
+  int left_count = count / 2;
+
+  Node* right;
+  uint64_t split_key;
+  if (node->is_leaf) {
+    auto leaf = as_leaf(node);
+    auto new_leaf = make_node<LeafNode>();
+    auto right_count = count - left_count;
+    for (int i = 0; i < right_count; i++)
+      move_entry(new_leaf, i, leaf, left_count + i);
+    // The reads and removals of the leaf node cover the new leaf node too.
+    new_leaf->rts.init(leaf->rts.get());
+    new_leaf->remove_wts = leaf->remove_wts;
+    new_leaf->count = static_cast<uint16_t>(right_count);
+    split_key = new_leaf->keys[0];
+    right = new_leaf;
+  } else {
+    // The middle key moves up to the parent.
+    auto inode = as_internal(node);
+    auto new_inode = make_node<InternalNode>();
+    auto right_count = count - left_count - 1;
+    for (int i = 0; i < right_count; i++)
+      new_inode->keys[i] = inode->keys[left_count + 1 + i];
+    for (int i = 0; i <= right_count; i++)
+      new_inode->children[i] = inode->children[left_count + 1 + i];
+    new_inode->count = static_cast<uint16_t>(right_count);
+    split_key = inode->keys[left_count];
+    right = new_inode;
+  }
+  // Keep the new node held until the caller releases the others.
+  right->version = 1;
+  node->count = static_cast<uint16_t>(left_count);
+
+  if (parent == nullptr) {
+    auto new_root = make_node<InternalNode>();
+    new_root->keys[0] = split_key;
+    new_root->children[0] = node;
+    new_root->children[1] = right;
+    new_root->count = 1;
+    ::mica::util::memory_barrier();
+    root_ = new_root;
+  } else {
+    int parent_count = parent->count;
+    assert(parent_count < kMaxCount);
+    auto pos = child_pos(parent, parent_count, split_key);
+    for (int i = parent_count; i > pos; i--) {
+      parent->keys[i] = parent->keys[i - 1];
+      parent->children[i + 1] = parent->children[i];
+    }
+    parent->keys[pos] = split_key;
+    parent->children[pos + 1] = right;
+    parent->count = static_cast<uint16_t>(parent_count + 1);
+  }
+  return right;
+}
+
+template <class StaticConfig>
+void OLCBTreeIndex<StaticConfig>::move_entry(LeafNode* dst, int dst_pos,
+                                             const LeafNode* src,
+                                             int src_pos) {
+  dst->keys[dst_pos] = src->keys[src_pos];
+  dst->values[dst_pos] = src->values[src_pos];
+  dst->wts[dst_pos] = src->wts[src_pos];
+  dst->pending_ts[dst_pos] = src->pending_ts[src_pos];
+  dst->states[dst_pos] = src->states[src_pos];
+}
+
+template <class StaticConfig>
+void OLCBTreeIndex<StaticConfig>::remove_entry_at(LeafNode* leaf, int pos) {
+  // Leaf nodes are not merged even if they become empty.
+  int count = leaf->count;
+  for (int i = pos; i < count - 1; i++) move_entry(leaf, i, leaf, i + 1);
+  leaf->count = static_cast<uint16_t>(count - 1);
+}
+
+template <class StaticConfig>
+template <typename Func>
+bool OLCBTreeIndex<StaticConfig>::update_leaf(uint64_t key,
+                                              const Func& func) {
+  while (true) {
+    bool has_low, has_high;
+    uint64_t low, high;
+    uint64_t v;
+    auto leaf = find_leaf(key, &v, &has_low, &low, &has_high, &high);
+    // The leaf node still covers the key if it has not changed since we got
+    // its version from the parent.
+    if (!upgrade_lock(leaf, v)) continue;
+
+    bool ret = func(leaf, lower_bound(leaf, leaf->count, key));
+    write_unlock(leaf);
+    return ret;
+  }
+}
+
+template <class StaticConfig>
+typename OLCBTreeIndex<StaticConfig>::LeafNode*
+OLCBTreeIndex<StaticConfig>::find_leaf(uint64_t key, uint64_t* version,
+                                       bool* has_low, uint64_t* low,
+                                       bool* has_high, uint64_t* high) const {
+  while (true) {
+    Node* node = root_;
+    uint64_t v;
+    if (!read_lock(node, &v)) continue;
+    // The root may have been split before we got its version.
+    if (node != root_) continue;
+
+    *has_low = false;
+    *has_high = false;
+
+    bool restart = false;
+    while (!node->is_leaf) {
+      auto inode = as_internal(node);
+      int count = inode->count;
+      auto pos = child_pos(inode, count, key);
+      if (pos > 0) {
+        *has_low = true;
+        *low = inode->keys[pos - 1];
+      }
+      if (pos < count) {
+        *has_high = true;
+        *high = inode->keys[pos];
+      }
+      Node* child = inode->children[pos];
+      // The child pointer is only valid if the node has not changed.
+      if (!read_unlock(node, v)) {
+        restart = true;
+        break;
+      }
+
+      uint64_t child_v;
+      if (!read_lock(child, &child_v) || !read_unlock(node, v)) {
+        restart = true;
+        break;
+      }
+      node = child;
+      v = child_v;
+    }
+    if (restart) continue;
+
+    *version = v;
+    return as_leaf(node);
+  }
+}
+}
+}
+
+#endif
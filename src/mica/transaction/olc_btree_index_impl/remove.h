@@ -0,0 +1,33 @@
+#pragma once
+#ifndef MICA_TRANSACTION_OLC_BTREE_INDEX_IMPL_REMOVE_H_
+#define MICA_TRANSACTION_OLC_BTREE_INDEX_IMPL_REMOVE_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+uint64_t OLCBTreeIndex<StaticConfig>::remove(Transaction* tx, uint64_t key,
+                                             uint64_t value) {
+  Timing t(tx->context()->timing_stack(), &Stats::index_write);
+
+  auto& state = track_transaction(tx);
+
+  auto write = find_write(state, key);
+  if (write != nullptr) {
+    if (write->new_value != value) return 0;
+    write->new_value = kNullRowID;
+    return 1;
+  }
+
+  // The entry must exist at the timestamp of the transaction.
+  uint64_t found_value;
+  auto ret = read_entry(tx, key, false, &found_value);
+  if (ret != 1) return ret;
+  if (found_value != value) return 0;
+
+  state.writes.push_back(Write{key, value, kNullRowID});
+  return 1;
+}
+}
+}
+
+#endif
@@ -0,0 +1,136 @@
+#pragma once
+#ifndef MICA_TRANSACTION_OLC_BTREE_INDEX_IMPL_TRACKING_H_
+#define MICA_TRANSACTION_OLC_BTREE_INDEX_IMPL_TRACKING_H_
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+typename OLCBTreeIndex<StaticConfig>::ThreadState*
+OLCBTreeIndex<StaticConfig>::thread_state(Transaction* tx) {
+  if (!tx->has_external_index(this)) return nullptr;
+  return &thread_states_[tx->context()->thread_id()];
+}
+
+template <class StaticConfig>
+typename OLCBTreeIndex<StaticConfig>::ThreadState&
+OLCBTreeIndex<StaticConfig>::track_transaction(Transaction* tx) {
+  auto& state = thread_states_[tx->context()->thread_id()];
+  if (tx->has_external_index(this)) return state;
+
+  // An earlier transaction of the thread may have left its state, e.g., when
+  // commit() failed after the validation and the transaction was not aborted.
+  discard(state);
+  tx->add_external_index(typename Transaction::ExternalIndex{
+      this, &validate_tx, &commit_tx, &abort_tx});
+  return state;
+}
+
+template <class StaticConfig>
+typename OLCBTreeIndex<StaticConfig>::Write*
+OLCBTreeIndex<StaticConfig>::find_write(ThreadState& state, uint64_t key) {
+  for (auto& write : state.writes)
+    if (write.key == key) return &write;
+  return nullptr;
+}
+
+template <class StaticConfig>
+bool OLCBTreeIndex<StaticConfig>::install_write(const Timestamp& ts,
+                                                const Write& write) {
+  if (write.old_value == write.new_value) return true;
+
+  if (write.old_value == kNullRowID)
+    return insert_entry(write.key, write.new_value, ts, true);
+
+  return update_leaf(write.key, [&](LeafNode* leaf, int pos) {
+    // A reader with a later timestamp has relied on the entry.
+    if (leaf->rts.get() > ts) return false;
+    // The entry must be the one that this transaction has read.
+    if (pos >= leaf->count || leaf->keys[pos] != write.key ||
+        leaf->states[pos] != kCommitted ||
+        leaf->values[pos] != write.old_value || leaf->wts[pos] > ts)
+      return false;
+    leaf->pending_ts[pos] = ts;
+    leaf->states[pos] = kPendingRemove;
+    return true;
+  });
+}
+
+template <class StaticConfig>
+void OLCBTreeIndex<StaticConfig>::finish_write(const Timestamp& ts,
+                                               const Write& write,
+                                               bool committed) {
+  if (write.old_value == write.new_value) return;
+
+  update_leaf(write.key, [&](LeafNode* leaf, int pos) {
+    assert(pos < leaf->count && leaf->keys[pos] == write.key);
+    assert(leaf->states[pos] != kCommitted);
+
+    if (write.old_value == kNullRowID) {
+      if (committed)
+        leaf->states[pos] = kCommitted;
+      else
+        remove_entry_at(leaf, pos);
+      return true;
+    }
+
+    if (committed) {
+      if (write.new_value == kNullRowID)
+        remove_entry_at(leaf, pos);
+      else {
+        leaf->values[pos] = write.new_value;
+        leaf->wts[pos] = ts;
+        leaf->states[pos] = kCommitted;
+      }
+      // Readers earlier than the removal must abort instead of missing the
+      // old entry.
+      if (leaf->remove_wts < ts) leaf->remove_wts = ts;
+    } else
+      leaf->states[pos] = kCommitted;
+    return true;
+  });
+}
+
+template <class StaticConfig>
+void OLCBTreeIndex<StaticConfig>::discard(ThreadState& state) {
+  while (state.installed > 0) {
+    state.installed--;
+    finish_write(state.ts, state.writes[state.installed], false);
+  }
+  state.writes.clear();
+}
+
+template <class StaticConfig>
+bool OLCBTreeIndex<StaticConfig>::validate_tx(void* idx, Transaction* tx) {
+  auto index = static_cast<OLCBTreeIndex*>(idx);
+  auto& state = *index->thread_state(tx);
+
+  // abort() undoes the writes installed before a failure.
+  state.ts = tx->ts();
+  while (state.installed < state.writes.size()) {
+    if (!index->install_write(state.ts, state.writes[state.installed]))
+      return false;
+    state.installed++;
+  }
+  return true;
+}
+
+template <class StaticConfig>
+void OLCBTreeIndex<StaticConfig>::commit_tx(void* idx, Transaction* tx) {
+  auto index = static_cast<OLCBTreeIndex*>(idx);
+  auto& state = *index->thread_state(tx);
+
+  assert(state.installed == state.writes.size());
+  for (auto& write : state.writes) index->finish_write(state.ts, write, true);
+  state.installed = 0;
+  state.writes.clear();
+}
+
+template <class StaticConfig>
+void OLCBTreeIndex<StaticConfig>::abort_tx(void* idx, Transaction* tx) {
+  auto index = static_cast<OLCBTreeIndex*>(idx);
+  index->discard(*index->thread_state(tx));
+}
+}
+}
+
+#endif
@@ -3,6 +3,8 @@
 #define MICA_TRANSACTION_PAGE_POOL_H_
 
 #include <cstdio>
+#include <string>
+#include "mica/util/barrier.h"
 #include "mica/util/lcore.h"
 
 namespace mica {
@@ -22,6 +24,9 @@ class PagePool {
     lock_ = 0;
     total_count_ = page_count;
     free_count_ = page_count;
+    reattached_ = false;
+    detached_ = false;
+    saved_state_ = nullptr;
 
     pages_ =
         reinterpret_cast<char*>(alloc_->malloc_contiguous(size_, numa_id_));
@@ -40,13 +45,125 @@ class PagePool {
            numa_id_, static_cast<double>(size) / 1000000000.);
   }
 
-  ~PagePool() { alloc_->free_striped(pages_); }
+  // Uses a file named name on the allocator (HugeTLBFS_SHM) that outlives the
+  // process.  If the file holds a page pool detached by detach(), it is
+  // reattached at the same address so that pointers in the pages stay valid,
+  // and is_reattached() becomes true.  If there is no such file, the pages are
+  // initialized as usual.  An existing file that cannot be reattached (e.g.,
+  // after a crash) is left intact and the pool has no pages (is_valid() is
+  // false); remove the file with the allocator's remove_shared() to start
+  // over.  The first page keeps the pool header and is not allocated.  The
+  // pages are placed on the NUMA node of the constructing thread.
+  PagePool(Alloc* alloc, uint64_t size, uint8_t numa_id,
+           const std::string& name)
+      : alloc_(alloc), numa_id_(numa_id), name_(name) {
+    uint64_t page_count = (size + kPageSize - 1) / kPageSize;
+    size_ = page_count * kPageSize;
+
+    lock_ = 0;
+    total_count_ = page_count - 1;
+    reattached_ = false;
+    detached_ = false;
+    saved_state_ = nullptr;
+
+    next_ = nullptr;
+    free_count_ = 0;
+    pages_ = nullptr;
+
+    auto h = reinterpret_cast<SavedHeader*>(
+        alloc_->map_shared(name_, sizeof(SavedHeader), false));
+    if (h != nullptr) {
+      bool clean = h->magic == kSavedMagic && h->clean && h->size == size_;
+      auto base = h->base;
+      alloc_->unmap_shared(h, sizeof(SavedHeader));
+
+      if (clean)
+        pages_ = reinterpret_cast<char*>(
+            alloc_->map_shared(name_, size_, false, base));
+
+      if (pages_ == nullptr) {
+        // Creating the file again would destroy the data in it.
+        printf("failed to reattach PagePool %s (%s)\n", name_.c_str(),
+               clean ? "cannot map at the saved address"
+                     : "not a cleanly detached pool of this size");
+        return;
+      }
+
+      h = reinterpret_cast<SavedHeader*>(pages_);
+      next_ = h->next;
+      free_count_ = h->free_count;
+      saved_state_ = h->saved_state;
+      // A crash from now on must not reuse the saved state.
+      h->clean = 0;
+      reattached_ = true;
+
+      printf("reattached PagePool on numa node %" PRIu8 " with %.3lf GB\n",
+             numa_id_, static_cast<double>(size) / 1000000000.);
+      return;
+    }
+
+    pages_ = reinterpret_cast<char*>(alloc_->map_shared(name_, size_, true));
+    if (!pages_ || page_count < 2) {
+      printf("failed to initialize PagePool\n");
+      return;
+    }
+    for (uint64_t i = 1; i < page_count; i++)
+      *reinterpret_cast<char**>(pages_ + i * kPageSize) =
+          pages_ + (i + 1) * kPageSize;
+
+    *reinterpret_cast<char**>(pages_ + (page_count - 1) * kPageSize) = nullptr;
+    next_ = pages_ + kPageSize;
+    free_count_ = total_count_;
+
+    h = reinterpret_cast<SavedHeader*>(pages_);
+    h->magic = kSavedMagic;
+    h->base = pages_;
+    h->size = size_;
+    h->clean = 0;
+
+    printf("initialized PagePool on numa node %" PRIu8 " with %.3lf GB\n",
+           numa_id_, static_cast<double>(size) / 1000000000.);
+  }
+
+  ~PagePool() {
+    if (name_.empty())
+      alloc_->free_striped(pages_);
+    else if (pages_)
+      alloc_->unmap_shared(pages_, size_);
+  }
+
+  // Whether the pool has pages.
+  bool is_valid() const { return pages_ != nullptr; }
+  // Whether the pool is backed by a named file.
+  bool is_persistent() const { return !name_.empty(); }
+  bool is_reattached() const { return reattached_; }
+
+  // The pointer given to detach() when the pool was detached.
+  char* saved_state() const { return saved_state_; }
+
+  // Saves the free page list and saved_state in the header for a later
+  // reattachment.  Pages are neither allocated nor freed afterward so that
+  // destroying the users of the pool keeps the saved state.
+  void detach(char* saved_state) {
+    assert(!name_.empty());
+    while (__sync_lock_test_and_set(&lock_, 1) == 1) ::mica::util::pause();
+
+    auto h = reinterpret_cast<SavedHeader*>(pages_);
+    h->next = next_;
+    h->free_count = free_count_;
+    h->saved_state = saved_state;
+    ::mica::util::memory_barrier();
+    h->clean = 1;
+    detached_ = true;
+
+    __sync_lock_release(&lock_);
+  }
 
   char* allocate() {
     while (__sync_lock_test_and_set(&lock_, 1) == 1) ::mica::util::pause();
 
-    auto p = next_;
-    if (next_) {
+    auto p = detached_ ? nullptr : next_;
+    if (p) {
       next_ = *reinterpret_cast<char**>(next_);
       free_count_--;
     }
@@ -59,9 +176,11 @@ class PagePool {
   void free(char* p) {
     while (__sync_lock_test_and_set(&lock_, 1) == 1) ::mica::util::pause();
 
-    *reinterpret_cast<char**>(p) = next_;
-    next_ = p;
-    free_count_++;
+    if (!detached_) {
+      *reinterpret_cast<char**>(p) = next_;
+      next_ = p;
+      free_count_++;
+    }
 
     __sync_lock_release(&lock_);
   }
@@ -83,9 +202,26 @@ class PagePool {
   }
 
  private:
+  static constexpr uint64_t kSavedMagic = 0x4c4f4f5045474150ULL;  // "PAGEPOOL"
+
+  struct SavedHeader {
+    uint64_t magic;
+    char* base;
+    uint64_t size;
+    volatile uint64_t clean;
+    char* next;
+    uint64_t free_count;
+    char* saved_state;
+  };
+
   Alloc* alloc_;
   uint64_t size_;
   uint8_t numa_id_;
+  std::string name_;
+
+  bool reattached_;
+  bool detached_;
+  char* saved_state_;
 
   uint64_t total_count_;
   char* pages_;
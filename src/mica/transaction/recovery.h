@@ -0,0 +1,91 @@
+#pragma once
+#ifndef MICA_TRANSACTION_RECOVERY_H_
+#define MICA_TRANSACTION_RECOVERY_H_
+
+#include <string>
+#include <vector>
+#include "mica/common.h"
+#include "mica/transaction/db.h"
+#include "mica/transaction/logging.h"
+
+namespace mica {
+namespace transaction {
+// Rebuilds a database from the log files written by ParallelLogger.
+//
+// Log files are read in parallel and their records are partitioned by
+// (table, row ID) across the recovery threads.  Each thread then installs the
+// latest version of each row in its partition directly into the table without
+// going through transactions.  Delta records are applied on top of the latest
+// full record of the row.  Index tables are logged like any other table,
+// so indexes are restored together with the tables they index.  Index state
+// outside tables is rebuilt at the end (see DB::rebuild_volatile_indexes()).
+//
+// Before replay, all tables (including those created for indexes) must have
+// been created in the same order as in the logged run, and no index may have
+// been initialized with init().  No thread may be active during replay.
+template <class StaticConfig>
+class Recovery {
+ public:
+  typedef typename StaticConfig::Timestamp Timestamp;
+
+  // recovery_impl.h
+  Recovery(DB<StaticConfig>* db);
+
+  // Replays the log files using num_threads threads (with contexts 0 to
+  // num_threads - 1).  If max_ts is given, transactions later than it are
+  // ignored; this is useful to restore a consistent state using the last known
+  // DB::durable_ts().  If min_ts is given, transactions earlier than it are
+  // ignored; this skips the log entries that are covered by a checkpoint whose
+  // files are also given in paths (see Checkpointer).  An incomplete
+  // transaction at the end of a log file is ignored.
+  bool replay(const std::vector<std::string>& paths, uint16_t num_threads,
+              const Timestamp* max_ts = nullptr,
+              const Timestamp* min_ts = nullptr);
+
+  uint64_t tx_count() const { return tx_count_; }
+  uint64_t record_count() const { return record_count_; }
+  // The timestamp of the latest replayed transaction.
+  const Timestamp& last_ts() const { return last_ts_; }
+
+ private:
+  struct Entry {
+    Timestamp ts;
+    const LogRecordHeader* rec;
+  };
+
+  struct ReaderState {
+    std::vector<std::vector<char>> bufs;
+    std::vector<std::vector<Entry>> parts;
+    std::vector<uint64_t> row_id_end;
+    uint64_t tx_count;
+    uint64_t record_count;
+    bool has_last_ts;
+    Timestamp last_ts;
+    bool failed;
+  };
+
+  void read_logs(uint16_t thread_id, uint16_t num_threads,
+                 const std::vector<std::string>& paths, const Timestamp* max_ts,
+                 const Timestamp* min_ts, ReaderState& rs);
+  bool install(uint16_t thread_id, uint16_t num_threads,
+               const std::vector<ReaderState>& readers);
+  void collect_free_rows(uint16_t thread_id, uint16_t num_threads);
+
+  static uint16_t partition(uint16_t table_id, uint64_t row_id,
+                            uint16_t num_threads) {
+    uint64_t h = (row_id ^ (uint64_t(table_id) << 48)) * 0x9ddfea08eb382d69ULL;
+    return static_cast<uint16_t>((h >> 32) % num_threads);
+  }
+
+  DB<StaticConfig>* db_;
+
+  uint64_t tx_count_;
+  uint64_t record_count_;
+  Timestamp last_ts_;
+};
+}
+}
+
+#include "recovery_impl.h"
+
+#endif
@@ -0,0 +1,338 @@
+#pragma once
+#ifndef MICA_TRANSACTION_RECOVERY_IMPL_H_
+#define MICA_TRANSACTION_RECOVERY_IMPL_H_
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <thread>
+#include "mica/util/lcore.h"
+#include "mica/util/memcpy.h"
+#include "mica/util/roundup.h"
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+Recovery<StaticConfig>::Recovery(DB<StaticConfig>* db)
+    : db_(db), tx_count_(0), record_count_(0) {}
+
+template <class StaticConfig>
+bool Recovery<StaticConfig>::replay(const std::vector<std::string>& paths,
+                                    uint16_t num_threads,
+                                    const Timestamp* max_ts,
+                                    const Timestamp* min_ts) {
+  assert(num_threads > 0 && num_threads <= db_->thread_count());
+  assert(db_->active_thread_count() == 0);
+
+  for (uint16_t table_id = 0; table_id < db_->table_count(); table_id++) {
+    if (db_->get_table_by_id(table_id)->row_count() != 0) {
+      printf("table %" PRIu16 " is not empty\n", table_id);
+      return false;
+    }
+  }
+
+  // Read and partition log records.
+  std::vector<ReaderState> readers(num_threads);
+  {
+    std::vector<std::thread> threads;
+    for (uint16_t thread_id = 0; thread_id < num_threads; thread_id++) {
+      threads.emplace_back([&, thread_id] {
+        ::mica::util::lcore.pin_thread(thread_id);
+        read_logs(thread_id, num_threads, paths, max_ts, min_ts,
+                  readers[thread_id]);
+      });
+    }
+    while (threads.size() > 0) {
+      threads.back().join();
+      threads.pop_back();
+    }
+  }
+
+  tx_count_ = 0;
+  record_count_ = 0;
+  bool has_last_ts = false;
+  std::vector<uint64_t> row_id_end(db_->table_count(), 0);
+  for (auto& rs : readers) {
+    if (rs.failed) return false;
+    tx_count_ += rs.tx_count;
+    record_count_ += rs.record_count;
+    if (rs.has_last_ts && (!has_last_ts || last_ts_ < rs.last_ts)) {
+      last_ts_ = rs.last_ts;
+      has_last_ts = true;
+    }
+    for (uint16_t table_id = 0; table_id < db_->table_count(); table_id++)
+      if (row_id_end[table_id] < rs.row_id_end[table_id])
+        row_id_end[table_id] = rs.row_id_end[table_id];
+  }
+  if (!has_last_ts) last_ts_ = db_->min_wts();
+
+  // Allocate row pages that will be filled by the installation.  The row IDs
+  // are reclaimed later by collect_free_rows() if unused.
+  {
+    auto ctx = db_->context(0);
+    std::vector<uint64_t> row_ids;
+    for (uint16_t table_id = 0; table_id < db_->table_count(); table_id++) {
+      auto tbl = db_->get_table_by_id(table_id);
+      while (tbl->row_count() < row_id_end[table_id]) {
+        if (!tbl->allocate_rows(ctx, row_ids)) return false;
+        row_ids.clear();
+      }
+    }
+  }
+
+  // Install the latest version of each row.
+  std::vector<char> installed(num_threads);
+  {
+    std::vector<std::thread> threads;
+    for (uint16_t thread_id = 0; thread_id < num_threads; thread_id++) {
+      threads.emplace_back([&, thread_id] {
+        ::mica::util::lcore.pin_thread(thread_id);
+        installed[thread_id] = install(thread_id, num_threads, readers);
+      });
+    }
+    while (threads.size() > 0) {
+      threads.back().join();
+      threads.pop_back();
+    }
+  }
+  for (auto ok : installed)
+    if (!ok) return false;
+
+  // Release the log data.
+  readers.clear();
+
+  {
+    std::vector<std::thread> threads;
+    for (uint16_t thread_id = 0; thread_id < num_threads; thread_id++) {
+      threads.emplace_back([&, thread_id] {
+        ::mica::util::lcore.pin_thread(thread_id);
+        collect_free_rows(thread_id, num_threads);
+      });
+    }
+    while (threads.size() > 0) {
+      threads.back().join();
+      threads.pop_back();
+    }
+  }
+
+  db_->advance_clock(last_ts_);
+  db_->rebuild_volatile_indexes();
+
+  if (StaticConfig::kVerbose)
+    printf("recovered %" PRIu64 " transactions (%" PRIu64 " records)\n",
+           tx_count_, record_count_);
+  return true;
+}
+
+template <class StaticConfig>
+void Recovery<StaticConfig>::read_logs(uint16_t thread_id,
+                                       uint16_t num_threads,
+                                       const std::vector<std::string>& paths,
+                                       const Timestamp* max_ts,
+                                       const Timestamp* min_ts,
+                                       ReaderState& rs) {
+  auto table_count = db_->table_count();
+
+  rs.parts.resize(num_threads);
+  rs.row_id_end.resize(table_count, 0);
+  rs.tx_count = 0;
+  rs.record_count = 0;
+  rs.has_last_ts = false;
+  rs.failed = false;
+
+  for (size_t i = thread_id; i < paths.size(); i += num_threads) {
+    int fd = ::open(paths[i].c_str(), O_RDONLY);
+    if (fd == -1) {
+      printf("failed to open log file %s\n", paths[i].c_str());
+      rs.failed = true;
+      return;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      printf("failed to stat log file %s\n", paths[i].c_str());
+      ::close(fd);
+      rs.failed = true;
+      return;
+    }
+
+    rs.bufs.emplace_back(static_cast<size_t>(st.st_size));
+    auto& buf = rs.bufs.back();
+
+    uint64_t len = 0;
+    while (len < buf.size()) {
+      auto ret = ::read(fd, buf.data() + len, buf.size() - len);
+      if (ret <= 0) break;
+      len += static_cast<uint64_t>(ret);
+    }
+    ::close(fd);
+
+    uint64_t off = 0;
+    while (off + sizeof(LogTxHeader<StaticConfig>) <= len) {
+      auto tx_h = reinterpret_cast<const LogTxHeader<StaticConfig>*>(
+          buf.data() + off);
+      // Ignore an incomplete transaction at the end.
+      if (tx_h->size < sizeof(LogTxHeader<StaticConfig>) ||
+          off + tx_h->size > len)
+        break;
+
+      if ((max_ts != nullptr && *max_ts < tx_h->ts) ||
+          (min_ts != nullptr && tx_h->ts < *min_ts)) {
+        off += tx_h->size;
+        continue;
+      }
+
+      auto p = buf.data() + off + sizeof(LogTxHeader<StaticConfig>);
+      for (uint32_t j = 0; j < tx_h->record_count; j++) {
+        auto rec_h = reinterpret_cast<const LogRecordHeader*>(p);
+        if (rec_h->table_id >= table_count ||
+            rec_h->cf_id >=
+                db_->get_table_by_id(rec_h->table_id)->cf_count()) {
+          printf("invalid log record in %s\n", paths[i].c_str());
+          rs.failed = true;
+          return;
+        }
+
+        rs.parts[partition(rec_h->table_id, rec_h->row_id, num_threads)]
+            .push_back(Entry{tx_h->ts, rec_h});
+
+        if (rs.row_id_end[rec_h->table_id] <= rec_h->row_id)
+          rs.row_id_end[rec_h->table_id] = rec_h->row_id + 1;
+
+        p += sizeof(LogRecordHeader) +
+             ::mica::util::roundup<8>(uint64_t(rec_h->data_size));
+      }
+
+      rs.tx_count++;
+      rs.record_count += tx_h->record_count;
+      if (!rs.has_last_ts || rs.last_ts < tx_h->ts) {
+        rs.last_ts = tx_h->ts;
+        rs.has_last_ts = true;
+      }
+
+      off += tx_h->size;
+    }
+  }
+}
+
+template <class StaticConfig>
+bool Recovery<StaticConfig>::install(uint16_t thread_id, uint16_t num_threads,
+                                     const std::vector<ReaderState>& readers) {
+  auto ctx = db_->context(thread_id);
+  bool failed = false;
+
+  std::vector<Entry> entries;
+  for (uint16_t i = 0; i < num_threads; i++)
+    entries.insert(entries.end(), readers[i].parts[thread_id].begin(),
+                   readers[i].parts[thread_id].end());
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) {
+              if (a.rec->table_id != b.rec->table_id)
+                return a.rec->table_id < b.rec->table_id;
+              if (a.rec->row_id != b.rec->row_id)
+                return a.rec->row_id < b.rec->row_id;
+              if (a.rec->cf_id != b.rec->cf_id)
+                return a.rec->cf_id < b.rec->cf_id;
+              return a.ts < b.ts;
+            });
+
+  size_t next_i;
+  for (size_t i = 0; i < entries.size(); i = next_i) {
+    // Find the records of the same column family of the row.
+    next_i = i + 1;
+    while (next_i < entries.size() &&
+           entries[next_i].rec->table_id == entries[i].rec->table_id &&
+           entries[next_i].rec->row_id == entries[i].rec->row_id &&
+           entries[next_i].rec->cf_id == entries[i].rec->cf_id)
+      next_i++;
+
+    // Only the latest full record and the delta records after it are used.
+    size_t base_i = next_i - 1;
+    while (base_i > i && entries[base_i].rec->is_delta) base_i--;
+
+    auto rec_h = entries[base_i].rec;
+    if (rec_h->is_delta) {
+      printf("no full record for delta record of row %" PRIu64
+             " in table %" PRIu16 "\n",
+             rec_h->row_id, rec_h->table_id);
+      failed = true;
+      continue;
+    }
+    if (rec_h->status != RowVersionStatus::kCommitted) continue;
+
+    auto tbl = db_->get_table_by_id(rec_h->table_id);
+    auto cf_id = rec_h->cf_id;
+    auto row_id = rec_h->row_id;
+    auto& ts = entries[next_i - 1].ts;
+
+    if (cf_id == 0) {
+      // Initialize GC information as Context::allocate_row() does.
+      for (uint16_t cf_id2 = 0; cf_id2 < tbl->cf_count(); cf_id2++) {
+        auto g = tbl->gc_info(cf_id2, row_id);
+        g->gc_lock = 0;
+        g->gc_ts.init(last_ts_);
+      }
+    }
+
+    auto head = tbl->head(cf_id, row_id);
+    auto rv = ctx->allocate_version_for_new_row(tbl, cf_id, row_id, head,
+                                                rec_h->data_size);
+    ::mica::util::memcpy(rv->data, reinterpret_cast<const char*>(rec_h + 1),
+                         rec_h->data_size);
+    for (size_t j = base_i + 1; j < next_i; j++) {
+      auto delta_h = entries[j].rec;
+      if (uint64_t(delta_h->data_off) + delta_h->data_size > rv->data_size) {
+        printf("invalid delta record of row %" PRIu64 " in table %" PRIu16
+               "\n",
+               row_id, rec_h->table_id);
+        failed = true;
+        break;
+      }
+      ::mica::util::memcpy(rv->data + delta_h->data_off,
+                           reinterpret_cast<const char*>(delta_h + 1),
+                           delta_h->data_size);
+    }
+    rv->older_rv = nullptr;
+    rv->wts = ts;
+    rv->rts.init(ts);
+    rv->status = RowVersionStatus::kCommitted;
+
+    head->older_rv = rv;
+  }
+  return !failed;
+}
+
+template <class StaticConfig>
+void Recovery<StaticConfig>::collect_free_rows(uint16_t thread_id,
+                                               uint16_t num_threads) {
+  auto ctx = db_->context(thread_id);
+
+  // Each thread takes every num_threads-th chunk of rows and keeps the unused
+  // ones in its own free row list.
+  const uint64_t kChunkSize = 4096;
+
+  for (uint16_t table_id = 0; table_id < db_->table_count(); table_id++) {
+    auto tbl = db_->get_table_by_id(table_id);
+    auto row_count = tbl->row_count();
+    uint64_t chunk_count = (row_count + kChunkSize - 1) / kChunkSize;
+
+    // Visit rows backwards so that lower row IDs are reused first.
+    for (uint64_t chunk = chunk_count; chunk > 0; chunk--) {
+      if ((chunk - 1) % num_threads != thread_id) continue;
+
+      uint64_t row_id_begin = (chunk - 1) * kChunkSize;
+      uint64_t row_id = std::min(row_id_begin + kChunkSize, row_count);
+      while (row_id > row_id_begin) {
+        row_id--;
+        if (tbl->head(0, row_id)->older_rv == nullptr)
+          ctx->deallocate_row(tbl, row_id);
+      }
+    }
+  }
+}
+}
+}
+
+#endif
@@ -123,7 +123,32 @@ class RowAccessHandle {
       return nullptr;
   }
 
-  uint64_t size() const { return access_item_->tbl->data_size(); }
+  // Marks data()[off, off + len) as modified so that the logger can write
+  // only the modified bytes of a row that has been read and written.  If
+  // never called, the whole row is considered modified.
+  void mark_dirty(uint64_t off, uint64_t len) {
+    assert(access_item_->write_rv != nullptr);
+    assert(off + len <= access_item_->write_rv->data_size);
+    if (len == 0) return;
+    auto end = static_cast<uint32_t>(off + len);
+    if (access_item_->dirty_end == 0) {
+      access_item_->dirty_begin = static_cast<uint32_t>(off);
+      access_item_->dirty_end = end;
+    } else {
+      if (off < access_item_->dirty_begin)
+        access_item_->dirty_begin = static_cast<uint32_t>(off);
+      if (access_item_->dirty_end < end) access_item_->dirty_end = end;
+    }
+  }
+
+  uint64_t size() const {
+    if (access_item_->write_rv != nullptr)
+      return access_item_->write_rv->data_size;
+    else if (access_item_->read_rv != nullptr)
+      return access_item_->read_rv->data_size;
+    else
+      return 0;
+  }
 
   uint64_t rv_size() const {
     if (access_item_->write_rv != nullptr)
@@ -235,7 +260,12 @@ class RowAccessHandlePeekOnly {
 
   char* data() { return nullptr; }
 
-  size_t size() const { return tbl_->data_size(); }
+  uint64_t size() const {
+    if (read_rv_ != nullptr)
+      return read_rv_->data_size;
+    else
+      return 0;
+  }
 
   void reset() { read_rv_ = nullptr; }
 
@@ -278,9 +308,12 @@ struct RowAccessItem {
   uint16_t i;
   uint8_t inserted;
   RowAccessState state;
+  // The modified range of write_rv->data for delta logging (none if 0).
+  uint32_t dirty_end;
 
   Table<StaticConfig>* tbl;
   uint16_t cf_id;
+  uint32_t dirty_begin;
   uint64_t row_id;
 
   RowHead<StaticConfig>* head;
@@ -6,6 +6,7 @@
 #include <vector>
 #include "mica/transaction/page_pool.h"
 #include "mica/transaction/row.h"
+#include "mica/transaction/saved_state.h"
 #include "mica/transaction/stats.h"
 #include "mica/util/lcore.h"
 #include "mica/util/tsc.h"
@@ -119,6 +120,28 @@ class SharedRowVersionPool {
   uint64_t total_count(uint16_t cls) const { return classes_[cls].total_count; }
   uint64_t free_count(uint16_t cls) const { return classes_[cls].free_count; }
 
+  // Warm restart.  Free row versions must have been returned by all
+  // RowVersionPools before save_state().
+  void save_state(SavedStateWriter& w) const {
+    for (uint16_t cls = 0; cls < kClassCount; cls++) {
+      auto& cls_info = classes_[cls];
+      w.write(cls_info.total_count);
+      w.write(cls_info.free_count);
+      w.write_vector(cls_info.groups);
+    }
+    w.write_vector(pages_);
+  }
+
+  bool restore_state(SavedStateReader& r) {
+    for (uint16_t cls = 0; cls < kClassCount; cls++) {
+      auto& cls_info = classes_[cls];
+      if (!r.read(&cls_info.total_count) || !r.read(&cls_info.free_count) ||
+          !r.read_vector(&cls_info.groups))
+        return false;
+    }
+    return r.read_vector(&pages_);
+  }
+
  private:
   void allocate(uint16_t cls) {
     assert(lock_ == 1);
@@ -216,7 +239,10 @@ class RowVersionPool {
     }
   }
 
-  ~RowVersionPool() {
+  ~RowVersionPool() { return_all(); }
+
+  // Returns all cached row versions to the shared pools.
+  void return_all() {
     for (uint8_t numa_id = 0; numa_id < ctx_->db()->numa_count(); numa_id++) {
       for (uint16_t cls = 0; cls < kClassCount; cls++) {
         auto state = &states_[numa_id * kClassCount + cls];
@@ -227,6 +253,8 @@ class RowVersionPool {
           state->groups[state->group_count].rv = state->rv;
           state->groups[state->group_count].count = state->current_free_count;
           state->group_count++;
+          state->rv = nullptr;
+          state->current_free_count = 0;
         }
 
         return_rows(numa_id, cls, true);
@@ -0,0 +1,72 @@
+#pragma once
+#ifndef MICA_TRANSACTION_SAVED_STATE_H_
+#define MICA_TRANSACTION_SAVED_STATE_H_
+
+#include <vector>
+#include "mica/common.h"
+#include "mica/util/memcpy.h"
+
+namespace mica {
+namespace transaction {
+// Serializes the process-local state of the DB for a warm restart.  Pointers
+// are written as they are because page pools are reattached at the same
+// addresses.
+class SavedStateWriter {
+ public:
+  template <typename T>
+  void write(const T& v) {
+    write_bytes(&v, sizeof(T));
+  }
+
+  template <typename T>
+  void write_vector(const std::vector<T>& v) {
+    write(uint64_t(v.size()));
+    if (!v.empty()) write_bytes(v.data(), sizeof(T) * v.size());
+  }
+
+  void write_bytes(const void* p, uint64_t len) {
+    auto off = buf_.size();
+    buf_.resize(off + len);
+    ::mica::util::memcpy(buf_.data() + off, p, len);
+  }
+
+  const std::vector<char>& buf() const { return buf_; }
+
+ private:
+  std::vector<char> buf_;
+};
+
+class SavedStateReader {
+ public:
+  SavedStateReader(const char* p, uint64_t len) : p_(p), end_(p + len) {}
+
+  template <typename T>
+  bool read(T* v) {
+    return read_bytes(v, sizeof(T));
+  }
+
+  template <typename T>
+  bool read_vector(std::vector<T>* v) {
+    uint64_t count;
+    if (!read(&count) || count > uint64_t(end_ - p_) / sizeof(T)) return false;
+    v->resize(count);
+    return count == 0 || read_bytes(v->data(), sizeof(T) * count);
+  }
+
+  bool read_bytes(void* p, uint64_t len) {
+    if (len > uint64_t(end_ - p_)) return false;
+    ::mica::util::memcpy(p, p_, len);
+    p_ += len;
+    return true;
+  }
+
+  bool at_end() const { return p_ == end_; }
+
+ private:
+  const char* p_;
+  const char* end_;
+};
+}
+}
+
+#endif
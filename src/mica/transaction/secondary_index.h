@@ -0,0 +1,152 @@
+#pragma once
+#ifndef MICA_TRANSACTION_SECONDARY_INDEX_H_
+#define MICA_TRANSACTION_SECONDARY_INDEX_H_
+
+#include <cstring>
+#include <utility>
+#include "mica/common.h"
+
+namespace mica {
+namespace transaction {
+template <class StaticConfig>
+class Transaction;
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+class HashIndex;
+
+template <class StaticConfig, bool HasValue, class Key, class Compare>
+class BTreeIndex;
+
+template <class StaticConfig>
+class ARTIndex;
+
+template <class StaticConfig>
+class OLCBTreeIndex;
+
+// Maps the key stored in a row (RowKey) to the key and value of an index
+// entry for the row.  kExternal is true if the index keeps its entries outside
+// tables, which are then not logged.
+template <class Index>
+struct SecondaryIndexTraits;
+
+template <class StaticConfig, bool UniqueKey, class Key, class Hash,
+          class KeyEqual>
+struct SecondaryIndexTraits<
+    HashIndex<StaticConfig, UniqueKey, Key, Hash, KeyEqual>> {
+  typedef Key RowKey;
+  static const Key& key(const RowKey& row_key, uint64_t row_id) {
+    (void)row_id;
+    return row_key;
+  }
+  static uint64_t value(uint64_t row_id) { return row_id; }
+  static constexpr bool kExternal = false;
+};
+
+template <class StaticConfig, class Key, class Compare>
+struct SecondaryIndexTraits<BTreeIndex<StaticConfig, true, Key, Compare>> {
+  typedef Key RowKey;
+  static const Key& key(const RowKey& row_key, uint64_t row_id) {
+    (void)row_id;
+    return row_key;
+  }
+  static uint64_t value(uint64_t row_id) { return row_id; }
+  static constexpr bool kExternal = false;
+};
+
+// A non-unique BTree index keeps the row ID in the key.
+template <class StaticConfig, class Key, class Compare>
+struct SecondaryIndexTraits<
+    BTreeIndex<StaticConfig, false, std::pair<Key, uint64_t>, Compare>> {
+  typedef Key RowKey;
+  static std::pair<Key, uint64_t> key(const RowKey& row_key,
+                                      uint64_t row_id) {
+    return std::make_pair(row_key, row_id);
+  }
+  static uint64_t value(uint64_t row_id) {
+    (void)row_id;
+    return 0;
+  }
+  static constexpr bool kExternal = false;
+};
+
+template <class StaticConfig>
+struct SecondaryIndexTraits<ARTIndex<StaticConfig>> {
+  typedef uint64_t RowKey;
+  static uint64_t key(const RowKey& row_key, uint64_t row_id) {
+    (void)row_id;
+    return row_key;
+  }
+  static uint64_t value(uint64_t row_id) { return row_id; }
+  static constexpr bool kExternal = false;
+};
+
+// The entries are not in an index table (see OLCBTreeIndex).
+template <class StaticConfig>
+struct SecondaryIndexTraits<OLCBTreeIndex<StaticConfig>> {
+  typedef uint64_t RowKey;
+  static uint64_t key(const RowKey& row_key, uint64_t row_id) {
+    (void)row_id;
+    return row_key;
+  }
+  static uint64_t value(uint64_t row_id) { return row_id; }
+  static constexpr bool kExternal = true;
+};
+
+// A secondary index declared on a column family of a table with
+// Table::add_secondary_index().  The key of a row is the RowKey stored at
+// key_offset of the row's data, and the value is the row ID.
+template <class StaticConfig>
+struct SecondaryIndex {
+  typedef ::mica::transaction::Transaction<StaticConfig> Transaction;
+
+  void* idx;
+  uint16_t cf_id;
+  uint64_t key_offset;
+  uint64_t key_size;
+  bool external;
+
+  // Moves the entry of a row from old_key to new_key, either of which can be
+  // nullptr for a new or deleted row.  Returns false if the transaction must
+  // abort, which includes a missing old entry and a duplicate new key in a
+  // unique index.
+  bool (*update)(void* idx, Transaction* tx, uint64_t row_id,
+                 const char* old_key, const char* new_key);
+
+  template <class Index>
+  static SecondaryIndex make(uint16_t cf_id, uint64_t key_offset,
+                             Index* idx) {
+    return SecondaryIndex{
+        idx, cf_id, key_offset,
+        sizeof(typename SecondaryIndexTraits<Index>::RowKey),
+        SecondaryIndexTraits<Index>::kExternal, &update_index<Index>};
+  }
+
+ private:
+  template <class Index>
+  static bool update_index(void* idx, Transaction* tx, uint64_t row_id,
+                           const char* old_key, const char* new_key) {
+    typedef SecondaryIndexTraits<Index> Traits;
+    auto index = static_cast<Index*>(idx);
+
+    // Row data is not necessarily aligned for the key type.
+    typename Traits::RowKey row_key;
+    if (old_key != nullptr) {
+      ::memcpy(&row_key, old_key, sizeof(row_key));
+      if (index->remove(tx, Traits::key(row_key, row_id),
+                        Traits::value(row_id)) != 1)
+        return false;
+    }
+    if (new_key != nullptr) {
+      ::memcpy(&row_key, new_key, sizeof(row_key));
+      if (index->insert(tx, Traits::key(row_key, row_id),
+                        Traits::value(row_id)) != 1)
+        return false;
+    }
+    return true;
+  }
+};
+}
+}
+
+#endif
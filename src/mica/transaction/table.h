@@ -8,6 +8,8 @@
 #include "mica/transaction/row.h"
 #include "mica/transaction/context.h"
 #include "mica/transaction/transaction.h"
+#include "mica/transaction/saved_state.h"
+#include "mica/transaction/secondary_index.h"
 #include "mica/util/memcpy.h"
 
 namespace mica {
@@ -27,6 +29,11 @@ class Table {
   DB<StaticConfig>* db() { return db_; }
   const DB<StaticConfig>* db() const { return db_; }
 
+  // The table ID is assigned in the table creation order.  It is stable across
+  // restarts as long as tables (including those for indexes) are created in
+  // the same order.
+  uint16_t id() const { return id_; }
+
   uint16_t cf_count() const { return cf_count_; }
 
   uint64_t data_size_hint(uint16_t cf_id) const {
@@ -35,6 +42,10 @@ class Table {
 
   uint64_t row_count() const { return row_count_; }
 
+  // The number of rows in each page.  Row IDs in [k * page_row_count(), (k + 1)
+  // * page_row_count()) share the same page.
+  uint64_t page_row_count() const { return second_level_width_; }
+
   uint8_t inlining(uint16_t cf_id) const { return cf_[cf_id].inlining; }
 
   uint16_t inlined_rv_size_cls(uint16_t cf_id) const {
@@ -61,14 +72,54 @@ class Table {
                   uint64_t& row_id_begin, uint64_t row_id_end,
                   bool expiring_only);
 
+  // Dirty page tracking for incremental checkpoints.  A page is marked with
+  // the current dirty epoch when any of its rows is written.
+  void mark_dirty(uint64_t row_id) {
+    auto page = row_id >> row_id_shift_;
+    auto epoch = dirty_epoch_;
+    // Avoid writing to a shared cache line if already marked.
+    if (page_dirty_epochs_[page] != epoch) page_dirty_epochs_[page] = epoch;
+  }
+  uint32_t dirty_epoch() const { return dirty_epoch_; }
+  uint32_t advance_dirty_epoch() { return ++dirty_epoch_; }
+  bool is_page_dirty(uint64_t page, uint32_t since_epoch) const {
+    return static_cast<int32_t>(page_dirty_epochs_[page] - since_epoch) >= 0;
+  }
+
+  // Secondary indexes that Transaction::commit() keeps up to date for the
+  // rows of the table written by the transaction (see secondary_index.h).
+  // Index entries are added, removed, or moved only for the rows whose key
+  // changes, and the transaction sees the changes in the index only after it
+  // commits.  Indexes must be added before any transaction writes to the
+  // table and must not be changed by applications.
+  template <class Index>
+  void add_secondary_index(uint16_t cf_id, uint64_t key_offset, Index* idx) {
+    assert(cf_id < cf_count_);
+    secondary_indexes_.push_back(
+        SecondaryIndex<StaticConfig>::make(cf_id, key_offset, idx));
+  }
+  const std::vector<SecondaryIndex<StaticConfig>>& secondary_indexes() const {
+    return secondary_indexes_;
+  }
+
+  // Warm restart.  restore_state() replaces the pages of a newly created table
+  // with those of the table saved by save_state() in an earlier process.
+  void save_state(SavedStateWriter& w) const;
+  bool restore_state(SavedStateReader& r);
+
   template <typename Func>
   bool scan(Transaction<StaticConfig>* tx, uint16_t cf_id, uint64_t off,
             uint64_t len, const Func& f);
+  template <typename Func>
+  bool scan(Transaction<StaticConfig>* tx, uint16_t cf_id, uint64_t off,
+            uint64_t len, uint64_t row_id_begin, uint64_t row_id_end,
+            const Func& f);
 
   void print_table_status() const;
 
  private:
   DB<StaticConfig>* db_;
+  uint16_t id_;
   uint16_t cf_count_;
 
   struct ColumnFamilyInfo {
@@ -95,6 +146,10 @@ class Table {
   char* base_root_;
   char** root_;
   uint8_t* page_numa_ids_;
+  volatile uint32_t* page_dirty_epochs_;
+  volatile uint32_t dirty_epoch_;
+
+  std::vector<SecondaryIndex<StaticConfig>> secondary_indexes_;
 
   volatile uint32_t lock_ __attribute__((aligned(64)));
   uint64_t row_count_;
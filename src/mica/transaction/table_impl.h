@@ -10,6 +10,9 @@ Table<StaticConfig>::Table(DB<StaticConfig>* db, uint16_t cf_count,
     : db_(db), cf_count_(cf_count) {
   assert(cf_count <= StaticConfig::kMaxColumnFamilyCount);
 
+  id_ = static_cast<uint16_t>(db_->tables_by_id_.size());
+  db_->tables_by_id_.push_back(this);
+
   constexpr size_t kAlignment = 64;
   // constexpr size_t kAlignment = 32;
   // constexpr size_t kAlignment = 8;
@@ -98,6 +101,15 @@ Table<StaticConfig>::Table(DB<StaticConfig>* db, uint16_t cf_count,
 
   page_numa_ids_ = reinterpret_cast<uint8_t*>(db_->page_pool(0)->allocate());
 
+  static_assert(kFirstLevelWidth * sizeof(uint32_t) <=
+                    PagePool<StaticConfig>::kPageSize,
+                "too many pages to track dirty pages");
+  page_dirty_epochs_ =
+      reinterpret_cast<uint32_t*>(db_->page_pool(0)->allocate());
+  ::mica::util::memset(const_cast<uint32_t*>(page_dirty_epochs_), 0,
+                       PagePool<StaticConfig>::kPageSize);
+  dirty_epoch_ = 1;
+
   lock_ = 0;
   row_count_ = 0;
 }
@@ -110,6 +122,60 @@ Table<StaticConfig>::~Table() {
   db_->page_pool(0)->free(base_root_);
   // root_ is part of base_root_.
   db_->page_pool(0)->free(reinterpret_cast<char*>(page_numa_ids_));
+  db_->page_pool(0)->free(reinterpret_cast<char*>(
+      const_cast<uint32_t*>(page_dirty_epochs_)));
+}
+
+template <class StaticConfig>
+void Table<StaticConfig>::save_state(SavedStateWriter& w) const {
+  w.write(cf_count_);
+  w.write(total_rh_size_);
+  w.write(second_level_width_);
+  w.write(base_root_);
+  w.write(uint64_t(reinterpret_cast<char*>(root_) - base_root_));
+  w.write(page_numa_ids_);
+  w.write(page_dirty_epochs_);
+  w.write(uint32_t(dirty_epoch_));
+  w.write(row_count_);
+}
+
+template <class StaticConfig>
+bool Table<StaticConfig>::restore_state(SavedStateReader& r) {
+  uint16_t cf_count;
+  uint64_t total_rh_size;
+  uint64_t second_level_width;
+  char* base_root;
+  uint64_t root_off;
+  uint8_t* page_numa_ids;
+  volatile uint32_t* page_dirty_epochs;
+  uint32_t dirty_epoch;
+  uint64_t row_count;
+  if (!r.read(&cf_count) || !r.read(&total_rh_size) ||
+      !r.read(&second_level_width) || !r.read(&base_root) ||
+      !r.read(&root_off) || !r.read(&page_numa_ids) ||
+      !r.read(&page_dirty_epochs) || !r.read(&dirty_epoch) ||
+      !r.read(&row_count))
+    return false;
+
+  // The table must have the same layout.
+  if (cf_count != cf_count_ || total_rh_size != total_rh_size_ ||
+      second_level_width != second_level_width_) {
+    printf("table %" PRIu16 " does not match the saved table\n", id_);
+    return false;
+  }
+
+  db_->page_pool(0)->free(base_root_);
+  db_->page_pool(0)->free(reinterpret_cast<char*>(page_numa_ids_));
+  db_->page_pool(0)->free(reinterpret_cast<char*>(
+      const_cast<uint32_t*>(page_dirty_epochs_)));
+
+  base_root_ = base_root;
+  root_ = reinterpret_cast<char**>(base_root_ + root_off);
+  page_numa_ids_ = page_numa_ids;
+  page_dirty_epochs_ = page_dirty_epochs;
+  dirty_epoch_ = dirty_epoch;
+  row_count_ = row_count;
+  return true;
 }
 
 template <class StaticConfig>
@@ -390,16 +456,31 @@ template <class StaticConfig>
 template <typename Func>
 bool Table<StaticConfig>::scan(Transaction<StaticConfig>* tx, uint16_t cf_id,
                                uint64_t off, uint64_t len, const Func& f) {
+  return scan(tx, cf_id, off, len, 0, row_count_, f);
+}
+
+template <class StaticConfig>
+template <typename Func>
+bool Table<StaticConfig>::scan(Transaction<StaticConfig>* tx, uint16_t cf_id,
+                               uint64_t off, uint64_t len,
+                               uint64_t row_id_begin, uint64_t row_id_end,
+                               const Func& f) {
   RowAccessHandlePeekOnly<StaticConfig> rah(tx);
 
   uint64_t row_count = row_count_;
-  for (uint64_t row_id = 0; row_id < row_count; row_id++) {
+  if (row_id_end > row_count) row_id_end = row_count;
+  for (uint64_t row_id = row_id_begin; row_id < row_id_end; row_id++) {
     if (head(cf_id, row_id)->older_rv == nullptr) continue;
 
-    if (row_id + 16 < row_count_)
+    if (row_id + 16 < row_id_end)
       rah.prefetch_row(this, cf_id, row_id + 16, off, len);
 
-    if (!rah.peek_row(this, cf_id, row_id, false, false, false)) return false;
+    if (!rah.peek_row(this, cf_id, row_id, false, false, false)) {
+      // A peek-only snapshot does not see rows deleted before or inserted
+      // after its timestamp.
+      if (tx->is_peek_only()) continue;
+      return false;
+    }
 
     f(rah);
 
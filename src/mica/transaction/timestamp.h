@@ -51,6 +51,8 @@ struct CompactTimestamp {
     // during the subtraction.
     return ((t2 | 0xff) - (b.t2 | 0xff)) >> 8;
   }
+
+  uint64_t clock() const { return t2 >> 8; }
 };
 
 struct CompactConcurrentTimestamp {
@@ -146,6 +148,8 @@ struct WideTimestamp {
     uint64_t b_tsc = (b.t1 << 32) | (b.t2 >> 32);
     return tsc - b_tsc;
   }
+
+  uint64_t clock() const { return (t1 << 32) | (t2 >> 32); }
 };
 
 struct WideConcurrentTimestamp {
@@ -266,6 +270,9 @@ struct CentralizedTimestamp {
     return t2 - b.t2;
   }
 
+  // Not meaningful either.
+  uint64_t clock() const { return t2; }
+
  private:
   static volatile uint64_t next_t2;
 };
@@ -21,6 +21,7 @@ enum class Result {
   kAbortedByDeferredRowVersionInsert,
   kAbortedByMainValidation,
   kAbortedByLogging,
+  kAbortedBySecondaryIndexUpdate,
   kInvalid,
 };
 
@@ -99,6 +100,46 @@ class Transaction {
 
   const Timestamp& ts() const { return ts_; }
 
+  // For command logging (see CommandLogger).  Records the stored procedure and
+  // its arguments that produce the writes of this transaction.  args must stay
+  // valid until commit() returns.  Cleared by begin().
+  void set_command(uint16_t proc_id, const void* args, uint32_t args_size) {
+    has_command_ = true;
+    command_proc_id_ = proc_id;
+    command_args_ = reinterpret_cast<const char*>(args);
+    command_args_size_ = args_size;
+  }
+  bool has_command() const { return has_command_; }
+  uint16_t command_proc_id() const { return command_proc_id_; }
+  const char* command_args() const { return command_args_; }
+  uint32_t command_args_size() const { return command_args_size_; }
+
+  // For transactions that apply shipped logs on a replica (see
+  // ReplicaApplier).  Their logs already have the rows of index tables, so
+  // commit() only updates the secondary indexes without tables.  Only these
+  // transactions may give new_row() an explicit row ID for column family 0.
+  void set_applies_log(bool applies_log) { applies_log_ = applies_log; }
+  bool applies_log() const { return applies_log_; }
+
+  // For indexes that keep their entries outside the row store (see
+  // OLCBTreeIndex).  An index adds itself once in a transaction that uses it.
+  // commit() calls validate() along with the main validation and commit()
+  // after the write phase; abort() calls abort().  Cleared by begin().
+  struct ExternalIndex {
+    void* idx;
+    bool (*validate)(void* idx, Transaction* tx);
+    void (*commit)(void* idx, Transaction* tx);
+    void (*abort)(void* idx, Transaction* tx);
+  };
+  void add_external_index(const ExternalIndex& ext_idx) {
+    external_idxs_.push_back(ext_idx);
+  }
+  bool has_external_index(const void* idx) const {
+    for (auto& ext_idx : external_idxs_)
+      if (ext_idx.idx == idx) return true;
+    return false;
+  }
+
   // For logging an verification.
   uint16_t access_size() const { return access_size_; }
   uint16_t iset_size() const { return iset_size_; }
@@ -127,6 +168,8 @@ class Transaction {
 
   // transaction_impl/commit.h
   Timestamp generate_timestamp();
+  bool update_secondary_indexes();
+  bool validate_external_indexes();
   void sort_wset();
   bool check_version();
   void update_rts();
@@ -151,6 +194,11 @@ class Transaction {
 
   uint8_t peek_only_;
 
+  bool has_command_;
+  uint16_t command_proc_id_;
+  const char* command_args_;
+  uint32_t command_args_size_;
+
   uint64_t begin_time_;
   uint64_t* abort_reason_target_count_;
   uint64_t* abort_reason_target_time_;
@@ -187,6 +235,10 @@ class Transaction {
     bool write_hint;
   };
   std::vector<ReserveItem> to_reserve_;
+
+  std::vector<ExternalIndex> external_idxs_;
+
+  bool applies_log_;
 };
 }
 }
@@ -3,6 +3,7 @@
 #define MICA_TRANSACTION_TRANSACTION_IMPL_COMMIT_H_
 
 #include <algorithm>  // For std::sort().
+#include <cstring>
 #include <unistd.h>
 
 namespace mica {
@@ -29,6 +30,8 @@ bool Transaction<StaticConfig>::begin(bool peek_only,
 
   peek_only_ = peek_only;
 
+  has_command_ = false;
+
   if (StaticConfig::kCollectExtraCommitStats) {
     abort_reason_target_count_ = &ctx_->stats().aborted_by_application_count;
     abort_reason_target_time_ = &ctx_->stats().aborted_by_application_time;
@@ -77,11 +80,76 @@ bool Transaction<StaticConfig>::begin(bool peek_only,
 
   access_bucket_count_ = 0;
 
+  external_idxs_.clear();
+
   if (StaticConfig::kVerbose) printf("begin: ts=%" PRIu64 "\n", ts_.t2);
 
   return true;
 }
 
+template <class StaticConfig>
+bool Transaction<StaticConfig>::update_secondary_indexes() {
+  // Index updates add more rows to the write set; only the rows written by
+  // the application need index updates.
+  auto iset_size = iset_size_;
+  auto wset_size = wset_size_;
+
+  for (auto j = 0; j < iset_size + wset_size; j++) {
+    auto item = &accesses_[j < iset_size ? iset_idx_[j]
+                                         : wset_idx_[j - iset_size]];
+    auto& sidxs = item->tbl->secondary_indexes();
+    if (sidxs.empty()) continue;
+
+    const char* old_data = nullptr;
+    const char* new_data = nullptr;
+    switch (item->state) {
+      case RowAccessState::kNew:
+        new_data = item->write_rv->data;
+        break;
+      case RowAccessState::kWrite:
+      case RowAccessState::kReadWrite:
+        old_data = item->read_rv->data;
+        new_data = item->write_rv->data;
+        break;
+      case RowAccessState::kDelete:
+      case RowAccessState::kReadDelete:
+        old_data = item->read_rv->data;
+        break;
+      default:
+        // Deleted new rows.
+        continue;
+    }
+
+    for (auto& sidx : sidxs) {
+      if (sidx.cf_id != item->cf_id) continue;
+      if (applies_log_ && !sidx.external) continue;
+
+      auto old_key = old_data == nullptr ? nullptr : old_data + sidx.key_offset;
+      auto new_key = new_data == nullptr ? nullptr : new_data + sidx.key_offset;
+      assert(old_key == nullptr ||
+             sidx.key_offset + sidx.key_size <= item->read_rv->data_size);
+      assert(new_key == nullptr ||
+             sidx.key_offset + sidx.key_size <= item->write_rv->data_size);
+
+      // Updates that do not touch the key need no index update.
+      if (old_key != nullptr && new_key != nullptr &&
+          ::memcmp(old_key, new_key, sidx.key_size) == 0)
+        continue;
+
+      if (!sidx.update(sidx.idx, this, item->row_id, old_key, new_key))
+        return false;
+    }
+  }
+  return true;
+}
+
+template <class StaticConfig>
+bool Transaction<StaticConfig>::validate_external_indexes() {
+  for (auto& ext_idx : external_idxs_)
+    if (!ext_idx.validate(ext_idx.idx, this)) return false;
+  return true;
+}
+
 template <class StaticConfig>
 void Transaction<StaticConfig>::sort_wset() {
   // Sort the write set's rows by contention level in descending order (high
@@ -196,6 +264,8 @@ void Transaction<StaticConfig>::write() {
       item->write_rv->status = RowVersionStatus::kDeleted;
     else
       item->write_rv->status = RowVersionStatus::kCommitted;
+
+    if (StaticConfig::kTrackDirtyPages) item->tbl->mark_dirty(item->row_id);
   }
 
   ::mica::util::memory_barrier();
@@ -274,6 +344,17 @@ bool Transaction<StaticConfig>::commit(Result* detail,
     }
   }
 
+  {
+    t.switch_to(&Stats::index_write);
+    if (StaticConfig::kVerbose)
+      printf("secondary_index_update: ts=%" PRIu64 "\n", ts_.t2);
+    if (!update_secondary_indexes()) {
+      abort();
+      if (detail != nullptr) *detail = Result::kAbortedBySecondaryIndexUpdate;
+      return false;
+    }
+  }
+
   if (consecutive_commits_ < 5) {
     if (StaticConfig::kSortWriteSetByContention) {
       t.switch_to(&Stats::sort_wset);
@@ -328,7 +409,7 @@ bool Transaction<StaticConfig>::commit(Result* detail,
     t.switch_to(&Stats::main_validation);
     if (StaticConfig::kVerbose)
       printf("main_validation: ts=%" PRIu64 "\n", ts_.t2);
-    if (!check_version()) {
+    if (!check_version() || !validate_external_indexes()) {
       if (StaticConfig::kCollectExtraCommitStats) {
         abort_reason_target_count_ =
             &ctx_->stats().aborted_by_main_validation_count;
@@ -366,6 +447,9 @@ bool Transaction<StaticConfig>::commit(Result* detail,
     insert_row_deferred();
 
     write();
+
+    for (auto& ext_idx : external_idxs_) ext_idx.commit(ext_idx.idx, this);
+    external_idxs_.clear();
   }
 
   // }    // if (peek_only_)
@@ -406,6 +490,9 @@ bool Transaction<StaticConfig>::abort(bool skip_backoff) {
 
   if (StaticConfig::kVerbose) printf("abort: ts=%" PRIu64 "\n", ts_.t2);
 
+  for (auto& ext_idx : external_idxs_) ext_idx.abort(ext_idx.idx, this);
+  external_idxs_.clear();
+
   // Delete the last insert first so that we clean up any newly allocated row
   // IDs after cleaning up related versions.
   uint16_t j = iset_size_;
@@ -414,6 +501,9 @@ bool Transaction<StaticConfig>::abort(bool skip_backoff) {
     auto i = iset_idx_[j];
     auto item = &accesses_[i];
 
+    // New rows deleted in this transaction have been released already.
+    if (item->state == RowAccessState::kInvalid) continue;
+
     assert(item->write_rv != nullptr);
 
     assert(!item->inserted);
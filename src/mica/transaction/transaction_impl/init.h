@@ -6,7 +6,7 @@ namespace mica {
 namespace transaction {
 template <class StaticConfig>
 Transaction<StaticConfig>::Transaction(Context<StaticConfig>* ctx)
-    : ctx_(ctx), began_(false) {
+    : ctx_(ctx), began_(false), has_command_(false), applies_log_(false) {
   last_commit_time_ = 0;
 
   access_buckets_.resize(StaticConfig::kAccessBucketRootCount);
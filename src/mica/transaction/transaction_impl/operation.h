@@ -24,9 +24,13 @@ bool Transaction<StaticConfig>::new_row(RAH& rah, Table<StaticConfig>* tbl,
   if (rah) return false;
 
   if (cf_id == 0) {
-    if (row_id != kNewRowID) return false;
-
-    row_id = ctx_->allocate_row(tbl);
+    // An explicit row ID is used only by replicas (see ReplicaApplier).
+    if (row_id == kNewRowID)
+      row_id = ctx_->allocate_row(tbl);
+    else if (applies_log_)
+      row_id = ctx_->allocate_row(tbl, row_id);
+    else
+      return false;
     if (row_id == static_cast<uint64_t>(-1)) {
       // TODO: Use different stats counter.
       if (StaticConfig::kCollectExtraCommitStats) {
@@ -118,9 +122,9 @@ bool Transaction<StaticConfig>::new_row(RAH& rah, Table<StaticConfig>* tbl,
   iset_idx_[iset_size_++] = access_size_;
   rah.access_item_ = &accesses_[access_size_];
   accesses_[access_size_] = {access_size_, 0,     RowAccessState::kNew,
-                             tbl,          cf_id, row_id,
-                             head,         head,  write_rv,
-                             nullptr /*, ts_*/};
+                             0,            tbl,   cf_id,
+                             0,            row_id, head,
+                             head,         write_rv, nullptr /*, ts_*/};
   access_size_++;
 
   return true;
@@ -181,8 +185,10 @@ bool Transaction<StaticConfig>::peek_row(RAH& rah, Table<StaticConfig>* tbl,
     while (true) {
       for (auto i = 0; i < bkt->count; i++) {
         auto item = &accesses_[bkt->idx[i]];
+        // A row deleted right after its creation has an invalid item, and
+        // its row ID may have been given to another new row.
         if (item->row_id == row_id && item->tbl == tbl &&
-            item->cf_id == cf_id) {
+            item->cf_id == cf_id && item->state != RowAccessState::kInvalid) {
           rah.access_item_ = item;
           return true;
         }
@@ -277,8 +283,10 @@ bool Transaction<StaticConfig>::peek_row(RAH& rah, Table<StaticConfig>* tbl,
   accesses_[access_size_] = {access_size_,
                              0,
                              RowAccessState::kPeek,
+                             0,
                              tbl,
                              cf_id,
+                             0,
                              row_id,
                              head,
                              newer_rv,
@@ -312,7 +320,7 @@ bool Transaction<StaticConfig>::peek_row(RAHPO& rah, Table<StaticConfig>* tbl,
       for (auto i = 0; i < bkt->count; i++) {
         auto item = &accesses_[bkt->idx[i]];
         if (item->row_id == row_id && item->tbl == tbl &&
-            item->cf_id == cf_id) {
+            item->cf_id == cf_id && item->state != RowAccessState::kInvalid) {
           rah.tbl_ = item->tbl;
           rah.cf_id_ = item->cf_id;
           rah.row_id_ = item->row_id;
@@ -671,6 +679,8 @@ void Transaction<StaticConfig>::insert_row_deferred() {
     item->write_rv->status = RowVersionStatus::kCommitted;
 
     item->inserted = 1;
+
+    if (StaticConfig::kTrackDirtyPages) item->tbl->mark_dirty(item->row_id);
   }
 }
 